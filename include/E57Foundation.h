@@ -338,7 +338,8 @@ class CompressedVectorReader {
 public:
     unsigned    read();
     unsigned    read(std::vector<SourceDestBuffer>& dbufs);
-    void        seek(int64_t recordNumber); // !!! not implemented yet
+    void        seek(int64_t recordNumber);
+    int64_t     lostRecords(std::vector<int64_t>& startRecord, std::vector<int64_t>& recordCount);
     void        close();
     bool        isOpen();
     CompressedVectorNode compressedVectorNode() const;
@@ -365,6 +366,14 @@ public:
     void        close();
     bool        isOpen();
     CompressedVectorNode compressedVectorNode() const;
+    bool        sourceRange(const ustring& pathName, double& minimum, double& maximum) const;
+    void        trackGroups(const ustring& idPathName, const std::vector<ustring>& rangePathNames);
+    bool        sourceGroups(std::vector<int64_t>& idValue, std::vector<int64_t>& startRecord, std::vector<int64_t>& recordCount,
+                             std::vector<double>& minimum, std::vector<double>& maximum) const;
+    void        trackChunks(int64_t chunkRecordCount, const std::vector<ustring>& rangePathNames);
+    bool        sourceChunks(std::vector<double>& minimum, std::vector<double>& maximum) const;
+    void        trackSamples(int64_t sampleInterval);
+    bool        sourceSamples(std::vector<SourceDestBuffer>& sbufs) const;
 
     void        dump(int indent = 0, std::ostream& os = std::cout) const;
     void        checkInvariant(bool doRecurse = true);
@@ -660,6 +669,7 @@ protected: //=================
     friend class FloatNode;
     friend class StringNode;
     friend class BlobNode;
+    friend class CompressedVectorWriterImpl;
 
                     ImageFile(boost::shared_ptr<ImageFileImpl> imfi);  // internal use only
 
@@ -756,6 +766,26 @@ protected: //=================
 //! \endcond
 };
 
+//! @brief A corrupted page, binary section header or packet found by E57Utilities::checkIntegrity
+struct IntegrityError {
+    ErrorCode   errorCode;          //!< E57_ERROR_BAD_CHECKSUM for a page, E57_ERROR_BAD_CV_HEADER or E57_ERROR_BAD_CV_PACKET for a CompressedVector section, ...
+    uint64_t    physicalOffset;     //!< Offset in the file of the start of the bad page, section header or packet
+    ustring     context;            //!< Details of the check that failed
+};
+
+//! @brief Summary of the structural checks done by E57Utilities::checkIntegrity
+struct IntegrityReport {
+    uint64_t    fileLength;             //!< Physical length of the file in bytes
+    uint64_t    pageCount;              //!< Number of pages whose checksum was verified
+    uint64_t    badPageCount;           //!< Number of pages with a bad checksum
+    uint64_t    sectionCount;           //!< Number of CompressedVector binary sections whose packets were walked
+    uint64_t    packetCount;            //!< Number of good packets in those sections
+    uint64_t    errorCount;             //!< Total number of problems found, may be more than errors.size()
+    std::vector<IntegrityError> errors; //!< The first problems found, in order of physicalOffset
+
+                IntegrityReport() : fileLength(0), pageCount(0), badPageCount(0), sectionCount(0), packetCount(0), errorCount(0) {};
+};
+
 class E57Utilities {
 public:
     // Constructor (does nothing for now)
@@ -770,6 +800,10 @@ public:
     // Direct read of XML representation in E57 file
     int64_t     rawXmlLength(const ustring& fname);
     void        rawXmlRead(const ustring& fname, uint8_t* buf, int64_t start, size_t byteCount);
+    void        rawXmlCopy(const ustring& fname, std::ostream& os);
+
+    // Check page checksums and CompressedVector packet chains without reading any values
+    bool        checkIntegrity(const ustring& fname, IntegrityReport& report, size_t maxErrorCount = 1000);
 };
 
 #ifndef DOXYGEN
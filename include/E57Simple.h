@@ -57,6 +57,8 @@
 #include "E57Foundation.h"
 #endif
 
+#include <functional>
+
 using namespace std;
 using namespace boost;
 
@@ -68,6 +70,7 @@ namespace e57 {
 
 class ReaderImpl;
 class WriterImpl;
+class Data3DIteratorImpl;
 
 ////////////////////////////////////////////////////////////////////
 //
@@ -285,6 +288,7 @@ public:
 	ustring		idElementName;		//!< The name of the PointRecord element that identifies which group the point is in. The value of this string must be rowIndex or columnIndex
 	int64_t		groupsSize;			//!< Size of the groups compressedVector of LineGroupRecord structures
 	int64_t		pointCountSize;		//!< This is the size value for the e57::LineGroupRecord::pointCount.
+	bool		generateGroups;		//!< Writer only: if true, the groups and their cartesianBounds are collected from the idElementName values as the points are written, and written by e57::Writer::Close(). A groupsSize or pointCountSize of 0 is then taken from the index maximum or the pointsSize.
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -352,6 +356,9 @@ public:
 #define E57_NOT_SCALED_USE_FLOAT		0.
 #define E57_NOT_SCALED_USE_INTEGER  -1.
 
+#define E57_LIBE57_PREFIX	"libe57"								//!< Namespace prefix of the elements libe57 adds to a file
+#define E57_LIBE57_URI		"http://www.libe57.org/extensions/v1.0"	//!< Namespace URI of the elements libe57 adds to a file
+
 ////////////////////////////////////////////////////////////////////
 //
 //	e57::PointRecord
@@ -390,6 +397,124 @@ public:
 	bool		isColorInvalid;		//!< Indicates whether the colorRed, colorBlue, and colorGreen elements are meaningful. Value = 0 if the color is considered valid, 1 otherwise. Shall be in the interval [0, 1].
 };
 
+////////////////////////////////////////////////////////////////////
+//
+//	e57::Data3DPointsData_t
+//
+//! @brief The e57::Data3DPointsData_t is a set of buffers for the fields of the PointRecord, each with one element per point.
+/*! @details The COORDTYPE template parameter is the type of the cartesian, spherical, intensity and timeStamp buffers.
+With float, values are converted directly between the file and single precision buffers, without an intermediate double buffer.
+With int32_t, ScaledInteger fields are transferred as raw integers, without applying the scale and offset.
+Buffers that are left NULL are not transferred. Used with the Reader and Writer SetUpData3DPointsData() functions.
+*/
+
+template <typename COORDTYPE>
+class Data3DPointsData_t {
+public:
+	COORDTYPE*	cartesianX;			//!< pointer to a buffer with the X coordinate (in meters) of the point in Cartesian coordinates
+	COORDTYPE*	cartesianY;			//!< pointer to a buffer with the Y coordinate (in meters) of the point in Cartesian coordinates
+	COORDTYPE*	cartesianZ;			//!< pointer to a buffer with the Z coordinate (in meters) of the point in Cartesian coordinates
+	int8_t*		cartesianInvalidState;	//!< Value = 0 if the point is considered valid, 1 otherwise
+
+	COORDTYPE*	intensity;			//!< pointer to a buffer with the Point response intensity. Unit is unspecified
+	int8_t*		isIntensityInvalid;	//!< Value = 0 if the intensity is considered valid, 1 otherwise
+
+	uint16_t*	colorRed;			//!< pointer to a buffer with the Red color coefficient. Unit is unspecified
+	uint16_t*	colorGreen;			//!< pointer to a buffer with the Green color coefficient. Unit is unspecified
+	uint16_t*	colorBlue;			//!< pointer to a buffer with the Blue color coefficient. Unit is unspecified
+	int8_t*		isColorInvalid;		//!< Value = 0 if the color is considered valid, 1 otherwise
+
+	COORDTYPE*	sphericalRange;		//!< pointer to a buffer with the range (in meters) of points in spherical coordinates. Shall be non-negative
+	COORDTYPE*	sphericalAzimuth;	//!< pointer to a buffer with the Azimuth angle (in radians) of point in spherical coordinates
+	COORDTYPE*	sphericalElevation;	//!< pointer to a buffer with the Elevation angle (in radians) of point in spherical coordinates
+	int8_t*		sphericalInvalidState; //!< Value = 0 if the range is considered valid, 1 otherwise
+
+	int32_t*	rowIndex;			//!< pointer to a buffer with the row number of point (zero based). This is useful for data that is stored in a regular grid.
+	int32_t*	columnIndex;		//!< pointer to a buffer with the column number of point (zero based). This is useful for data that is stored in a regular grid.
+	int8_t*		returnIndex;		//!< pointer to a buffer with the number of this return (zero based). Only for multi-return sensors.
+	int8_t*		returnCount;		//!< pointer to a buffer with the total number of returns for the pulse that this corresponds to. Only for multi-return sensors.
+
+	COORDTYPE*	timeStamp;			//!< pointer to a buffer with the time (in seconds) since the start time for the data, which is given by acquisitionStart in the parent Data3D Structure.
+	int8_t*		isTimeStampInvalid;	//!< Value = 0 if the timeStamp is considered valid, 1 otherwise
+
+//! @brief This function is the constructor for the Data3DPointsData_t class, all buffers start NULL
+	Data3DPointsData_t()
+	: cartesianX(NULL), cartesianY(NULL), cartesianZ(NULL), cartesianInvalidState(NULL)
+	, intensity(NULL), isIntensityInvalid(NULL)
+	, colorRed(NULL), colorGreen(NULL), colorBlue(NULL), isColorInvalid(NULL)
+	, sphericalRange(NULL), sphericalAzimuth(NULL), sphericalElevation(NULL), sphericalInvalidState(NULL)
+	, rowIndex(NULL), columnIndex(NULL), returnIndex(NULL), returnCount(NULL)
+	, timeStamp(NULL), isTimeStampInvalid(NULL) {};
+};
+
+typedef Data3DPointsData_t<double>	Data3DPointsData;		//!< Buffers with double precision values
+typedef Data3DPointsData_t<float>	Data3DPointsFloatData;	//!< Buffers with single precision values
+typedef Data3DPointsData_t<int32_t>	Data3DPointsRawData;	//!< Buffers with raw (unscaled) ScaledInteger values
+
+////////////////////////////////////////////////////////////////////
+//
+//	e57::PointFieldsMask
+//
+//! @brief The e57::PointFieldsMask selects the groups of PointRecord fields loaded by e57::Reader::LoadData3D
+enum PointFieldsMask {
+	E57_POINT_CARTESIAN				= 0x0001,	//!< cartesianX, cartesianY and cartesianZ
+	E57_POINT_CARTESIAN_INVALID		= 0x0002,	//!< cartesianInvalidState
+	E57_POINT_SPHERICAL				= 0x0004,	//!< sphericalRange, sphericalAzimuth and sphericalElevation
+	E57_POINT_SPHERICAL_INVALID		= 0x0008,	//!< sphericalInvalidState
+	E57_POINT_INTENSITY				= 0x0010,	//!< intensity
+	E57_POINT_INTENSITY_INVALID		= 0x0020,	//!< isIntensityInvalid
+	E57_POINT_COLOR					= 0x0040,	//!< colorRed, colorGreen and colorBlue
+	E57_POINT_COLOR_INVALID			= 0x0080,	//!< isColorInvalid
+	E57_POINT_ROW_COLUMN			= 0x0100,	//!< rowIndex and columnIndex
+	E57_POINT_RETURN				= 0x0200,	//!< returnIndex and returnCount
+	E57_POINT_TIMESTAMP				= 0x0400,	//!< timeStamp
+	E57_POINT_TIMESTAMP_INVALID		= 0x0800,	//!< isTimeStampInvalid
+	E57_POINT_ALL					= 0x0FFF	//!< all the standardized fields
+};
+
+////////////////////////////////////////////////////////////////////
+//
+//	e57::PointCloud
+//
+//! @brief The e57::PointCloud holds all the points of a Data3D as one buffer per field (structure of arrays)
+/*! @details The buffers are the inherited Data3DPointsData pointers, which are NULL for fields that are not loaded.
+All the buffers are carved out of one allocation, each starting on a cache line boundary, and large allocations
+are aligned so that the system can back them with huge pages. Filled by e57::Reader::LoadData3D.
+*/
+
+class PointCloud : public Data3DPointsData {
+public:
+//! @brief This function is the constructor for the PointCloud class
+					PointCloud(void);
+//! @brief This function is the destructor for the PointCloud class, it frees the buffers
+					~PointCloud(void);
+//! @brief This function frees the buffers and sets all the pointers to NULL
+	void			Reset(void);
+//! @brief This function returns the number of bytes Allocate() takes for pointCount points of the fieldsMask groups
+static	size_t		AllocationSize(
+						int64_t		pointCount,	//!< number of points per buffer
+						uint32_t	fieldsMask	//!< combination of e57::PointFieldsMask values
+						);
+//! @brief This function allocates pointCount elements for every field group in fieldsMask, discarding any previous contents
+	void			Allocate(
+						int64_t		pointCount,	//!< number of points per buffer
+						uint32_t	fieldsMask	//!< combination of e57::PointFieldsMask values
+						);
+
+	int64_t			pointCount;		//!< Number of points in each of the buffers
+	uint32_t		fieldsMask;		//!< The e57::PointFieldsMask field groups that have buffers
+private:
+					PointCloud(const PointCloud &);				// The buffers are owned, no copy
+	PointCloud &	operator=(const PointCloud &);
+
+	void *			storage_;		//!< Allocation holding all the buffers
+};
+
+//! @brief The e57::Data3DPointsFunction is called by e57::Reader::ForEachData3DParallel with all the points of a Data3D
+/*! @details It returns false to stop the other Data3D from being loaded. The PointCloud is freed when it returns.
+*/
+typedef std::function<bool(int32_t dataIndex, PointCloud & pointCloud)>	Data3DPointsFunction;
+
 ////////////////////////////////////////////////////////////////////
 //
 //	e57::Data3D
@@ -435,6 +560,8 @@ public:
 	e57::PointStandardizedFieldsAvailable pointFields;	//!< This defines the active fields used in the WritePoints function.
 
 	int64_t			pointsSize;				//!< Total size of the compressed vector of PointRecord structures referring to the binary data that actually stores the point data
+	int64_t			pointChunkSize;			//!< Writer only: if > 0, the cartesianBounds of every pointChunkSize points are collected as the points are written, and stored by e57::Writer::Close() in the "libe57:pointChunks" extension for e57::Reader::ReadPointsInBox.
+	int64_t			pointPreviewStride;		//!< If > 0, every pointPreviewStride-th point is also stored by e57::Writer::Close() in the "libe57:preview" extension, a decimated copy of the points that e57::Reader::ReadData3DPreview reads quickly. Set by the Reader from the file, 0 if there is no preview.
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -586,7 +713,8 @@ public:
 
 //! @brief This function is the constructor for the reader class
 				Reader(
-					const ustring & filePath		//!< file path string
+					const ustring & filePath,		//!< file path string
+					const ustring & configuration = ""	//!< options passed to ImageFile, e.g. "lazyXml" to parse scan headers on first access
 					);
 //! @brief This function returns true if the file is open
 	bool		IsOpen(void) const;
@@ -594,6 +722,18 @@ public:
 //! @brief This function closes the file
 	bool		Close(void) const;
 
+//! @brief This function makes LoadData3D, ForEachData3DParallel and Data3DIterator return the points in other coordinates
+/*! @details With applyPose the cartesian coordinates are moved by the pose of their Data3D, then by the transform when it
+is not NULL. They are transformed block by block as they are decoded, so no second pass over the points is needed. While
+a transform is set, the cartesian coordinates of a Data3D that only has spherical coordinates are computed from them
+(the Data3DIterator batches then hold the spherical coordinates as well, and their cartesianInvalidState is the
+sphericalInvalidState). Call with false and NULL to get the points as stored. The other read functions are not affected.
+*/
+	bool		SetPointTransform(
+						bool		applyPose,				//!< move the points by the pose of their Data3D
+						const RigidBodyTransform * transform = NULL	//!< applied after the pose, NULL for none
+						) const;					//!< @return Return true if sucessful, false otherwise
+
 ////////////////////////////////////////////////////////////////////
 //
 //	File information
@@ -729,6 +869,123 @@ Call the CompressedVectorReader::read() until all data is read.
 
 						) const;					//!< @return Return true if sucessful, false otherwise
 
+//! @brief This function sets up the point data fields to be read straight into buffers of the given type
+/*! @details See e57::Data3DPointsData_t. All the non-NULL buffers have number of elements = pointCount.
+Call the CompressedVectorReader::read() until all data is read.
+*/
+	CompressedVectorReader	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each element buffer.
+						const Data3DPointsData_t<double> & buffers,	//!< buffers to receive the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers) = NULL
+						) const;					//!< @return Returns the reader for the points
+	CompressedVectorReader	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each element buffer.
+						const Data3DPointsData_t<float> & buffers,	//!< buffers to receive the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers) = NULL
+						) const;					//!< @return Returns the reader for the points
+	CompressedVectorReader	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each element buffer.
+						const Data3DPointsData_t<int32_t> & buffers,	//!< buffers to receive the point fields, ScaledInteger fields are not scaled
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers) = NULL
+						) const;					//!< @return Returns the reader for the points
+
+//! @brief This function reads all the points of a Data3D into a PointCloud
+/*! @details The buffers are sized from the number of records in the "points" CompressedVector and only
+the field groups of fieldsMask that are present in the scan are allocated; the pointCloud.fieldsMask tells which.
+The points are decoded in large blocks. With threadCount > 1 the fields are split between several threads,
+each reading the file through its own ImageFile, so the binary section is read once per thread.
+*/
+	bool		LoadData3D(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values, like E57_POINT_ALL
+						PointCloud &	pointCloud,	//!< receives the points
+						int			threadCount = 1	//!< number of threads decoding the fields
+						) const;					//!< @return Return true if sucessful, false otherwise
+
+//! @brief This function reads all the points of every Data3D of the file, several Data3D at a time
+/*! @details Each thread reads the file through its own ImageFile and loads one Data3D after the other into a
+PointCloud, as LoadData3D does, then calls the function with it. The Data3D are taken largest first by pointsSize,
+so that a large scan doesn't start last and hold up the end. The function is called from several threads at once,
+and must not use this Reader; at most threadCount PointClouds are held at a time.
+*/
+	bool		ForEachData3DParallel(
+						uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values, like E57_POINT_ALL
+						const Data3DPointsFunction & function,	//!< called with the points of each Data3D
+						int			threadCount = 0	//!< number of Data3D loaded at a time, 0 for the number of hardware threads
+						) const;					//!< @return Return true if every Data3D was loaded and the function returned true, false otherwise
+
+//! @brief This function reads whole lines of a gridded Data3D, the lines are rows or columns as given by the groupingByLine idElementName
+/*! @details The groupingByLine groups tell where each line starts in the "points" CompressedVector, and the reader
+seeks there, so only the data packets holding the lines are decoded. The lines are stored one after the other in the
+buffers in file order; lines that have no group are skipped. Only the non-NULL buffers of fields in the scan are filled.
+*/
+	bool		ReadData3DLines(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						int64_t		firstLine,		//!< idElementValue of the first line to read
+						int64_t		lineCount,		//!< number of lines to read
+						const Data3DPointsData & buffers,	//!< buffers to receive the points
+						int64_t		bufferSize,		//!< number of elements in each of the buffers
+						int64_t &	pointCount		//!< receives the number of points stored in the buffers
+						) const;					//!< @return Return true if all the points fit in the buffers, false otherwise
+
+//! @brief This function reads a rectangular window of the row/column grid of a gridded Data3D
+/*! @details Reads the lines of the window like ReadData3DLines and keeps the points with a row and column index
+inside the window. When a line holds every index of the indexBounds once in increasing order, only the part of the
+line inside the window is decoded.
+*/
+	bool		ReadData3DWindow(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						int64_t		firstRow,		//!< rowIndex of the first row of the window
+						int64_t		rowCount,		//!< number of rows in the window
+						int64_t		firstColumn,	//!< columnIndex of the first column of the window
+						int64_t		columnCount,	//!< number of columns in the window
+						const Data3DPointsData & buffers,	//!< buffers to receive the points
+						int64_t		bufferSize,		//!< number of elements in each of the buffers
+						int64_t &	pointCount		//!< receives the number of points stored in the buffers
+						) const;					//!< @return Return true if all the points fit in the buffers, false otherwise
+
+//! @brief This function reads a decimated preview of the points of a Data3D, spread over the whole scan
+/*! @details The points come from the "libe57:preview" extension of the Data3D (see e57::Data3D::pointPreviewStride),
+so only about pointsSize/pointPreviewStride points are decoded. Without a preview every k-th point of the scan is
+kept, which decodes all the points. When there are more preview points than bufferSize, every k-th of them is kept
+so that the result still covers the scan; preview point i is then point i*k*pointPreviewStride of the scan.
+Only the non-NULL buffers of fields in the scan are filled.
+*/
+	bool		ReadData3DPreview(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						const Data3DPointsData & buffers,	//!< buffers to receive the points
+						int64_t		bufferSize,		//!< number of elements in each of the buffers
+						int64_t &	pointCount		//!< receives the number of points stored in the buffers
+						) const;					//!< @return Return true if sucessful, false otherwise
+
+//! @brief This function reads the points of a Data3D that are inside a box
+/*! @details Only the chunks of points whose bounds overlap the box are decoded, the reader seeks past the others.
+The chunk bounds come from the "libe57:pointChunks" extension of the Data3D (see e57::Data3D::pointChunkSize),
+else from a point chunk index file made by BuildPointChunkIndex next to the file, else from the cartesianBounds of
+the line groups. Without any of them all the points are decoded. The points are stored in file order and only the
+non-NULL buffers of fields in the scan are filled; the box is in the local coordinates of the points.
+*/
+	bool		ReadPointsInBox(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						const CartesianBounds & box,	//!< bounds of the points to read, inclusive
+						const Data3DPointsData & buffers,	//!< buffers to receive the points
+						int64_t		bufferSize,		//!< number of elements in each of the buffers
+						int64_t &	pointCount		//!< receives the number of points stored in the buffers
+						) const;					//!< @return Return true if all the points fit in the buffers, false otherwise
+
+//! @brief This function makes a point chunk index file for all the Data3D of the file, in one pass over their points
+/*! @details The index file is an E57 file next to the file, its path followed by ".chunks", holding the file guid and,
+for the guid of each Data3D, the cartesianBounds of every chunkSize points. It is for files that were written without
+e57::Data3D::pointChunkSize. ReadPointsInBox ignores it if the file guid differs, as it does once the file is rewritten,
+or if its chunks don't cover exactly the points of the Data3D.
+*/
+	bool		BuildPointChunkIndex(
+						int64_t		chunkSize = 65536		//!< number of points per chunk
+						) const;					//!< @return Return true if sucessful, false otherwise
+
 ////////////////////////////////////////////////////////////////////
 //
 //	Raw File information
@@ -745,11 +1002,72 @@ private:   //=================
 					Reader();                 // No default constructor is defined for Node
 protected: //=================
     friend class	ReaderImpl;
+    friend class	Data3DIterator;
 
     E57_OBJECT_IMPLEMENTATION(Reader)  // Internal implementation details, not part of API, must be last in object
 
 }; //end Reader class
 
+////////////////////////////////////////////////////////////////////
+//
+//	e57::Data3DIterator
+//
+
+//! @brief The e57::Data3DIterator reads the points of a Data3D in batches that fit in a memory budget
+/*! @details The batch size is picked from the memory budget and the widths of the fields read: the field groups of
+fieldsMask that are present in the scan. The buffers are allocated once and reused for every batch, so the memory
+used does not depend on the number of points in the scan. This includes the data packet cache and channel buffers
+of the CompressedVectorReader, which have a fixed size.
+@code
+	Data3DIterator	points(reader, 0, E57_POINT_CARTESIAN, 64*1024*1024);
+	while(points.Next())
+		for(int64_t i = 0; i < points.PointCount(); i++)
+			use(points.Points().cartesianX[i], ...);
+@endcode
+*/
+class	Data3DIterator {
+public:
+
+//! @brief This function is the constructor for the iterator, the first batch is read by Next()
+					Data3DIterator(
+						const Reader &	reader,			//!< open reader, kept open while the iterator lives
+						int32_t		dataIndex,			//!< This in the index into the images3D vector
+						uint32_t	fieldsMask = E57_POINT_ALL,	//!< combination of e57::PointFieldsMask values
+						int64_t		memoryBudget = 64*1024*1024	//!< bytes the buffers and the decoders may use
+						);
+
+//! @brief This function is the destructor for the iterator
+					~Data3DIterator(void);
+
+//! @brief This function reads the next batch of points into the buffers
+	bool			Next(void);				//!< @return Return true if a batch was read, false at the end of the points
+
+//! @brief This function returns the buffers, the fields that are not read are NULL
+	const Data3DPointsData & Points(void) const;	//!< @return Returns the buffers holding the current batch
+
+//! @brief This function returns the number of points in the current batch, at most BatchSize()
+	int64_t			PointCount(void) const;	//!< @return Returns the number of points in the buffers
+
+//! @brief This function returns the index in the "points" CompressedVector of the first point of the current batch
+	int64_t			FirstPoint(void) const;	//!< @return Returns the index of the first point in the buffers
+
+//! @brief This function returns the number of elements in each of the buffers
+	int64_t			BatchSize(void) const;	//!< @return Returns the largest number of points in a batch
+
+//! @brief This function returns the e57::PointFieldsMask field groups that are read
+	uint32_t		FieldsMask(void) const;	//!< @return Returns the field groups that have buffers
+
+//! @brief This function releases the buffers and the file reader before the iterator is destroyed
+	void			Close(void);
+
+private:   //=================
+					Data3DIterator(const Data3DIterator &);		// The buffers are owned, no copy
+	Data3DIterator & operator=(const Data3DIterator &);
+
+    E57_OBJECT_IMPLEMENTATION(Data3DIterator)  // Internal implementation details, not part of API, must be last in object
+
+}; //end Data3DIterator class
+
 
 ////////////////////////////////////////////////////////////////////
 //
@@ -795,7 +1113,10 @@ public:
 						) const;						//!< @return Returns the number of bytes written
 
 //! @brief This function sets up the Data3D header and positions the cursor for the binary data
-//* @details The user needs to config a Data3D structure with all the scanning information before making this call. */
+/*! @details The user needs to config a Data3D structure with all the scanning information before making this call.
+The cartesianBounds, sphericalBounds and indexBounds that are left at their Reset() values are filled in by Close()
+from the range of the point values written, so they need no extra pass over the data. The pointFields ranges,
+intensityLimits and colorLimits still have to be given, they set how the points are encoded. */
 
 	int32_t		NewData3D( 
 						Data3D &	data3DHeader,	//!< pointer to the Data3D structure to receive the image information
@@ -834,6 +1155,28 @@ public:
 						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers) = NULL
 						) const ;		//!< @return Return true if sucessful, false otherwise
 
+//! @brief This function sets up the point data fields to be written straight from buffers of the given type
+/*! @details See e57::Data3DPointsData_t. All the non-NULL buffers have number of elements = pointCount.
+*/
+	CompressedVectorWriter	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each of the buffers given
+						const Data3DPointsData_t<double> & buffers,	//!< buffers with the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers) = NULL
+						) const;		//!< @return Returns the writer for the points
+	CompressedVectorWriter	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each of the buffers given
+						const Data3DPointsData_t<float> & buffers,	//!< buffers with the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers) = NULL
+						) const;		//!< @return Returns the writer for the points
+	CompressedVectorWriter	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each of the buffers given
+						const Data3DPointsData_t<int32_t> & buffers,	//!< buffers with the point fields, ScaledInteger fields are not scaled
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers) = NULL
+						) const;		//!< @return Returns the writer for the points
+
 
 //! @brief This funtion writes out the group data
 	bool		WriteData3DGroupsData(
@@ -37,43 +37,48 @@
 
 namespace e57 {
 
-struct LASPublicHeaderBlock {//                   file format#:  1.0 1.1 1.2 1.3
-    char      fileSignature[4];                     // required   4   4   4   4
-    uint16_t  fileSourceId;                         // required       2   2   2
-    uint8_t   gpsTimeType;                          // required           1b  1b
-    bool      waveformDataPacketsInternal;          // required               1b
-    bool      waveformDataPacketsExternal;          // required               1b
-    bool      returnNumbersSyntheticallyGenerated;  // required               1b
-    uint32_t  projectIdGuidData1;                   // optional   4   4   4   4
-    uint16_t  projectIdGuidData2;                   // optional   2   2   2   2
-    uint16_t  projectIdGuidData3;                   // optional   2   2   2   2
-    uint8_t   projectIdGuidData4[8];                // optional   8   8   8   8
-    uint8_t   versionMajor;                         // required   1   1   1   1
-    uint8_t   versionMinor;                         // required   1   1   1   1
-    char      systemIdentifier[32];                 // required  32  32  32  32
-    char      generatingSoftware[32];               // required  32  32  32  32
-    uint16_t  fileCreationDayOfYear;                // *=reqd     2   2   2   2*
-    uint16_t  fileCreationYear;                     // *=reqd     2   2   2   2*
-    uint16_t  headerSize;                           // required   2   2   2   2
-    uint32_t  offsetToPointData;                    // required   4   4   4   4
-    uint32_t  numberOfVariableLengthRecords;        // required   4   4   4   4
-    uint8_t   pointDataFormatId;                    // required   1   1   1   1
-    uint16_t  pointDataRecordLength;                // required   2   2   2   2
-    uint32_t  numberOfPointRecords;                 // required   4   4   4   4
-    uint32_t  numberOfPointsByReturn[7];            // required  20  20  20  28
-    double    xScaleFactor;                         // required   8   8   8   8
-    double    yScaleFactor;                         // required   8   8   8   8
-    double    zScaleFactor;                         // required   8   8   8   8
-    double    xOffset;                              // required   8   8   8   8
-    double    yOffset;                              // required   8   8   8   8
-    double    zOffset;                              // required   8   8   8   8
-    double    maxX;                                 // required   8   8   8   8
-    double    minX;                                 // required   8   8   8   8
-    double    maxY;                                 // required   8   8   8   8
-    double    minY;                                 // required   8   8   8   8
-    double    maxZ;                                 // required   8   8   8   8
-    double    minZ;                                 // required   8   8   8   8
-    uint64_t  startOfWaveformDataPacketRecord;      // required               8
+struct LASPublicHeaderBlock {//                   file format#:  1.0 1.1 1.2 1.3 1.4
+    char      fileSignature[4];                     // required   4   4   4   4   4
+    uint16_t  fileSourceId;                         // required       2   2   2   2
+    uint8_t   gpsTimeType;                          // required           1b  1b  1b
+    bool      waveformDataPacketsInternal;          // required               1b  1b
+    bool      waveformDataPacketsExternal;          // required               1b  1b
+    bool      returnNumbersSyntheticallyGenerated;  // required               1b  1b
+    bool      wellKnownTextCrs;                     // required                   1b
+    uint32_t  projectIdGuidData1;                   // optional   4   4   4   4   4
+    uint16_t  projectIdGuidData2;                   // optional   2   2   2   2   2
+    uint16_t  projectIdGuidData3;                   // optional   2   2   2   2   2
+    uint8_t   projectIdGuidData4[8];                // optional   8   8   8   8   8
+    uint8_t   versionMajor;                         // required   1   1   1   1   1
+    uint8_t   versionMinor;                         // required   1   1   1   1   1
+    char      systemIdentifier[32];                 // required  32  32  32  32  32
+    char      generatingSoftware[32];               // required  32  32  32  32  32
+    uint16_t  fileCreationDayOfYear;                // *=reqd     2   2   2   2*  2*
+    uint16_t  fileCreationYear;                     // *=reqd     2   2   2   2*  2*
+    uint16_t  headerSize;                           // required   2   2   2   2   2
+    uint32_t  offsetToPointData;                    // required   4   4   4   4   4
+    uint32_t  numberOfVariableLengthRecords;        // required   4   4   4   4   4
+    uint8_t   pointDataFormatId;                    // required   1   1   1   1   1
+    uint16_t  pointDataRecordLength;                // required   2   2   2   2   2
+    uint32_t  numberOfPointRecords;                 // required   4   4   4   4   4 (legacy, 0 if > 2^32-1 points)
+    uint32_t  numberOfPointsByReturn[7];            // required  20  20  20  20  20 (legacy)
+    double    xScaleFactor;                         // required   8   8   8   8   8
+    double    yScaleFactor;                         // required   8   8   8   8   8
+    double    zScaleFactor;                         // required   8   8   8   8   8
+    double    xOffset;                              // required   8   8   8   8   8
+    double    yOffset;                              // required   8   8   8   8   8
+    double    zOffset;                              // required   8   8   8   8   8
+    double    maxX;                                 // required   8   8   8   8   8
+    double    minX;                                 // required   8   8   8   8   8
+    double    maxY;                                 // required   8   8   8   8   8
+    double    minY;                                 // required   8   8   8   8   8
+    double    maxZ;                                 // required   8   8   8   8   8
+    double    minZ;                                 // required   8   8   8   8   8
+    uint64_t  startOfWaveformDataPacketRecord;      // required               8   8
+    uint64_t  startOfFirstExtendedVariableLengthRecord; // required               8
+    uint32_t  numberOfExtendedVariableLengthRecords;    // required               4
+    uint64_t  extendedNumberOfPointRecords;             // required               8
+    uint64_t  extendedNumberOfPointsByReturn[15];       // required             120
 
     /// Diagnostic functions:
     void        dump(int indent = 0, std::ostream& os = std::cout);
@@ -118,6 +123,49 @@ struct LASPointDataRecord {//              point format#: pf0 pf0 pf1 pf1 pf2 pf
                 LASPointDataRecord(){memset(this, 0, sizeof(*this));};
 };
 
+/// Point records decoded a block at a time, one array per field (see LASReader::readPointBlock).
+/// Only the arrays of fields present in the file's point data format are sized, the others are left empty
+///   (a/b = LAS 1.0 / LAS 1.1 and later). The 1.4 scanAngle is in units of 0.006 degrees.
+/// The coordinates are the raw integers of the file, the actual coordinate is x*xScaleFactor + xOffset
+/// using the scale factors and offsets of the LASPublicHeaderBlock.
+struct LASPointBlock {                                    //   point format#:  pf0-5       pf6-10
+    uint64_t                count;                        // number of records decoded into the arrays
+    std::vector<int32_t>    x;                            // required,         32           32
+    std::vector<int32_t>    y;                            // required,         32           32
+    std::vector<int32_t>    z;                            // required,         32           32
+    std::vector<uint16_t>   intensity;                    // optional,         16           16
+    std::vector<uint8_t>    returnNumber;                 // required,          3            4
+    std::vector<uint8_t>    numberOfReturns;              // required,          3            4
+    std::vector<uint8_t>    scanDirectionFlag;            // required,          1            1
+    std::vector<uint8_t>    edgeOfFlightLine;             // required,          1            1
+    std::vector<uint8_t>    classification;               // required,        8/5            8
+    std::vector<uint8_t>    synthetic;                    // required,        -/1            1
+    std::vector<uint8_t>    keyPoint;                     // required,        -/1            1
+    std::vector<uint8_t>    withheld;                     // required,        -/1            1
+    std::vector<uint8_t>    overlap;                      // required,                       1
+    std::vector<uint8_t>    scannerChannel;               // required,                       2
+    std::vector<int8_t>     scanAngleRank;                // required,          8
+    std::vector<int16_t>    scanAngle;                    // required,                      16
+    std::vector<uint8_t>    fileMarker;                   // optional,        8/-
+    std::vector<uint16_t>   userBitField;                 // optional,       16/-
+    std::vector<uint8_t>    userData;                     // optional,        -/8            8
+    std::vector<uint16_t>   pointSourceId;                // required,       -/16           16
+    std::vector<double>     gpsTime;                      // required, 64 pf1,3-5           64
+    std::vector<uint16_t>   red;                          // required, 16 pf2,3,5   16 pf7,8,10
+    std::vector<uint16_t>   green;                        // required, 16 pf2,3,5   16 pf7,8,10
+    std::vector<uint16_t>   blue;                         // required, 16 pf2,3,5   16 pf7,8,10
+    std::vector<uint16_t>   nir;                          // required,               16 pf8,10
+    std::vector<uint8_t>    wavePacketDescriptorIndex;    // required,    8 pf4,5     8 pf9,10
+    std::vector<uint64_t>   byteOffsetToWaveformData;     // required,   64 pf4,5    64 pf9,10
+    std::vector<uint32_t>   waveformPacketSizeInBytes;    // required,   32 pf4,5    32 pf9,10
+    std::vector<float>      returnPointWaveformLocation;  // required,   32 pf4,5    32 pf9,10
+    std::vector<float>      xT;                           // required,   32 pf4,5    32 pf9,10
+    std::vector<float>      yT;                           // required,   32 pf4,5    32 pf9,10
+    std::vector<float>      zT;                           // required,   32 pf4,5    32 pf9,10
+
+                LASPointBlock() : count(0) {};
+};
+
 struct LASVariableRecordLengthHeader { //!!! not needed
     uint16_t  reserved;                      // 2 bytes  optional
     char      userId[16];                    // 16 bytes required
@@ -170,13 +218,19 @@ struct LASGeoKeyEntry {
 class LASReader {
 public:
                 LASReader(ustring fname);
-    void        operator~();
-    void        close(){/*???*/};  //???TODO implement
+                ~LASReader();
+    void        close();
 
     void        getHeader(LASPublicHeaderBlock& h);
     std::vector<uint8_t> getRawHeader();
+    uint64_t    pointCount();
     int         readPoints(LASPointDataRecord* points, uint32_t start, uint32_t count);
 
+    /// Decode up to count records starting at record start into the arrays of block, returns the number decoded.
+    /// The point data region is memory mapped on first use (falls back to buffered reads if the mapping fails),
+    ///   so consecutive calls with a reused block do no per-record I/O or allocation.
+    uint64_t    readPointBlock(LASPointBlock& block, uint64_t start, uint64_t count);
+
     void        rewindVLR();
     bool        readNextVLR(LASVariableLengthRecord& vlrInfo);
 
@@ -190,16 +244,29 @@ public:
 */
 
 protected: //================
+    ustring                 fileName_;
     std::ifstream           fs_;
     LASPublicHeaderBlock    hdr_;
     unsigned                nextVLROffset_;
     unsigned                readVLRCount_;
 
+    /// Memory mapping of the point data region, established by mapPointData()
+    bool                    mapTried_;
+    const uint8_t*          pointData_;     // first byte of first point record, or NULL if not mapped
+    void*                   mapAddress_;    // start of mapping (page aligned, at or before pointData_)
+    uint64_t                mapLength_;
+    std::vector<uint8_t>    readBuffer_;    // holds the records when reading without a mapping
+
     //TODO this doesn't work in MSVC6.0:
     //static const int POINT_DATA_RECORD_MAX_BYTES = 63;  // version dependency!, change if point record gets longer
 #define POINT_DATA_RECORD_MAX_BYTES 63
 
     void readPoint(LASPointDataRecord& point);
+    void mapPointData();
+    void unmapPointData();
+    unsigned minimumPointDataRecordLength();
+    void sizePointBlock(LASPointBlock& block, size_t count);
+    void decodePointBlock(const uint8_t* records, LASPointBlock& block, size_t first, size_t count);
 };
 
 }; // end namspace e57
@@ -29,12 +29,28 @@
 #include "E57FoundationImpl.h"
 
 #include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(WIN32)
+#  include <windows.h>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
 
 using namespace std;
 using namespace e57;
 
 LASReader::LASReader(string fname)
-: fs_(fname.c_str(), ios::in|ios::binary)   /// Open the file for binary read
+: fileName_(fname),
+  fs_(fname.c_str(), ios::in|ios::binary),   /// Open the file for binary read
+  mapTried_(false),
+  pointData_(NULL),
+  mapAddress_(NULL),
+  mapLength_(0)
 {
     if (!fs_.is_open())
         throw EXCEPTION("open failed"); //??? TODO pick standard exception
@@ -89,8 +105,8 @@ LASReader::LASReader(string fname)
     fs_.read(reinterpret_cast<char*>(&hdr_.versionMinor), sizeof(hdr_.versionMinor));
     if (fs_.fail())
         throw EXCEPTION("file read failed");
-    /// We understand versions 1.0, 1.1, 1.2, 1.3
-    if (hdr_.versionMajor != 1 || hdr_.versionMinor > 3)
+    /// We understand versions 1.0, 1.1, 1.2, 1.3, 1.4
+    if (hdr_.versionMajor != 1 || hdr_.versionMinor > 4)
         throw EXCEPTION("unknown LAS version");
 
     /// Decode fileSourceId field, now that we known the version
@@ -105,6 +121,8 @@ LASReader::LASReader(string fname)
         hdr_.waveformDataPacketsExternal         = (globalEncoding & (1<<2)) ? true : false;
         hdr_.returnNumbersSyntheticallyGenerated = (globalEncoding & (1<<3)) ? true : false;
     }
+    if (hdr_.versionMajor == 1 && hdr_.versionMinor >= 4)
+        hdr_.wellKnownTextCrs = (globalEncoding & (1<<4)) ? true : false;
 
     fs_.read(reinterpret_cast<char*>(hdr_.systemIdentifier), sizeof(hdr_.systemIdentifier));
     if (fs_.fail())
@@ -145,20 +163,13 @@ LASReader::LASReader(string fname)
     if (fs_.fail())
         throw EXCEPTION("file read failed");
     SWAB(hdr_.numberOfPointRecords);
-    if (hdr_.versionMajor == 1 && hdr_.versionMinor <= 2) {
-        /// Earlier versions of LAS (1.0, 1.1, 1.2) only had provision for upto 5 returns per pulse
-        fs_.read(reinterpret_cast<char*>(hdr_.numberOfPointsByReturn), 5*sizeof(uint32_t));
-        if (fs_.fail())
-            throw EXCEPTION("file read failed");
-        for (int i=0; i<5; i++)
-            SWAB(hdr_.numberOfPointsByReturn[i]);
-    } else {
-        fs_.read(reinterpret_cast<char*>(hdr_.numberOfPointsByReturn), 7*sizeof(uint32_t));
-        if (fs_.fail())
-            throw EXCEPTION("file read failed");
-        for (int i=0; i<7; i++)
-            SWAB(hdr_.numberOfPointsByReturn[i]);
-    }
+    /// All versions of the public header block have 5 legacy per-return counts.
+    /// LAS 1.4 adds 15 64-bit counts after the waveform offset, see below.
+    fs_.read(reinterpret_cast<char*>(hdr_.numberOfPointsByReturn), 5*sizeof(uint32_t));
+    if (fs_.fail())
+        throw EXCEPTION("file read failed");
+    for (int i=0; i<5; i++)
+        SWAB(hdr_.numberOfPointsByReturn[i]);
     fs_.read(reinterpret_cast<char*>(&hdr_.xScaleFactor), sizeof(hdr_.xScaleFactor));
     if (fs_.fail())
         throw EXCEPTION("file read failed");
@@ -215,6 +226,26 @@ LASReader::LASReader(string fname)
         SWAB(hdr_.startOfWaveformDataPacketRecord);
     }
 
+    if (hdr_.versionMajor == 1 && hdr_.versionMinor >= 4) {
+        fs_.read(reinterpret_cast<char*>(&hdr_.startOfFirstExtendedVariableLengthRecord), sizeof(hdr_.startOfFirstExtendedVariableLengthRecord));
+        if (fs_.fail())
+            throw EXCEPTION("file read failed");
+        SWAB(hdr_.startOfFirstExtendedVariableLengthRecord);
+        fs_.read(reinterpret_cast<char*>(&hdr_.numberOfExtendedVariableLengthRecords), sizeof(hdr_.numberOfExtendedVariableLengthRecords));
+        if (fs_.fail())
+            throw EXCEPTION("file read failed");
+        SWAB(hdr_.numberOfExtendedVariableLengthRecords);
+        fs_.read(reinterpret_cast<char*>(&hdr_.extendedNumberOfPointRecords), sizeof(hdr_.extendedNumberOfPointRecords));
+        if (fs_.fail())
+            throw EXCEPTION("file read failed");
+        SWAB(hdr_.extendedNumberOfPointRecords);
+        fs_.read(reinterpret_cast<char*>(hdr_.extendedNumberOfPointsByReturn), 15*sizeof(uint64_t));
+        if (fs_.fail())
+            throw EXCEPTION("file read failed");
+        for (int i=0; i<15; i++)
+            SWAB(hdr_.extendedNumberOfPointsByReturn[i]);
+    }
+
 //???TODO check error returns
     if (fs_.fail())
         throw EXCEPTION("file read failed");
@@ -223,19 +254,43 @@ LASReader::LASReader(string fname)
     readVLRCount_ = 0;
 }
 
+LASReader::~LASReader()
+{
+    unmapPointData();
+}
+
+void LASReader::close()
+{
+    unmapPointData();
+    if (fs_.is_open())
+        fs_.close();
+}
+
 void LASReader::getHeader(LASPublicHeaderBlock& h)
 {
     h = hdr_;
 }
 
+uint64_t LASReader::pointCount()
+{
+    /// LAS 1.4 files with more than 2^32-1 points (or with the new point formats) leave the legacy count zero.
+    if (hdr_.versionMajor == 1 && hdr_.versionMinor >= 4 && hdr_.extendedNumberOfPointRecords > 0)
+        return(hdr_.extendedNumberOfPointRecords);
+    return(hdr_.numberOfPointRecords);
+}
+
 int LASReader::readPoints(LASPointDataRecord* points, uint32_t start, uint32_t count)
 {
     if (!fs_.is_open())
         throw EXCEPTION("file not open"); //??? TODO pick standard exception
     
     /// Calculate location of first point and how many we can fetch
-    unsigned long start_offset = hdr_.offsetToPointData + start * hdr_.pointDataRecordLength;
-    count = (count < hdr_.numberOfPointRecords - start) ? count : hdr_.numberOfPointRecords - start;
+    uint64_t start_offset = hdr_.offsetToPointData + static_cast<uint64_t>(start) * hdr_.pointDataRecordLength;
+    uint64_t total = pointCount();
+    if (start >= total)
+        return(0);
+    if (count > total - start)
+        count = static_cast<uint32_t>(total - start);
 
     /// Seek to start of first record
     fs_.seekg(start_offset, ios::beg);
@@ -279,8 +334,8 @@ void LASReader::readPoint(LASPointDataRecord& point)
     SWAB(point.z);
     memcpy(&point.intensity, &buf[12], sizeof (point.intensity));
     SWAB(point.intensity);
-    point.returnNumber      = buf[14]      & 0x3;
-    point.numberOfReturns   = (buf[14]>>3) & 0x3;
+    point.returnNumber      = buf[14]      & 0x7;
+    point.numberOfReturns   = (buf[14]>>3) & 0x7;
     point.scanDirectionFlag = (buf[14] & (1<<6)) ? true : false;
     point.edgeOfFlightLine  = (buf[14] & (1<<7)) ? true : false;
     if (hdr_.versionMajor == 1 && hdr_.versionMinor == 0) {
@@ -288,8 +343,8 @@ void LASReader::readPoint(LASPointDataRecord& point)
     } else {
         point.classification = buf[15] & 0x1f;
         point.synthetic         = (buf[15] & (1<<5)) ? true : false;
-        point.withheld          = (buf[15] & (1<<6)) ? true : false;
-        point.edgeOfFlightLine  = (buf[15] & (1<<7)) ? true : false;
+        point.keyPoint          = (buf[15] & (1<<6)) ? true : false;
+        point.withheld          = (buf[15] & (1<<7)) ? true : false;
     }
     point.scanAngleRank = buf[16];
     if (hdr_.versionMajor == 1 && hdr_.versionMinor == 0) {
@@ -383,6 +438,307 @@ void LASReader::readPoint(LASPointDataRecord& point)
     }
 }
 
+namespace {
+
+/// Number of records decoded field by field before moving on (at most 67 bytes each, so a run fits in L2 cache)
+const size_t DECODE_RUN_RECORDS = 2048;
+
+/// Copy one little endian field out of count consecutive records into an array.
+template <class T>
+void decodeField(const uint8_t* records, size_t recordLength, size_t count, size_t fieldOffset, T* values)
+{
+    const uint8_t* p = records + fieldOffset;
+    for (size_t i = 0; i < count; i++, p += recordLength) {
+        T value;
+        memcpy(&value, p, sizeof(value));
+        SWAB(value);
+        values[i] = value;
+    }
+}
+
+/// Extract a bit field from one byte of count consecutive records into an array.
+void decodeBits(const uint8_t* records, size_t recordLength, size_t count, size_t byteOffset,
+                unsigned shift, unsigned mask, uint8_t* values)
+{
+    const uint8_t* p = records + byteOffset;
+    for (size_t i = 0; i < count; i++, p += recordLength)
+        values[i] = static_cast<uint8_t>((*p >> shift) & mask);
+}
+
+/// Size an array if the field is in the point format, otherwise empty it (capacity is kept for later blocks).
+template <class T>
+void sizeField(std::vector<T>& values, bool present, size_t count)
+{
+    if (present)
+        values.resize(count);
+    else
+        values.clear();
+}
+
+} // end anonymous namespace
+
+unsigned LASReader::minimumPointDataRecordLength()
+{
+    /// Record length of each point data format, files may append extra bytes to each record
+    static const unsigned lengths[] = {20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67};
+    if (hdr_.pointDataFormatId >= sizeof(lengths)/sizeof(lengths[0]))
+        throw EXCEPTION("unknown LAS packet format"); //??? TODO pick standard exception
+    return(lengths[hdr_.pointDataFormatId]);
+}
+
+void LASReader::mapPointData()
+{
+    mapTried_ = true;
+
+    uint64_t begin  = hdr_.offsetToPointData;
+    uint64_t length = pointCount() * hdr_.pointDataRecordLength;
+    if (length == 0)
+        return;
+
+    /// Mappings have to start on an allocation boundary, so map from the boundary before the first record.
+    /// On any failure, leave pointData_ NULL and let readPointBlock fall back to reading the file.
+#if defined(WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    uint64_t mapBegin  = begin - begin % info.dwAllocationGranularity;
+    uint64_t mapLength = begin + length - mapBegin;
+    if (mapLength > static_cast<uint64_t>(numeric_limits<size_t>::max()))
+        return;
+
+    HANDLE file = CreateFileA(fileName_.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) < begin + length) {
+        CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return;
+    /// The view keeps its own reference to the mapping object
+    void* address = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(mapBegin >> 32),
+                                  static_cast<DWORD>(mapBegin & 0xffffffff), static_cast<SIZE_T>(mapLength));
+    CloseHandle(mapping);
+    if (address == NULL)
+        return;
+#else
+    uint64_t pageSize  = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t mapBegin  = begin - begin % pageSize;
+    uint64_t mapLength = begin + length - mapBegin;
+    if (mapLength > static_cast<uint64_t>(numeric_limits<size_t>::max()))
+        return;
+
+    int fd = open(fileName_.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < begin + length) {
+        ::close(fd);
+        return;
+    }
+    /// The mapping stays valid after the descriptor is closed
+    void* address = mmap(NULL, static_cast<size_t>(mapLength), PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(mapBegin));
+    ::close(fd);
+    if (address == MAP_FAILED)
+        return;
+    madvise(address, static_cast<size_t>(mapLength), MADV_SEQUENTIAL);
+#endif
+
+    mapAddress_ = address;
+    mapLength_  = mapLength;
+    pointData_  = static_cast<const uint8_t*>(address) + (begin - mapBegin);
+}
+
+void LASReader::unmapPointData()
+{
+    if (mapAddress_ != NULL) {
+#if defined(WIN32)
+        UnmapViewOfFile(mapAddress_);
+#else
+        munmap(mapAddress_, static_cast<size_t>(mapLength_));
+#endif
+    }
+    mapAddress_ = NULL;
+    mapLength_  = 0;
+    pointData_  = NULL;
+    mapTried_   = false;
+}
+
+void LASReader::sizePointBlock(LASPointBlock& block, size_t count)
+{
+    unsigned format   = hdr_.pointDataFormatId;
+    bool     legacy   = (format <= 5);
+    bool     version0 = (hdr_.versionMajor == 1 && hdr_.versionMinor == 0);
+    bool     gps      = (format == 1 || format >= 3);
+    bool     rgb      = (format == 2 || format == 3 || format == 5 || format == 7 || format == 8 || format == 10);
+    bool     wave     = (format == 4 || format == 5 || format == 9 || format == 10);
+
+    block.x.resize(count);
+    block.y.resize(count);
+    block.z.resize(count);
+    block.intensity.resize(count);
+    block.returnNumber.resize(count);
+    block.numberOfReturns.resize(count);
+    block.scanDirectionFlag.resize(count);
+    block.edgeOfFlightLine.resize(count);
+    block.classification.resize(count);
+    sizeField(block.synthetic,      !version0, count);
+    sizeField(block.keyPoint,       !version0, count);
+    sizeField(block.withheld,       !version0, count);
+    sizeField(block.overlap,        !legacy, count);
+    sizeField(block.scannerChannel, !legacy, count);
+    sizeField(block.scanAngleRank,  legacy, count);
+    sizeField(block.scanAngle,      !legacy, count);
+    sizeField(block.fileMarker,     version0, count);
+    sizeField(block.userBitField,   version0, count);
+    sizeField(block.userData,       !version0, count);
+    sizeField(block.pointSourceId,  !version0, count);
+    sizeField(block.gpsTime,        gps, count);
+    sizeField(block.red,            rgb, count);
+    sizeField(block.green,          rgb, count);
+    sizeField(block.blue,           rgb, count);
+    sizeField(block.nir,            format == 8 || format == 10, count);
+    sizeField(block.wavePacketDescriptorIndex,   wave, count);
+    sizeField(block.byteOffsetToWaveformData,    wave, count);
+    sizeField(block.waveformPacketSizeInBytes,   wave, count);
+    sizeField(block.returnPointWaveformLocation, wave, count);
+    sizeField(block.xT,             wave, count);
+    sizeField(block.yT,             wave, count);
+    sizeField(block.zT,             wave, count);
+}
+
+void LASReader::decodePointBlock(const uint8_t* records, LASPointBlock& block, size_t first, size_t count)
+{
+    /// Decode one field at a time across the whole block, so each loop is a simple strided copy.
+    size_t   len    = hdr_.pointDataRecordLength;
+    unsigned format = hdr_.pointDataFormatId;
+
+    decodeField(records, len, count,  0, &block.x[first]);
+    decodeField(records, len, count,  4, &block.y[first]);
+    decodeField(records, len, count,  8, &block.z[first]);
+    decodeField(records, len, count, 12, &block.intensity[first]);
+
+    size_t gpsOffset, rgbOffset = 0, waveOffset = 0;
+    if (format <= 5) {
+        decodeBits(records, len, count, 14, 0, 0x7, &block.returnNumber[first]);
+        decodeBits(records, len, count, 14, 3, 0x7, &block.numberOfReturns[first]);
+        decodeBits(records, len, count, 14, 6, 0x1, &block.scanDirectionFlag[first]);
+        decodeBits(records, len, count, 14, 7, 0x1, &block.edgeOfFlightLine[first]);
+        if (hdr_.versionMajor == 1 && hdr_.versionMinor == 0) {
+            decodeBits(records, len, count, 15, 0, 0xff, &block.classification[first]);
+            decodeField(records, len, count, 16, &block.scanAngleRank[first]);
+            decodeField(records, len, count, 17, &block.fileMarker[first]);
+            decodeField(records, len, count, 18, &block.userBitField[first]);
+        } else {
+            decodeBits(records, len, count, 15, 0, 0x1f, &block.classification[first]);
+            decodeBits(records, len, count, 15, 5, 0x1, &block.synthetic[first]);
+            decodeBits(records, len, count, 15, 6, 0x1, &block.keyPoint[first]);
+            decodeBits(records, len, count, 15, 7, 0x1, &block.withheld[first]);
+            decodeField(records, len, count, 16, &block.scanAngleRank[first]);
+            decodeField(records, len, count, 17, &block.userData[first]);
+            decodeField(records, len, count, 18, &block.pointSourceId[first]);
+        }
+        gpsOffset = 20;
+        switch (format) {
+            case 2:  rgbOffset = 20; break;
+            case 3:  rgbOffset = 28; break;
+            case 4:  waveOffset = 28; break;
+            case 5:  rgbOffset = 28; waveOffset = 34; break;
+        }
+    } else {
+        decodeBits(records, len, count, 14, 0, 0xf, &block.returnNumber[first]);
+        decodeBits(records, len, count, 14, 4, 0xf, &block.numberOfReturns[first]);
+        decodeBits(records, len, count, 15, 0, 0x1, &block.synthetic[first]);
+        decodeBits(records, len, count, 15, 1, 0x1, &block.keyPoint[first]);
+        decodeBits(records, len, count, 15, 2, 0x1, &block.withheld[first]);
+        decodeBits(records, len, count, 15, 3, 0x1, &block.overlap[first]);
+        decodeBits(records, len, count, 15, 4, 0x3, &block.scannerChannel[first]);
+        decodeBits(records, len, count, 15, 6, 0x1, &block.scanDirectionFlag[first]);
+        decodeBits(records, len, count, 15, 7, 0x1, &block.edgeOfFlightLine[first]);
+        decodeField(records, len, count, 16, &block.classification[first]);
+        decodeField(records, len, count, 17, &block.userData[first]);
+        decodeField(records, len, count, 18, &block.scanAngle[first]);
+        decodeField(records, len, count, 20, &block.pointSourceId[first]);
+        gpsOffset = 22;
+        switch (format) {
+            case 7:
+            case 8:  rgbOffset = 30; break;
+            case 9:  waveOffset = 30; break;
+            case 10: rgbOffset = 30; waveOffset = 38; break;
+        }
+        if (format == 8 || format == 10)
+            decodeField(records, len, count, 36, &block.nir[first]);
+    }
+    if (!block.gpsTime.empty())
+        decodeField(records, len, count, gpsOffset, &block.gpsTime[first]);
+    if (rgbOffset > 0) {
+        decodeField(records, len, count, rgbOffset,   &block.red[first]);
+        decodeField(records, len, count, rgbOffset+2, &block.green[first]);
+        decodeField(records, len, count, rgbOffset+4, &block.blue[first]);
+    }
+    if (waveOffset > 0) {
+        decodeField(records, len, count, waveOffset,    &block.wavePacketDescriptorIndex[first]);
+        decodeField(records, len, count, waveOffset+1,  &block.byteOffsetToWaveformData[first]);
+        decodeField(records, len, count, waveOffset+9,  &block.waveformPacketSizeInBytes[first]);
+        decodeField(records, len, count, waveOffset+13, &block.returnPointWaveformLocation[first]);
+        decodeField(records, len, count, waveOffset+17, &block.xT[first]);
+        decodeField(records, len, count, waveOffset+21, &block.yT[first]);
+        decodeField(records, len, count, waveOffset+25, &block.zT[first]);
+    }
+}
+
+uint64_t LASReader::readPointBlock(LASPointBlock& block, uint64_t start, uint64_t count)
+{
+    if (!fs_.is_open())
+        throw EXCEPTION("file not open"); //??? TODO pick standard exception
+    if (hdr_.pointDataRecordLength < minimumPointDataRecordLength())
+        throw EXCEPTION("bad packet length"); //??? TODO pick standard exception
+
+    /// Calculate how many we can fetch
+    uint64_t total = pointCount();
+    if (start >= total)
+        count = 0;
+    else if (count > total - start)
+        count = total - start;
+    if (count > static_cast<uint64_t>(numeric_limits<size_t>::max()) / hdr_.pointDataRecordLength)
+        throw EXCEPTION("block too large"); //??? TODO pick standard exception
+
+    block.count = count;
+    sizePointBlock(block, static_cast<size_t>(count));
+    if (count == 0)
+        return(0);
+
+    if (!mapTried_)
+        mapPointData();
+
+    const uint8_t* records;
+    if (pointData_ != NULL)
+        records = pointData_ + start * hdr_.pointDataRecordLength;
+    else {
+        /// No mapping, read the whole block of records with a single read
+        size_t byteCount = static_cast<size_t>(count) * hdr_.pointDataRecordLength;
+        readBuffer_.resize(byteCount);
+        fs_.clear();
+        fs_.seekg(static_cast<streamoff>(hdr_.offsetToPointData + start * hdr_.pointDataRecordLength), ios::beg);
+        if (fs_.fail())
+            throw EXCEPTION("file seek failed");
+        fs_.read(reinterpret_cast<char*>(&readBuffer_[0]), byteCount);
+        if (fs_.fail())
+            throw EXCEPTION("file read failed");
+        records = &readBuffer_[0];
+    }
+
+    /// Decode in runs of records small enough to stay in cache while each field is extracted
+    for (size_t first = 0; first < count; first += DECODE_RUN_RECORDS) {
+        size_t n = (count - first < DECODE_RUN_RECORDS) ? static_cast<size_t>(count - first) : DECODE_RUN_RECORDS;
+        decodePointBlock(records + first * hdr_.pointDataRecordLength, block, first, n);
+    }
+    return(count);
+}
+
 vector<uint8_t> LASReader::getRawHeader()
 {
     vector<uint8_t> rawHeader(hdr_.headerSize);
@@ -512,6 +868,12 @@ void LASPublicHeaderBlock::dump(int indent, std::ostream& os)
     os << space(indent) << "maxZ:                      " << maxZ << endl;
     os << space(indent) << "minZ:                      " << minZ << endl;
     os << space(indent) << "startOfWaveformDataPacketRecord:" << startOfWaveformDataPacketRecord << endl;
+    os << space(indent) << "wellKnownTextCrs:          " << static_cast<unsigned>(wellKnownTextCrs) << endl;
+    os << space(indent) << "startOfFirstExtendedVariableLengthRecord:" << startOfFirstExtendedVariableLengthRecord << endl;
+    os << space(indent) << "numberOfExtendedVariableLengthRecords:" << numberOfExtendedVariableLengthRecords << endl;
+    os << space(indent) << "extendedNumberOfPointRecords: " << extendedNumberOfPointRecords << endl;
+    for (int i = 0; i < 15; i++)
+        os << space(indent) << "extendedNumberOfPointsByReturn[" << i << "]: " << extendedNumberOfPointsByReturn[i] << endl;
 }
 
 void LASPointDataRecord::dump(int indent, std::ostream& os)
@@ -566,15 +928,16 @@ void LASReader::dump(int indent, std::ostream& os)
     os << space(indent) << "readVLRCount:      " << readVLRCount_ << endl;
     os << space(indent) << "nextVLROffset:     " << nextVLROffset_ << endl;
 
+    uint64_t total = pointCount();
     unsigned i;
-    for (i = 0; i < hdr_.numberOfPointRecords && i < 4; i++) {
+    for (i = 0; i < total && i < 4; i++) {
         LASPointDataRecord pt;
         readPoints(&pt, i, 1);
         os << space(indent) << "Point[" << i << "]:" << endl;
         pt.dump(4, os);
     }
-    if (i < hdr_.numberOfPointRecords)
-        os << space(indent) << hdr_.numberOfPointRecords - i << " points unprinted..." << endl;
+    if (i < total)
+        os << space(indent) << total - i << " points unprinted..." << endl;
 }
 
 #if 0 //!!!
@@ -2780,10 +2780,16 @@ This function may be called at any time (as long as ImageFile and CompressedVect
 The next read will start at the given recordNumber.
 It is not an error to seek to recordNumber = childCount() (i.e. to one record past end of CompressedVectorNode).
 
+Only the data packets holding the requested records are decoded.
+The first seek on a CompressedVectorNode reads the headers of all its data packets (not their contents) to find where each field's values are,
+later seeks by any reader of the same node in the same ImageFile reuse that.
+Fields of String type have records of varying size and can't be sought.
+
 @pre     @a recordNumber <= childCount() of CompressedVectorNode.
 @pre     The associated ImageFile must be open.
 @pre     This CompressedVectorReader must be open (i.e isOpen())
 @throw   ::E57_ERROR_BAD_API_ARGUMENT
+@throw   ::E57_ERROR_NOT_IMPLEMENTED    a String field is being read.
 @throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
 @throw   ::E57_ERROR_READER_NOT_OPEN
 @throw   ::E57_ERROR_BAD_CV_PACKET
@@ -2800,6 +2806,42 @@ void CompressedVectorReader::seek(int64_t recordNumber)
     CHECK_THIS_INVARIANCE()
 }
 
+/*================*/ /*!
+@brief   Get the ranges of records skipped because their packets were damaged.
+@param   [out] startRecord   The record number of the first record of each skipped range, in increasing order.
+@param   [out] recordCount   The number of records in each skipped range.
+@details
+Only an ImageFile opened with the @c recover configuration option skips damaged packets, otherwise the list is always empty.
+When a read meets a packet with a bad checksum, the records that have any of their bits stored in it are not transferred to the buffers,
+and the read goes on with the record after them.
+So a read can return fewer records than it would have, and the records it returns may not be consecutive.
+The ranges are found as the damaged packets are met, so they are complete only after the last record has been read.
+If a packet header can't be trusted, the positions of the packets after it are found from the end of the bytestreams,
+which is only possible if none of the fields being read is a String.
+Otherwise the records of the rest of the CompressedVectorNode are skipped.
+Only one such gap is bridged: if several packets are damaged, every packet from the first to the last of them is treated as damaged,
+and its records are skipped, even when the packets in between are intact.
+
+@pre     The associated ImageFile must be open.
+@pre     This CompressedVectorReader must be open (i.e isOpen())
+@return  The total number of records skipped so far.
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_READER_NOT_OPEN
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     ImageFile::ImageFile, CompressedVectorReader::read
+*/ /*================*/
+int64_t CompressedVectorReader::lostRecords(std::vector<int64_t>& startRecord, std::vector<int64_t>& recordCount)
+{
+    CHECK_THIS_INVARIANCE()
+    impl_->lostRecords(startRecord, recordCount);
+    CHECK_THIS_INVARIANCE()
+
+    int64_t total = 0;
+    for (size_t i = 0; i < recordCount.size(); i++)
+        total += recordCount[i];
+    return(total);
+}
+
 /*================*/ /*!
 @brief   End the read operation.
 @details
@@ -3033,6 +3075,148 @@ CompressedVectorNode CompressedVectorWriter::compressedVectorNode() const
     CHECK_INVARIANCE_RETURN(CompressedVectorNode, impl_->compressedVectorNode());
 }
 
+/*================*/ /*!
+@brief   Get the smallest and largest value written so far from one of the source buffers.
+@param   [in] pathName  The pathName of the SourceDestBuffer, as given when the writer was created.
+@param   [out] minimum  The smallest value written, as stored in the buffer memory (before any scaling).
+@param   [out] maximum  The largest value written, as stored in the buffer memory (before any scaling).
+@details
+The range is gathered from each block of records handed to CompressedVectorWriter::write, so it costs a pass over buffer memory that is already in cache and lets the caller fill in bounds without an extra pass over the data.
+NaN values are ignored. The range is still available after the CompressedVectorWriter is closed.
+@return  true if records have been written from a numeric buffer with the given pathName, false otherwise (and minimum and maximum are unchanged).
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     CompressedVectorWriter::write
+*/ /*================*/
+bool CompressedVectorWriter::sourceRange(const ustring& pathName, double& minimum, double& maximum) const
+{
+    return(impl_->sourceRange(pathName, minimum, maximum));
+}
+
+/*================*/ /*!
+@brief   Start collecting the runs of records that share the value of one of the source buffers.
+@param   [in] idPathName      The pathName of the SourceDestBuffer holding the group identifier of each record (e.g. "columnIndex").
+@param   [in] rangePathNames  The pathNames of SourceDestBuffers whose range is kept for each group (e.g. "cartesianX").
+@details
+Each maximal run of consecutive records with the same identifier value becomes one group.
+The groups and the ranges of their values are gathered from each block of records handed to CompressedVectorWriter::write, like CompressedVectorWriter::sourceRange, and are retrieved with CompressedVectorWriter::sourceGroups.
+This must be called before any records are written.
+@pre     The associated ImageFile must be open.
+@pre     The CompressedVectorWriter must be open (i.e isOpen())
+@pre     No records have been written yet.
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_WRITER_NOT_OPEN
+@throw   ::E57_ERROR_BAD_API_ARGUMENT   records have already been written.
+@throw   ::E57_ERROR_PATH_UNDEFINED     a pathName is not one of the source buffers.
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     CompressedVectorWriter::sourceGroups
+*/ /*================*/
+void CompressedVectorWriter::trackGroups(const ustring& idPathName, const std::vector<ustring>& rangePathNames)
+{
+    impl_->trackGroups(idPathName, rangePathNames);
+    CHECK_THIS_INVARIANCE()
+}
+
+/*================*/ /*!
+@brief   Get the groups of records collected since CompressedVectorWriter::trackGroups was called.
+@param   [out] idValue      The identifier value of each group.
+@param   [out] startRecord  The record number of the first record of each group.
+@param   [out] recordCount  The number of records in each group.
+@param   [out] minimum      For each group, the smallest value of each of the range buffers (as stored in the buffer memory), in the order given to trackGroups.
+@param   [out] maximum      For each group, the largest value of each of the range buffers, laid out like @a minimum.
+@details
+Empty groups, and range buffers that held only NaN values in a group, get a minimum larger than their maximum.
+The groups are still available after the CompressedVectorWriter is closed.
+@return  true if groups were tracked and every identifier value forms a single group, false otherwise (and the outputs are cleared).
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     CompressedVectorWriter::trackGroups
+*/ /*================*/
+bool CompressedVectorWriter::sourceGroups(std::vector<int64_t>& idValue, std::vector<int64_t>& startRecord, std::vector<int64_t>& recordCount,
+                                          std::vector<double>& minimum, std::vector<double>& maximum) const
+{
+    return(impl_->sourceGroups(idValue, startRecord, recordCount, minimum, maximum));
+}
+
+/*================*/ /*!
+@brief   Start collecting the range of some source buffers for every chunk of a fixed number of records.
+@param   [in] chunkRecordCount  The number of records in a chunk; chunk k holds records [k*chunkRecordCount, (k+1)*chunkRecordCount).
+@param   [in] rangePathNames    The pathNames of SourceDestBuffers whose range is kept for each chunk (e.g. "cartesianX").
+@details
+The ranges are gathered from each block of records handed to CompressedVectorWriter::write, like CompressedVectorWriter::sourceRange, and are retrieved with CompressedVectorWriter::sourceChunks.
+They can be stored as a coarse spatial index that lets a reader seek past the chunks it doesn't need.
+This must be called before any records are written.
+@pre     The associated ImageFile must be open.
+@pre     The CompressedVectorWriter must be open (i.e isOpen())
+@pre     No records have been written yet.
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_WRITER_NOT_OPEN
+@throw   ::E57_ERROR_BAD_API_ARGUMENT   records have already been written, or chunkRecordCount is not positive.
+@throw   ::E57_ERROR_PATH_UNDEFINED     a pathName is not one of the source buffers.
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     CompressedVectorWriter::sourceChunks
+*/ /*================*/
+void CompressedVectorWriter::trackChunks(int64_t chunkRecordCount, const std::vector<ustring>& rangePathNames)
+{
+    impl_->trackChunks(chunkRecordCount, rangePathNames);
+    CHECK_THIS_INVARIANCE()
+}
+
+/*================*/ /*!
+@brief   Get the ranges collected for each chunk of records since CompressedVectorWriter::trackChunks was called.
+@param   [out] minimum      For each chunk, the smallest value of each of the range buffers (as stored in the buffer memory), in the order given to trackChunks.
+@param   [out] maximum      For each chunk, the largest value of each of the range buffers, laid out like @a minimum.
+@details
+There is one chunk for every chunkRecordCount records written, the last one may be partly filled.
+Range buffers that held only NaN values in a chunk get a minimum larger than their maximum.
+The chunks are still available after the CompressedVectorWriter is closed.
+@return  true if chunks were tracked, false otherwise (and the outputs are cleared).
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     CompressedVectorWriter::trackChunks
+*/ /*================*/
+bool CompressedVectorWriter::sourceChunks(std::vector<double>& minimum, std::vector<double>& maximum) const
+{
+    return(impl_->sourceChunks(minimum, maximum));
+}
+
+/*================*/ /*!
+@brief   Start keeping a copy of every sampleInterval-th record written.
+@param   [in] sampleInterval    The distance between kept records; records 0, sampleInterval, 2*sampleInterval... are kept.
+@details
+The records are copied from each block of records handed to CompressedVectorWriter::write, in the memory representation of the source buffers, and are retrieved with CompressedVectorWriter::sourceSamples.
+Once the CompressedVectorWriter is closed, they can be written to a second CompressedVectorNode with the same prototype, as a decimated preview of the records that is much faster to read than all of them.
+The copies take about 1/sampleInterval of the memory that all the records would take in the source buffers.
+This must be called before any records are written.
+@pre     The associated ImageFile must be open.
+@pre     The CompressedVectorWriter must be open (i.e isOpen())
+@pre     No records have been written yet.
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_WRITER_NOT_OPEN
+@throw   ::E57_ERROR_BAD_API_ARGUMENT   records have already been written, or sampleInterval is not positive.
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     CompressedVectorWriter::sourceSamples
+*/ /*================*/
+void CompressedVectorWriter::trackSamples(int64_t sampleInterval)
+{
+    impl_->trackSamples(sampleInterval);
+    CHECK_THIS_INVARIANCE()
+}
+
+/*================*/ /*!
+@brief   Get buffers holding the records kept since CompressedVectorWriter::trackSamples was called.
+@param   [out] sbufs    One SourceDestBuffer for each of the source buffers, with the same pathName, memory representation and options, whose capacity is the number of records kept.
+@details
+The buffers refer to memory owned by the CompressedVectorWriter, they are valid until it is destroyed.
+They can be given to CompressedVectorNode::writer of another CompressedVectorNode after this CompressedVectorWriter is closed (only one CompressedVectorWriter can be open at a time).
+@pre     The associated ImageFile must be open.
+@return  true if records were kept, false otherwise (and @a sbufs is cleared).
+@throw   ::E57_ERROR_IMAGEFILE_NOT_OPEN
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     CompressedVectorWriter::trackSamples
+*/ /*================*/
+bool CompressedVectorWriter::sourceSamples(std::vector<SourceDestBuffer>& sbufs) const
+{
+    return(impl_->sourceSamples(sbufs));
+}
+
 //! @brief   Diagnostic function to print internal state of object to output stream in an indented format.
 //! @copydetails Node::dump()
 #ifdef E57_DEBUG
@@ -4567,7 +4751,20 @@ It is recommended that files that meet all of the requirements for a legal ASTM
 It is recommended that files that utilize the low-level E57 element data types, but do not have all the required element names required by ASTM E57 file format standard use the file extension @c "._e57".
 @param   [in] mode Either "w" for writing or "r" for reading.
 @param   [in] configuration A string that modifies the configuration of the E57 API implementation at run-time.
-Currently, in the reference implementation, this parameter is ignored.
+In the reference implementation, this is a list of options separated by whitespace, commas or semicolons.
+Unrecognized options cause ::E57_ERROR_BAD_CONFIGURATION to be thrown.
+The recognized options are:
+    - @c lazyXml  In read mode, the children of the top level @c /data3D and @c /images2D elements are not parsed when the file is opened.
+Instead the location of each one in the XML section is remembered, and it is parsed the first time its contents are accessed.
+This makes opening files with many scans much faster when only a few of them are used.
+    - @c noXmlValidation  Turn off the XML parser's validation and schema checking features, for input that is trusted.
+    - @c builtinXml  Read the XML section with the small built-in non-validating parser instead of Xerces.
+It parses the whole section in memory and is considerably faster, but doesn't check the XML against a schema.
+If the library was built without Xerces (CMake option @c E57_WITH_XERCES=OFF), the built-in parser is always used.
+    - @c recover  In read mode, a CompressedVectorReader that finds a packet with a bad checksum skips the records stored in it, instead of throwing ::E57_ERROR_BAD_CHECKSUM.
+Reading resumes at the next intact data packet, and the skipped records are listed by CompressedVectorReader::lostRecords.
+All the packets from the first damaged one to the last are skipped, including any intact ones between them.
+The file header, the XML section and the section headers of the binary sections must still be intact.
 @details
 
 @par Write Mode
@@ -5382,3 +5579,57 @@ void E57Utilities::rawXmlRead(const ustring& fname, uint8_t* buf, int64_t logica
     cf.seek(cf.physicalToLogical(header.xmlPhysicalOffset) + logicalStart, CheckedFile::logical);
     cf.read(reinterpret_cast<char*>(buf), byteCount);
 }
+
+/*================*/ /*!
+@brief   Copy the whole XML section of an E57 file to a stream.
+@param   [in] fname     File name of the E57 file.
+@param   [in] os        Stream to receive the XML text.
+@details
+This function gives the same bytes as reading the XML section with E57Utilities::rawXmlRead, but the file is only opened once
+and is read in large blocks of whole pages, so it is much faster for large XML sections.
+The checksum of every page read is verified, and the interspersed checksums are removed.
+No parsing, validation or checking of any kind is performed on the XML copied.
+The E57 file header section must be well formed.
+If an exception is thrown, a part of the XML section may already have been written to @a os.
+@throw   ::E57_ERROR_OPEN_FAILED
+@throw   ::E57_ERROR_LSEEK_FAILED
+@throw   ::E57_ERROR_READ_FAILED
+@throw   ::E57_ERROR_WRITE_FAILED
+@throw   ::E57_ERROR_BAD_CHECKSUM
+@throw   ::E57_ERROR_BAD_FILE_SIGNATURE
+@throw   ::E57_ERROR_UNKNOWN_FILE_VERSION
+@throw   ::E57_ERROR_BAD_FILE_LENGTH
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     E57Utilities::rawXmlLength, E57Utilities::rawXmlRead
+*/ /*================*/
+void E57Utilities::rawXmlCopy(const ustring& fname, std::ostream& os)
+{
+    ImageFileImpl::copyRawXml(fname, os);
+}
+
+/*================*/ /*!
+@brief   Check the structural integrity of an E57 file, without interpreting its contents.
+@param   [in] fname         File name of the E57 file.
+@param   [out] report       Counts of what was checked, and the problems found.
+@param   [in] maxErrorCount Maximum number of problems kept in @a report.errors, the rest are only counted.
+@details
+The file is read once from start to end, in large reads of whole pages, and the checksum of every page is verified.
+The XML section is only searched for the file offsets of the CompressedVector elements.
+The packet chain of each of those binary sections is walked, and each section header and packet is checked
+with the same verification used when reading, but no values are decoded.
+After a bad packet the rest of its section can't be walked, so is skipped.
+This is much faster than reading all the data, and tells whether a file was damaged after it was written.
+It doesn't check that the file follows the E57 standard, which needs a validating reader.
+The file header doesn't have to be good, but if it isn't the CompressedVector sections aren't found.
+@return  true if no problems were found.
+@throw   ::E57_ERROR_OPEN_FAILED
+@throw   ::E57_ERROR_LSEEK_FAILED
+@throw   ::E57_ERROR_READ_FAILED
+@throw   ::E57_ERROR_INTERNAL           All objects in undocumented state
+@see     E57Utilities::rawXmlRead, IntegrityReport
+*/ /*================*/
+bool E57Utilities::checkIntegrity(const ustring& fname, IntegrityReport& report, size_t maxErrorCount)
+{
+    ImageFileImpl::checkIntegrity(fname, report, maxErrorCount);
+    return(report.errorCount == 0);
+}
@@ -77,6 +77,10 @@
 #include <iomanip> //??? needed?
 #include <cmath> //??? needed?
 #include <float.h> //??? needed?
+#include <limits>
+#include <algorithm>
+#include <mutex>
+#include <clocale>
 
 #ifdef E57_MAX_VERBOSE
 #include <iostream>
@@ -98,6 +102,7 @@ using std::ios_base;
 using std::scientific;
 using std::setprecision;
 using std::string;
+using std::map;
 using std::auto_ptr;
 using std::min;
 using std::max;
@@ -107,53 +112,6 @@ using boost::weak_ptr;
 using boost::shared_ptr;
 using boost::dynamic_pointer_cast;
 
-#include <xercesc/util/TransService.hpp>
-
-namespace {
-
-// define convenient constants for the attribute names
-const XMLCh att_minimum[] = {
-    chLatin_m, chLatin_i, chLatin_n, chLatin_i, chLatin_m, chLatin_u,
-    chLatin_m, chNull
-};
-const XMLCh att_maximum[] = {
-    chLatin_m, chLatin_a, chLatin_x, chLatin_i, chLatin_m, chLatin_u,
-    chLatin_m, chNull
-};
-const XMLCh att_scale[] = {
-    chLatin_s, chLatin_c, chLatin_a, chLatin_l, chLatin_e, chNull
-};
-const XMLCh att_offset[] = {
-    chLatin_o, chLatin_f, chLatin_f, chLatin_s, chLatin_e, chLatin_t, chNull
-};
-const XMLCh att_precision[] = {
-    chLatin_p, chLatin_r, chLatin_e, chLatin_c, chLatin_i, chLatin_s,
-    chLatin_i, chLatin_o, chLatin_n, chNull
-};
-const XMLCh att_allowHeterogeneousChildren[] = {
-    chLatin_a, chLatin_l, chLatin_l, chLatin_o, chLatin_w, chLatin_H,
-    chLatin_e, chLatin_t, chLatin_e, chLatin_r, chLatin_o, chLatin_g,
-    chLatin_e, chLatin_n, chLatin_e, chLatin_o, chLatin_u, chLatin_s,
-    chLatin_C, chLatin_h, chLatin_i, chLatin_l, chLatin_d, chLatin_r,
-    chLatin_e, chLatin_n, chNull
-};
-const XMLCh att_fileOffset[] = {
-    chLatin_f, chLatin_i, chLatin_l, chLatin_e, chLatin_O, chLatin_f,
-    chLatin_f, chLatin_s, chLatin_e, chLatin_t, chNull
-};
-
-const XMLCh att_type[] = {
-    chLatin_t, chLatin_y, chLatin_p, chLatin_e, chNull
-};
-const XMLCh att_length[] = {
-    chLatin_l, chLatin_e, chLatin_n, chLatin_g, chLatin_t, chLatin_h,
-    chNull
-};
-const XMLCh att_recordCount[] = {
-    chLatin_r, chLatin_e, chLatin_c, chLatin_o, chLatin_r, chLatin_d,
-    chLatin_C, chLatin_o, chLatin_u, chLatin_n, chLatin_t, chNull
-};
-}
 
 ///============================================================================================================
 ///============================================================================================================
@@ -555,7 +513,9 @@ void NodeImpl::dump(int indent, ostream& os)
 
 //================================================================================================
 StructureNodeImpl::StructureNodeImpl(weak_ptr<ImageFileImpl> destImageFile)
-: NodeImpl(destImageFile)
+: NodeImpl(destImageFile),
+  lazyXmlOffset_(0),
+  lazyXmlLength_(0)
 {
     checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
 }
@@ -580,6 +540,10 @@ bool StructureNodeImpl::isTypeEquivalent(shared_ptr<NodeImpl> ni)
     if (!si)  // check if failed
         throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "this->pathName=" + this->pathName() + " elementName="+ni->elementName());
 
+    /// Need the real children of both before comparing
+    materialize();
+    si->materialize();
+
     /// Same number of children?
     if (childCount() != si->childCount())
         return(false);
@@ -593,9 +557,10 @@ bool StructureNodeImpl::isTypeEquivalent(shared_ptr<NodeImpl> ni)
                 return(false);
         } else {
             /// Children in different order, so lookup by name and check if equal to our child
-            if (!si->isDefined(myChildsFieldName))
+            shared_ptr<NodeImpl> siChild(si->findChild(myChildsFieldName));
+            if (!siChild)
                 return(false);
-            if (!children_.at(i)->isTypeEquivalent(si->lookup(myChildsFieldName)))
+            if (!children_.at(i)->isTypeEquivalent(siChild))
                 return(false);
         }
     }
@@ -624,11 +589,13 @@ void StructureNodeImpl::setAttachedRecursive()
 int64_t StructureNodeImpl::childCount()
 {
     checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    materialize();
     return(children_.size());
 };
 shared_ptr<NodeImpl> StructureNodeImpl::get(int64_t index)
 {
     checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    materialize();
 		if (index < 0 || index >= static_cast<boost::int64_t>(children_.size())) {	// %%% Possible truncation on platforms where size_t = uint64
         throw E57_EXCEPTION2(E57_ERROR_CHILD_INDEX_OUT_OF_BOUNDS,
                              "this->pathName=" + this->pathName()
@@ -651,52 +618,82 @@ shared_ptr<NodeImpl> StructureNodeImpl::get(const ustring& pathName)
 shared_ptr<NodeImpl> StructureNodeImpl::lookup(const ustring& pathName)
 {
     /// don't checkImageFileOpen
-    //??? use lookup(fields, level) instead, for speed.
-    bool isRelative;
-    vector<ustring> fields;
     shared_ptr<ImageFileImpl> imf(destImageFile_);
-    imf->pathNameParse(pathName, isRelative, fields);  // throws if bad pathName
+    shared_ptr<const CompiledPathName> path(imf->pathNameCompile(pathName));  // throws if bad pathName
 
-    if (isRelative || isRoot()) {
-        if (fields.size() == 0)
-            if (isRelative) {
+    if (path->isRelative || isRoot()) {
+        if (path->fields.size() == 0) {
+            if (path->isRelative) {
                 return(shared_ptr<NodeImpl>());  /// empty pointer
             } else {
                 shared_ptr<NodeImpl> root(getRoot());
                 return(root);
             }
-        else {
-            /// Find child with elementName that matches first field in path
-            unsigned i;
-            for (i = 0; i < children_.size(); i++) {
-                if (fields.at(0) == children_.at(i)->elementName())
-                    break;
-            }
-            if (i == children_.size())
-                return(shared_ptr<NodeImpl>());  /// empty pointer
-            if (fields.size() == 1) {
-                return(children_.at(i));
-            } else {
-                //??? use level here rather than unparse
-                /// Remove first field in path
-                fields.erase(fields.begin());
-
-                /// Call lookup on child object with remaining fields in path name
-                return(children_.at(i)->lookup(imf->pathNameUnparse(true, fields)));
-            }
         }
+        /// Walk down the tree one field at a time, no reparsing of the remaining path
+        return(lookup(path->fields, 0));
     } else {  /// Absolute pathname and we aren't at the root
         /// Find root of the tree
         shared_ptr<NodeImpl> root(getRoot());
 
         /// Call lookup on root
-        return(root->lookup(pathName));
+        return(root->lookup(path->fields, 0));
+    }
+}
+
+shared_ptr<NodeImpl> StructureNodeImpl::lookup(const vector<ustring>& fields, unsigned level)
+{
+    /// don't checkImageFileOpen
+    /// Find child with elementName that matches field at this level in path
+    shared_ptr<NodeImpl> child(findChild(fields.at(level)));
+    if (!child || level == fields.size()-1)
+        return(child);
+
+    /// Call lookup on child object with remaining fields in path name
+    return(child->lookup(fields, level+1));
+}
+
+shared_ptr<NodeImpl> StructureNodeImpl::findChild(const ustring& elementName)
+{
+    /// don't checkImageFileOpen
+    materialize();
+
+    /// Small structures are faster to search serially than to index
+    if (children_.size() < CHILD_INDEX_THRESHOLD) {
+        for (unsigned i = 0; i < children_.size(); i++) {
+            if (elementName == children_[i]->elementName_)
+                return(children_[i]);
+        }
+        return(shared_ptr<NodeImpl>());  /// empty pointer
+    }
+
+    /// Build the index on first search of a big structure, appendChild() keeps it up to date after that
+    if (childIndex_.size() != children_.size()) {
+        childIndex_.clear();
+        for (size_t i = 0; i < children_.size(); i++)
+            childIndex_[children_[i]->elementName_] = i;
     }
+
+    boost::unordered_map<ustring, size_t>::const_iterator it = childIndex_.find(elementName);
+    if (it == childIndex_.end())
+        return(shared_ptr<NodeImpl>());  /// empty pointer
+    return(children_.at(it->second));
+}
+
+void StructureNodeImpl::appendChild(shared_ptr<NodeImpl> ni)
+{
+    /// Caller has already called ni->setParent(), so elementName_ is final
+    children_.push_back(ni);
+
+    /// Only maintain the index if it has already been built
+    if (!childIndex_.empty())
+        childIndex_[ni->elementName_] = children_.size()-1;
 }
 
 void StructureNodeImpl::set(int64_t index64, shared_ptr<NodeImpl> ni)
 {
     checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    materialize();
     unsigned index = static_cast<unsigned>(index64);
 
     /// Allow index == current number of elements, interpret as append
@@ -732,7 +729,7 @@ void StructureNodeImpl::set(int64_t index64, shared_ptr<NodeImpl> ni)
         throw E57_EXCEPTION2(E57_ERROR_HOMOGENEOUS_VIOLATION, "this->pathName=" + this->pathName());
 
     ni->setParent(shared_from_this(), elementName.str());
-    children_.push_back(ni);
+    appendChild(ni);
 }
 
 void StructureNodeImpl::set(const ustring& pathName, shared_ptr<NodeImpl> ni, bool autoPathCreate)
@@ -775,18 +772,17 @@ void StructureNodeImpl::set(const vector<ustring>& fields, unsigned level, share
     if (level == 0 && fields.size() == 0)
         throw E57_EXCEPTION2(E57_ERROR_SET_TWICE, "this->pathName=" + this->pathName() + " element=/");
 
-    /// Serial search for matching field name, if find match, have error since can't set twice
-    for (unsigned i = 0; i < children_.size(); i++) {
-        if (fields.at(level) == children_.at(i)->elementName()) {
-            if (level == fields.size()-1) {
-                /// Enforce "set once" policy, don't allow reset
-                throw E57_EXCEPTION2(E57_ERROR_SET_TWICE, "this->pathName=" + this->pathName() + " element=" + fields[level]);
-            } else {
-                /// Recurse on child
-                children_.at(i)->set(fields, level+1, ni);
-            }
-            return;
+    /// Search for matching field name, if find match, have error since can't set twice
+    shared_ptr<NodeImpl> child(findChild(fields.at(level)));
+    if (child) {
+        if (level == fields.size()-1) {
+            /// Enforce "set once" policy, don't allow reset
+            throw E57_EXCEPTION2(E57_ERROR_SET_TWICE, "this->pathName=" + this->pathName() + " element=" + fields[level]);
+        } else {
+            /// Recurse on child
+            child->set(fields, level+1, ni);
         }
+        return;
     }
     /// Didn't find matching field name, so have a new child.
 
@@ -798,7 +794,7 @@ void StructureNodeImpl::set(const vector<ustring>& fields, unsigned level, share
     if (level == fields.size()-1){
         /// At bottom, so append node at end of children
         ni->setParent(shared_from_this(), fields.at(level));
-        children_.push_back(ni);
+        appendChild(ni);
     } else {
         /// Not at bottom level, if not autoPathCreate have an error
         if (!autoPathCreate) {
@@ -830,6 +826,7 @@ void StructureNodeImpl::append(shared_ptr<NodeImpl> ni)
 void StructureNodeImpl::checkLeavesInSet(const std::set<ustring>& pathNames, shared_ptr<NodeImpl> origin)
 {
     /// don't checkImageFileOpen
+    materialize();
 
     /// Not a leaf node, so check all our children
     for (unsigned i = 0; i < children_.size(); i++)
@@ -837,9 +834,10 @@ void StructureNodeImpl::checkLeavesInSet(const std::set<ustring>& pathNames, sha
 }
 
 //??? use visitor?
-void StructureNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName)
+void StructureNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName)
 {
     /// don't checkImageFileOpen
+    materialize();
 
     ustring fieldName;
     if (forcedFieldName != NULL)
@@ -882,11 +880,48 @@ void StructureNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFi
     }
 }
 
+void StructureNodeImpl::setLazyXmlRange(uint64_t xmlOffset, uint64_t xmlLength)
+{
+    /// don't checkImageFileOpen
+    /// Only an empty placeholder can be made lazy, otherwise the parsed children would be duplicated
+    if (children_.size() > 0 || xmlLength == 0)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "this->pathName=" + this->pathName() + " childCount=" + toString(children_.size()));
+    lazyXmlOffset_ = xmlOffset;
+    lazyXmlLength_ = xmlLength;
+}
+
+void StructureNodeImpl::materializeLazy()
+{
+    /// Parse our element from the XML section into a separate unattached tree.
+    /// Can't add children to ourselves directly, since we may already be type constrained by a homogeneous parent Vector.
+    shared_ptr<ImageFileImpl> imf(destImageFile_);
+    if (!imf->isOpen())
+        throw E57_EXCEPTION2(E57_ERROR_IMAGEFILE_NOT_OPEN, "fileName=" + imf->fileName());
+    shared_ptr<StructureNodeImpl> parsed(imf->parseXmlSubtree(lazyXmlOffset_, lazyXmlLength_));
+
+    /// Done with range, clear before adopting children so don't recurse back here
+    lazyXmlOffset_ = 0;
+    lazyXmlLength_ = 0;
+
+    /// Move the parsed children underneath us, keeping their element names
+    shared_ptr<NodeImpl> self(shared_from_this());
+    for (unsigned i = 0; i < parsed->children_.size(); i++) {
+        shared_ptr<NodeImpl> child(parsed->children_[i]);
+        child->parent_ = self;
+        appendChild(child);
+        if (isAttached_)
+            child->setAttachedRecursive();
+    }
+    parsed->children_.clear();
+    parsed->childIndex_.clear();
+}
+
 //??? use visitor?
 #ifdef E57_DEBUG
 void StructureNodeImpl::dump(int indent, ostream& os)
 {
     /// don't checkImageFileOpen
+    materialize();
     os << space(indent) << "type:        Structure" << " (" << type() << ")" << endl;
     NodeImpl::dump(indent, os);
     for (unsigned i = 0; i < children_.size(); i++) {
@@ -962,7 +997,7 @@ void VectorNodeImpl::set(int64_t index64, shared_ptr<NodeImpl> ni)
     StructureNodeImpl::set(index64, ni);
 }
 
-void VectorNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName)
+void VectorNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName)
 {
     /// don't checkImageFileOpen
 
@@ -1431,6 +1466,145 @@ ustring SourceDestBufferImpl::getNextString()
     return((*ustrings_)[nextIndex_++]);
 }
 
+namespace {
+    /// Min/max over a buffer. Written as plain compare-selects over a contiguous array
+    /// so that the compiler can turn the loop into SIMD min/max instructions.
+    /// NaNs never compare less or greater, so they are skipped.
+    template <typename T>
+    void rangeOf(const char* base, size_t stride, size_t count, double& minimum, double& maximum)
+    {
+        T lo = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+        T hi = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+        if (stride == sizeof(T)) {
+            const T* p = reinterpret_cast<const T*>(base);
+            for (size_t i = 0; i < count; i++) {
+                lo = p[i] < lo ? p[i] : lo;
+                hi = p[i] > hi ? p[i] : hi;
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                T value = *reinterpret_cast<const T*>(base + i*stride);
+                lo = value < lo ? value : lo;
+                hi = value > hi ? value : hi;
+            }
+        }
+        if (lo <= hi) {
+            if (static_cast<double>(lo) < minimum)
+                minimum = static_cast<double>(lo);
+            if (static_cast<double>(hi) > maximum)
+                maximum = static_cast<double>(hi);
+        }
+    }
+
+    /// Append the index and value of the first element of each run of equal values
+    template <typename T>
+    void runsOf(const char* base, size_t stride, size_t count, std::vector<size_t>& runStart, std::vector<int64_t>& runValue)
+    {
+        for (size_t i = 0; i < count; i++) {
+            int64_t value = static_cast<int64_t>(*reinterpret_cast<const T*>(base + i*stride));
+            if (i == 0 || value != runValue.back()) {
+                runStart.push_back(i);
+                runValue.push_back(value);
+            }
+        }
+    }
+
+    /// Append count elements, every step elements from base, packed
+    template <typename T>
+    void copyOf(const char* base, size_t stride, size_t step, size_t count, std::vector<char>& bytes)
+    {
+        size_t size = bytes.size();
+        bytes.resize(size + count*sizeof(T));
+        T* p = reinterpret_cast<T*>(&bytes[size]);
+        for (size_t i = 0; i < count; i++)
+            p[i] = *reinterpret_cast<const T*>(base + i*step*stride);
+    }
+}
+
+void SourceDestBufferImpl::accumulateRange(size_t first, size_t count, double& minimum, double& maximum)
+{
+    /// don't checkImageFileOpen
+
+    if (first >= capacity_)
+        return;
+    if (count > capacity_ - first)
+        count = capacity_ - first;
+
+    const char* p = &base_[first*stride_];
+    switch (memoryRepresentation_) {
+        case E57_INT8:   rangeOf<int8_t>(p, stride_, count, minimum, maximum);   break;
+        case E57_UINT8:  rangeOf<uint8_t>(p, stride_, count, minimum, maximum);  break;
+        case E57_INT16:  rangeOf<int16_t>(p, stride_, count, minimum, maximum);  break;
+        case E57_UINT16: rangeOf<uint16_t>(p, stride_, count, minimum, maximum); break;
+        case E57_INT32:  rangeOf<int32_t>(p, stride_, count, minimum, maximum);  break;
+        case E57_UINT32: rangeOf<uint32_t>(p, stride_, count, minimum, maximum); break;
+        case E57_INT64:  rangeOf<int64_t>(p, stride_, count, minimum, maximum);  break;
+        case E57_BOOL:   rangeOf<bool>(p, stride_, count, minimum, maximum);     break;
+        case E57_REAL32: rangeOf<float>(p, stride_, count, minimum, maximum);    break;
+        case E57_REAL64: rangeOf<double>(p, stride_, count, minimum, maximum);   break;
+        case E57_USTRING:
+            break;  /// no numeric range
+        default:
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "pathName=" + pathName_);
+    }
+}
+
+void SourceDestBufferImpl::findRuns(size_t count, std::vector<size_t>& runStart, std::vector<int64_t>& runValue)
+{
+    /// don't checkImageFileOpen
+
+    if (count > capacity_)
+        count = capacity_;
+
+    /// Real values are truncated to integers, group identifiers are integer valued
+    switch (memoryRepresentation_) {
+        case E57_INT8:   runsOf<int8_t>(base_, stride_, count, runStart, runValue);   break;
+        case E57_UINT8:  runsOf<uint8_t>(base_, stride_, count, runStart, runValue);  break;
+        case E57_INT16:  runsOf<int16_t>(base_, stride_, count, runStart, runValue);  break;
+        case E57_UINT16: runsOf<uint16_t>(base_, stride_, count, runStart, runValue); break;
+        case E57_INT32:  runsOf<int32_t>(base_, stride_, count, runStart, runValue);  break;
+        case E57_UINT32: runsOf<uint32_t>(base_, stride_, count, runStart, runValue); break;
+        case E57_INT64:  runsOf<int64_t>(base_, stride_, count, runStart, runValue);  break;
+        case E57_BOOL:   runsOf<bool>(base_, stride_, count, runStart, runValue);     break;
+        case E57_REAL32: runsOf<float>(base_, stride_, count, runStart, runValue);    break;
+        case E57_REAL64: runsOf<double>(base_, stride_, count, runStart, runValue);   break;
+        case E57_USTRING:
+            throw E57_EXCEPTION2(E57_ERROR_EXPECTING_NUMERIC, "pathName=" + pathName_);
+        default:
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "pathName=" + pathName_);
+    }
+}
+
+void SourceDestBufferImpl::copyElements(size_t first, size_t step, size_t count, std::vector<char>& bytes, std::vector<ustring>& strings)
+{
+    /// don't checkImageFileOpen
+
+    if (count == 0)
+        return;
+    if (step == 0 || first + (count-1)*step >= capacity_)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "pathName=" + pathName_);
+
+    const char* p = (memoryRepresentation_ == E57_USTRING) ? NULL : &base_[first*stride_];
+    switch (memoryRepresentation_) {
+        case E57_INT8:   copyOf<int8_t>(p, stride_, step, count, bytes);   break;
+        case E57_UINT8:  copyOf<uint8_t>(p, stride_, step, count, bytes);  break;
+        case E57_INT16:  copyOf<int16_t>(p, stride_, step, count, bytes);  break;
+        case E57_UINT16: copyOf<uint16_t>(p, stride_, step, count, bytes); break;
+        case E57_INT32:  copyOf<int32_t>(p, stride_, step, count, bytes);  break;
+        case E57_UINT32: copyOf<uint32_t>(p, stride_, step, count, bytes); break;
+        case E57_INT64:  copyOf<int64_t>(p, stride_, step, count, bytes);  break;
+        case E57_BOOL:   copyOf<bool>(p, stride_, step, count, bytes);     break;
+        case E57_REAL32: copyOf<float>(p, stride_, step, count, bytes);    break;
+        case E57_REAL64: copyOf<double>(p, stride_, step, count, bytes);   break;
+        case E57_USTRING:
+            for (size_t i = 0; i < count; i++)
+                strings.push_back(ustrings_->at(first + i*step));
+            break;
+        default:
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "pathName=" + pathName_);
+    }
+}
+
 void  SourceDestBufferImpl::setNextInt64(int64_t value)
 {
     /// don't checkImageFileOpen
@@ -1779,11 +1953,7 @@ void SourceDestBufferImpl::checkCompatible(shared_ptr<SourceDestBufferImpl> newB
                              "memoryRepresentation=" + toString(memoryRepresentation_)
                              + " newMemoryType=" + toString(newBuf->memoryRepresentation()));
     }
-    if (capacity_ != newBuf->capacity()) {
-        throw E57_EXCEPTION2(E57_ERROR_BUFFERS_NOT_COMPATIBLE,
-                             "capacity=" + toString(capacity_)
-                             + " newCapacity=" + toString(newBuf->capacity()));
-    }
+    /// Capacity may change, as documented for CompressedVectorReader::read(dbufs) and CompressedVectorWriter::write(sbufs)
     if (doConversion_ != newBuf->doConversion()) {
         throw E57_EXCEPTION2(E57_ERROR_BUFFERS_NOT_COMPATIBLE,
                              "doConversion=" + toString(doConversion_)
@@ -1988,7 +2158,7 @@ void CompressedVectorNodeImpl::checkLeavesInSet(const std::set<ustring>& /*pathN
     throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "this->pathName=" + this->pathName());
 }
 
-void CompressedVectorNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName)
+void CompressedVectorNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName)
 {
     // don't checkImageFileOpen
 
@@ -1998,7 +2168,7 @@ void CompressedVectorNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> imf, Ch
     else
         fieldName = elementName_;
 
-    uint64_t physicalStart = cf.logicalToPhysical(binarySectionLogicalStart_);
+    uint64_t physicalStart = CheckedFile::logicalToPhysical(binarySectionLogicalStart_);
 
     cf << space(indent) << "<" << fieldName << " type=\"CompressedVector\"";
     cf << " fileOffset=\"" << physicalStart;
@@ -2209,7 +2379,7 @@ void IntegerNodeImpl::checkLeavesInSet(const std::set<ustring>& pathNames, share
         throw E57_EXCEPTION2(E57_ERROR_NO_BUFFER_FOR_ELEMENT, "this->pathName=" + this->pathName());
 }
 
-void IntegerNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf???*/, CheckedFile& cf, int indent, const char* forcedFieldName)
+void IntegerNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf???*/, E57XmlWriter& cf, int indent, const char* forcedFieldName)
 {
     // don't checkImageFileOpen
 
@@ -2390,7 +2560,7 @@ void ScaledIntegerNodeImpl::checkLeavesInSet(const std::set<ustring>& pathNames,
         throw E57_EXCEPTION2(E57_ERROR_NO_BUFFER_FOR_ELEMENT, "this->pathName=" + this->pathName());
 }
 
-void ScaledIntegerNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, CheckedFile& cf, int indent, const char* forcedFieldName)
+void ScaledIntegerNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, E57XmlWriter& cf, int indent, const char* forcedFieldName)
 {
     // don't checkImageFileOpen
 
@@ -2541,7 +2711,7 @@ void FloatNodeImpl::checkLeavesInSet(const std::set<ustring>& pathNames, shared_
         throw E57_EXCEPTION2(E57_ERROR_NO_BUFFER_FOR_ELEMENT, "this->pathName=" + this->pathName());
 }
 
-void FloatNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, CheckedFile& cf, int indent, const char* forcedFieldName)
+void FloatNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, E57XmlWriter& cf, int indent, const char* forcedFieldName)
 {
     // don't checkImageFileOpen
 
@@ -2661,7 +2831,7 @@ void StringNodeImpl::checkLeavesInSet(const std::set<ustring>& pathNames, shared
         throw E57_EXCEPTION2(E57_ERROR_NO_BUFFER_FOR_ELEMENT, "this->pathName=" + this->pathName());
 }
 
-void StringNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, CheckedFile& cf, int indent, const char* forcedFieldName)
+void StringNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, E57XmlWriter& cf, int indent, const char* forcedFieldName)
 {
     // don't checkImageFileOpen
 
@@ -2861,7 +3031,7 @@ void BlobNodeImpl::checkLeavesInSet(const std::set<ustring>& pathNames, shared_p
         throw E57_EXCEPTION2(E57_ERROR_NO_BUFFER_FOR_ELEMENT, "this->pathName=" + this->pathName());
 }
 
-void BlobNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, CheckedFile& cf, int indent, const char* forcedFieldName)
+void BlobNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, E57XmlWriter& cf, int indent, const char* forcedFieldName)
 {
     // don't checkImageFileOpen
 
@@ -2874,7 +3044,7 @@ void BlobNodeImpl::writeXml(boost::shared_ptr<ImageFileImpl> /*imf*/, CheckedFil
     //??? need to implement
     //??? Type --> type
     //??? need to have length?, check same as in section header?
-    uint64_t physicalOffset = cf.logicalToPhysical(binarySectionLogicalStart_);
+    uint64_t physicalOffset = CheckedFile::logicalToPhysical(binarySectionLogicalStart_);
     cf << space(indent) << "<" << fieldName << " type=\"Blob\" fileOffset=\"" << physicalOffset << "\" length=\"" << blobLogicalLength_ << "\"/>\n";
 }
 
@@ -2902,8 +3072,11 @@ void BlobNodeImpl::dump(int indent, ostream& os)
 ///================================================================
 ///================================================================
 
+#ifndef E57_NO_XERCES
 #include <xercesc/sax/InputSource.hpp>
 #include <xercesc/util/BinInputStream.hpp>
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/util/TransService.hpp>
 
 /// Make shorthand for Xerces namespace???
 XERCES_CPP_NAMESPACE_USE
@@ -3006,6 +3179,251 @@ BinInputStream* E57FileInputSource::makeStream() const
 {
     return new E57FileInputStream(cf_, logicalStart_, logicalLength_);
 }
+#endif // E57_NO_XERCES
+
+///================================================================
+/// Support for the "lazyXml" read mode.
+/// The XML section is scanned (without a real parse) to find the children of the top level data3D and images2D elements.
+
+namespace {
+
+struct LazyXmlRange {
+    ustring     parentName;     /// Top level element that contains the deferred element, e.g. "data3D"
+    int64_t     childIndex;     /// Position of deferred element among the children of parentName
+    size_t      start;          /// Offset in XML section of the '<' of the start tag
+    size_t      startTagEnd;    /// Offset of the '>' that ends the start tag
+    size_t      end;            /// Offset just past the '>' of the end tag
+};
+
+/// Find first occurrence of str in xml starting at pos, returns xml.size() if not found
+size_t xmlFind(const vector<char>& xml, size_t pos, const char* str)
+{
+    size_t n = strlen(str);
+    while (pos + n <= xml.size()) {
+        const char* p = static_cast<const char*>(memchr(&xml[pos], str[0], xml.size() - pos));
+        if (p == NULL)
+            break;
+        pos = p - &xml[0];
+        if (pos + n <= xml.size() && memcmp(p, str, n) == 0)
+            return(pos);
+        pos++;
+    }
+    return(xml.size());
+}
+
+/// Get the value of the attribute with the given name from the attributes of a start tag.
+/// No entities are expanded, so only good for simple values like types and numbers.
+bool xmlFindAttribute(const char* attrs, size_t length, const char* name, string& value)
+{
+    const string a(attrs, length);
+    const size_t nameLength = strlen(name);
+    size_t pos = 0;
+    while ((pos = a.find(name, pos)) != string::npos) {
+        /// Must be a whole attribute name, not the end of some other name
+        if (pos == 0 || !strchr(" \t\r\n", a[pos-1])) {
+            pos += nameLength;
+            continue;
+        }
+        size_t i = a.find_first_not_of(" \t\r\n", pos+nameLength);
+        if (i == string::npos || a[i] != '=') {
+            pos += nameLength;
+            continue;
+        }
+        i = a.find_first_not_of(" \t\r\n", i+1);
+        if (i == string::npos || (a[i] != '"' && a[i] != '\''))
+            return(false);
+        size_t valueEnd = a.find(a[i], i+1);
+        if (valueEnd == string::npos)
+            return(false);
+        value = a.substr(i+1, valueEnd-(i+1));
+        return(true);
+    }
+    return(false);
+}
+
+/// Check if the attributes of a start tag declare type="Structure"
+bool xmlIsStructureTag(const char* attrs, size_t length)
+{
+    string type;
+    return(xmlFindAttribute(attrs, length, "type", type) && type == "Structure");
+}
+
+/// Scan XML for the fileOffset of every CompressedVector element, in document order.
+/// If the XML is malformed, the scan just stops.
+void xmlFindCompressedVectorOffsets(const vector<char>& xml, vector<uint64_t>& fileOffsets)
+{
+    fileOffsets.clear();
+    const size_t length = xml.size();
+    size_t pos = 0;
+
+    while (pos < length) {
+        const char* p = static_cast<const char*>(memchr(&xml[pos], '<', length - pos));
+        if (p == NULL)
+            break;
+        pos = p - &xml[0];
+        size_t remaining = length - pos;
+
+        /// Skip over markup that isn't a start tag
+        const char* skipEnd = NULL;
+        if (remaining >= 4 && memcmp(p, "<!--", 4) == 0)
+            skipEnd = "-->";
+        else if (remaining >= 9 && memcmp(p, "<![CDATA[", 9) == 0)
+            skipEnd = "]]>";
+        else if (remaining >= 2 && memcmp(p, "<?", 2) == 0)
+            skipEnd = "?>";
+        else if (remaining >= 2 && (p[1] == '!' || p[1] == '/'))
+            skipEnd = ">";
+        if (skipEnd != NULL) {
+            pos = xmlFind(xml, pos+2, skipEnd);
+            if (pos == length)
+                return;
+            pos += strlen(skipEnd);
+            continue;
+        }
+
+        /// Start tag, find end of name and end of tag (attribute values may contain '>')
+        size_t nameEnd = pos + 1;
+        while (nameEnd < length && !strchr(" \t\r\n/>", xml[nameEnd]))
+            nameEnd++;
+        size_t tagEnd = nameEnd;
+        char quote = 0;
+        for (; tagEnd < length; tagEnd++) {
+            char c = xml[tagEnd];
+            if (quote != 0) {
+                if (c == quote)
+                    quote = 0;
+            } else if (c == '"' || c == '\'')
+                quote = c;
+            else if (c == '>')
+                break;
+        }
+        if (tagEnd == length)
+            return;
+
+        string type, fileOffset;
+        if (xmlFindAttribute(&xml[nameEnd], tagEnd - nameEnd, "type", type) && type == "CompressedVector"
+            && xmlFindAttribute(&xml[nameEnd], tagEnd - nameEnd, "fileOffset", fileOffset)) {
+            fileOffsets.push_back(strtoull(fileOffset.c_str(), NULL, 10));
+        }
+        pos = tagEnd + 1;
+    }
+}
+
+/// Scan XML for non-empty Structure children of top level data3D or images2D elements.
+/// If the XML is malformed, the scan just stops, and the real parser reports the problem.
+void xmlFindLazyRanges(const vector<char>& xml, vector<LazyXmlRange>& ranges)
+{
+    ranges.clear();
+    const size_t length = xml.size();
+    size_t pos = 0;
+    int depth = 0;
+    bool inLazyParent = false;
+    bool inLazyChild = false;
+    int64_t childCount = 0;
+    LazyXmlRange current;
+
+    while (pos < length) {
+        /// Character data can't contain a '<', so next one starts markup
+        const char* p = static_cast<const char*>(memchr(&xml[pos], '<', length - pos));
+        if (p == NULL)
+            break;
+        pos = p - &xml[0];
+        size_t remaining = length - pos;
+
+        /// Skip over markup that doesn't change the element depth
+        const char* skipEnd = NULL;
+        if (remaining >= 4 && memcmp(p, "<!--", 4) == 0)
+            skipEnd = "-->";
+        else if (remaining >= 9 && memcmp(p, "<![CDATA[", 9) == 0)
+            skipEnd = "]]>";
+        else if (remaining >= 2 && memcmp(p, "<?", 2) == 0)
+            skipEnd = "?>";
+        else if (remaining >= 2 && memcmp(p, "<!", 2) == 0)
+            skipEnd = ">";
+        if (skipEnd != NULL) {
+            pos = xmlFind(xml, pos+2, skipEnd);
+            if (pos == length)
+                return;
+            pos += strlen(skipEnd);
+            continue;
+        }
+
+        /// End tag
+        if (remaining >= 2 && p[1] == '/') {
+            pos = xmlFind(xml, pos, ">");
+            if (pos == length)
+                return;
+            pos++;
+            depth--;
+            if (inLazyChild && depth == 2) {
+                current.end = pos;
+                ranges.push_back(current);
+                inLazyChild = false;
+            }
+            if (depth <= 1)
+                inLazyParent = false;
+            continue;
+        }
+
+        /// Start tag, find end of name and end of tag (attribute values may contain '>')
+        size_t nameEnd = pos + 1;
+        while (nameEnd < length && !strchr(" \t\r\n/>", xml[nameEnd]))
+            nameEnd++;
+        size_t tagEnd = nameEnd;
+        char quote = 0;
+        for (; tagEnd < length; tagEnd++) {
+            char c = xml[tagEnd];
+            if (quote != 0) {
+                if (c == quote)
+                    quote = 0;
+            } else if (c == '"' || c == '\'')
+                quote = c;
+            else if (c == '>')
+                break;
+        }
+        if (tagEnd == length)
+            return;
+        bool isEmptyElement = (xml[tagEnd-1] == '/');
+
+        if (depth == 1 && !isEmptyElement) {
+            ustring name(&xml[pos+1], nameEnd - (pos+1));
+            inLazyParent = (name == "data3D" || name == "images2D");
+            if (inLazyParent) {
+                current.parentName = name;
+                childCount = 0;
+            }
+        } else if (depth == 2 && inLazyParent) {
+            if (!isEmptyElement && xmlIsStructureTag(&xml[nameEnd], tagEnd - nameEnd)) {
+                current.childIndex  = childCount;
+                current.start       = pos;
+                current.startTagEnd = tagEnd;
+                inLazyChild = true;
+            }
+            childCount++;
+        }
+
+        if (!isEmptyElement)
+            depth++;
+        pos = tagEnd + 1;
+    }
+}
+
+/// Escape a string so it can be used as an XML attribute value in double quotes
+ustring xmlEscapeAttribute(const ustring& s)
+{
+    ustring result;
+    for (size_t i = 0; i < s.size(); i++) {
+        switch (s[i]) {
+            case '&':   result += "&amp;";  break;
+            case '<':   result += "&lt;";   break;
+            case '"':   result += "&quot;"; break;
+            default:    result += s[i];
+        }
+    }
+    return(result);
+}
+
+} // end anonymous namespace
 
 ///============================================================================================================
 ///============================================================================================================
@@ -3014,32 +3432,42 @@ BinInputStream* E57FileInputSource::makeStream() const
 
 namespace e57 {
 
-class E57XmlParser : public DefaultHandler
+/// Attributes of the element being parsed, independent of which XML parser backend produced them.
+/// All strings are UTF-8.
+class E57XmlAttributes {
+public:
+    virtual         ~E57XmlAttributes() {};
+    virtual size_t  count() const = 0;
+    virtual ustring uri(size_t i) const = 0;
+    virtual ustring localName(size_t i) const = 0;
+    virtual ustring qName(size_t i) const = 0;
+    virtual ustring value(size_t i) const = 0;
+
+    /// Get value of attribute with given qualified name, returns false if not present
+    virtual bool    find(const char* qName, ustring& value) const = 0;
+};
+
+class E57XmlParser
 {
 public:
-    E57XmlParser(boost::shared_ptr<ImageFileImpl> imf);
+    E57XmlParser(boost::shared_ptr<ImageFileImpl> imf, bool isSubtree = false);
     ~E57XmlParser();
 
-    /// SAX interface
-    void startDocument();
-    void endDocument();
-    void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const Attributes& attributes);
-    void endElement( const XMLCh* const uri,
-                     const XMLCh* const localname,
-                     const XMLCh* const qname);
-    void characters(const XMLCh* const chars, const XMLSize_t length);
-    void processingInstruction(const XMLCh* const target, const XMLCh* const data);
+    /// In subtree mode, the outermost Structure is returned here instead of becoming the ImageFile root
+    boost::shared_ptr<StructureNodeImpl> subtreeRoot() {return(subtreeRoot_);};
+
+    /// SAX style interface, called by whichever XML parser backend is reading the XML section.  Strings are UTF-8.
+    void startElement(const ustring& uri, const ustring& localName, const ustring& qName, const E57XmlAttributes& attributes);
+    void endElement(const ustring& uri, const ustring& localName, const ustring& qName);
+    void characters(const char* chars, size_t length);
 
-    /// SAX error interface
-    void warning(const SAXParseException& exc);
-    void error(const SAXParseException& exc);
-    void fatalError(const SAXParseException& exc);
 private:
-    ustring toUString(const XMLCh* const xml_str);
-    ustring lookupAttribute(const Attributes& attributes, const XMLCh* attribute_name);
-    bool    isAttributeDefined(const Attributes& attributes, const XMLCh* attribute_name);
+    ustring lookupAttribute(const E57XmlAttributes& attributes, const char* attribute_name);
+    bool    isAttributeDefined(const E57XmlAttributes& attributes, const char* attribute_name);
 
     boost::shared_ptr<ImageFileImpl> imf_;   /// Image file we are reading
+    bool                             isSubtree_;
+    boost::shared_ptr<StructureNodeImpl> subtreeRoot_;
 
     struct ParseInfo {
         /// All the fields need to remember while parsing the XML
@@ -3108,8 +3536,9 @@ void E57XmlParser::ParseInfo::dump(int indent, ostream& os)
 
 } /// end namespace e57
 
-E57XmlParser::E57XmlParser(boost::shared_ptr<ImageFileImpl> imf)
-: imf_(imf)
+E57XmlParser::E57XmlParser(boost::shared_ptr<ImageFileImpl> imf, bool isSubtree)
+: imf_(imf),
+  isSubtree_(isSubtree)
 {
 }
 
@@ -3118,43 +3547,27 @@ E57XmlParser::~E57XmlParser()
 }
 
 
-void E57XmlParser::startDocument()
-{
-#ifdef E57_MAX_VERBOSE
-    cout << "startDocument" << endl;
-#endif
-}
-
-
-void E57XmlParser::endDocument()
-{
-#ifdef E57_MAX_VERBOSE
-    cout << "endDocument"<<endl;
-#endif
-}
-
-
-void E57XmlParser::startElement(const   XMLCh* const    uri,
-                                const   XMLCh* const    localName,
-                                const   XMLCh* const    qName,
-                                const   Attributes&     attributes)
+void E57XmlParser::startElement(const ustring&          uri,
+                                const ustring&          localName,
+                                const ustring&          qName,
+                                const E57XmlAttributes& attributes)
 {
 #ifdef E57_MAX_VERBOSE
     cout << "startElement" << endl;
-    cout << space(2) << "URI:       " << toUString(uri) << endl;
-    cout << space(2) << "localName: " << toUString(localName) << endl;
-    cout << space(2) << "qName:     " << toUString(qName) << endl;
+    cout << space(2) << "URI:       " << uri << endl;
+    cout << space(2) << "localName: " << localName << endl;
+    cout << space(2) << "qName:     " << qName << endl;
 
-    for (size_t i = 0; i < attributes.getLength(); i++) {
+    for (size_t i = 0; i < attributes.count(); i++) {
         cout << space(2) << "Attribute[" << i << "]" << endl;
-        cout << space(4) << "URI:       " << toUString(attributes.getURI(i)) << endl;
-        cout << space(4) << "localName: " << toUString(attributes.getLocalName(i)) << endl;
-        cout << space(4) << "qName:     " << toUString(attributes.getQName(i)) << endl;
-        cout << space(4) << "value:     " << toUString(attributes.getValue(i)) << endl;
+        cout << space(4) << "URI:       " << attributes.uri(i) << endl;
+        cout << space(4) << "localName: " << attributes.localName(i) << endl;
+        cout << space(4) << "qName:     " << attributes.qName(i) << endl;
+        cout << space(4) << "value:     " << attributes.value(i) << endl;
     }
 #endif
     /// Get Type attribute
-    ustring node_type = lookupAttribute(attributes, att_type);
+    ustring node_type = lookupAttribute(attributes, "type");
 
     //??? check to make sure not in primitive type (can only nest inside compound types).
 
@@ -3167,8 +3580,8 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
         //??? check validity of numeric strings
         pi.nodeType = E57_INTEGER;
 
-        if (isAttributeDefined(attributes, att_minimum)) {
-            ustring minimum_str = lookupAttribute(attributes, att_minimum);
+        if (isAttributeDefined(attributes, "minimum")) {
+            ustring minimum_str = lookupAttribute(attributes, "minimum");
 #if defined(_MSC_VER)
             pi.minimum = _atoi64(minimum_str.c_str());
 #elif defined(__GNUC__)
@@ -3181,8 +3594,8 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
             pi.minimum = E57_INT64_MIN;
         }
 
-        if (isAttributeDefined(attributes, att_maximum)) {
-            ustring maximum_str   = lookupAttribute(attributes, att_maximum);
+        if (isAttributeDefined(attributes, "maximum")) {
+            ustring maximum_str   = lookupAttribute(attributes, "maximum");
 #if defined(_MSC_VER)
             pi.maximum = _atoi64(maximum_str.c_str());
 #elif defined(__GNUC__)
@@ -3204,8 +3617,8 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
         pi.nodeType = E57_SCALED_INTEGER;
 
         //??? check validity of numeric strings
-        if (isAttributeDefined(attributes, att_minimum)) {
-            ustring minimum_str = lookupAttribute(attributes, att_minimum);
+        if (isAttributeDefined(attributes, "minimum")) {
+            ustring minimum_str = lookupAttribute(attributes, "minimum");
 #if defined(_MSC_VER)
             pi.minimum = _atoi64(minimum_str.c_str());
 #elif defined(__GNUC__)
@@ -3218,8 +3631,8 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
             pi.minimum = E57_INT64_MIN;
         }
 
-        if (isAttributeDefined(attributes, att_maximum)) {
-            ustring maximum_str   = lookupAttribute(attributes, att_maximum);
+        if (isAttributeDefined(attributes, "maximum")) {
+            ustring maximum_str   = lookupAttribute(attributes, "maximum");
 #if defined(_MSC_VER)
             pi.maximum = _atoi64(maximum_str.c_str());
 #elif defined(__GNUC__)
@@ -3232,16 +3645,16 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
             pi.maximum = E57_INT64_MAX;
         }
 
-        if (isAttributeDefined(attributes, att_scale)) {
-            ustring scale_str = lookupAttribute(attributes, att_scale);
+        if (isAttributeDefined(attributes, "scale")) {
+            ustring scale_str = lookupAttribute(attributes, "scale");
             pi.scale = atof(scale_str.c_str());  //??? use exact rounding library
         } else {
             /// Not defined defined in XML, so defaults to 1.0
             pi.scale = 1.0;
         }
 
-        if (isAttributeDefined(attributes, att_offset)) {
-            ustring offset_str = lookupAttribute(attributes, att_offset);
+        if (isAttributeDefined(attributes, "offset")) {
+            ustring offset_str = lookupAttribute(attributes, "offset");
             pi.offset = atof(offset_str.c_str());  //??? use exact rounding library
         } else {
             /// Not defined defined in XML, so defaults to 0.0
@@ -3256,8 +3669,8 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
 #endif
         pi.nodeType = E57_FLOAT;
 
-        if (isAttributeDefined(attributes, att_precision)) {
-			ustring precision_str = lookupAttribute(attributes, att_precision);
+        if (isAttributeDefined(attributes, "precision")) {
+			ustring precision_str = lookupAttribute(attributes, "precision");
 			if (precision_str == "single")
 				pi.precision = E57_SINGLE;
 			else if (precision_str == "double")
@@ -3266,17 +3679,17 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
 				throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
 									 "precisionString=" + precision_str
 									 + " fileName=" + imf_->fileName()
-									 + " uri=" + toUString(uri)
-									 + " localName=" + toUString(localName)
-									 + " qName=" + toUString(qName));
+									 + " uri=" + uri
+									 + " localName=" + localName
+									 + " qName=" + qName);
 			}
 		} else {
             /// Not defined defined in XML, so defaults to double
 			pi.precision = E57_DOUBLE;
 		}
 
-        if (isAttributeDefined(attributes, att_minimum)) {
-            ustring minimum_str = lookupAttribute(attributes, att_minimum);
+        if (isAttributeDefined(attributes, "minimum")) {
+            ustring minimum_str = lookupAttribute(attributes, "minimum");
             pi.floatMinimum = atof(minimum_str.c_str());  //??? use exact rounding library
         } else {
             /// Not defined defined in XML, so defaults to E57_FLOAT_MIN or E57_DOUBLE_MIN
@@ -3286,8 +3699,8 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
                 pi.floatMinimum = E57_DOUBLE_MIN;
         }
 
-        if (isAttributeDefined(attributes, att_maximum)) {
-            ustring maximum_str = lookupAttribute(attributes, att_maximum);
+        if (isAttributeDefined(attributes, "maximum")) {
+            ustring maximum_str = lookupAttribute(attributes, "maximum");
             pi.floatMaximum = atof(maximum_str.c_str());  //??? use exact rounding library
         } else {
             /// Not defined defined in XML, so defaults to FLOAT_MAX or DOUBLE_MAX
@@ -3316,7 +3729,7 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
         //??? check validity of numeric strings
 
         /// fileOffset is required to be defined
-        ustring fileOffset_str = lookupAttribute(attributes, att_fileOffset);
+        ustring fileOffset_str = lookupAttribute(attributes, "fileOffset");
 #if defined(_MSC_VER)
         pi.fileOffset = _atoi64(fileOffset_str.c_str());
 #elif defined(__GNUC__)
@@ -3326,7 +3739,7 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
 #endif
 
         /// length is required to be defined
-        ustring length_str = lookupAttribute(attributes, att_length);
+        ustring length_str = lookupAttribute(attributes, "length");
 #if defined(_MSC_VER)
         pi.length = _atoi64(length_str.c_str());
 #elif defined(__GNUC__)
@@ -3343,27 +3756,27 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
 #endif
         pi.nodeType = E57_STRUCTURE;
 
-        /// Read name space decls, if e57Root element
-        if (toUString(localName) == "e57Root") {
+        /// Read name space decls, if e57Root element (a subtree only borrows the declarations already registered)
+        if (!isSubtree_ && localName == "e57Root") {
             /// Search attributes for namespace declarations (only allowed in E57Root structure)
             bool gotDefault = false;
-            for (size_t i = 0; i < attributes.getLength(); i++) {
+            for (size_t i = 0; i < attributes.count(); i++) {
                 /// Check if declaring the default namespace
-                if (toUString(attributes.getQName(i)) == "xmlns") {
+                if (attributes.qName(i) == "xmlns") {
 #ifdef E57_VERBOSE
-                    cout << "declared default namespace, URI=" << toUString(attributes.getValue(i)) << endl;
+                    cout << "declared default namespace, URI=" << attributes.value(i) << endl;
 #endif
-                    imf_->extensionsAdd("", toUString(attributes.getValue(i)));
+                    imf_->extensionsAdd("", attributes.value(i));
                     gotDefault = true;
                 }
 
                 /// Check if declaring a namespace
-                if (toUString(attributes.getURI(i)) == "http://www.w3.org/2000/xmlns/") {
+                if (attributes.uri(i) == "http://www.w3.org/2000/xmlns/") {
 #ifdef E57_VERBOSE
-                    cout << "declared extension, prefix=" << toUString(attributes.getLocalName(i))
-                         << " URI=" << toUString(attributes.getValue(i)) << endl;
+                    cout << "declared extension, prefix=" << attributes.localName(i)
+                         << " URI=" << attributes.value(i) << endl;
 #endif
-                    imf_->extensionsAdd(toUString(attributes.getLocalName(i)), toUString(attributes.getValue(i)));
+                    imf_->extensionsAdd(attributes.localName(i), attributes.value(i));
                 }
             }
 
@@ -3371,9 +3784,9 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
             if (!gotDefault) {
                 throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                                      "fileName=" + imf_->fileName()
-                                     + " uri=" + toUString(uri)
-                                     + " localName=" + toUString(localName)
-                                     + " qName=" + toUString(qName));
+                                     + " uri=" + uri
+                                     + " localName=" + localName
+                                     + " qName=" + qName);
             }
         }
 
@@ -3382,7 +3795,7 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
         pi.container_ni = s_ni;
 
         /// After have Structure, check again if E57Root, if so mark attached so all children will be attached when added
-        if (toUString(localName) == "e57Root")
+        if (!isSubtree_ && localName == "e57Root")
             s_ni->setAttachedRecursive();
 
         /// Push info so far onto stack
@@ -3393,8 +3806,8 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
 #endif
         pi.nodeType = E57_VECTOR;
 
-        if (isAttributeDefined(attributes, att_allowHeterogeneousChildren)) {
-            ustring allowHetero_str = lookupAttribute(attributes, att_allowHeterogeneousChildren);
+        if (isAttributeDefined(attributes, "allowHeterogeneousChildren")) {
+            ustring allowHetero_str = lookupAttribute(attributes, "allowHeterogeneousChildren");
 #if defined(_MSC_VER)
             int64_t i64 = _atoi64(allowHetero_str.c_str());
 #elif defined(__GNUC__)
@@ -3410,9 +3823,9 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
                 throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                                      "allowHeterogeneousChildren=" + toString(i64)
                                      + "fileName=" + imf_->fileName()
-                                     + " uri=" + toUString(uri)
-                                     + " localName=" + toUString(localName)
-                                     + " qName=" + toUString(qName));
+                                     + " uri=" + uri
+                                     + " localName=" + localName
+                                     + " qName=" + qName);
             }
         } else {
             /// Not defined defined in XML, so defaults to false
@@ -3432,7 +3845,7 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
         pi.nodeType = E57_COMPRESSED_VECTOR;
 
         /// fileOffset is required to be defined
-        ustring fileOffset_str = lookupAttribute(attributes, att_fileOffset);
+        ustring fileOffset_str = lookupAttribute(attributes, "fileOffset");
 #if defined(_MSC_VER)
         pi.fileOffset = _atoi64(fileOffset_str.c_str());
 #elif defined(__GNUC__)
@@ -3442,7 +3855,7 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
 #endif
 
         /// recordCount is required to be defined
-        ustring recordCount_str = lookupAttribute(attributes, att_recordCount);
+        ustring recordCount_str = lookupAttribute(attributes, "recordCount");
 #if defined(_MSC_VER)
         pi.recordCount = _atoi64(recordCount_str.c_str());
 #elif defined(__GNUC__)
@@ -3463,18 +3876,18 @@ void E57XmlParser::startElement(const   XMLCh* const    uri,
         throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                              "nodeType=" + node_type
                              + " fileName=" + imf_->fileName()
-                             + " uri=" + toUString(uri)
-                             + " localName=" + toUString(localName)
-                             + " qName=" + toUString(qName));
+                             + " uri=" + uri
+                             + " localName=" + localName
+                             + " qName=" + qName);
     }
 #ifdef E57_MAX_VERBOSE
     pi.dump(4);
 #endif
 }
 
-void E57XmlParser::endElement(const XMLCh* const uri,
-                              const XMLCh* const localName,
-                              const XMLCh* const qName)
+void E57XmlParser::endElement(const ustring& uri,
+                              const ustring& localName,
+                              const ustring& qName)
 {
 #ifdef E57_MAX_VERBOSE
     cout << "endElement" << endl;
@@ -3552,9 +3965,9 @@ void E57XmlParser::endElement(const XMLCh* const uri,
             throw E57_EXCEPTION2(E57_ERROR_INTERNAL,
                                  "nodeType=" + toString(pi.nodeType)
                                  + " fileName=" + imf_->fileName()
-                                 + " uri=" + toUString(uri)
-                                 + " localName=" + toUString(localName)
-                                 + " qName=" + toUString(qName));
+                                 + " uri=" + uri
+                                 + " localName=" + localName
+                                 + " qName=" + qName);
     }
 #ifdef E57_MAX_VERBOSE
     current_ni->dump(4);
@@ -3567,11 +3980,14 @@ void E57XmlParser::endElement(const XMLCh* const uri,
             throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                                  "currentType=" + toString(current_ni->type())
                                  + " fileName=" + imf_->fileName()
-                                 + " uri=" + toUString(uri)
-                                 + " localName=" + toUString(localName)
-                                 + " qName=" + toUString(qName));
+                                 + " uri=" + uri
+                                 + " localName=" + localName
+                                 + " qName=" + qName);
         }
-        imf_->root_ = dynamic_pointer_cast<StructureNodeImpl>(current_ni);
+        if (isSubtree_)
+            subtreeRoot_ = dynamic_pointer_cast<StructureNodeImpl>(current_ni);
+        else
+            imf_->root_ = dynamic_pointer_cast<StructureNodeImpl>(current_ni);
         return;
     }
 
@@ -3580,9 +3996,9 @@ void E57XmlParser::endElement(const XMLCh* const uri,
     if (!parent_ni) {
         throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                              "fileName=" + imf_->fileName()
-                             + " uri=" + toUString(uri)
-                             + " localName=" + toUString(localName)
-                             + " qName=" + toUString(qName));
+                             + " uri=" + uri
+                             + " localName=" + localName
+                             + " qName=" + qName);
     }
 
     /// Add current node into parent at top of stack
@@ -3591,7 +4007,7 @@ void E57XmlParser::endElement(const XMLCh* const uri,
             shared_ptr<StructureNodeImpl> struct_ni = dynamic_pointer_cast<StructureNodeImpl>(parent_ni);
 
             /// Add named child to structure
-            struct_ni->set(toUString(qName), current_ni);
+            struct_ni->set(qName, current_ni);
             } break;
         case E57_VECTOR: {
             shared_ptr<VectorNodeImpl> vector_ni = dynamic_pointer_cast<VectorNodeImpl>(parent_ni);
@@ -3601,7 +4017,7 @@ void E57XmlParser::endElement(const XMLCh* const uri,
             } break;
         case E57_COMPRESSED_VECTOR: {
             shared_ptr<CompressedVectorNodeImpl> cv_ni = dynamic_pointer_cast<CompressedVectorNodeImpl>(parent_ni);
-            ustring uQName = toUString(qName);
+            ustring uQName = qName;
 
             /// n can be either prototype or codecs
             if (uQName == "prototype")
@@ -3611,9 +4027,9 @@ void E57XmlParser::endElement(const XMLCh* const uri,
                     throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                                          "currentType=" + toString(current_ni->type())
                                          + " fileName=" + imf_->fileName()
-                                         + " uri=" + toUString(uri)
-                                         + " localName=" + toUString(localName)
-                                         + " qName=" + toUString(qName));
+                                         + " uri=" + uri
+                                         + " localName=" + localName
+                                         + " qName=" + qName);
                 }
                 shared_ptr<VectorNodeImpl> vi = dynamic_pointer_cast<VectorNodeImpl>(current_ni);
 
@@ -3622,9 +4038,9 @@ void E57XmlParser::endElement(const XMLCh* const uri,
                     throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                                          "currentType=" + toString(current_ni->type())
                                          + " fileName=" + imf_->fileName()
-                                         + " uri=" + toUString(uri)
-                                         + " localName=" + toUString(localName)
-                                         + " qName=" + toUString(qName));
+                                         + " uri=" + uri
+                                         + " localName=" + localName
+                                         + " qName=" + qName);
                 }
 
                 cv_ni->setCodecs(vi);
@@ -3632,9 +4048,9 @@ void E57XmlParser::endElement(const XMLCh* const uri,
                 /// Found unknown XML child element of CompressedVector, not prototype or codecs
                 throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                                      + "fileName=" + imf_->fileName()
-                                     + " uri=" + toUString(uri)
-                                     + " localName=" + toUString(localName)
-                                     + " qName=" + toUString(qName));
+                                     + " uri=" + uri
+                                     + " localName=" + localName
+                                     + " qName=" + qName);
             }
         } break;
         default:
@@ -3642,28 +4058,17 @@ void E57XmlParser::endElement(const XMLCh* const uri,
             throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT,
                                  "parentType=" + toString(parent_ni->type())
                                  + " fileName=" + imf_->fileName()
-                                 + " uri=" + toUString(uri)
-                                 + " localName=" + toUString(localName)
-                                 + " qName=" + toUString(qName));
+                                 + " uri=" + uri
+                                 + " localName=" + localName
+                                 + " qName=" + qName);
     }
 }
 
 
-void E57XmlParser::processingInstruction(const XMLCh* const /*target*/,
-                                         const XMLCh* const /*data*/)
-{
-#ifdef E57_MAX_VERBOSE
-    cout << "processingInstruction" << endl;
-#endif
-}
-
-
-void E57XmlParser::characters(const   XMLCh* const chars,
-                              const   XMLSize_t    length)
+void E57XmlParser::characters(const char* chars, size_t length)
 {
-//??? use length to make ustring
 #ifdef E57_MAX_VERBOSE
-    cout << "characters, chars=\"" << toUString(chars) << "\" length=" << length << endl;
+    cout << "characters, chars=\"" << ustring(chars, length) << "\" length=" << length << endl;
 #endif
     /// Get active element
     ParseInfo& pi = stack_.top();
@@ -3675,66 +4080,909 @@ void E57XmlParser::characters(const   XMLCh* const chars,
         case E57_COMPRESSED_VECTOR:
         case E57_BLOB: {
             /// If characters aren't whitespace, have an error, else ignore
-            ustring s = toUString(chars);
-            if (s.find_first_not_of(" \t\n\r") != string::npos)
-                throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT, "chars=" + toUString(chars));
+            for (size_t i = 0; i < length; i++) {
+                if (!strchr(" \t\n\r", chars[i]) || chars[i] == '\0')
+                    throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT, "chars=" + ustring(chars, length));
+            }
             } break;
         default:
             /// Append to any previous characters
-            pi.childText += toUString(chars);
+            pi.childText.append(chars, length);
     }
 }
 
-void E57XmlParser::error(const SAXParseException& ex)
+ustring E57XmlParser::lookupAttribute(const E57XmlAttributes& attributes, const char* attribute_name)
 {
-    throw E57_EXCEPTION2(E57_ERROR_XML_PARSER,
-                         "systemId=" + ustring(XMLString::transcode(ex.getSystemId()))
-                         + " xmlLine=" + toString(ex.getLineNumber())
-                         + " xmlColumn=" + toString(ex.getColumnNumber())
-                         + " parserMessage=" + ustring(XMLString::transcode(ex.getMessage())));
+    ustring value;
+    if (!attributes.find(attribute_name, value))
+        throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT, "attributeName=" + ustring(attribute_name));
+    return(value);
 }
 
-void E57XmlParser::fatalError(const SAXParseException& ex)
+bool E57XmlParser::isAttributeDefined(const E57XmlAttributes& attributes, const char* attribute_name)
 {
-    throw E57_EXCEPTION2(E57_ERROR_XML_PARSER,
-                         "systemId=" + ustring(XMLString::transcode(ex.getSystemId()))
-                         + " xmlLine=" + toString(ex.getLineNumber())
-                         + " xmlColumn=" + toString(ex.getColumnNumber())
-                         + " parserMessage=" + ustring(XMLString::transcode(ex.getMessage())));
+    ustring value;
+    return(attributes.find(attribute_name, value));
 }
 
-void E57XmlParser::warning(const SAXParseException& ex)
-{
-    /// Don't take any action on warning from parser, just report
-    cerr << "**** XML parser warning: " << ustring(XMLString::transcode(ex.getMessage())) << endl;
-    cerr << "  Debug info:" << endl;
-    cerr << "    systemId=" << XMLString::transcode(ex.getSystemId()) << endl;
-    cerr << ",   xmlLine="     << ex.getLineNumber() << endl;
-    cerr << ",   xmlColumn="   << ex.getColumnNumber() << endl;
-}
+//=============================================================================
+#ifndef E57_NO_XERCES
 
-ustring E57XmlParser::toUString(const XMLCh* const xml_str)
-{
-    ustring u_str;
-    if (xml_str && *xml_str) {
-        TranscodeToStr UTF8Transcoder(xml_str, "UTF-8");
-        u_str  = ustring(reinterpret_cast<const char*>(UTF8Transcoder.str()));
-    }
-    return(u_str);
-}
+namespace e57 {
 
-ustring E57XmlParser::lookupAttribute(const Attributes& attributes, const XMLCh* attribute_name)
+/// Adapts Xerces SAX2 events to the E57XmlParser interface, transcoding strings to UTF-8
+class E57XercesHandler : public DefaultHandler
 {
-    XMLSize_t attr_index;
-    if (!attributes.getIndex(attribute_name, attr_index))
-        throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT, "attributeName=" + toUString(attribute_name));
-    return(toUString(attributes.getValue(attr_index)));
-}
+public:
+    E57XercesHandler(E57XmlParser& parser) : parser_(parser) {};
+
+    /// SAX interface
+    void startDocument();
+    void endDocument();
+    void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const Attributes& attributes);
+    void endElement( const XMLCh* const uri,
+                     const XMLCh* const localname,
+                     const XMLCh* const qname);
+    void characters(const XMLCh* const chars, const XMLSize_t length);
+    void processingInstruction(const XMLCh* const target, const XMLCh* const data);
+
+    /// SAX error interface
+    void warning(const SAXParseException& exc);
+    void error(const SAXParseException& exc);
+    void fatalError(const SAXParseException& exc);
+
+    static ustring toUString(const XMLCh* const xml_str);
+private:
+    E57XmlParser&   parser_;
+};
+
+/// Xerces attribute list seen through the E57XmlAttributes interface
+class E57XercesAttributes : public E57XmlAttributes
+{
+public:
+    E57XercesAttributes(const Attributes& attributes) : attributes_(attributes) {};
+
+    size_t  count() const                 {return(attributes_.getLength());};
+    ustring uri(size_t i) const           {return(E57XercesHandler::toUString(attributes_.getURI(i)));};
+    ustring localName(size_t i) const     {return(E57XercesHandler::toUString(attributes_.getLocalName(i)));};
+    ustring qName(size_t i) const         {return(E57XercesHandler::toUString(attributes_.getQName(i)));};
+    ustring value(size_t i) const         {return(E57XercesHandler::toUString(attributes_.getValue(i)));};
+    bool    find(const char* qName, ustring& value) const;
+private:
+    const Attributes&   attributes_;
+};
+
+} /// end namespace e57
 
-bool E57XmlParser::isAttributeDefined(const Attributes& attributes, const XMLCh* attribute_name)
+void E57XercesHandler::startDocument()
 {
-    XMLSize_t attr_index;
-    return(attributes.getIndex(attribute_name, attr_index));
+#ifdef E57_MAX_VERBOSE
+    cout << "startDocument" << endl;
+#endif
+}
+
+void E57XercesHandler::endDocument()
+{
+#ifdef E57_MAX_VERBOSE
+    cout << "endDocument"<<endl;
+#endif
+}
+
+void E57XercesHandler::startElement(const   XMLCh* const    uri,
+                                    const   XMLCh* const    localName,
+                                    const   XMLCh* const    qName,
+                                    const   Attributes&     attributes)
+{
+    E57XercesAttributes e57Attributes(attributes);
+    parser_.startElement(toUString(uri), toUString(localName), toUString(qName), e57Attributes);
+}
+
+void E57XercesHandler::endElement(const XMLCh* const uri,
+                                  const XMLCh* const localName,
+                                  const XMLCh* const qName)
+{
+    parser_.endElement(toUString(uri), toUString(localName), toUString(qName));
+}
+
+void E57XercesHandler::characters(const   XMLCh* const chars,
+                                  const   XMLSize_t    length)
+{
+    if (length == 0)
+        return;
+    TranscodeToStr UTF8Transcoder(chars, length, "UTF-8");
+    parser_.characters(reinterpret_cast<const char*>(UTF8Transcoder.str()), UTF8Transcoder.length());
+}
+
+void E57XercesHandler::processingInstruction(const XMLCh* const /*target*/,
+                                             const XMLCh* const /*data*/)
+{
+#ifdef E57_MAX_VERBOSE
+    cout << "processingInstruction" << endl;
+#endif
+}
+
+void E57XercesHandler::error(const SAXParseException& ex)
+{
+    throw E57_EXCEPTION2(E57_ERROR_XML_PARSER,
+                         "systemId=" + ustring(XMLString::transcode(ex.getSystemId()))
+                         + " xmlLine=" + toString(ex.getLineNumber())
+                         + " xmlColumn=" + toString(ex.getColumnNumber())
+                         + " parserMessage=" + ustring(XMLString::transcode(ex.getMessage())));
+}
+
+void E57XercesHandler::fatalError(const SAXParseException& ex)
+{
+    throw E57_EXCEPTION2(E57_ERROR_XML_PARSER,
+                         "systemId=" + ustring(XMLString::transcode(ex.getSystemId()))
+                         + " xmlLine=" + toString(ex.getLineNumber())
+                         + " xmlColumn=" + toString(ex.getColumnNumber())
+                         + " parserMessage=" + ustring(XMLString::transcode(ex.getMessage())));
+}
+
+void E57XercesHandler::warning(const SAXParseException& ex)
+{
+    /// Don't take any action on warning from parser, just report
+    cerr << "**** XML parser warning: " << ustring(XMLString::transcode(ex.getMessage())) << endl;
+    cerr << "  Debug info:" << endl;
+    cerr << "    systemId=" << XMLString::transcode(ex.getSystemId()) << endl;
+    cerr << ",   xmlLine="     << ex.getLineNumber() << endl;
+    cerr << ",   xmlColumn="   << ex.getColumnNumber() << endl;
+}
+
+ustring E57XercesHandler::toUString(const XMLCh* const xml_str)
+{
+    ustring u_str;
+    if (xml_str && *xml_str) {
+        TranscodeToStr UTF8Transcoder(xml_str, "UTF-8");
+        u_str  = ustring(reinterpret_cast<const char*>(UTF8Transcoder.str()));
+    }
+    return(u_str);
+}
+
+bool E57XercesAttributes::find(const char* qName, ustring& value) const
+{
+    /// Compare against the ASCII name directly, rather than transcoding every attribute name
+    for (XMLSize_t i = 0; i < attributes_.getLength(); i++) {
+        const XMLCh* name = attributes_.getQName(i);
+        size_t j = 0;
+        while (qName[j] != '\0' && name[j] == static_cast<XMLCh>(qName[j]))
+            j++;
+        if (qName[j] == '\0' && name[j] == chNull) {
+            value = E57XercesHandler::toUString(attributes_.getValue(i));
+            return(true);
+        }
+    }
+    return(false);
+}
+
+//=============================================================================
+
+namespace e57 {
+
+/// Process wide pool of Xerces SAX2 readers.
+/// Initializing the Xerces platform and creating a reader with all its features costs far more than parsing a small XML section,
+/// so the platform is initialized once (on first use) and readers are kept for reuse by later ImageFiles.
+/// Readers are kept separately for each validation setting, since changing features between parses isn't reliable.
+class E57XmlReaderPool {
+public:
+    static E57XmlReaderPool& instance();
+
+    SAX2XMLReader*  acquire(bool validation);
+    void            release(SAX2XMLReader* xmlReader, bool validation);
+    void            discard(SAX2XMLReader* xmlReader);
+
+private:
+                    E57XmlReaderPool();
+                    ~E57XmlReaderPool();
+
+    /// Don't keep more idle readers than this, per validation setting
+    static const size_t MAX_IDLE = 8;
+
+    std::mutex                      mutex_;
+    bool                            isInitialized_;
+    std::vector<SAX2XMLReader*>     idle_[2];   /// indexed by validation setting
+};
+
+} /// end namespace e57
+
+E57XmlReaderPool& E57XmlReaderPool::instance()
+{
+    /// Function static, so construction is thread safe and destruction happens at program exit
+    static E57XmlReaderPool pool;
+    return(pool);
+}
+
+E57XmlReaderPool::E57XmlReaderPool()
+: isInitialized_(false)
+{
+}
+
+E57XmlReaderPool::~E57XmlReaderPool()
+{
+    /// Program is exiting, give everything back to Xerces
+    for (unsigned i = 0; i < 2; i++) {
+        for (unsigned j = 0; j < idle_[i].size(); j++)
+            delete idle_[i][j];
+        idle_[i].clear();
+    }
+    if (isInitialized_) {
+        try {
+            XMLPlatformUtils::Terminate();
+        } catch (...) {};
+    }
+}
+
+SAX2XMLReader* E57XmlReaderPool::acquire(bool validation)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Initialize the XML4C2 system, only once per process
+    if (!isInitialized_) {
+        try {
+             XMLPlatformUtils::Initialize();
+        } catch (const XMLException& ex) {
+            /// Turn parser exception into E57Exception
+             throw E57_EXCEPTION2(E57_ERROR_XML_PARSER_INIT, "parserMessage=" + ustring(XMLString::transcode(ex.getMessage())));
+        }
+        isInitialized_ = true;
+    }
+
+    /// Reuse an idle reader if have one
+    std::vector<SAX2XMLReader*>& idle = idle_[validation ? 1 : 0];
+    if (!idle.empty()) {
+        SAX2XMLReader* xmlReader = idle.back();
+        idle.pop_back();
+        return(xmlReader);
+    }
+
+    SAX2XMLReader* xmlReader = XMLReaderFactory::createXMLReader();
+
+    //??? check these are right
+    xmlReader->setFeature(XMLUni::fgSAX2CoreValidation,        validation);
+    xmlReader->setFeature(XMLUni::fgXercesDynamic,             validation);
+    xmlReader->setFeature(XMLUni::fgSAX2CoreNameSpaces,        true);
+    xmlReader->setFeature(XMLUni::fgXercesSchema,              validation);
+    xmlReader->setFeature(XMLUni::fgXercesSchemaFullChecking,  validation);
+    xmlReader->setFeature(XMLUni::fgSAX2CoreNameSpacePrefixes, true);
+    if (!validation)
+        xmlReader->setFeature(XMLUni::fgXercesLoadExternalDTD, false);
+    return(xmlReader);
+}
+
+void E57XmlReaderPool::release(SAX2XMLReader* xmlReader, bool validation)
+{
+    /// Don't leave pointers to handlers that are about to go away
+    xmlReader->setContentHandler(NULL);
+    xmlReader->setErrorHandler(NULL);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SAX2XMLReader*>& idle = idle_[validation ? 1 : 0];
+    if (idle.size() < MAX_IDLE)
+        idle.push_back(xmlReader);
+    else
+        delete xmlReader;
+}
+
+void E57XmlReaderPool::discard(SAX2XMLReader* xmlReader)
+{
+    delete xmlReader;
+}
+
+namespace {
+
+/// Parse a Xerces input source with a reader borrowed from the pool
+void xercesParse(const InputSource& source, E57XmlParser& parser, bool validation)
+{
+    /// Borrow a configured reader from the process wide pool, Xerces stays initialized between files.
+    E57XmlReaderPool& pool = E57XmlReaderPool::instance();
+    SAX2XMLReader* xmlReader = pool.acquire(validation);
+
+    try {
+        /// Attach parser event handers to the SAX2 reader
+        E57XercesHandler handler(parser);
+        xmlReader->setContentHandler(&handler);
+        xmlReader->setErrorHandler(&handler);
+
+        /// Do the parse, building up the node tree
+        xmlReader->parse(source);
+    } catch (...) {
+        /// Reader may be in a bad state after an error, don't reuse it
+        pool.discard(xmlReader);
+        throw;  // rethrow
+    }
+    pool.release(xmlReader, validation);
+}
+
+} // end anonymous namespace
+
+#endif // E57_NO_XERCES
+
+//=============================================================================
+/// Built-in XML parser, used instead of Xerces when configured with "builtinXml" (or always, when built without Xerces).
+/// It is a non-validating pull parser for the subset of XML that E57 files use: elements, attributes, namespaces, character data,
+/// CDATA sections, the predefined and numeric character references, comments, processing instructions and an (ignored) DOCTYPE.
+/// It works in place on the whole XML section held in memory: names and text are reported as pointers into the buffer,
+/// and character references and line ends are decoded by overwriting the buffer, so the text doesn't need to be copied.
+
+namespace e57 {
+
+class E57XmlPullParser
+{
+public:
+    enum Event {
+        START_ELEMENT,
+        END_ELEMENT,
+        CHARACTERS,
+        END_DOCUMENT
+    };
+
+                    E57XmlPullParser(char* xml, size_t length);
+
+    /// Advance to next event.  An empty element tag produces both a START_ELEMENT and an END_ELEMENT.
+    Event           next();
+
+    /// Details of current event, valid until next call to next()
+    const ustring&  uri() const                     {return(uri_);};
+    const ustring&  localName() const               {return(localName_);};
+    const ustring&  qName() const                   {return(qName_);};
+    const E57XmlAttributes& attributes() const      {return(attributeList_);};
+    const char*     text() const                    {return(text_);};
+    size_t          textLength() const              {return(textLength_);};
+
+    /// Pull all remaining events, sending them to parser
+    void            parse(E57XmlParser& parser);
+
+private:
+    /// Namespace prefix bound to a URI, by a declaration on an element that is still open
+    struct Binding {
+        const char* prefix;
+        size_t      prefixLength;   /// zero for the default namespace
+        ustring     uri;
+                    Binding(const char* prefix0, size_t prefixLength0, const ustring& uri0)
+                    : prefix(prefix0), prefixLength(prefixLength0), uri(uri0) {};
+    };
+
+    struct OpenElement {
+        const char* qName;
+        size_t      qNameLength;
+        size_t      localOffset;    /// start of local name within qName
+        size_t      uriIndex;       /// index into bindings_, or NO_NAMESPACE
+        size_t      bindingsMark;   /// size of bindings_ before element's declarations
+    };
+
+    struct Attribute {
+        const char* qName;
+        size_t      qNameLength;
+        size_t      localOffset;
+        const char* value;
+        size_t      valueLength;
+        size_t      uriIndex;
+    };
+
+    class AttributeList : public E57XmlAttributes {
+    public:
+                AttributeList(const E57XmlPullParser& p) : p_(p) {};
+        size_t  count() const               {return(p_.attributes_.size());};
+        ustring uri(size_t i) const         {return(p_.bindingUri(p_.attributes_.at(i).uriIndex));};
+        ustring localName(size_t i) const;
+        ustring qName(size_t i) const;
+        ustring value(size_t i) const;
+        bool    find(const char* qName, ustring& value) const;
+    private:
+        const E57XmlPullParser& p_;
+    };
+
+    static const size_t NO_NAMESPACE = static_cast<size_t>(-1);
+
+    void            startTag();
+    void            endTag();
+    void            skipPast(const char* terminator, const char* what);
+    void            skipDoctype();
+    void            skipWhitespace();
+    size_t          scanName();
+    size_t          decode(char* begin, char* end, bool isAttribute);
+    size_t          resolvePrefix(const char* qName, size_t localOffset, bool isElement);
+    const ustring&  bindingUri(size_t uriIndex) const;
+    void            setElementEvent(const OpenElement& e);
+    void            error(const char* at, const ustring& message);
+
+    char*                   xml_;
+    char*                   pos_;
+    char*                   end_;
+    bool                    seenRoot_;
+    bool                    pendingEnd_;    /// true if current START_ELEMENT was an empty element tag
+    std::vector<Binding>    bindings_;
+    std::vector<OpenElement> open_;
+    std::vector<Attribute>  attributes_;
+    AttributeList           attributeList_;
+    ustring                 uri_;
+    ustring                 localName_;
+    ustring                 qName_;
+    const char*             text_;
+    size_t                  textLength_;
+};
+
+} /// end namespace e57
+
+namespace {
+
+inline bool xmlIsSpace(char c)
+{
+    return(c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+inline bool xmlIsNameChar(char c)
+{
+    /// Anything non-ASCII is accepted, since names aren't checked beyond well-formedness
+    return((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+           || c == '_' || c == ':' || c == '-' || c == '.' || (static_cast<unsigned char>(c) & 0x80));
+}
+
+inline bool xmlStartsWith(const char* p, const char* end, const char* s)
+{
+    size_t n = strlen(s);
+    return(static_cast<size_t>(end - p) >= n && memcmp(p, s, n) == 0);
+}
+
+/// Write Unicode code point as UTF-8, return number of bytes written
+size_t xmlEncodeUtf8(uint32_t code, char* out)
+{
+    if (code < 0x80) {
+        out[0] = static_cast<char>(code);
+        return(1);
+    } else if (code < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (code >> 6));
+        out[1] = static_cast<char>(0x80 | (code & 0x3F));
+        return(2);
+    } else if (code < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (code >> 12));
+        out[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (code & 0x3F));
+        return(3);
+    } else {
+        out[0] = static_cast<char>(0xF0 | (code >> 18));
+        out[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out[3] = static_cast<char>(0x80 | (code & 0x3F));
+        return(4);
+    }
+}
+
+const ustring xmlNamespaceUri("http://www.w3.org/XML/1998/namespace");
+const ustring xmlnsNamespaceUri("http://www.w3.org/2000/xmlns/");
+const ustring xmlNoNamespaceUri;
+
+} // end anonymous namespace
+
+E57XmlPullParser::E57XmlPullParser(char* xml, size_t length)
+: xml_(xml),
+  pos_(xml),
+  end_(xml + length),
+  seenRoot_(false),
+  pendingEnd_(false),
+  attributeList_(*this),
+  text_(NULL),
+  textLength_(0)
+{
+    /// Skip UTF-8 byte order mark
+    if (length >= 3 && memcmp(xml, "\xEF\xBB\xBF", 3) == 0)
+        pos_ += 3;
+
+    /// The "xml" and "xmlns" prefixes are always bound
+    bindings_.push_back(Binding("xml", 3, xmlNamespaceUri));
+    bindings_.push_back(Binding("xmlns", 5, xmlnsNamespaceUri));
+}
+
+void E57XmlPullParser::parse(E57XmlParser& parser)
+{
+    for (;;) {
+        switch (next()) {
+            case START_ELEMENT:
+                parser.startElement(uri_, localName_, qName_, attributeList_);
+                break;
+            case END_ELEMENT:
+                parser.endElement(uri_, localName_, qName_);
+                break;
+            case CHARACTERS:
+                parser.characters(text_, textLength_);
+                break;
+            case END_DOCUMENT:
+                return;
+        }
+    }
+}
+
+E57XmlPullParser::Event E57XmlPullParser::next()
+{
+    attributes_.clear();
+
+    /// Finish an empty element tag
+    if (pendingEnd_) {
+        pendingEnd_ = false;
+        setElementEvent(open_.back());
+        bindings_.resize(open_.back().bindingsMark, Binding(NULL, 0, ustring()));
+        open_.pop_back();
+        return(END_ELEMENT);
+    }
+
+    for (;;) {
+        if (open_.empty()) {
+            /// Outside the root element, only markup and whitespace allowed
+            skipWhitespace();
+            if (pos_ >= end_) {
+                if (!seenRoot_)
+                    error(pos_, "no root element");
+                return(END_DOCUMENT);
+            }
+            if (*pos_ != '<')
+                error(pos_, "text not allowed outside root element");
+        } else if (pos_ >= end_) {
+            error(pos_, "unexpected end of document inside element " + ustring(open_.back().qName, open_.back().qNameLength));
+        }
+
+        if (*pos_ != '<') {
+            /// Character data runs up to next markup
+            char* textEnd = static_cast<char*>(memchr(pos_, '<', end_ - pos_));
+            if (textEnd == NULL)
+                textEnd = end_;
+            text_       = pos_;
+            textLength_ = decode(pos_, textEnd, false);
+            pos_ = textEnd;
+            if (textLength_ > 0)
+                return(CHARACTERS);
+        } else if (xmlStartsWith(pos_, end_, "<!--")) {
+            skipPast("-->", "comment");
+        } else if (xmlStartsWith(pos_, end_, "<?")) {
+            /// Processing instruction or the XML declaration, neither affect E57 content
+            skipPast("?>", "processing instruction");
+        } else if (xmlStartsWith(pos_, end_, "<![CDATA[")) {
+            if (open_.empty())
+                error(pos_, "CDATA section outside root element");
+            char* begin = pos_ + 9;
+            skipPast("]]>", "CDATA section");
+            /// Only line ends are decoded in a CDATA section
+            char* w = begin;
+            for (char* r = begin; r < pos_ - 3; ) {
+                if (*r == '\r') {
+                    *w++ = '\n';
+                    if (++r < pos_ - 3 && *r == '\n')
+                        r++;
+                } else
+                    *w++ = *r++;
+            }
+            text_       = begin;
+            textLength_ = w - begin;
+            if (textLength_ > 0)
+                return(CHARACTERS);
+        } else if (xmlStartsWith(pos_, end_, "<!DOCTYPE")) {
+            if (seenRoot_)
+                error(pos_, "DOCTYPE must come before root element");
+            skipDoctype();
+        } else if (xmlStartsWith(pos_, end_, "</")) {
+            endTag();
+            return(END_ELEMENT);
+        } else {
+            startTag();
+            return(START_ELEMENT);
+        }
+    }
+}
+
+void E57XmlPullParser::startTag()
+{
+    char* tagStart = pos_;
+    if (open_.empty() && seenRoot_)
+        error(pos_, "more than one root element");
+    seenRoot_ = true;
+
+    pos_++;
+    OpenElement e;
+    e.qName        = pos_;
+    e.qNameLength  = scanName();
+    e.bindingsMark = bindings_.size();
+
+    /// Gather attributes, values are decoded in place
+    for (;;) {
+        char* beforeSpace = pos_;
+        skipWhitespace();
+        if (pos_ >= end_)
+            error(tagStart, "unterminated start tag");
+        if (*pos_ == '>' || *pos_ == '/')
+            break;
+        if (pos_ == beforeSpace)
+            error(pos_, "whitespace required between attributes");
+
+        Attribute a;
+        a.qName       = pos_;
+        a.qNameLength = scanName();
+        a.localOffset = 0;
+        a.uriIndex    = NO_NAMESPACE;
+        skipWhitespace();
+        if (pos_ >= end_ || *pos_ != '=')
+            error(pos_, "expected '=' after attribute name");
+        pos_++;
+        skipWhitespace();
+        if (pos_ >= end_ || (*pos_ != '"' && *pos_ != '\''))
+            error(pos_, "expected quoted attribute value");
+        char quote = *pos_++;
+        char* valueEnd = static_cast<char*>(memchr(pos_, quote, end_ - pos_));
+        if (valueEnd == NULL)
+            error(pos_, "unterminated attribute value");
+        a.value       = pos_;
+        a.valueLength = decode(pos_, valueEnd, true);
+        pos_ = valueEnd + 1;
+
+        for (unsigned i = 0; i < attributes_.size(); i++) {
+            if (attributes_[i].qNameLength == a.qNameLength && memcmp(attributes_[i].qName, a.qName, a.qNameLength) == 0)
+                error(a.qName, "duplicate attribute " + ustring(a.qName, a.qNameLength));
+        }
+        attributes_.push_back(a);
+    }
+
+    bool isEmpty = (*pos_ == '/');
+    if (isEmpty) {
+        pos_++;
+        if (pos_ >= end_ || *pos_ != '>')
+            error(pos_, "expected '>' after '/'");
+    }
+    pos_++;
+
+    /// Namespace declarations apply to the element's own name and attributes, so bind them first
+    for (unsigned i = 0; i < attributes_.size(); i++) {
+        Attribute& a = attributes_[i];
+        if (a.qNameLength == 5 && memcmp(a.qName, "xmlns", 5) == 0) {
+            bindings_.push_back(Binding(a.qName, 0, ustring(a.value, a.valueLength)));
+        } else if (a.qNameLength > 6 && memcmp(a.qName, "xmlns:", 6) == 0) {
+            a.localOffset = 6;
+            a.uriIndex    = 1;  /// the xmlns namespace binding
+            bindings_.push_back(Binding(a.qName + 6, a.qNameLength - 6, ustring(a.value, a.valueLength)));
+        }
+    }
+
+    /// Resolve prefixes of element and other attributes (unprefixed attributes are in no namespace)
+    const char* colon = static_cast<const char*>(memchr(e.qName, ':', e.qNameLength));
+    e.localOffset = colon ? (colon - e.qName + 1) : 0;
+    e.uriIndex    = resolvePrefix(e.qName, e.localOffset, true);
+    for (unsigned i = 0; i < attributes_.size(); i++) {
+        Attribute& a = attributes_[i];
+        if (a.localOffset == 0) {
+            colon = static_cast<const char*>(memchr(a.qName, ':', a.qNameLength));
+            if (colon && !(a.qNameLength > 6 && memcmp(a.qName, "xmlns:", 6) == 0)) {
+                a.localOffset = colon - a.qName + 1;
+                a.uriIndex    = resolvePrefix(a.qName, a.localOffset, false);
+            }
+        }
+    }
+
+    open_.push_back(e);
+    setElementEvent(e);
+    pendingEnd_ = isEmpty;
+}
+
+void E57XmlPullParser::endTag()
+{
+    char* tagStart = pos_;
+    pos_ += 2;
+    const char* name = pos_;
+    size_t nameLength = scanName();
+    skipWhitespace();
+    if (pos_ >= end_ || *pos_ != '>')
+        error(pos_, "expected '>' at end of end tag");
+    pos_++;
+
+    if (open_.empty())
+        error(tagStart, "end tag without start tag");
+    const OpenElement& e = open_.back();
+    if (e.qNameLength != nameLength || memcmp(e.qName, name, nameLength) != 0) {
+        error(tagStart, "end tag " + ustring(name, nameLength) + " doesn't match start tag "
+                        + ustring(e.qName, e.qNameLength));
+    }
+
+    setElementEvent(e);
+    bindings_.resize(e.bindingsMark, Binding(NULL, 0, ustring()));
+    open_.pop_back();
+}
+
+void E57XmlPullParser::skipPast(const char* terminator, const char* what)
+{
+    size_t n = strlen(terminator);
+    for (char* p = pos_; p + n <= end_; p++) {
+        p = static_cast<char*>(memchr(p, terminator[0], end_ - p));
+        if (p == NULL || p + n > end_)
+            break;
+        if (memcmp(p, terminator, n) == 0) {
+            pos_ = p + n;
+            return;
+        }
+    }
+    error(pos_, "unterminated " + ustring(what));
+}
+
+void E57XmlPullParser::skipDoctype()
+{
+    /// Skip to the closing '>', stepping over quoted strings and an internal subset in brackets.
+    /// Declarations in the internal subset are not processed.
+    char* start = pos_;
+    int bracketDepth = 0;
+    for (pos_ += 9; pos_ < end_; pos_++) {
+        char c = *pos_;
+        if (c == '"' || c == '\'') {
+            char* close = static_cast<char*>(memchr(pos_ + 1, c, end_ - pos_ - 1));
+            if (close == NULL)
+                break;
+            pos_ = close;
+        } else if (c == '[')
+            bracketDepth++;
+        else if (c == ']')
+            bracketDepth--;
+        else if (c == '>' && bracketDepth <= 0) {
+            pos_++;
+            return;
+        }
+    }
+    error(start, "unterminated DOCTYPE");
+}
+
+void E57XmlPullParser::skipWhitespace()
+{
+    while (pos_ < end_ && xmlIsSpace(*pos_))
+        pos_++;
+}
+
+size_t E57XmlPullParser::scanName()
+{
+    char* start = pos_;
+    if (pos_ >= end_ || (*pos_ >= '0' && *pos_ <= '9') || *pos_ == '-' || *pos_ == '.' || !xmlIsNameChar(*pos_))
+        error(pos_, "expected a name");
+    while (pos_ < end_ && xmlIsNameChar(*pos_))
+        pos_++;
+    return(pos_ - start);
+}
+
+size_t E57XmlPullParser::decode(char* begin, char* end, bool isAttribute)
+{
+    /// Replace character references and normalize line ends, writing the result over the input (it never gets longer).
+    /// In attribute values, literal whitespace characters also become spaces.
+    char* w = begin;
+    char* r = begin;
+    while (r < end) {
+        char c = *r;
+        if (c == '&') {
+            char* semi = static_cast<char*>(memchr(r, ';', end - r));
+            if (semi == NULL)
+                error(r, "unterminated character reference");
+            const char* name = r + 1;
+            size_t nameLength = semi - name;
+            uint32_t code = 0;
+            if (nameLength == 2 && memcmp(name, "lt", 2) == 0)
+                code = '<';
+            else if (nameLength == 2 && memcmp(name, "gt", 2) == 0)
+                code = '>';
+            else if (nameLength == 3 && memcmp(name, "amp", 3) == 0)
+                code = '&';
+            else if (nameLength == 4 && memcmp(name, "quot", 4) == 0)
+                code = '"';
+            else if (nameLength == 4 && memcmp(name, "apos", 4) == 0)
+                code = '\'';
+            else if (nameLength >= 2 && name[0] == '#') {
+                bool isHex = (name[1] == 'x');
+                const char* digit = name + (isHex ? 2 : 1);
+                if (digit == semi)
+                    error(r, "bad character reference");
+                for (; digit < semi; digit++) {
+                    uint32_t d = 0;
+                    if (*digit >= '0' && *digit <= '9')
+                        d = *digit - '0';
+                    else if (isHex && *digit >= 'a' && *digit <= 'f')
+                        d = *digit - 'a' + 10;
+                    else if (isHex && *digit >= 'A' && *digit <= 'F')
+                        d = *digit - 'A' + 10;
+                    else
+                        error(r, "bad character reference");
+                    code = code * (isHex ? 16 : 10) + d;
+                    if (code > 0x10FFFF)
+                        error(r, "character reference out of range");
+                }
+                if (code == 0 || (code >= 0xD800 && code <= 0xDFFF))
+                    error(r, "character reference out of range");
+            } else
+                error(r, "undefined entity " + ustring(name, nameLength));
+            w += xmlEncodeUtf8(code, w);
+            r = semi + 1;
+        } else if (c == '\r') {
+            /// CR LF and lone CR become LF
+            *w++ = isAttribute ? ' ' : '\n';
+            if (++r < end && *r == '\n')
+                r++;
+        } else if (isAttribute && (c == '\n' || c == '\t')) {
+            *w++ = ' ';
+            r++;
+        } else if (isAttribute && c == '<') {
+            error(r, "'<' not allowed in attribute value");
+        } else
+            *w++ = *r++;
+    }
+    return(w - begin);
+}
+
+size_t E57XmlPullParser::resolvePrefix(const char* qName, size_t localOffset, bool isElement)
+{
+    /// Unprefixed element names are in default namespace (if any), the innermost binding wins
+    size_t prefixLength = (localOffset > 0) ? localOffset - 1 : 0;
+    if (prefixLength == 0 && !isElement)
+        return(NO_NAMESPACE);
+    for (size_t i = bindings_.size(); i > 0; i--) {
+        const Binding& b = bindings_[i-1];
+        if (b.prefixLength == prefixLength && memcmp(b.prefix, qName, prefixLength) == 0)
+            return(i-1);
+    }
+    if (prefixLength > 0)
+        error(qName, "undeclared namespace prefix " + ustring(qName, prefixLength));
+    return(NO_NAMESPACE);
+}
+
+const ustring& E57XmlPullParser::bindingUri(size_t uriIndex) const
+{
+    if (uriIndex == NO_NAMESPACE)
+        return(xmlNoNamespaceUri);
+    return(bindings_[uriIndex].uri);
+}
+
+void E57XmlPullParser::setElementEvent(const OpenElement& e)
+{
+    uri_       = bindingUri(e.uriIndex);
+    qName_.assign(e.qName, e.qNameLength);
+    localName_.assign(e.qName + e.localOffset, e.qNameLength - e.localOffset);
+}
+
+void E57XmlPullParser::error(const char* at, const ustring& message)
+{
+    /// Find line and column of error, only done when have an error
+    int64_t line = 1;
+    int64_t column = 1;
+    for (const char* p = xml_; p < at && p < end_; p++) {
+        if (*p == '\n') {
+            line++;
+            column = 1;
+        } else
+            column++;
+    }
+    throw E57_EXCEPTION2(E57_ERROR_XML_PARSER,
+                         "systemId=E57File"
+                         " xmlLine=" + toString(line)
+                         + " xmlColumn=" + toString(column)
+                         + " parserMessage=" + message);
+}
+
+ustring E57XmlPullParser::AttributeList::localName(size_t i) const
+{
+    const Attribute& a = p_.attributes_.at(i);
+    return(ustring(a.qName + a.localOffset, a.qNameLength - a.localOffset));
+}
+
+ustring E57XmlPullParser::AttributeList::qName(size_t i) const
+{
+    const Attribute& a = p_.attributes_.at(i);
+    return(ustring(a.qName, a.qNameLength));
+}
+
+ustring E57XmlPullParser::AttributeList::value(size_t i) const
+{
+    const Attribute& a = p_.attributes_.at(i);
+    return(ustring(a.value, a.valueLength));
+}
+
+bool E57XmlPullParser::AttributeList::find(const char* qName, ustring& value) const
+{
+    size_t n = strlen(qName);
+    for (unsigned i = 0; i < p_.attributes_.size(); i++) {
+        const Attribute& a = p_.attributes_[i];
+        if (a.qNameLength == n && memcmp(a.qName, qName, n) == 0) {
+            value.assign(a.value, a.valueLength);
+            return(true);
+        }
+    }
+    return(false);
 }
 
 //=============================================================================
@@ -3744,13 +4992,21 @@ bool E57XmlParser::isAttributeDefined(const Attributes& attributes, const XMLCh*
 ImageFileImpl::ImageFileImpl()
 : writerCount_(0),
   readerCount_(0),
-  file_(0)
+  file_(0),
+  lazyXml_(false),
+  xmlValidation_(true),
+#ifdef E57_NO_XERCES
+  builtinXml_(true),
+#else
+  builtinXml_(false),
+#endif
+  recover_(false)
 {
     /// First phase of construction, can't do much until have the ImageFile object.
     /// See ImageFileImpl::construct2() for second phase.
 }
 
-void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, const ustring& /*configuration*/)
+void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, const ustring& configuration)
 {
     /// Second phase of construction, now we have a well-formed ImageFile object.
 
@@ -3779,6 +5035,9 @@ void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, con
     else
         throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT, "mode=" + ustring(mode));
 
+    /// Pick up run-time options before touching the file
+    configure(configuration);
+
     /// If mode is read, do it
     file_ = NULL;
     if (!isWriter_) {
@@ -3805,54 +5064,26 @@ void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, con
             throw;  // rethrow
         }
 
-        SAX2XMLReader* xmlReader = NULL;
-
-        // Initialize the XML4C2 system
         try {
-             XMLPlatformUtils::Initialize();
-        } catch (const XMLException& ex) {
-            /// Turn parser exception into E57Exception
-             throw E57_EXCEPTION2(E57_ERROR_XML_PARSER_INIT, "parserMessage=" + ustring(XMLString::transcode(ex.getMessage())));
-        }
-
-        xmlReader = XMLReaderFactory::createXMLReader(); //??? auto_ptr?
-
-        //??? check these are right
-        xmlReader->setFeature(XMLUni::fgSAX2CoreValidation,        true);
-        xmlReader->setFeature(XMLUni::fgXercesDynamic,             true);
-        xmlReader->setFeature(XMLUni::fgSAX2CoreNameSpaces,        true);
-        xmlReader->setFeature(XMLUni::fgXercesSchema,              true);
-        xmlReader->setFeature(XMLUni::fgXercesSchemaFullChecking,  true);
-        xmlReader->setFeature(XMLUni::fgSAX2CoreNameSpacePrefixes, true);
-
-        try {
-            /// Create parser state, attach its event handers to the SAX2 reader
-            E57XmlParser parser(imf);
-            xmlReader->setContentHandler(&parser);
-            xmlReader->setErrorHandler(&parser);
-
-            /// Create input source (XML section of E57 file turned into a stream).
-            E57FileInputSource xmlSection(file_, xmlLogicalOffset_, xmlLogicalLength_);
+            unusedLogicalStart_ = sizeof(E57FileHeader);	//Added by SC
 
-			unusedLogicalStart_ = sizeof(E57FileHeader);	//Added by SC
-
-            /// Do the parse, building up the node tree
-            xmlReader->parse(xmlSection);
+            if (lazyXml_) {
+                /// Build tree with the big subtrees left as placeholders
+                parseXmlLazy();
+            } else {
+                /// Create parser state, will be fed by the XML parser backend
+                E57XmlParser parser(imf);
 
-        } catch (...) {
-            if (xmlReader != NULL) {
-                delete xmlReader;
-                xmlReader = NULL;
+                /// Do the parse, building up the node tree
+                parseXmlSection(parser);
             }
+        } catch (...) {
             if (file_ != NULL) {
                 delete file_;
                 file_ = NULL;
             }
             throw;  // rethrow
         }
-        delete xmlReader;
-
-		XMLPlatformUtils::Terminate();	//Added by SC
 
     } else { /// open for writing (start empty)
         try {
@@ -3878,6 +5109,156 @@ void ImageFileImpl::construct2(const ustring& fileName, const ustring& mode, con
     }
 }
 
+void ImageFileImpl::configure(const ustring& configuration)
+{
+    /// The configuration string is a list of options separated by whitespace, ',' or ';'.
+    /// Recognized options:
+    ///     lazyXml             In read mode, don't parse the children of /data3D and /images2D until they are first accessed.
+    ///     noXmlValidation     Turn off the parser's validation and schema checking features, for trusted input.
+    ///     builtinXml          Use the built-in non-validating XML parser instead of Xerces (always used if built without Xerces).
+    ///     recover             In read mode, CompressedVectorReaders skip the records in packets with bad checksums instead of throwing,
+    ///                         see CompressedVectorReader::lostRecords().  The XML section must still be intact.
+    lazyXml_ = false;
+    xmlValidation_ = true;
+#ifdef E57_NO_XERCES
+    builtinXml_ = true;
+#else
+    builtinXml_ = false;
+#endif
+    recover_ = false;
+
+    const char* separators = " \t\r\n,;";
+    size_t start = 0;
+    while ((start = configuration.find_first_not_of(separators, start)) != ustring::npos) {
+        size_t end = configuration.find_first_of(separators, start);
+        ustring option = configuration.substr(start, end - start);
+
+        if (option == "lazyXml")
+            lazyXml_ = true;
+        else if (option == "noXmlValidation")
+            xmlValidation_ = false;
+        else if (option == "builtinXml")
+            builtinXml_ = true;
+        else if (option == "recover")
+            recover_ = true;
+        else
+            throw E57_EXCEPTION2(E57_ERROR_BAD_CONFIGURATION, "configuration=" + configuration + " option=" + option);
+        start = end;
+    }
+}
+
+void ImageFileImpl::readXmlSection(vector<char>& xml)
+{
+    size_t xmlLength = static_cast<size_t>(xmlLogicalLength_);
+    if (static_cast<uint64_t>(xmlLength) != xmlLogicalLength_)
+        throw E57_EXCEPTION2(E57_ERROR_BAD_FILE_LENGTH, "xmlLogicalLength=" + toString(xmlLogicalLength_));
+    xml.resize(xmlLength);
+    if (xmlLength > 0) {
+        file_->seek(xmlLogicalOffset_);
+        file_->read(&xml[0], xmlLength);
+    }
+}
+
+void ImageFileImpl::parseXmlSection(E57XmlParser& parser)
+{
+#ifndef E57_NO_XERCES
+    if (!builtinXml_) {
+        /// Let Xerces stream the XML section of the E57 file
+        E57FileInputSource xmlSection(file_, xmlLogicalOffset_, xmlLogicalLength_);
+        xercesParse(xmlSection, parser, xmlValidation_);
+        return;
+    }
+#endif
+    /// Built-in parser needs the whole section in memory
+    vector<char> xml;
+    readXmlSection(xml);
+    parseXmlBuffer(xml.empty() ? NULL : &xml[0], xml.size(), parser);
+}
+
+void ImageFileImpl::parseXmlBuffer(char* xml, size_t length, E57XmlParser& parser)
+{
+    /// Note the built-in parser decodes the buffer in place, so its contents are undefined afterwards
+#ifndef E57_NO_XERCES
+    if (!builtinXml_) {
+        MemBufInputSource xmlSection(reinterpret_cast<const XMLByte*>(xml), length, "E57File");
+        xercesParse(xmlSection, parser, xmlValidation_);
+        return;
+    }
+#endif
+    E57XmlPullParser xmlReader(xml, length);
+    xmlReader.parse(parser);
+}
+
+void ImageFileImpl::parseXmlLazy()
+{
+    /// Read whole XML section into memory, so can find the subtrees to defer
+    vector<char> xml;
+    readXmlSection(xml);
+    size_t xmlLength = xml.size();
+
+    /// Replace each deferred element with an empty placeholder element, and parse the rest normally
+    vector<LazyXmlRange> ranges;
+    xmlFindLazyRanges(xml, ranges);
+    string stripped;
+    stripped.reserve(xmlLength);
+    size_t pos = 0;
+    for (unsigned i = 0; i < ranges.size(); i++) {
+        /// Copy up to, but not including, the '>' that closes the start tag, then close the element right there
+        stripped.append(&xml[pos], ranges[i].startTagEnd - pos);
+        stripped.append("/>");
+        pos = ranges[i].end;
+    }
+    if (pos < xmlLength)
+        stripped.append(&xml[pos], xmlLength - pos);
+
+    /// Don't keep both copies around during the parse
+    vector<char>().swap(xml);
+
+    E57XmlParser parser(shared_from_this());
+    parseXmlBuffer(&stripped[0], stripped.size(), parser);
+
+    /// Remember where each placeholder's real contents are
+    for (unsigned i = 0; i < ranges.size(); i++) {
+        shared_ptr<StructureNodeImpl> parent(dynamic_pointer_cast<StructureNodeImpl>(root_->get("/" + ranges[i].parentName)));
+        if (!parent)
+            throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT, "fileName=" + fileName_ + " elementName=" + ranges[i].parentName);
+        shared_ptr<StructureNodeImpl> placeholder(dynamic_pointer_cast<StructureNodeImpl>(parent->get(ranges[i].childIndex)));
+        if (!placeholder)
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "fileName=" + fileName_ + " childIndex=" + toString(ranges[i].childIndex));
+        placeholder->setLazyXmlRange(ranges[i].start, ranges[i].end - ranges[i].start);
+    }
+}
+
+shared_ptr<StructureNodeImpl> ImageFileImpl::parseXmlSubtree(uint64_t xmlOffset, uint64_t xmlLength)
+{
+    /// Read the element back from the XML section
+    vector<char> element(static_cast<size_t>(xmlLength));
+    file_->seek(xmlLogicalOffset_ + xmlOffset);
+    file_->read(&element[0], element.size());
+
+    /// The element is parsed on its own, so it needs the namespace declarations of the e57Root element.
+    /// Insert them just after the element name in the start tag.
+    size_t nameEnd = 1;
+    while (nameEnd < element.size() && !strchr(" \t\r\n/>", element[nameEnd]))
+        nameEnd++;
+    string doc(&element[0], nameEnd);
+    for (unsigned i = 0; i < nameSpaces_.size(); i++) {
+        if (nameSpaces_[i].prefix == "")
+            doc += " xmlns=\"";
+        else
+            doc += " xmlns:" + nameSpaces_[i].prefix + "=\"";
+        doc += xmlEscapeAttribute(nameSpaces_[i].uri) + "\"";
+    }
+    doc.append(&element[nameEnd], element.size() - nameEnd);
+
+    E57XmlParser parser(shared_from_this(), true);
+    parseXmlBuffer(&doc[0], doc.size(), parser);
+
+    if (!parser.subtreeRoot())
+        throw E57_EXCEPTION2(E57_ERROR_BAD_XML_FORMAT, "fileName=" + fileName_ + " xmlOffset=" + toString(xmlOffset));
+    return(parser.subtreeRoot());
+}
+
 void ImageFileImpl::readFileHeader(CheckedFile* file, E57FileHeader& header)
 {
 #ifdef E57_DEBUG
@@ -3991,7 +5372,9 @@ void ImageFileImpl::close()
 #endif
 
         //??? need to add name space attributes to e57Root
-        root_->writeXml(shared_from_this(), *file_, 0, "e57Root");
+        E57XmlWriter xmlWriter(file_);
+        root_->writeXml(shared_from_this(), xmlWriter, 0, "e57Root");
+        xmlWriter.flush();
 
         /// Pad XML section so length is multiple of 4
         while ((file_->position(CheckedFile::logical) - xmlLogicalOffset_) % 4 != 0)
@@ -4368,6 +5751,27 @@ void ImageFileImpl::pathNameParse(const ustring& pathName, bool& isRelative, vec
 #endif
 }
 
+shared_ptr<const CompiledPathName> ImageFileImpl::pathNameCompile(const ustring& pathName)
+{
+    /// no checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__)
+
+    /// The same few path names get looked up over and over (e.g. "pose" in each data3D entry), so keep the parsed form.
+    /// Only successful parses are cached, and registering more extensions can't make a legal path illegal.
+    std::map<ustring, shared_ptr<const CompiledPathName> >::const_iterator it = pathCache_.find(pathName);
+    if (it != pathCache_.end())
+        return(it->second);
+
+    shared_ptr<CompiledPathName> path(new CompiledPathName);
+    path->pathName = pathName;
+    pathNameParse(pathName, path->isRelative, path->fields);  // throws if bad pathName
+
+    /// Keep cache bounded, a program walking lots of distinct paths shouldn't grow it forever
+    if (pathCache_.size() >= PATH_CACHE_MAX)
+        pathCache_.clear();
+    pathCache_[pathName] = path;
+    return(path);
+}
+
 ustring ImageFileImpl::pathNameUnparse(bool isRelative, const vector<ustring>& fields)
 {
     /// no checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__)
@@ -4658,92 +6062,105 @@ void CheckedFile::write(const char* buf, size_t nWrite)
 #endif  // SAFE_MODE
 }
 
-CheckedFile& CheckedFile::operator<<(const ustring& s)
-{
-    write(s.c_str(), s.length()); //??? should be times size of uchar?
-    return(*this);
-}
+namespace {
 
-CheckedFile& CheckedFile::operator<<(int64_t i)
-{
-    stringstream ss;
-    ss << i;
-    return(*this << ss.str());
-}
+/// Big enough for any formatted number, e.g. "-1.2345678901234567e-308" or "-9223372036854775808"
+const size_t NUMBER_TEXT_MAX = 32;
 
-CheckedFile& CheckedFile::operator<<(uint64_t i)
+size_t formatUnsigned(uint64_t i, char* out)
 {
-    stringstream ss;
-    ss << i;
-    return(*this << ss.str());
+    /// Write digits backwards into temp, then copy forward
+    char temp[NUMBER_TEXT_MAX];
+    char* p = temp + sizeof(temp);
+    do {
+        *--p = static_cast<char>('0' + i % 10);
+        i /= 10;
+    } while (i != 0);
+    size_t n = temp + sizeof(temp) - p;
+    memcpy(out, p, n);
+    return(n);
+}
+
+size_t formatSigned(int64_t i, char* out)
+{
+    if (i >= 0)
+        return(formatUnsigned(static_cast<uint64_t>(i), out));
+    /// Negate in unsigned arithmetic, so E57_INT64_MIN works
+    out[0] = '-';
+    return(1 + formatUnsigned(0 - static_cast<uint64_t>(i), out + 1));
+}
+
+inline float  readBack(const char* s, float)  {return(strtof(s, NULL));}
+inline double readBack(const char* s, double) {return(strtod(s, NULL));}
+
+/// Replace the decimal point of the current C locale (e.g. "," after setlocale(LC_ALL,"")) with '.', as XML requires.
+size_t classicDecimalPoint(char* out, size_t n)
+{
+    const char* point = localeconv()->decimal_point;
+    size_t pointLength = strlen(point);
+    if (pointLength == 0 || (pointLength == 1 && point[0] == '.'))
+        return(n);
+    char* p = strstr(out, point);
+    if (p == NULL)
+        return(n);
+    *p = '.';
+    memmove(p + 1, p + pointLength, out + n + 1 - (p + pointLength));  /// includes terminating nul
+    return(n + 1 - pointLength);
+}
+
+/// Format floating point number with the fewest significant digits that read back as the same value.
+/// Any number that needs at most minDigits digits is printed exactly so (trailing zeros are dropped by %g),
+/// otherwise try more digits until reach maxDigits, which always round trips.
+/// The read back is done before the decimal point is made '.', so that both use the same locale.
+template<class FTYPE>
+size_t formatShortest(FTYPE value, int minDigits, int maxDigits, char* out)
+{
+    for (int digits = minDigits; ; digits++) {
+        int n = snprintf(out, NUMBER_TEXT_MAX, "%.*g", digits, static_cast<double>(value));
+        if (n < 0 || static_cast<size_t>(n) >= NUMBER_TEXT_MAX)
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "n=" + toString(n));
+        if (digits >= maxDigits || readBack(out, value) == value || value != value)
+            return(classicDecimalPoint(out, static_cast<size_t>(n)));
+    }
 }
 
-CheckedFile& CheckedFile::operator<<(float f)
+inline size_t formatFloat(float f, char* out)   {return(formatShortest(f, FLT_DIG, 9, out));}
+inline size_t formatDouble(double d, char* out) {return(formatShortest(d, DBL_DIG, 17, out));}
+
+} // end anonymous namespace
+
+CheckedFile& CheckedFile::operator<<(const ustring& s)
 {
-    //??? is 7 digits right number?
-    return(writeFloatingPoint(f, 8));
+    write(s.c_str(), s.length()); //??? should be times size of uchar?
+    return(*this);
 }
 
-CheckedFile& CheckedFile::operator<<(double d)
+CheckedFile& CheckedFile::operator<<(int64_t i)
 {
-    //??? is 17 digits right number?
-    return(writeFloatingPoint(d, 17));
+    char buf[NUMBER_TEXT_MAX];
+    write(buf, formatSigned(i, buf));
+    return(*this);
 }
 
-template<class FTYPE> CheckedFile& CheckedFile::writeFloatingPoint(FTYPE value, int precision)
+CheckedFile& CheckedFile::operator<<(uint64_t i)
 {
-#ifdef E57_MAX_VERBOSE
-    cout << "CheckedFile::writeFloatingPoint, value=" << value << " precision=" << precision << endl;
-#endif
-
-    stringstream ss;
-    ss << scientific << setprecision(precision) << value;
-
-    /// Try to remove trailing zeroes and decimal point
-    /// E.g. 1.23456000000000000e+005  ==> 1.23456e+005
-    /// E.g. 2.00000000000000000e+005  ==> 2e+005
-
-    ustring s = ss.str();
-    size_t len = s.length();
-
-#ifdef E57_MAX_DEBUG
-    ustring old_s = s;
-#endif
-
-    /// Split into mantissa and exponent
-    /// E.g. 1.23456000000000000e+005  ==> "1.23456000000000000" + "e+005"
-    ustring mantissa = s.substr(0, len-5);
-    ustring exponent = s.substr(len-5, 5);
-
-    /// Double check that we understand the formatting
-    if (exponent[0] == 'e') {
-        /// Trim of any trailing zeros in mantissa
-        while (mantissa[mantissa.length()-1] == '0')
-            mantissa = mantissa.substr(0, mantissa.length()-1);
-
-        /// Make one attempt to trim off trailing decimal point
-        if (mantissa[mantissa.length()-1] == '.')
-            mantissa = mantissa.substr(0, mantissa.length()-1);
-
-        /// Reassemble whole floating point number
-        /// Check if can drop exponent.
-        if (exponent.compare("e+000") == 0)
-            s = mantissa;
-        else
-            s = mantissa + exponent;
-    }
+    char buf[NUMBER_TEXT_MAX];
+    write(buf, formatUnsigned(i, buf));
+    return(*this);
+}
 
-#ifdef E57_MAX_DEBUG
-    /// Double check same value
-    FTYPE old_value = static_cast<FTYPE>(atof(old_s.c_str()));
-    FTYPE new_value = static_cast<FTYPE>(atof(s.c_str()));
-    if (old_value != new_value)
-        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "fileName=" + fileName_ + " oldValue=" + toString(old_value) + " newValue=" + toString(new_value));
-    if (new_value != value)
-        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "fileName=" + fileName_ + " newValue=" + toString(new_value) + " value=" + toString(value));
-#endif
+CheckedFile& CheckedFile::operator<<(float f)
+{
+    char buf[NUMBER_TEXT_MAX];
+    write(buf, formatFloat(f, buf));
+    return(*this);
+}
 
-    return(*this << s);
+CheckedFile& CheckedFile::operator<<(double d)
+{
+    char buf[NUMBER_TEXT_MAX];
+    write(buf, formatDouble(d, buf));
+    return(*this);
 }
 
 void CheckedFile::seek(uint64_t offset, OffsetMode omode)
@@ -4953,32 +6370,92 @@ size_t CheckedFile::efficientBufferSize(size_t logicalBytes)
 #endif  // SAFE_MODE
 }
 
-uint32_t CheckedFile::checksum(char* buf, size_t size)
+uint32_t CheckedFile::checksum(const char* buf, size_t size)
 {
 #ifdef SAFE_MODE
-#if 1
     /// Calc CRC32C of given data
-    crcCalculator_.reset();
-    crcCalculator_.process_bytes(buf, size);
-    uint32_t crc = crcCalculator_.checksum();
+    uint32_t crc = crc32c(buf, size);
     swab(crc); //!!! inside BIGENDIAN?
     return(crc);
-#else
-    /// For page size performance testing purposes, approximate the computation time for
-    /// computing checksum on a multiple of shorter blocks in the page.
-    /// This doesn't produce a legal file format, but approximates the processing time of smaller pages.
-    const int blocksPerPage = 1;
-    int bytesPerBlock = size / blocksPerPage;
-    uint32_t crc;
-    for (int block = 0; block < blocksPerPage; block++) {
-        crcCalculator_.reset();
-        crcCalculator_.process_bytes(&buf[block*bytesPerBlock], bytesPerBlock);
-        crc = crcCalculator_.checksum();
-        swab(crc);
+#endif  // SAFE_MODE
+}
+
+namespace {
+
+/// Lookup tables for CRC32C (iSCSI polynomial 0x1EDC6F41, reflected) eight bytes at a time ("slicing-by-8").
+/// table[0] is the classic byte at a time table, table[k] advances a byte that is followed by k more bytes.
+struct Crc32cTables {
+    uint32_t table[8][256];
+
+    Crc32cTables() {
+        for (unsigned i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+            table[0][i] = crc;
+        }
+        for (unsigned i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++)
+                table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xFF];
+        }
     }
-    return(crc);
+};
+
+} // end anonymous namespace
+
+uint32_t CheckedFile::crc32c(const char* buf, size_t size)
+{
+    /// Tables are built once, on first use (thread safe static initialization)
+    static const Crc32cTables tables;
+    const uint32_t (*t)[256] = tables.table;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(buf);
+    uint32_t crc = 0xFFFFFFFF;
+
+    /// Bytes are assembled explicitly, so result doesn't depend on CPU byte order
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; size > 0; size--, p++)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+
+    return(crc ^ 0xFFFFFFFF);
+}
+
+bool CheckedFile::pageChecksumIsGood(const char* pageBuffer)
+{
+    uint32_t storedChecksum;
+    memcpy(&storedChecksum, &pageBuffer[logicalPageSize], sizeof(storedChecksum));  //??? little endian dependency
+    return(checksum(pageBuffer, logicalPageSize) == storedChecksum);
+}
+
+size_t CheckedFile::readPhysicalPages(char* buf, uint64_t firstPage, size_t pageCount)
+{
+    uint64_t fileLength = length(physical);
+    if (firstPage*physicalPageSize >= fileLength)
+        return(0);
+    pageCount = static_cast<size_t>(min(static_cast<uint64_t>(pageCount), (fileLength - firstPage*physicalPageSize) / physicalPageSize));
+
+    seek(firstPage*physicalPageSize, physical);
+
+    /// Large reads may be satisfied piecewise
+    size_t byteCount = pageCount*physicalPageSize;
+    size_t done = 0;
+    while (done < byteCount) {
+        unsigned n = static_cast<unsigned>(min(byteCount - done, static_cast<size_t>(1) << 30));
+#if defined(_MSC_VER)
+        int result = ::_read(fd_, buf + done, n);
+#elif defined(__GNUC__)
+        ssize_t result = ::read(fd_, buf + done, n);
+#else
+#  error "no supported compiler defined"
 #endif
-#endif  // SAFE_MODE
+        if (result <= 0)
+            throw E57_EXCEPTION2(E57_ERROR_READ_FAILED, "fileName=" + fileName_ + " result=" + toString(static_cast<int64_t>(result)));
+        done += result;
+    }
+    return(pageCount);
 }
 
 #ifdef SAFE_MODE
@@ -5056,6 +6533,51 @@ void CheckedFile::writePhysicalPage(char* page_buffer, uint64_t page)
 
 #endif  // SAFE_MODE
 
+//=============================================================
+
+E57XmlWriter::E57XmlWriter(CheckedFile* cf, size_t bufferSize)
+: cf_(cf),
+  buffer_(bufferSize),
+  used_(0)
+{
+}
+
+E57XmlWriter& E57XmlWriter::operator<<(int64_t i)
+{
+    char buf[NUMBER_TEXT_MAX];
+    append(buf, formatSigned(i, buf));
+    return(*this);
+}
+
+E57XmlWriter& E57XmlWriter::operator<<(uint64_t i)
+{
+    char buf[NUMBER_TEXT_MAX];
+    append(buf, formatUnsigned(i, buf));
+    return(*this);
+}
+
+E57XmlWriter& E57XmlWriter::operator<<(float f)
+{
+    char buf[NUMBER_TEXT_MAX];
+    append(buf, formatFloat(f, buf));
+    return(*this);
+}
+
+E57XmlWriter& E57XmlWriter::operator<<(double d)
+{
+    char buf[NUMBER_TEXT_MAX];
+    append(buf, formatDouble(d, buf));
+    return(*this);
+}
+
+void E57XmlWriter::flush()
+{
+    if (used_ > 0) {
+        cf_->write(&buffer_[0], used_);
+        used_ = 0;
+    }
+}
+
 //=============================================================
 #ifdef UNIT_TEST
 
@@ -5147,7 +6669,7 @@ void CompressedVectorSectionHeader::verify(uint64_t filePhysicalSize)
 {
     /// Verify that section is correct type
     if (sectionId != E57_COMPRESSED_VECTOR_SECTION)
-        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_HEADER, "sectionId=" + toString(sectionId));
+        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_HEADER, "sectionId=" + toString(static_cast<unsigned>(sectionId)));
 
     /// Verify reserved fields are zero. ???  if fileversion==1.0 ???
     for (unsigned i=0; i < sizeof(reserved1); i++) {
@@ -5307,7 +6829,7 @@ void DataPacket::verify(unsigned bufferLength)
     if (needed > packetLength || needed+3 < packetLength) {
         throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
                              "needed=" + toString(needed)
-                             + "packetLength=" + toString(packetLength));
+                             + " packetLength=" + toString(packetLength));
     }
 
     /// Verify that padding at end of packet is zero
@@ -5445,9 +6967,9 @@ void IndexPacket::verify(unsigned bufferLength, uint64_t totalRecordCount, uint6
     if (packetType != E57_INDEX_PACKET)
         throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetType=" + toString(packetType));
 
-    /// Check packetLength is at least large enough to hold header
+    /// Check packetLength is at least large enough to hold header (the entries array is only as long as entryCount)
     unsigned packetLength = packetLogicalLengthMinus1+1;
-    if (packetLength < sizeof(*this))
+    if (packetLength < sizeof(*this) - sizeof(entries))
         throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetLength=" + toString(packetLength));
 
     /// Check packet length is multiple of 4
@@ -5613,35 +7135,736 @@ void EmptyPacketHeader::verify(unsigned bufferLength)
     if (packetLength < sizeof(*this))
         throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetLength=" + toString(packetLength));
 
-    /// Check packet length is multiple of 4
-    if (packetLength % 4)
-        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetLength=" + toString(packetLength));
+    /// Check packet length is multiple of 4
+    if (packetLength % 4)
+        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetLength=" + toString(packetLength));
+
+    /// Check actual packet length is large enough.
+    if (bufferLength > 0 && packetLength > bufferLength) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
+                             "packetLength=" + toString(packetLength)
+                             + " bufferLength=" + toString(bufferLength));
+    }
+}
+
+#ifdef E57_BIGENDIAN
+void EmptyPacketHeader::swab()
+{
+    /// Byte swap fields in-place, if CPU is BIG_ENDIAN
+    SWAB(&packetLogicalLengthMinus1);
+};
+#endif
+
+#ifdef E57_DEBUG
+void EmptyPacketHeader::dump(int indent, std::ostream& os)
+{
+    os << space(indent) << "packetType:                " << (unsigned)packetType << endl;
+    os << space(indent) << "packetLogicalLengthMinus1: " << packetLogicalLengthMinus1 << endl;
+}
+#endif
+
+///================================================================
+/// Support for E57Utilities::checkIntegrity.
+/// The file is read once from start to end, in large reads of whole pages.
+
+namespace {
+
+void addIntegrityError(IntegrityReport& report, size_t maxErrorCount, ErrorCode ecode, uint64_t physicalOffset, const ustring& context)
+{
+    report.errorCount++;
+    if (report.errors.size() < maxErrorCount) {
+        IntegrityError error;
+        error.errorCode      = ecode;
+        error.physicalOffset = physicalOffset;
+        error.context        = context;
+        report.errors.push_back(error);
+    }
+}
+
+bool integrityErrorLess(const IntegrityError& a, const IntegrityError& b)
+{
+    return(a.physicalOffset < b.physicalOffset);
+}
+
+/// Walks the packets of the CompressedVector binary sections while the logical bytes of the file stream past in order.
+/// Each section header and packet is assembled in a buffer and checked with its verify() routine, no values are decoded.
+class PacketChainChecker {
+public:
+                PacketChainChecker(const vector<uint64_t>& sectionLogicalStarts, IntegrityReport& report, size_t maxErrorCount);
+    void        feed(uint64_t logicalStart, const char* data, size_t length);
+    void        finish();
+
+private:
+    enum State {SECTION_HEADER, PACKET_HEADER, PACKET, DONE};
+
+    void        startNextSection();
+    void        completed();
+    void        error(ErrorCode ecode, const ustring& context);
+
+    vector<uint64_t>    sectionStarts_;     /// logical offsets of section headers, in increasing order
+    size_t              nextSection_;
+    IntegrityReport&    report_;
+    size_t              maxErrorCount_;
+
+    State               state_;
+    uint64_t            objectStart_;       /// logical offset of the section header or packet being assembled
+    size_t              needed_;            /// bytes of it needed before it can be checked
+    size_t              filled_;            /// bytes of it in buffer_ so far
+    uint64_t            sectionEnd_;        /// logical offset just past the current section
+    uint64_t            streamEnd_;         /// logical offset just past the bytes fed so far
+    vector<uint64_t>    buffer_;            /// 64 bit elements, so packet fields are aligned
+};
+
+PacketChainChecker::PacketChainChecker(const vector<uint64_t>& sectionLogicalStarts, IntegrityReport& report, size_t maxErrorCount)
+: sectionStarts_(sectionLogicalStarts),
+  nextSection_(0),
+  report_(report),
+  maxErrorCount_(maxErrorCount),
+  state_(DONE),
+  objectStart_(0),
+  needed_(0),
+  filled_(0),
+  sectionEnd_(0),
+  streamEnd_(0),
+  buffer_(E57_DATA_PACKET_MAX/sizeof(uint64_t))
+{
+    std::sort(sectionStarts_.begin(), sectionStarts_.end());
+    sectionStarts_.erase(std::unique(sectionStarts_.begin(), sectionStarts_.end()), sectionStarts_.end());
+    startNextSection();
+}
+
+void PacketChainChecker::feed(uint64_t logicalStart, const char* data, size_t length)
+{
+    uint64_t logicalEnd = logicalStart + length;
+    while (state_ != DONE && objectStart_ + filled_ < logicalEnd) {
+        uint64_t from = objectStart_ + filled_;
+        size_t n = static_cast<size_t>(min(static_cast<uint64_t>(needed_ - filled_), logicalEnd - from));
+        memcpy(reinterpret_cast<char*>(&buffer_[0]) + filled_, data + (from - logicalStart), n);
+        filled_ += n;
+        if (filled_ == needed_)
+            completed();
+    }
+    streamEnd_ = logicalEnd;
+}
+
+void PacketChainChecker::finish()
+{
+    if (state_ != DONE) {
+        error(E57_ERROR_BAD_CV_PACKET,
+              "truncated at end of file, needed=" + toString(static_cast<uint64_t>(needed_))
+              + " available=" + toString(static_cast<uint64_t>(filled_)));
+        nextSection_ = sectionStarts_.size();
+        state_ = DONE;
+    }
+}
+
+void PacketChainChecker::startNextSection()
+{
+    state_ = DONE;
+    if (nextSection_ >= sectionStarts_.size())
+        return;
+    objectStart_ = sectionStarts_[nextSection_++];
+
+    /// Sections can't overlap, so the header mustn't have streamed past already
+    if (objectStart_ < streamEnd_ || objectStart_ < sectionEnd_) {
+        error(E57_ERROR_BAD_CV_HEADER, "section overlaps previous section ending at physicalOffset="
+                                       + toString(CheckedFile::logicalToPhysical(max(streamEnd_, sectionEnd_))));
+        startNextSection();
+        return;
+    }
+    state_  = SECTION_HEADER;
+    needed_ = sizeof(CompressedVectorSectionHeader);
+    filled_ = 0;
+}
+
+void PacketChainChecker::completed()
+{
+    switch (state_) {
+        case SECTION_HEADER: {
+            CompressedVectorSectionHeader header;
+            memcpy(reinterpret_cast<char*>(&header), &buffer_[0], sizeof(header));
+            header.swab();  /// swab if neccesary
+            try {
+                header.verify(report_.fileLength);
+            } catch (E57Exception& ex) {
+                error(ex.errorCode(), ex.context());
+                startNextSection();
+                return;
+            }
+            sectionEnd_ = objectStart_ + header.sectionLogicalLength;
+            report_.sectionCount++;
+
+            /// A CompressedVector with no records has no packets
+            if (header.sectionLogicalLength <= sizeof(header)) {
+                startNextSection();
+                return;
+            }
+            uint64_t dataStart = CheckedFile::physicalToLogical(header.dataPhysicalOffset);
+            if (dataStart < objectStart_ + sizeof(header) || dataStart >= sectionEnd_) {
+                error(E57_ERROR_BAD_CV_HEADER,
+                      "dataPhysicalOffset=" + toString(header.dataPhysicalOffset)
+                      + " sectionLogicalLength=" + toString(header.sectionLogicalLength));
+                startNextSection();
+                return;
+            }
+            objectStart_ = dataStart;
+            state_  = PACKET_HEADER;
+            needed_ = sizeof(EmptyPacketHeader);
+            filled_ = 0;
+            return;
+        }
+        case PACKET_HEADER: {
+            /// Use EmptyPacketHeader since it has the fields common to all packets
+            EmptyPacketHeader header;
+            memcpy(reinterpret_cast<char*>(&header), &buffer_[0], sizeof(header));
+            header.swab();
+            size_t packetLength = header.packetLogicalLengthMinus1 + 1;
+            if (packetLength < sizeof(header) || objectStart_ + packetLength > sectionEnd_) {
+                error(E57_ERROR_BAD_CV_PACKET,
+                      "packetType=" + toString(static_cast<unsigned>(header.packetType))
+                      + " packetLength=" + toString(static_cast<uint64_t>(packetLength))
+                      + " bytesLeftInSection=" + toString(sectionEnd_ - objectStart_));
+                startNextSection();
+                return;
+            }
+            state_  = PACKET;
+            needed_ = packetLength;
+            if (filled_ == needed_)
+                completed();
+            return;
+        }
+        case PACKET: {
+            unsigned packetLength = static_cast<unsigned>(needed_);
+            uint8_t packetType = reinterpret_cast<EmptyPacketHeader*>(&buffer_[0])->packetType;
+            try {
+                switch (packetType) {
+                    case E57_DATA_PACKET: {
+                            DataPacket* dpkt = reinterpret_cast<DataPacket*>(&buffer_[0]);
+#ifdef E57_BIGENDIAN
+                            dpkt->swab(false);
+#endif
+                            dpkt->verify(packetLength);
+                        }
+                        break;
+                    case E57_INDEX_PACKET: {
+                            IndexPacket* ipkt = reinterpret_cast<IndexPacket*>(&buffer_[0]);
+#ifdef E57_BIGENDIAN
+                            ipkt->swab(false);
+#endif
+                            ipkt->verify(packetLength, 0, report_.fileLength);
+                        }
+                        break;
+                    case E57_EMPTY_PACKET: {
+                            EmptyPacketHeader* hp = reinterpret_cast<EmptyPacketHeader*>(&buffer_[0]);
+                            hp->swab();
+                            hp->verify(packetLength);
+                        }
+                        break;
+                    default:
+                        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetType=" + toString(static_cast<unsigned>(packetType)));
+                }
+            } catch (E57Exception& ex) {
+                /// Can't trust the rest of the chain after a bad packet
+                error(ex.errorCode(), ex.context() + ", rest of section not checked");
+                startNextSection();
+                return;
+            }
+            report_.packetCount++;
+
+            objectStart_ += packetLength;
+            if (objectStart_ == sectionEnd_) {
+                startNextSection();
+                return;
+            }
+            state_  = PACKET_HEADER;
+            needed_ = sizeof(EmptyPacketHeader);
+            filled_ = 0;
+            return;
+        }
+        default:
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "state=" + toString(state_));
+    }
+}
+
+void PacketChainChecker::error(ErrorCode ecode, const ustring& context)
+{
+    addIntegrityError(report_, maxErrorCount_, ecode, CheckedFile::logicalToPhysical(objectStart_), context);
+}
+
+/// Read logical bytes without verifying checksums, returns false if any page read had a bad checksum.
+bool readUnchecked(CheckedFile& cf, uint64_t logicalStart, size_t byteCount, vector<char>& buf)
+{
+    buf.resize(byteCount);
+    vector<char> page(CheckedFile::physicalPageSize);
+    bool checksumsGood = true;
+    size_t done = 0;
+    while (done < byteCount) {
+        uint64_t pos = logicalStart + done;
+        uint64_t pageNumber = pos / CheckedFile::logicalPageSize;
+        size_t pageOffset = static_cast<size_t>(pos - pageNumber*CheckedFile::logicalPageSize);
+        if (cf.readPhysicalPages(&page[0], pageNumber, 1) != 1)
+            throw E57_EXCEPTION2(E57_ERROR_BAD_FILE_LENGTH, "logicalOffset=" + toString(pos));
+        if (!CheckedFile::pageChecksumIsGood(&page[0]))
+            checksumsGood = false;
+        size_t n = min(byteCount - done, CheckedFile::logicalPageSize - pageOffset);
+        memcpy(&buf[done], &page[pageOffset], n);
+        done += n;
+    }
+    return(checksumsGood);
+}
+
+/// Header of a CompressedVector packet, read by SeekIndex::buildTolerant() without trusting the page checksums
+struct PacketHeaderProbe {
+    unsigned            packetType;
+    unsigned            packetLength;
+    vector<uint16_t>    bsbLength;          /// buffer lengths, for data packets
+    bool                checksumsGood;      /// all pages holding the header have good checksums
+};
+
+/// Read the header of the packet at logicalOffset, returns false if it isn't self-consistent or doesn't fit in the section.
+/// A data packet must have bytestreamCount bytestreams, or any number if bytestreamCount is 0.
+bool probePacketHeader(CheckedFile& cf, uint64_t logicalOffset, uint64_t sectionEndLogicalOffset, unsigned bytestreamCount,
+                       PacketHeaderProbe& probe)
+{
+    if (logicalOffset + sizeof(EmptyPacketHeader) > sectionEndLogicalOffset)
+        return(false);
+
+    /// Use EmptyPacketHeader since it has the fields common to all packets
+    vector<char> buf;
+    size_t headerLength = static_cast<size_t>(min(static_cast<uint64_t>(sizeof(DataPacketHeader)), sectionEndLogicalOffset - logicalOffset));
+    probe.checksumsGood = readUnchecked(cf, logicalOffset, headerLength, buf);
+    EmptyPacketHeader common;
+    memcpy(&common, &buf[0], sizeof(common));
+    common.swab();  /// swab if neccesary
+    probe.packetType   = common.packetType;
+    probe.packetLength = common.packetLogicalLengthMinus1 + 1;
+    probe.bsbLength.clear();
+    if (probe.packetLength % 4 != 0 || logicalOffset + probe.packetLength > sectionEndLogicalOffset)
+        return(false);
+
+    switch (probe.packetType) {
+        case E57_EMPTY_PACKET:
+            return(common.reserved1 == 0);
+        case E57_INDEX_PACKET:
+            return(probe.packetLength >= 16);   /// size of the index packet header
+        case E57_DATA_PACKET: {
+            if (headerLength < sizeof(DataPacketHeader))
+                return(false);
+            DataPacketHeader header;
+            memcpy(&header, &buf[0], sizeof(header));
+            header.swab();  /// swab if neccesary
+            if (bytestreamCount != 0 && header.bytestreamCount != bytestreamCount)
+                return(false);
+            unsigned needed = static_cast<unsigned>(sizeof(DataPacketHeader)) + 2*header.bytestreamCount;
+            if (needed > probe.packetLength)
+                return(false);
+            if (header.bytestreamCount > 0) {
+                if (!readUnchecked(cf, logicalOffset + sizeof(DataPacketHeader), 2*header.bytestreamCount, buf))
+                    probe.checksumsGood = false;
+                probe.bsbLength.resize(header.bytestreamCount);
+                for (unsigned i = 0; i < header.bytestreamCount; i++) {
+                    /// Stored little endian
+                    probe.bsbLength[i] = static_cast<uint16_t>(static_cast<uint8_t>(buf[2*i]) | static_cast<uint8_t>(buf[2*i+1]) << 8);
+                    needed += probe.bsbLength[i];
+                }
+            }
+            /// Same test as DataPacket::verify()
+            return(needed <= probe.packetLength && needed+3 >= probe.packetLength);
+        }
+        default:
+            return(false);
+    }
+}
+
+/// True if a packet header that can be trusted starts at logicalOffset, or it is the end of the section
+bool isTrustedPacketStart(CheckedFile& cf, uint64_t logicalOffset, uint64_t sectionEndLogicalOffset, unsigned bytestreamCount)
+{
+    if (logicalOffset == sectionEndLogicalOffset)
+        return(true);
+    PacketHeaderProbe probe;
+    return(probePacketHeader(cf, logicalOffset, sectionEndLogicalOffset, bytestreamCount, probe) && probe.checksumsGood);
+}
+
+/// Scan forward in 4 byte steps (packets are multiples of 4 long) for the next data packet header that can be trusted,
+/// followed by another one or the section end.  Returns the section end if there is none.
+uint64_t resyncDataPacket(CheckedFile& cf, uint64_t logicalOffset, uint64_t sectionEndLogicalOffset, unsigned bytestreamCount)
+{
+    vector<char> page;
+    uint64_t offset = logicalOffset;
+    while (offset + sizeof(DataPacketHeader) <= sectionEndLogicalOffset) {
+        /// Candidates on a page with a bad checksum can't be trusted, check the others' type byte before probing them
+        uint64_t pageEnd = (offset / CheckedFile::logicalPageSize + 1) * CheckedFile::logicalPageSize;
+        size_t n = static_cast<size_t>(min(pageEnd, sectionEndLogicalOffset) - offset);
+        if (readUnchecked(cf, offset, n, page)) {
+            for (size_t i = 0; i < n; i += 4) {
+                if (page[i] != E57_DATA_PACKET)
+                    continue;
+                PacketHeaderProbe probe;
+                if (probePacketHeader(cf, offset + i, sectionEndLogicalOffset, bytestreamCount, probe) && probe.checksumsGood
+                    && isTrustedPacketStart(cf, offset + i + probe.packetLength, sectionEndLogicalOffset, bytestreamCount))
+                    return(offset + i);
+            }
+        }
+        offset += (n + 3) & ~static_cast<size_t>(3);
+    }
+    return(sectionEndLogicalOffset);
+}
+
+} // end anonymous namespace
+
+void ImageFileImpl::copyRawXml(const ustring& fileName, std::ostream& os)
+{
+    CheckedFile cf(fileName, CheckedFile::readOnly);
+
+    /// Get header from file (swabbed if necessary)
+    E57FileHeader header;
+    readFileHeader(&cf, header);
+
+    /// Check the XML section is inside the file, before reading it
+    uint64_t logicalStart = CheckedFile::physicalToLogical(header.xmlPhysicalOffset);
+    uint64_t fileLogicalLength = cf.length(CheckedFile::logical);
+    if (header.xmlLogicalLength > fileLogicalLength || logicalStart > fileLogicalLength - header.xmlLogicalLength) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_FILE_LENGTH,
+                             "fileName=" + fileName
+                             + " xmlPhysicalOffset=" + toString(header.xmlPhysicalOffset)
+                             + " xmlLogicalLength=" + toString(header.xmlLogicalLength));
+    }
+    if (header.xmlLogicalLength == 0)
+        return;
+    uint64_t logicalEnd = logicalStart + header.xmlLogicalLength;
+
+    /// Read whole pages in large blocks, verify each checksum, and pack the logical bytes of
+    /// the XML section to the front of the block so it can be written in one piece.
+    const size_t pageSize = CheckedFile::physicalPageSize;
+    const size_t logicalPageSize = CheckedFile::logicalPageSize;
+    const size_t pagesPerRead = 1024;
+    vector<char> buffer(pagesPerRead*pageSize);
+
+    uint64_t page = logicalStart / logicalPageSize;
+    uint64_t endPage = (logicalEnd - 1) / logicalPageSize + 1;
+    while (page < endPage) {
+        size_t pageCount = static_cast<size_t>(min(static_cast<uint64_t>(pagesPerRead), endPage - page));
+        if (cf.readPhysicalPages(&buffer[0], page, pageCount) != pageCount)
+            throw E57_EXCEPTION2(E57_ERROR_READ_FAILED, "fileName=" + fileName + " page=" + toString(page));
+
+        size_t packedLength = 0;
+        for (size_t i = 0; i < pageCount; i++) {
+            const char* pageBuffer = &buffer[i*pageSize];
+            if (!CheckedFile::pageChecksumIsGood(pageBuffer)) {
+                throw E57_EXCEPTION2(E57_ERROR_BAD_CHECKSUM,
+                                     "fileName=" + fileName + " physicalOffset=" + toString((page + i)*pageSize));
+            }
+            uint64_t pageLogicalStart = (page + i)*logicalPageSize;
+            size_t begin = static_cast<size_t>(max(logicalStart, pageLogicalStart) - pageLogicalStart);
+            size_t end = static_cast<size_t>(min(logicalEnd, pageLogicalStart + logicalPageSize) - pageLogicalStart);
+            memmove(&buffer[packedLength], pageBuffer + begin, end - begin);
+            packedLength += end - begin;
+        }
+
+        os.write(&buffer[0], packedLength);
+        if (!os)
+            throw E57_EXCEPTION2(E57_ERROR_WRITE_FAILED, "fileName=" + fileName);
+        page += pageCount;
+    }
+}
+
+void ImageFileImpl::checkIntegrity(const ustring& fileName, IntegrityReport& report, size_t maxErrorCount)
+{
+    report = IntegrityReport();
+
+    CheckedFile cf(fileName, CheckedFile::readOnly);
+    report.fileLength = cf.length(CheckedFile::physical);
+    const size_t pageSize = CheckedFile::physicalPageSize;
+
+    if (report.fileLength % pageSize != 0) {
+        addIntegrityError(report, maxErrorCount, E57_ERROR_BAD_FILE_LENGTH, report.fileLength - report.fileLength % pageSize,
+                          "file length " + toString(report.fileLength) + " is not a whole number of pages");
+    }
+
+    /// The file header locates the XML section, which gives the file offsets of the CompressedVector sections.
+    /// Problems here only limit which sections are checked, so keep going with the page checksums.
+    vector<uint64_t> sectionLogicalStarts;
+    vector<char> page(pageSize);
+    if (cf.readPhysicalPages(&page[0], 0, 1) == 1) {
+        E57FileHeader header;
+        memcpy(&header, &page[0], sizeof(header));
+        header.swab();  /// swab if neccesary
+
+        if (strncmp(header.fileSignature, "ASTM-E57", 8) != 0)
+            addIntegrityError(report, maxErrorCount, E57_ERROR_BAD_FILE_SIGNATURE, 0, "CompressedVector sections not checked");
+        else {
+            if (header.filePhysicalLength != report.fileLength) {
+                addIntegrityError(report, maxErrorCount, E57_ERROR_BAD_FILE_LENGTH, 0,
+                                  "header.filePhysicalLength=" + toString(header.filePhysicalLength)
+                                  + " fileLength=" + toString(report.fileLength));
+            }
+
+            uint64_t xmlLogicalStart = CheckedFile::physicalToLogical(header.xmlPhysicalOffset);
+            uint64_t fileLogicalLength = CheckedFile::physicalToLogical(report.fileLength - report.fileLength % pageSize);
+            if (header.xmlLogicalLength > fileLogicalLength || xmlLogicalStart > fileLogicalLength - header.xmlLogicalLength) {
+                addIntegrityError(report, maxErrorCount, E57_ERROR_BAD_FILE_LENGTH, 0,
+                                  "xmlPhysicalOffset=" + toString(header.xmlPhysicalOffset)
+                                  + " xmlLogicalLength=" + toString(header.xmlLogicalLength)
+                                  + ", CompressedVector sections not checked");
+            } else {
+                vector<char> xml;
+                readUnchecked(cf, xmlLogicalStart, static_cast<size_t>(header.xmlLogicalLength), xml);
+
+                vector<uint64_t> fileOffsets;
+                xmlFindCompressedVectorOffsets(xml, fileOffsets);
+                for (size_t i = 0; i < fileOffsets.size(); i++) {
+                    if (fileOffsets[i] >= report.fileLength || (fileOffsets[i] & CheckedFile::physicalPageSizeMask) >= CheckedFile::logicalPageSize) {
+                        addIntegrityError(report, maxErrorCount, E57_ERROR_BAD_CV_HEADER, fileOffsets[i],
+                                          "fileOffset in XML is not in the file");
+                    } else
+                        sectionLogicalStarts.push_back(CheckedFile::physicalToLogical(fileOffsets[i]));
+                }
+            }
+        }
+    }
+
+    /// Now one pass through the whole file
+    const size_t pagesPerRead = 4096;
+    vector<char> buffer(pagesPerRead*pageSize);
+    PacketChainChecker chains(sectionLogicalStarts, report, maxErrorCount);
+    uint64_t pageNumber = 0;
+    size_t n;
+    while ((n = cf.readPhysicalPages(&buffer[0], pageNumber, pagesPerRead)) > 0) {
+        for (size_t i = 0; i < n; i++, pageNumber++) {
+            const char* p = &buffer[i*pageSize];
+            if (!CheckedFile::pageChecksumIsGood(p)) {
+                report.badPageCount++;
+                addIntegrityError(report, maxErrorCount, E57_ERROR_BAD_CHECKSUM, pageNumber*pageSize, "page=" + toString(pageNumber));
+            }
+            chains.feed(pageNumber*CheckedFile::logicalPageSize, p, CheckedFile::logicalPageSize);
+        }
+        report.pageCount += n;
+    }
+    chains.finish();
+
+    std::stable_sort(report.errors.begin(), report.errors.end(), integrityErrorLess);
+}
+
+///================================================================
+
+void SeekIndex::build(CheckedFile* cf, uint64_t dataLogicalOffset, uint64_t sectionEndLogicalOffset)
+{
+    packetLogicalOffset_.clear();
+    streamByteStart_.clear();
+
+    /// Read just the header and the buffer lengths of each packet, not the bytestream data.
+    /// All packet types have their length in the same place, so can skip the index and empty packets.
+    vector<uint16_t> bsbLength;
+    vector<uint64_t> streamLength;
+    uint64_t packetLogicalOffset = dataLogicalOffset;
+    while (packetLogicalOffset < sectionEndLogicalOffset) {
+        DataPacketHeader header;
+        cf->seek(packetLogicalOffset, CheckedFile::logical);
+        cf->read(reinterpret_cast<char*>(&header), sizeof(header));
+        header.swab();  /// swab if neccesary
+
+        if (header.packetType == E57_DATA_PACKET) {
+            if (packetLogicalOffset_.empty()) {
+                streamByteStart_.resize(header.bytestreamCount);
+                streamLength.assign(header.bytestreamCount, 0);
+            }
+            if (header.bytestreamCount != streamLength.size()) {
+                throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
+                                     "bytestreamCount=" + toString(header.bytestreamCount)
+                                     + " expected=" + toString(streamLength.size())
+                                     + " packetLogicalOffset=" + toString(packetLogicalOffset));
+            }
+
+            bsbLength.resize(header.bytestreamCount);
+            if (header.bytestreamCount > 0)
+                cf->read(reinterpret_cast<char*>(&bsbLength[0]), bsbLength.size()*sizeof(uint16_t));
+
+            packetLogicalOffset_.push_back(packetLogicalOffset);
+            for (unsigned i = 0; i < bsbLength.size(); i++) {
+                streamByteStart_[i].push_back(streamLength[i]);
+                streamLength[i] += bsbLength[i];
+            }
+        }
+        packetLogicalOffset += header.packetLogicalLengthMinus1 + 1;
+    }
+
+    /// End each list with the bytestream length, so every packet's buffer length is the difference to the next entry
+    for (unsigned i = 0; i < streamLength.size(); i++)
+        streamByteStart_[i].push_back(streamLength[i]);
+
+    if (packetLogicalOffset_.empty())
+        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "dataLogicalOffset=" + toString(dataLogicalOffset));
+}
+
+void SeekIndex::buildTolerant(CheckedFile* cf, uint64_t dataLogicalOffset, uint64_t sectionEndLogicalOffset,
+                              unsigned bytestreamCount, const vector<uint64_t>& streamLength)
+{
+    /// Like build(), for the "recover" read mode.  bytestreamCount is the number of terminals in the prototype,
+    /// which every data packet header must match.  streamLength gives the exact length of each bytestream that will be read,
+    /// and E57_UINT64_MAX for the others.
+    packetLogicalOffset_.clear();
+    streamByteStart_.clear();
+    damaged_.clear();
+    resyncPacket_ = E57_UINT64_MAX;
+
+    /// Don't read past the last whole page of a truncated file
+    uint64_t fileLogicalLength = cf->length(CheckedFile::physical) / CheckedFile::physicalPageSize * CheckedFile::logicalPageSize;
+    uint64_t sectionEnd = min(sectionEndLogicalOffset, fileLogicalLength);
+
+    /// Follow the packet chain reading the headers without trusting the page checksums.
+    /// A header on a page with a bad checksum is believed if it is self-consistent and leads to a good header,
+    /// but its buffer lengths aren't.  A header that isn't believed breaks the chain, which is picked up again
+    /// at the next trustworthy data packet header.  Data packets without known buffer lengths are marked unknown.
+    const size_t none = static_cast<size_t>(-1);
+    size_t firstUnknown = none;
+    size_t lastUnknown  = none;
+    vector<vector<uint16_t> > bsbLengths;
+    uint64_t offset = dataLogicalOffset;
+    while (offset < sectionEnd) {
+        PacketHeaderProbe probe;
+        bool chained = probePacketHeader(*cf, offset, sectionEnd, bytestreamCount, probe)
+                       && (probe.checksumsGood || isTrustedPacketStart(*cf, offset + probe.packetLength, sectionEnd, bytestreamCount));
+        if (chained && probe.packetType != E57_DATA_PACKET) {
+            offset += probe.packetLength;
+            continue;
+        }
+
+        bool known = chained && probe.checksumsGood;
+        if (!known) {
+            if (firstUnknown == none)
+                firstUnknown = packetLogicalOffset_.size();
+            lastUnknown = packetLogicalOffset_.size();
+        }
+        packetLogicalOffset_.push_back(offset);
+        damaged_.push_back(!known);
+        bsbLengths.push_back(known ? probe.bsbLength : vector<uint16_t>());
+
+        if (chained)
+            offset += probe.packetLength;
+        else
+            offset = resyncDataPacket(*cf, offset + 4, sectionEnd, bytestreamCount);
+    }
+
+    /// Packets before the first unknown one get their positions by summing buffer lengths from the start of each bytestream.
+    /// The unknown packets and any between them become a single damaged entry, the resync gap,
+    /// even the intact packets between two damaged ones, since their positions in the bytestreams aren't known.
+    /// Every bytestream being read has a known exact length, so the packets after the gap are placed backwards from its end.
+    /// If that doesn't fit, the gap extends to the end of the section.
+    size_t bytestreamTotal = max(static_cast<size_t>(bytestreamCount), streamLength.size());
+    size_t packetCount = packetLogicalOffset_.size();
+    size_t forwardCount = (firstUnknown == none) ? packetCount : firstUnknown;
+    size_t backwardStart = (firstUnknown == none) ? packetCount : lastUnknown + 1;
+    vector<uint64_t> forwardEnd(bytestreamTotal, 0);
+    vector<uint64_t> backwardLength(bytestreamTotal, 0);
+    for (size_t k = 0; k < packetCount; k++) {
+        for (unsigned i = 0; i < bsbLengths[k].size(); i++) {
+            if (k < forwardCount)
+                forwardEnd[i] += bsbLengths[k][i];
+            else if (k >= backwardStart)
+                backwardLength[i] += bsbLengths[k][i];
+        }
+    }
+    bool placed = true;
+    for (size_t i = 0; i < bytestreamTotal; i++) {
+        uint64_t length = (i < streamLength.size()) ? streamLength[i] : E57_UINT64_MAX;
+        if (length != E57_UINT64_MAX && (length < backwardLength[i] || length - backwardLength[i] < forwardEnd[i]))
+            placed = false;
+    }
+    if (!placed)
+        backwardStart = packetCount;
+
+    vector<uint64_t> offsets;
+    vector<bool> damaged;
+    streamByteStart_.resize(bytestreamTotal);
+    for (size_t i = 0; i < bytestreamTotal; i++) {
+        uint64_t length = (i < streamLength.size()) ? streamLength[i] : E57_UINT64_MAX;
+        vector<uint64_t>& start = streamByteStart_[i];
+        uint64_t position = 0;
+        for (size_t k = 0; k < forwardCount; k++) {
+            start.push_back(position);
+            position += (i < bsbLengths[k].size()) ? bsbLengths[k][i] : 0;
+        }
+        if (firstUnknown != none) {
+            start.push_back(position);
+
+            /// Bytestreams not being read just need increasing positions
+            if (length != E57_UINT64_MAX)
+                position = placed ? length - backwardLength[i] : length;
+            for (size_t k = backwardStart; k < packetCount; k++) {
+                start.push_back(position);
+                position += (i < bsbLengths[k].size()) ? bsbLengths[k][i] : 0;
+            }
+        }
+        start.push_back(position);
+    }
+    for (size_t k = 0; k < packetCount; k++) {
+        if (k < forwardCount || k == firstUnknown || k >= backwardStart) {
+            offsets.push_back(packetLogicalOffset_[k]);
+            damaged.push_back(damaged_[k]);
+        }
+    }
+    if (firstUnknown != none)
+        resyncPacket_ = firstUnknown;
+    packetLogicalOffset_.swap(offsets);
+    damaged_.swap(damaged);
+}
+
+void SeekIndex::find(unsigned bytestreamNumber, uint64_t streamByte,
+                     uint64_t& packetLogicalOffset, size_t& bufferIndex, size_t& bufferLength)
+{
+    if (bytestreamNumber >= streamByteStart_.size())
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "bytestreamNumber=" + toString(bytestreamNumber));
+
+    /// Last packet whose buffer starts at or before streamByte.
+    /// Packets with an empty buffer start where the next one does, so this skips them.
+    const vector<uint64_t>& start = streamByteStart_[bytestreamNumber];
+    size_t packetCount = packetLogicalOffset_.size();
+    size_t found = std::upper_bound(start.begin(), start.begin() + packetCount, streamByte) - start.begin();
+    if (found > 0)
+        found--;
+
+    packetLogicalOffset = packetLogicalOffset_[found];
+    bufferLength        = static_cast<size_t>(start[found+1] - start[found]);
+    bufferIndex         = static_cast<size_t>(min(streamByte - start[found], static_cast<uint64_t>(bufferLength)));
+}
+
+size_t SeekIndex::packetIndex(uint64_t packetLogicalOffset)
+{
+    vector<uint64_t>::iterator it = std::lower_bound(packetLogicalOffset_.begin(), packetLogicalOffset_.end(), packetLogicalOffset);
+    if (it == packetLogicalOffset_.end() || *it != packetLogicalOffset)
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "packetLogicalOffset=" + toString(packetLogicalOffset));
+    return(it - packetLogicalOffset_.begin());
+}
 
-    /// Check actual packet length is large enough.
-    if (bufferLength > 0 && packetLength > bufferLength) {
-        throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET,
-                             "packetLength=" + toString(packetLength)
-                             + " bufferLength=" + toString(bufferLength));
-    }
+uint64_t SeekIndex::packetAtOrAfter(uint64_t logicalOffset)
+{
+    /// The index only holds data packets, so this skips index and empty packets without reading them
+    vector<uint64_t>::iterator it = std::lower_bound(packetLogicalOffset_.begin(), packetLogicalOffset_.end(), logicalOffset);
+    return((it == packetLogicalOffset_.end()) ? E57_UINT64_MAX : *it);
 }
 
-#ifdef E57_BIGENDIAN
-void EmptyPacketHeader::swab()
+void SeekIndex::bufferRange(size_t packetIndex, unsigned bytestreamNumber, uint64_t& streamByteStart, uint64_t& streamByteEnd)
 {
-    /// Byte swap fields in-place, if CPU is BIG_ENDIAN
-    SWAB(&packetLogicalLengthMinus1);
-};
-#endif
+    if (bytestreamNumber >= streamByteStart_.size() || packetIndex >= packetLogicalOffset_.size())
+        throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "bytestreamNumber=" + toString(bytestreamNumber) + " packetIndex=" + toString(packetIndex));
+    streamByteStart = streamByteStart_[bytestreamNumber][packetIndex];
+    streamByteEnd   = streamByteStart_[bytestreamNumber][packetIndex+1];
+}
 
 #ifdef E57_DEBUG
-void EmptyPacketHeader::dump(int indent, std::ostream& os)
+void SeekIndex::dump(int indent, std::ostream& os)
 {
-    os << space(indent) << "packetType:                " << (unsigned)packetType << endl;
-    os << space(indent) << "packetLogicalLengthMinus1: " << packetLogicalLengthMinus1 << endl;
+    os << space(indent) << "packetCount:     " << packetLogicalOffset_.size() << endl;
+    os << space(indent) << "bytestreamCount: " << streamByteStart_.size() << endl;
+    unsigned i;
+    for (i = 0; i < packetLogicalOffset_.size() && i < 10; i++)
+        os << space(indent+4) << "packetLogicalOffset[" << i << "]: " << packetLogicalOffset_[i] << endl;
+    if (i < packetLogicalOffset_.size())
+        os << space(indent+4) << packetLogicalOffset_.size()-i << " more unprinted..." << endl;
 }
 #endif
 
-///================================================================
+//================================================================
 
 struct SortByBytestreamNumber {
     bool operator () (shared_ptr<Encoder> lhs , shared_ptr<Encoder> rhs) const {
@@ -5652,7 +7875,11 @@ struct SortByBytestreamNumber {
 CompressedVectorWriterImpl::CompressedVectorWriterImpl(shared_ptr<CompressedVectorNodeImpl> ni, vector<SourceDestBuffer>& sbufs)
 : isOpen_(false),  // set to true when succeed below
   cVector_(ni),
-  seekIndex_()      /// Init seek index for random access to beginning of chunks
+  seekIndex_(),     /// Init seek index for random access to beginning of chunks
+  groupIdSource_(-1),
+  chunkRecordCount_(0),
+  sampleInterval_(0),
+  sampleCount_(0)
 {
     //???  check if cvector already been written (can't write twice)
 
@@ -5669,6 +7896,10 @@ CompressedVectorWriterImpl::CompressedVectorWriterImpl(shared_ptr<CompressedVect
     /// Check sbufs well formed (matches proto exactly)
     setBuffers(sbufs); //??? copy code here?
 
+    /// Nothing written yet, so every range is empty
+    sourceMinimum_.assign(sbufs_.size(), DBL_MAX);
+    sourceMaximum_.assign(sbufs_.size(), -DBL_MAX);
+
     /// Zero dataPacket_ at start
     memset(&dataPacket_, 0, sizeof(dataPacket_));
 
@@ -5815,6 +8046,267 @@ boost::shared_ptr<CompressedVectorNodeImpl> CompressedVectorWriterImpl::compress
     return(cVector_);
 }
 
+bool CompressedVectorWriterImpl::sourceRange(const ustring& pathName, double& minimum, double& maximum)
+{
+    /// don't checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__), or checkWriterOpen(), ranges are kept after close
+    for (unsigned i = 0; i < sbufs_.size(); i++) {
+        if (sbufs_.at(i).pathName() == pathName) {
+            if (sourceMinimum_.at(i) > sourceMaximum_.at(i))
+                return(false);
+            minimum = sourceMinimum_.at(i);
+            maximum = sourceMaximum_.at(i);
+            return(true);
+        }
+    }
+    return(false);
+}
+
+unsigned CompressedVectorWriterImpl::sourceIndex(const ustring& pathName)
+{
+    for (unsigned i = 0; i < sbufs_.size(); i++) {
+        if (sbufs_.at(i).pathName() == pathName)
+            return(i);
+    }
+    throw E57_EXCEPTION2(E57_ERROR_PATH_UNDEFINED,
+                         "pathName=" + pathName
+                         + " imageFileName=" + cVector_->imageFileName()
+                         + " cvPathName=" + cVector_->pathName());
+}
+
+void CompressedVectorWriterImpl::trackGroups(const ustring& idPathName, const vector<ustring>& rangePathNames)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    checkWriterOpen(__FILE__, __LINE__, __FUNCTION__);
+
+    /// Groups must start at the first record
+    if (recordCount_ > 0) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT,
+                             "recordCount=" + toString(recordCount_)
+                             + " imageFileName=" + cVector_->imageFileName()
+                             + " cvPathName=" + cVector_->pathName());
+    }
+
+    groupRangeSources_.clear();
+    for (unsigned i = 0; i < rangePathNames.size(); i++)
+        groupRangeSources_.push_back(sourceIndex(rangePathNames.at(i)));
+    groupIdSource_ = static_cast<int>(sourceIndex(idPathName));
+
+    groupIdValue_.clear();
+    groupStartRecord_.clear();
+    groupRecordCount_.clear();
+    groupMinimum_.clear();
+    groupMaximum_.clear();
+}
+
+void CompressedVectorWriterImpl::accumulateGroups(size_t recordCount)
+{
+    /// Find where the group identifier changes in this block of records
+    vector<size_t>  runStart;
+    vector<int64_t> runValue;
+    sbufs_.at(groupIdSource_).impl()->findRuns(recordCount, runStart, runValue);
+
+    size_t rangeCount = groupRangeSources_.size();
+    for (size_t r = 0; r < runStart.size(); r++) {
+        size_t first = runStart.at(r);
+        size_t count = ((r+1 < runStart.size()) ? runStart.at(r+1) : recordCount) - first;
+
+        /// The first run continues the last group of the previous block if it has the same identifier
+        if (groupIdValue_.empty() || r > 0 || groupIdValue_.back() != runValue.at(r)) {
+            groupIdValue_.push_back(runValue.at(r));
+            groupStartRecord_.push_back(static_cast<int64_t>(recordCount_ + first));
+            groupRecordCount_.push_back(0);
+            groupMinimum_.resize(groupMinimum_.size() + rangeCount, DBL_MAX);
+            groupMaximum_.resize(groupMaximum_.size() + rangeCount, -DBL_MAX);
+        }
+        groupRecordCount_.back() += count;
+
+        size_t group = groupIdValue_.size() - 1;
+        for (size_t j = 0; j < rangeCount; j++) {
+            sbufs_.at(groupRangeSources_.at(j)).impl()->accumulateRange(first, count,
+                                                                        groupMinimum_.at(group*rangeCount + j),
+                                                                        groupMaximum_.at(group*rangeCount + j));
+        }
+    }
+}
+
+bool CompressedVectorWriterImpl::sourceGroups(vector<int64_t>& idValue, vector<int64_t>& startRecord, vector<int64_t>& recordCount,
+                                              vector<double>& minimum, vector<double>& maximum)
+{
+    /// don't checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__), or checkWriterOpen(), groups are kept after close
+    idValue.clear();
+    startRecord.clear();
+    recordCount.clear();
+    minimum.clear();
+    maximum.clear();
+
+    if (groupIdSource_ < 0)
+        return(false);
+
+    /// An identifier that shows up in more than one run can't be described by a single group
+    vector<int64_t> sortedIds(groupIdValue_);
+    std::sort(sortedIds.begin(), sortedIds.end());
+    if (std::adjacent_find(sortedIds.begin(), sortedIds.end()) != sortedIds.end())
+        return(false);
+
+    idValue     = groupIdValue_;
+    startRecord = groupStartRecord_;
+    recordCount = groupRecordCount_;
+    minimum     = groupMinimum_;
+    maximum     = groupMaximum_;
+    return(true);
+}
+
+void CompressedVectorWriterImpl::trackChunks(int64_t chunkRecordCount, const vector<ustring>& rangePathNames)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    checkWriterOpen(__FILE__, __LINE__, __FUNCTION__);
+
+    /// Chunks must start at the first record
+    if (recordCount_ > 0 || chunkRecordCount <= 0) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT,
+                             "recordCount=" + toString(recordCount_)
+                             + " chunkRecordCount=" + toString(chunkRecordCount)
+                             + " imageFileName=" + cVector_->imageFileName()
+                             + " cvPathName=" + cVector_->pathName());
+    }
+
+    chunkRangeSources_.clear();
+    for (unsigned i = 0; i < rangePathNames.size(); i++)
+        chunkRangeSources_.push_back(sourceIndex(rangePathNames.at(i)));
+    chunkRecordCount_ = static_cast<uint64_t>(chunkRecordCount);
+
+    chunkMinimum_.clear();
+    chunkMaximum_.clear();
+}
+
+void CompressedVectorWriterImpl::accumulateChunks(size_t recordCount)
+{
+    /// Split the block of records at the chunk boundaries
+    size_t rangeCount = chunkRangeSources_.size();
+    size_t first = 0;
+    while (first < recordCount) {
+        uint64_t record = recordCount_ + first;
+        size_t   chunk  = static_cast<size_t>(record / chunkRecordCount_);
+        size_t   count  = static_cast<size_t>(min(static_cast<uint64_t>(recordCount - first), (chunk+1)*chunkRecordCount_ - record));
+
+        if (chunkMinimum_.size() <= chunk*rangeCount) {
+            chunkMinimum_.resize((chunk+1)*rangeCount, DBL_MAX);
+            chunkMaximum_.resize((chunk+1)*rangeCount, -DBL_MAX);
+        }
+        for (size_t j = 0; j < rangeCount; j++) {
+            sbufs_.at(chunkRangeSources_.at(j)).impl()->accumulateRange(first, count,
+                                                                        chunkMinimum_.at(chunk*rangeCount + j),
+                                                                        chunkMaximum_.at(chunk*rangeCount + j));
+        }
+        first += count;
+    }
+}
+
+bool CompressedVectorWriterImpl::sourceChunks(vector<double>& minimum, vector<double>& maximum)
+{
+    /// don't checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__), or checkWriterOpen(), chunks are kept after close
+    minimum.clear();
+    maximum.clear();
+
+    if (chunkRecordCount_ == 0)
+        return(false);
+
+    minimum = chunkMinimum_;
+    maximum = chunkMaximum_;
+    return(true);
+}
+
+void CompressedVectorWriterImpl::trackSamples(int64_t sampleInterval)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    checkWriterOpen(__FILE__, __LINE__, __FUNCTION__);
+
+    /// Samples are counted from the first record
+    if (recordCount_ > 0 || sampleInterval <= 0) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT,
+                             "recordCount=" + toString(recordCount_)
+                             + " sampleInterval=" + toString(sampleInterval)
+                             + " imageFileName=" + cVector_->imageFileName()
+                             + " cvPathName=" + cVector_->pathName());
+    }
+
+    sampleInterval_ = static_cast<uint64_t>(sampleInterval);
+    sampleCount_ = 0;
+    sampleBytes_.assign(sbufs_.size(), vector<char>());
+    sampleStrings_.assign(sbufs_.size(), vector<ustring>());
+}
+
+void CompressedVectorWriterImpl::accumulateSamples(size_t recordCount)
+{
+    /// Index in this block of records of the first record that is a multiple of sampleInterval_
+    size_t first = static_cast<size_t>((sampleInterval_ - recordCount_ % sampleInterval_) % sampleInterval_);
+    if (first >= recordCount)
+        return;
+    size_t count = (recordCount - first - 1) / static_cast<size_t>(sampleInterval_) + 1;
+
+    for (unsigned i = 0; i < sbufs_.size(); i++)
+        sbufs_.at(i).impl()->copyElements(first, static_cast<size_t>(sampleInterval_), count, sampleBytes_.at(i), sampleStrings_.at(i));
+    sampleCount_ += count;
+}
+
+bool CompressedVectorWriterImpl::sourceSamples(vector<SourceDestBuffer>& sbufs)
+{
+    /// don't checkWriterOpen(), samples are kept after close
+    sbufs.clear();
+
+    if (sampleInterval_ == 0 || sampleCount_ == 0)
+        return(false);
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+
+    /// The buffers refer to the copies held by this writer, and have the representation and options of the source buffers
+    ImageFile imf(cVector_->destImageFile());
+    for (unsigned i = 0; i < sbufs_.size(); i++) {
+        shared_ptr<SourceDestBufferImpl> source = sbufs_.at(i).impl();
+        ustring pathName     = source->pathName();
+        bool    doConversion = source->doConversion();
+        bool    doScaling    = source->doScaling();
+        char*   b = sampleBytes_.at(i).empty() ? NULL : &sampleBytes_.at(i)[0];
+        switch (source->memoryRepresentation()) {
+            case E57_INT8:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<int8_t*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_UINT8:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<uint8_t*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_INT16:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<int16_t*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_UINT16:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<uint16_t*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_INT32:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<int32_t*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_UINT32:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<uint32_t*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_INT64:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<int64_t*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_BOOL:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<bool*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_REAL32:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<float*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_REAL64:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, reinterpret_cast<double*>(b), sampleCount_, doConversion, doScaling));
+                break;
+            case E57_USTRING:
+                sbufs.push_back(SourceDestBuffer(imf, pathName, &sampleStrings_.at(i)));
+                break;
+            default:
+                throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "pathName=" + pathName);
+        }
+    }
+    return(true);
+}
+
 void CompressedVectorWriterImpl::setBuffers(vector<SourceDestBuffer>& sbufs)
 {
     /// don't checkImageFileOpen
@@ -5840,6 +8332,20 @@ void CompressedVectorWriterImpl::setBuffers(vector<SourceDestBuffer>& sbufs)
     proto_->checkBuffers(sbufs, false);
 
     sbufs_ = sbufs;
+
+    /// Point the encoders at the new buffers (the encoders are created after the first call, from the constructor).
+    /// bytestreams_ is sorted by bytestreamNumber, and every field of the prototype has a bytestream.
+    if (bytestreams_.size() == sbufs_.size()) {
+        for (unsigned i = 0; i < sbufs_.size(); i++) {
+            uint64_t bytestreamNumber = 0;
+            if (!proto_->findTerminalPosition(proto_->get(sbufs_.at(i).pathName()), bytestreamNumber))
+                throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "sbufIndex=" + toString(i));
+
+            vector<SourceDestBuffer> vTemp;
+            vTemp.push_back(sbufs_.at(i));
+            bytestreams_.at(static_cast<size_t>(bytestreamNumber))->sourceBufferSetNew(vTemp);
+        }
+    }
 }
 
 void CompressedVectorWriterImpl::write(vector<SourceDestBuffer>& sbufs, const size_t requestedRecordCount)
@@ -5868,9 +8374,17 @@ void CompressedVectorWriterImpl::write(const size_t requestedRecordCount)
                              + " cvPathName=" + cVector_->pathName());
     }
 
-    /// Rewind all sbufs so start reading from beginning
-    for (unsigned i=0; i < sbufs_.size(); i++)
+    /// Rewind all sbufs so start reading from beginning, and track the range of the values written from them
+    for (unsigned i=0; i < sbufs_.size(); i++) {
         sbufs_.at(i).impl()->rewind();
+        sbufs_.at(i).impl()->accumulateRange(0, requestedRecordCount, sourceMinimum_.at(i), sourceMaximum_.at(i));
+    }
+    if (groupIdSource_ >= 0)
+        accumulateGroups(requestedRecordCount);
+    if (chunkRecordCount_ > 0)
+        accumulateChunks(requestedRecordCount);
+    if (sampleInterval_ > 0)
+        accumulateSamples(requestedRecordCount);
 
     /// Loop until all channels have completed requestedRecordCount transfers
     uint64_t endRecordIndex = recordCount_ + requestedRecordCount;
@@ -6213,7 +8727,9 @@ void CompressedVectorWriterImpl::dump(int indent, std::ostream& os)
 
 CompressedVectorReaderImpl::CompressedVectorReaderImpl(shared_ptr<CompressedVectorNodeImpl> cvi, vector<SourceDestBuffer>& dbufs)
 : isOpen_(false),  // set to true when succeed below
-  cVector_(cvi)
+  cVector_(cvi),
+  recover_(false),
+  readStartRecord_(0)
 {
 #ifdef E57_MAX_VERBOSE
     cout << "CompressedVectorReaderImpl() called" << endl; //???
@@ -6286,9 +8802,50 @@ CompressedVectorReaderImpl::CompressedVectorReaderImpl(shared_ptr<CompressedVect
 
     /// Convert physical offset to first data packet to logical
     uint64_t dataLogicalOffset = imf->file_->physicalToLogical(sectionHeader.dataPhysicalOffset);
+    dataLogicalOffset_ = dataLogicalOffset;
 
-    /// Verify that packet given by dataPhysicalOffset is actually a data packet, init channels
-    {
+    recover_ = imf->recover_;
+    if (recover_) {
+        /// Find all the data packets first, without trusting any checksums, so damaged ones can be skipped.
+        /// The encoders pad each bytestream to whole words, so the length of a bytestream of fixed size records is known.
+        vector<uint64_t> streamLength;
+        for (unsigned i = 0; i < channels_.size(); i++) {
+            DecodeChannel* chan = &channels_[i];
+            if (streamLength.size() <= chan->bytestreamNumber)
+                streamLength.resize(chan->bytestreamNumber + 1, E57_UINT64_MAX);
+            unsigned bitsPerRecord, bytesPerWord;
+            if (chan->decoder->recordLayout(bitsPerRecord, bytesPerWord)) {
+                uint64_t wordCount = (maxRecordCount_*bitsPerRecord + 8*bytesPerWord - 1) / (8*bytesPerWord);
+                streamLength[chan->bytestreamNumber] = wordCount * bytesPerWord;
+            }
+        }
+
+        /// Count all the terminals in the prototype, the number of bytestreams in every data packet.
+        /// cVector_ isn't part of its own prototype, so the search fails after visiting every terminal.
+        uint64_t bytestreamCount = 0;
+        proto_->findTerminalPosition(cVector_, bytestreamCount);
+
+        recoveryIndex_.reset(new SeekIndex);
+        recoveryIndex_->buildTolerant(imf->file_, dataLogicalOffset, sectionEndLogicalOffset_,
+                                      static_cast<unsigned>(bytestreamCount), streamLength);
+
+        if (recoveryIndex_->isBuilt()) {
+            for (unsigned i = 0; i < channels_.size(); i++) {
+                DecodeChannel* chan = &channels_[i];
+                uint64_t streamByteStart, streamByteEnd;
+                recoveryIndex_->bufferRange(0, chan->bytestreamNumber, streamByteStart, streamByteEnd);
+                chan->currentPacketLogicalOffset    = recoveryIndex_->packetLogicalOffset(0);
+                chan->currentBytestreamBufferIndex  = 0;
+                chan->currentBytestreamBufferLength = static_cast<size_t>(streamByteEnd - streamByteStart);
+            }
+        } else if (maxRecordCount_ > 0) {
+            /// No data packet could be found
+            lostRecords_[0] = maxRecordCount_;
+            for (unsigned i = 0; i < channels_.size(); i++)
+                channels_[i].inputFinished = true;
+        }
+    } else {
+        /// Verify that packet given by dataPhysicalOffset is actually a data packet, init channels
         char* anyPacket = NULL;
         auto_ptr<PacketLock> packetLock = cache_->lock(dataLogicalOffset, anyPacket);
 
@@ -6355,6 +8912,16 @@ void CompressedVectorReaderImpl::setBuffers(vector<SourceDestBuffer>& dbufs)
     }
 
     dbufs_ = dbufs;
+
+    /// Point the decoders at the new buffers (the channels are created after the first call, from the constructor)
+    if (channels_.size() == dbufs_.size()) {
+        for (size_t i = 0; i < channels_.size(); i++) {
+            vector<SourceDestBuffer> theDbuf;
+            theDbuf.push_back(dbufs_.at(i));
+            channels_[i].dbuf = dbufs_.at(i);
+            channels_[i].decoder->destBufferSetNew(theDbuf);
+        }
+    }
 }
 
 unsigned CompressedVectorReaderImpl::read(vector<SourceDestBuffer>& dbufs)
@@ -6381,6 +8948,14 @@ unsigned CompressedVectorReaderImpl::read()
     for (unsigned i=0; i < dbufs_.size(); i++)
         dbufs_[i].impl()->rewind();
 
+    /// In recovery mode, channels left at the start of a lost range go past it, then all are at the same record
+    if (recover_) {
+        skipLostRecords();
+        readStartRecord_ = E57_UINT64_MAX;
+        for (unsigned i = 0; i < channels_.size(); i++)
+            readStartRecord_ = min(readStartRecord_, channels_[i].decoder->totalRecordsCompleted());
+    }
+
     /// Allow decoders to use data they already have in their queue to fill newly empty dbufs
     /// This helps to keep decoder input queues smaller, which reduces backtracking in the packet cache.
     for (unsigned i = 0; i < channels_.size(); i++)
@@ -6388,6 +8963,9 @@ unsigned CompressedVectorReaderImpl::read()
 
     /// Loop until every dbuf is full or we have reached end of the binary section.
     while (1) {
+        if (!lostRecords_.empty())
+            skipLostRecords();
+
         /// Find the earliest packet position for channels that are still hungry
         /// It's important to call inputProcess of the decoders before this call, so current hungriness level is reflected.
         uint64_t earliestPacketLogicalOffset = earliestPacketNeededForInput();
@@ -6397,7 +8975,10 @@ unsigned CompressedVectorReaderImpl::read()
             break;
 
         /// Feed packet to the hungry decoders
-        feedPacketToDecoders(earliestPacketLogicalOffset);
+        if (recover_)
+            feedOrSkipPacket(earliestPacketLogicalOffset);
+        else
+            feedPacketToDecoders(earliestPacketLogicalOffset);
     }
 
     /// Verify that each channel produced the same number of records
@@ -6519,8 +9100,14 @@ void CompressedVectorReaderImpl::feedPacketToDecoders(uint64_t currentPacketLogi
     if (channelHasExhaustedPacket) {
         if (nextPacketLogicalOffset < E57_UINT64_MAX) { //??? huh?
             /// Get packet at nextPacketLogicalOffset into memory.
+            /// In recovery mode take the buffer lengths from the packet map instead, the packet may be damaged.
             char* anyPacket = NULL;
-            auto_ptr<PacketLock> packetLock = cache_->lock(nextPacketLogicalOffset, anyPacket);
+            auto_ptr<PacketLock> packetLock;
+            size_t nextPacketIndex = 0;
+            if (recover_)
+                nextPacketIndex = recoveryIndex_->packetIndex(nextPacketLogicalOffset);
+            else
+                packetLock = cache_->lock(nextPacketLogicalOffset, anyPacket);
             DataPacket* dpkt = reinterpret_cast<DataPacket*>(anyPacket);
 
             /// Got a data packet, update the channels with exhausted input
@@ -6531,7 +9118,12 @@ void CompressedVectorReaderImpl::feedPacketToDecoders(uint64_t currentPacketLogi
                     chan->currentBytestreamBufferIndex = 0;
 
                     /// It is OK if the next packet doesn't contain any data for this channel, will skip packet on next iter of loop
-                    chan->currentBytestreamBufferLength = dpkt->getBytestreamBufferLength(chan->bytestreamNumber);
+                    if (recover_) {
+                        uint64_t streamByteStart, streamByteEnd;
+                        recoveryIndex_->bufferRange(nextPacketIndex, chan->bytestreamNumber, streamByteStart, streamByteEnd);
+                        chan->currentBytestreamBufferLength = static_cast<size_t>(streamByteEnd - streamByteStart);
+                    } else
+                        chan->currentBytestreamBufferLength = dpkt->getBytestreamBufferLength(chan->bytestreamNumber);
 
 #ifdef E57_MAX_VERBOSE
                     cout << "  set new stream buffer for channel[" << i << "], length=" << chan->currentBytestreamBufferLength << endl;
@@ -6566,6 +9158,10 @@ uint64_t CompressedVectorReaderImpl::findNextDataPacket(uint64_t nextPacketLogic
          << " sectionEndLogicalOffset=" << sectionEndLogicalOffset_ << endl;
 #endif
 
+    /// In recovery mode a damaged packet can't be relied on to lead to the next one, use the packet map
+    if (recover_)
+        return(recoveryIndex_->packetAtOrAfter(nextPacketLogicalOffset));
+
     /// Starting at nextPacketLogicalOffset, search for next data packet until hit end of binary section.
     while (nextPacketLogicalOffset < sectionEndLogicalOffset_) {
         char* anyPacket = NULL;
@@ -6588,12 +9184,200 @@ uint64_t CompressedVectorReaderImpl::findNextDataPacket(uint64_t nextPacketLogic
     return(E57_UINT64_MAX);
 }
 
-void CompressedVectorReaderImpl::seek(uint64_t /*recordNumber*/)
+void CompressedVectorReaderImpl::seek(uint64_t recordNumber)
+{
+    checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    checkReaderOpen(__FILE__, __LINE__, __FUNCTION__);
+
+    /// It is OK to seek to one past the last record, the next read will get nothing
+    if (recordNumber > maxRecordCount_) {
+        throw E57_EXCEPTION2(E57_ERROR_BAD_API_ARGUMENT,
+                             "recordNumber=" + toString(recordNumber)
+                             + " maxRecordCount=" + toString(maxRecordCount_)
+                             + " imageFileName=" + cVector_->imageFileName()
+                             + " cvPathName=" + cVector_->pathName());
+    }
+
+    /// Find the packets from their headers the first time any reader of this CompressedVector seeks.
+    /// In recovery mode the reader has its own packet map.
+    if (!recover_ && !cVector_->seekIndex_) {
+        shared_ptr<ImageFileImpl> imf(cVector_->destImageFile_);
+        shared_ptr<SeekIndex> seekIndex(new SeekIndex);
+        seekIndex->build(imf->file_, dataLogicalOffset_, sectionEndLogicalOffset_);
+        cVector_->seekIndex_ = seekIndex;
+    }
+
+    /// Every bytestream holds records of a fixed bit size (except strings), so each decoder knows which byte its record starts in.
+    /// Point each channel at the packet holding that byte, the packets before it are never read.
+    for (unsigned i = 0; i < channels_.size(); i++)
+        seekChannel(&channels_[i], recordNumber);
+
+    if (recover_)
+        skipLostRecords();
+}
+
+void CompressedVectorReaderImpl::seekChannel(DecodeChannel* chan, uint64_t recordNumber)
+{
+    SeekIndex* seekIndex = recover_ ? recoveryIndex_.get() : cVector_->seekIndex_.get();
+
+    uint64_t streamByte = 0;
+    if (!chan->decoder->seekRecord(recordNumber, streamByte))
+        throw E57_EXCEPTION2(E57_ERROR_NOT_IMPLEMENTED, "pathName=" + chan->dbuf.pathName());
+
+    /// A recovery packet map can be empty, then all records are lost
+    if (!seekIndex->isBuilt()) {
+        chan->inputFinished = true;
+        return;
+    }
+    seekIndex->find(chan->bytestreamNumber, streamByte, chan->currentPacketLogicalOffset,
+                    chan->currentBytestreamBufferIndex, chan->currentBytestreamBufferLength);
+    chan->inputFinished = false;
+}
+
+void CompressedVectorReaderImpl::feedOrSkipPacket(uint64_t packetLogicalOffset)
+{
+    size_t packetIndex = recoveryIndex_->packetIndex(packetLogicalOffset);
+    if (!recoveryIndex_->isDamaged(packetIndex)) {
+        /// In recovery mode feedPacketToDecoders() only reads this packet, and fails before feeding any decoder
+        try {
+            feedPacketToDecoders(packetLogicalOffset);
+            return;
+        } catch (E57Exception& ex) {
+            if (ex.errorCode() != E57_ERROR_BAD_CHECKSUM && ex.errorCode() != E57_ERROR_BAD_CV_PACKET)
+                throw;
+        }
+        recoveryIndex_->setDamaged(packetIndex);
+    }
+    skipDamagedPacket(packetIndex);
+}
+
+void CompressedVectorReaderImpl::skipDamagedPacket(size_t packetIndex)
+{
+    /// Find the records with bits in the packet's buffers of the bytestreams being read.
+    /// Decoders take whole words, so a word partly in the packet is lost with all the records touching it.
+    /// Strings can't be located in their bytestream, so everything from the current one on is lost.
+    uint64_t lostStart = E57_UINT64_MAX;
+    uint64_t lostEnd   = 0;
+    for (unsigned i = 0; i < channels_.size(); i++) {
+        DecodeChannel* chan = &channels_[i];
+        uint64_t streamByteStart, streamByteEnd;
+        recoveryIndex_->bufferRange(packetIndex, chan->bytestreamNumber, streamByteStart, streamByteEnd);
+
+        unsigned bitsPerRecord, bytesPerWord;
+        if (!chan->decoder->recordLayout(bitsPerRecord, bytesPerWord)) {
+            if (streamByteEnd > streamByteStart || recoveryIndex_->isResyncGap(packetIndex)) {
+                lostStart = min(lostStart, chan->decoder->totalRecordsCompleted());
+                lostEnd   = maxRecordCount_;
+            }
+        } else if (bitsPerRecord > 0 && streamByteEnd > streamByteStart) {
+            uint64_t firstBit = streamByteStart / bytesPerWord * bytesPerWord * 8;
+            uint64_t endBit   = (streamByteEnd + bytesPerWord - 1) / bytesPerWord * bytesPerWord * 8;
+            lostStart = min(lostStart, firstBit / bitsPerRecord);
+            lostEnd   = max(lostEnd, (endBit + bitsPerRecord - 1) / bitsPerRecord);
+        }
+    }
+    lostStart = max(lostStart, readStartRecord_);
+    lostEnd   = min(lostEnd, maxRecordCount_);
+
+    if (lostStart < lostEnd) {
+        /// Channels that already output records of the range take them back, the range starts at this position in the read
+        uint64_t lostBefore = 0;
+        for (map<uint64_t, uint64_t>::iterator it = lostRecords_.begin(); it != lostRecords_.end() && it->first < lostStart; ++it) {
+            if (it->second > readStartRecord_)
+                lostBefore += min(it->second, lostStart) - max(it->first, readStartRecord_);
+        }
+        unsigned outputIndex = static_cast<unsigned>(lostStart - readStartRecord_ - lostBefore);
+
+        for (unsigned i = 0; i < channels_.size(); i++) {
+            DecodeChannel* chan = &channels_[i];
+            if (chan->decoder->totalRecordsCompleted() >= lostStart) {
+                chan->dbuf.impl()->setNextIndex(outputIndex);
+                if (lostEnd < maxRecordCount_)
+                    seekChannel(chan, lostEnd);
+            }
+        }
+
+        /// Add the range, merged with any it overlaps or touches
+        map<uint64_t, uint64_t>::iterator next = lostRecords_.upper_bound(lostEnd);
+        while (next != lostRecords_.begin()) {
+            map<uint64_t, uint64_t>::iterator range = next;
+            --range;
+            if (range->second < lostStart)
+                break;
+            lostStart = min(lostStart, range->first);
+            lostEnd   = max(lostEnd, range->second);
+            lostRecords_.erase(range);
+        }
+        lostRecords_[lostStart] = lostEnd;
+        skipLostRecords();
+    }
+
+    /// Channels still waiting for the packet decode what they have queued up to the lost range, or move on to the next packet
+    /// if none of their records are in it.
+    uint64_t packetLogicalOffset = recoveryIndex_->packetLogicalOffset(packetIndex);
+    uint64_t nextPacketLogicalOffset = recoveryIndex_->packetAtOrAfter(packetLogicalOffset + 1);
+    for (unsigned i = 0; i < channels_.size(); i++) {
+        DecodeChannel* chan = &channels_[i];
+        if (chan->currentPacketLogicalOffset != packetLogicalOffset || chan->isOutputBlocked() || chan->inputFinished)
+            continue;
+        chan->decoder->inputProcess(NULL, 0);
+        if (chan->isOutputBlocked())
+            continue;
+
+        uint64_t streamByteStart, streamByteEnd;
+        recoveryIndex_->bufferRange(packetIndex, chan->bytestreamNumber, streamByteStart, streamByteEnd);
+        if (streamByteEnd > streamByteStart)
+            throw E57_EXCEPTION2(E57_ERROR_INTERNAL, "packetLogicalOffset=" + toString(packetLogicalOffset));
+        if (nextPacketLogicalOffset == E57_UINT64_MAX)
+            chan->inputFinished = true;
+        else {
+            recoveryIndex_->bufferRange(packetIndex + 1, chan->bytestreamNumber, streamByteStart, streamByteEnd);
+            chan->currentPacketLogicalOffset    = nextPacketLogicalOffset;
+            chan->currentBytestreamBufferIndex  = 0;
+            chan->currentBytestreamBufferLength = static_cast<size_t>(streamByteEnd - streamByteStart);
+        }
+    }
+}
+
+void CompressedVectorReaderImpl::skipLostRecords()
+{
+    /// Move channels that have reached a lost range past it, and stop the others at the start of the next one,
+    /// so every channel skips the same records.  A range reaching the end is never left.
+    for (unsigned i = 0; i < channels_.size(); i++) {
+        DecodeChannel* chan = &channels_[i];
+        uint64_t recordNumber = chan->decoder->totalRecordsCompleted();
+        uint64_t limit = maxRecordCount_;
+
+        map<uint64_t, uint64_t>::iterator next = lostRecords_.upper_bound(recordNumber);
+        if (next != lostRecords_.begin()) {
+            map<uint64_t, uint64_t>::iterator range = next;
+            --range;
+            if (recordNumber < range->second) {
+                if (range->second < maxRecordCount_)
+                    seekChannel(chan, range->second);
+                else
+                    limit = recordNumber;
+            }
+        }
+        if (limit == maxRecordCount_ && next != lostRecords_.end())
+            limit = next->first;
+
+        chan->decoder->setRecordLimit(limit);
+        chan->maxRecordCount = limit;
+    }
+}
+
+void CompressedVectorReaderImpl::lostRecords(vector<int64_t>& startRecord, vector<int64_t>& recordCount)
 {
     checkImageFileOpen(__FILE__, __LINE__, __FUNCTION__);
+    checkReaderOpen(__FILE__, __LINE__, __FUNCTION__);
 
-    ///!!! implement
-    throw E57_EXCEPTION1(E57_ERROR_NOT_IMPLEMENTED);
+    startRecord.clear();
+    recordCount.clear();
+    for (map<uint64_t, uint64_t>::iterator it = lostRecords_.begin(); it != lostRecords_.end(); ++it) {
+        startRecord.push_back(static_cast<int64_t>(it->first));
+        recordCount.push_back(static_cast<int64_t>(it->second - it->first));
+    }
 }
 
 bool CompressedVectorReaderImpl::isOpen()
@@ -6683,6 +9467,8 @@ void CompressedVectorReaderImpl::dump(int indent, std::ostream& os)
     os << space(indent) << "recordCount:             " << recordCount_ << endl;
     os << space(indent) << "maxRecordCount:          " << maxRecordCount_ << endl;
     os << space(indent) << "sectionEndLogicalOffset: " << sectionEndLogicalOffset_ << endl;
+    os << space(indent) << "recover:                 " << recover_ << endl;
+    os << space(indent) << "lostRecordRanges:        " << lostRecords_.size() << endl;
 }
 
 //================================================================
@@ -7322,6 +10108,7 @@ BitpackDecoder::BitpackDecoder(unsigned bytestreamNumber, SourceDestBuffer& dbuf
 {
     currentRecordIndex_     = 0;
     maxRecordCount_         = maxRecordCount;
+    recordCount_            = maxRecordCount;
     inBufferFirstBit_       = 0;
     inBufferEndByte_        = 0;
     inBufferAlignmentSize_  = alignmentSize;
@@ -7380,7 +10167,11 @@ size_t BitpackDecoder::inputProcess(const char* source, const size_t availableBy
 #ifdef E57_MAX_VERBOSE
     cout << "  feeding aligned decoder " << endBit - inBufferFirstBit_ << " bits." << endl;
 #endif
-        bitsEaten = inputProcessAligned(&inBuffer_[firstWord * bytesPerWord_], inBufferFirstBit_ - firstNaturalBit, endBit - firstNaturalBit);
+        /// After a seek, the first record may start beyond the bytes that have arrived so far
+        if (endBit > inBufferFirstBit_)
+            bitsEaten = inputProcessAligned(&inBuffer_[firstWord * bytesPerWord_], inBufferFirstBit_ - firstNaturalBit, endBit - firstNaturalBit);
+        else
+            bitsEaten = 0;
 #ifdef E57_MAX_VERBOSE
     cout << "  bitsEaten=" << bitsEaten << " firstWord=" << firstWord << " firstNaturalBit=" << firstNaturalBit << " endBit=" << endBit << endl;
 #endif
@@ -7410,6 +10201,37 @@ void BitpackDecoder::stateReset()
     inBufferEndByte_  = 0;
 }
 
+bool BitpackDecoder::seekRecord(uint64_t recordIndex, uint64_t& streamByte)
+{
+    /// Can only compute where the record is if all records have the same size
+    unsigned bitsPerRecord = recordBits();
+    if (bitsPerRecord == 0)
+        return(false);
+
+    /// Input must start on a word boundary, skip the bits of the word before the record
+    uint64_t firstBit = recordIndex * bitsPerRecord;
+    uint64_t firstWord = firstBit / bitsPerWord_;
+    streamByte = firstWord * bytesPerWord_;
+
+    inBufferEndByte_     = 0;
+    inBufferFirstBit_    = static_cast<size_t>(firstBit - firstWord * bitsPerWord_);
+    currentRecordIndex_  = recordIndex;
+    return(true);
+}
+
+bool BitpackDecoder::recordLayout(unsigned& bitsPerRecord, unsigned& bytesPerWord)
+{
+    bitsPerRecord = recordBits();
+    bytesPerWord  = bytesPerWord_;
+    return(bitsPerRecord != 0);
+}
+
+void BitpackDecoder::setRecordLimit(uint64_t recordLimit)
+{
+    /// Never below the records already output, so the remaining count can't go negative
+    maxRecordCount_ = max(min(recordLimit, recordCount_), currentRecordIndex_);
+}
+
 void BitpackDecoder::inBufferShiftDown()
 {
     /// Move uneaten data down to beginning of inBuffer_.
@@ -7712,6 +10534,7 @@ ConstantIntegerDecoder::ConstantIntegerDecoder(bool isScaledInteger, unsigned by
 {
     currentRecordIndex_ = 0;
     maxRecordCount_     = maxRecordCount;
+    recordCount_        = maxRecordCount;
     isScaledInteger_    = isScaledInteger;
     minimum_            = minimum;
     scale_              = scale;
@@ -7750,6 +10573,26 @@ size_t ConstantIntegerDecoder::inputProcess(const char* source, const size_t ava
     return(count);
 }
 
+bool ConstantIntegerDecoder::seekRecord(uint64_t recordIndex, uint64_t& streamByte)
+{
+    /// Constant values take no space in the bytestream
+    streamByte = 0;
+    currentRecordIndex_ = recordIndex;
+    return(true);
+}
+
+bool ConstantIntegerDecoder::recordLayout(unsigned& bitsPerRecord, unsigned& bytesPerWord)
+{
+    bitsPerRecord = 0;
+    bytesPerWord  = 1;
+    return(true);
+}
+
+void ConstantIntegerDecoder::setRecordLimit(uint64_t recordLimit)
+{
+    maxRecordCount_ = max(min(recordLimit, recordCount_), currentRecordIndex_);
+}
+
 void ConstantIntegerDecoder::stateReset()
 {
 }
@@ -7926,6 +10769,9 @@ void PacketReadCache::readPacket(unsigned oldestEntry, uint64_t packetLogicalOff
     if (packetLength > E57_DATA_PACKET_MAX)
         throw E57_EXCEPTION2(E57_ERROR_BAD_CV_PACKET, "packetLength=" + toString(packetLength));
 
+    /// The buffer is overwritten below, so forget what it held in case the read or verify throws
+    entries_.at(oldestEntry).logicalOffset_ = 0;
+
     /// Now read in whole packet into preallocated buffer_.  Note buffer is
     cFile_->seek(packetLogicalOffset, CheckedFile::logical);
     cFile_->read(entries_.at(oldestEntry).buffer_, packetLength);
@@ -41,7 +41,9 @@
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
-#include <boost/crc.hpp>        // for boost::crc_optimal
+#include <map>
+#include <cstring>
+#include <boost/unordered_map.hpp>
 
 // Define the following symbol adds some functions to the API for implementation purposes.
 // These functions are not available to a normal API user.
@@ -92,7 +94,8 @@
 // Turn off DLL input/export mechanism for Xerces library (usually done by defining in compile command line).
 //#define XERCES_STATIC_LIBRARY 1
 
-// The XML parser headers
+// The XML parser headers (not needed if only using the built-in parser)
+#ifndef E57_NO_XERCES
 #include <xercesc/sax2/SAX2XMLReader.hpp>
 #include <xercesc/sax2/XMLReaderFactory.hpp>
 #include <xercesc/sax2/DefaultHandler.hpp>
@@ -100,6 +103,7 @@
 
 // Use Xerces namespace (the current version defined in Xerces header)
 XERCES_CPP_NAMESPACE_USE
+#endif
 
 namespace e57 {
 
@@ -163,7 +167,9 @@ inline std::string binaryString(int8_t x)  {return(binaryString(static_cast<uint
 template <typename RegisterT> class BitpackIntegerEncoder;
 template <typename RegisterT> class BitpackIntegerDecoder;
 class E57XmlParser;
+class E57XmlWriter;
 class Encoder;
+class SeekIndex;
 
 /// Version numbers of ASTM standard that this library supports
 const uint32_t E57_FORMAT_MAJOR = 1;			//Changed from 0 to 1 by SC
@@ -241,24 +247,20 @@ public:
 
     static size_t   efficientBufferSize(size_t logicalSize);  //??? needed?
 
+    /// Read whole physical pages without verifying their checksums, returns number of pages read (fewer at end of file)
+    size_t          readPhysicalPages(char* buf, uint64_t firstPage, size_t pageCount);
+    static bool     pageChecksumIsGood(const char* pageBuffer);
+
     static inline uint64_t logicalToPhysical(uint64_t logicalOffset);
     static inline uint64_t physicalToLogical(uint64_t physicalOffset);
 private:
-    uint32_t        checksum(char* buf, size_t size);
-template<class FTYPE>
-    CheckedFile&    writeFloatingPoint(FTYPE value, int precision);
+    static uint32_t checksum(const char* buf, size_t size);
+    static uint32_t crc32c(const char* buf, size_t size);
 
     ustring         fileName_;
     int             fd_;
     bool            readOnly_;
     uint64_t        logicalLength_;
-    boost::crc_optimal<32,          // bits
-                       0x1EDC6F41,  // truncated polynomial, iSCSI
-                       0xFFFFFFFF,  // initial remainder
-                       0xFFFFFFFF,  // final xor value
-                       true,        // reflect input
-                       true         // reflect remainder
-                      > crcCalculator_;
 
 #ifdef SAFE_MODE
     void        getCurrentPageAndOffset(uint64_t& page, size_t& pageOffset, OffsetMode omode = logical);
@@ -293,6 +295,46 @@ inline uint64_t CheckedFile::physicalToLogical(uint64_t physicalOffset)
 
 //================================================================
 
+/// Collects XML text in a large memory buffer, which is written to the CheckedFile in bulk.
+/// Writing each small piece straight to the CheckedFile would cost a page read-modify-write every time.
+/// Buffered text is only written by flush(), the destructor discards it.
+class E57XmlWriter {
+public:
+                    E57XmlWriter(CheckedFile* cf, size_t bufferSize = 64*1024);
+
+    E57XmlWriter&   operator<<(const ustring& s)    {append(s.data(), s.length()); return(*this);};
+    E57XmlWriter&   operator<<(const char* s)       {append(s, strlen(s)); return(*this);};
+    E57XmlWriter&   operator<<(int64_t i);
+    E57XmlWriter&   operator<<(uint64_t i);
+    E57XmlWriter&   operator<<(float f);
+    E57XmlWriter&   operator<<(double d);
+    void            flush();
+
+private:
+    inline void     append(const char* s, size_t n);
+
+    CheckedFile*        cf_;
+    std::vector<char>   buffer_;
+    size_t              used_;
+};
+
+inline void E57XmlWriter::append(const char* s, size_t n)
+{
+    if (n > buffer_.size() - used_) {
+        flush();
+
+        /// Don't bother copying anything bigger than the buffer
+        if (n > buffer_.size()) {
+            cf_->write(s, n);
+            return;
+        }
+    }
+    memcpy(&buffer_[used_], s, n);
+    used_ += n;
+}
+
+//================================================================
+
 class NodeImpl : public boost::enable_shared_from_this<NodeImpl> {
 public:
     virtual NodeType        type() = 0;
@@ -321,7 +363,7 @@ public:
     void                    checkBuffers(const std::vector<SourceDestBuffer>& sdbufs, bool allowMissing);
     bool                    findTerminalPosition(boost::shared_ptr<NodeImpl> ni, uint64_t& countFromLeft);
 
-    virtual void            writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL) = 0;
+    virtual void            writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL) = 0;
 
     virtual                 ~NodeImpl() {};
 
@@ -342,6 +384,7 @@ protected: //=================
                                          NodeImpl(boost::weak_ptr<ImageFileImpl> destImageFile);
     NodeImpl&                            operator=(NodeImpl& n);
     virtual boost::shared_ptr<NodeImpl>  lookup(const ustring& /*pathName*/) {return(boost::shared_ptr<NodeImpl>());}; //???
+    virtual boost::shared_ptr<NodeImpl>  lookup(const std::vector<ustring>& /*fields*/, unsigned /*level*/) {return(boost::shared_ptr<NodeImpl>());};
     boost::shared_ptr<NodeImpl>          getRoot();
 
     boost::weak_ptr<ImageFileImpl>       destImageFile_;
@@ -370,7 +413,11 @@ public:
 
     virtual void        checkLeavesInSet(const std::set<ustring>& pathNames, boost::shared_ptr<NodeImpl> origin);
 
-    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL);
+    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL);
+
+    /// Support for "lazyXml" read mode, children are parsed from the given XML section range on first access
+    void                setLazyXmlRange(uint64_t xmlOffset, uint64_t xmlLength);
+    bool                isLazy() {return(lazyXmlLength_ != 0);};
 
 #ifdef E57_DEBUG
     void                dump(int indent = 0, std::ostream& os = std::cout);
@@ -381,9 +428,25 @@ public:
 
 protected: //=================
     friend class CompressedVectorReaderImpl;
+    void                materialize() {if (lazyXmlLength_ != 0) materializeLazy();};
+    void                materializeLazy();
     virtual boost::shared_ptr<NodeImpl> lookup(const ustring& pathName);
+    virtual boost::shared_ptr<NodeImpl> lookup(const std::vector<ustring>& fields, unsigned level);
+    boost::shared_ptr<NodeImpl> findChild(const ustring& elementName);
+    void                        appendChild(boost::shared_ptr<NodeImpl> ni);
+
+    /// Structures with fewer children than this are searched serially, bigger ones get a name index.
+    static const size_t CHILD_INDEX_THRESHOLD = 16;
 
     std::vector<boost::shared_ptr<NodeImpl> > children_;
+
+    /// Map from child elementName to index in children_, built lazily when the structure gets big.
+    /// Children are only ever appended and never renamed, so the index stays valid once built.
+    boost::unordered_map<ustring, size_t>     childIndex_;
+
+    /// Location of this element in the XML section if children haven't been parsed yet, length is 0 otherwise
+    uint64_t            lazyXmlOffset_;
+    uint64_t            lazyXmlLength_;
 };
 
 class VectorNodeImpl : public StructureNodeImpl {
@@ -401,7 +464,7 @@ public:
     //???virtual void   set(const ustring& pathName, boost::shared_ptr<NodeImpl> ni);
     //???virtual void   append(boost::shared_ptr<NodeImpl> ni);
 
-    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL);
+    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL);
 
 #ifdef E57_DEBUG
     void                dump(int indent = 0, std::ostream& os = std::cout);
@@ -447,6 +510,7 @@ public:
     size_t                  capacity()      {return(capacity_);}
     unsigned                nextIndex()     {return(nextIndex_);};
     void                    rewind()        {nextIndex_=0;};
+    void                    setNextIndex(unsigned i) {nextIndex_=i;};
 
     /// Get/set values:
     int64_t         getNextInt64();
@@ -460,6 +524,12 @@ public:
     void            setNextDouble(double value);
     void            setNextString(const ustring& value);
 
+    /// Widen [minimum, maximum] to cover the first count elements (as stored in memory, no scaling)
+    void            accumulateRange(size_t first, size_t count, double& minimum, double& maximum);
+    void            findRuns(size_t count, std::vector<size_t>& runStart, std::vector<int64_t>& runValue);
+    /// Append count elements, from first every step elements, to bytes (packed, as stored in memory) or strings
+    void            copyElements(size_t first, size_t step, size_t count, std::vector<char>& bytes, std::vector<ustring>& strings);
+
     void            checkCompatible(boost::shared_ptr<SourceDestBufferImpl> newBuf);
 
 #ifdef E57_DEBUG
@@ -515,7 +585,7 @@ public:
 
     virtual void        checkLeavesInSet(const std::set<ustring>& pathNames, boost::shared_ptr<NodeImpl> origin);
 
-    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL);
+    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL);
 
     /// Iterator constructors
     boost::shared_ptr<CompressedVectorWriterImpl> writer(std::vector<SourceDestBuffer> sbufs);
@@ -542,6 +612,9 @@ protected: //=================
 //???    bool                            writeCompleted_;
     int64_t                     recordCount_;
     uint64_t                    binarySectionLogicalStart_;
+
+    /// Packet positions for CompressedVectorReaderImpl::seek(), shared by all readers of this node
+    boost::shared_ptr<SeekIndex> seekIndex_;
 };
 
 class IntegerNodeImpl : public NodeImpl {
@@ -559,7 +632,7 @@ public:
 
     virtual void        checkLeavesInSet(const std::set<ustring>& pathNames, boost::shared_ptr<NodeImpl> origin);
 
-    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL);
+    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL);
 
 #ifdef E57_DEBUG
     void                dump(int indent = 0, std::ostream& os = std::cout);
@@ -601,7 +674,7 @@ public:
 
     virtual void        checkLeavesInSet(const std::set<ustring>& pathNames, boost::shared_ptr<NodeImpl> origin);
 
-    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL);
+    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL);
 
 
 #ifdef E57_DEBUG
@@ -637,7 +710,7 @@ public:
 
     virtual void        checkLeavesInSet(const std::set<ustring>& pathNames, boost::shared_ptr<NodeImpl> origin);
 
-    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL);
+    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL);
 
 #ifdef E57_DEBUG
     void                dump(int indent = 0, std::ostream& os = std::cout);
@@ -666,7 +739,7 @@ public:
 
     virtual void        checkLeavesInSet(const std::set<ustring>& pathNames, boost::shared_ptr<NodeImpl> origin);
 
-    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL);
+    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL);
 
 #ifdef E57_DEBUG
     void                dump(int indent = 0, std::ostream& os = std::cout);
@@ -695,7 +768,7 @@ public:
 
     virtual void        checkLeavesInSet(const std::set<ustring>& pathNames, boost::shared_ptr<NodeImpl> origin);
 
-    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, CheckedFile& cf, int indent, const char* forcedFieldName=NULL);
+    virtual void        writeXml(boost::shared_ptr<ImageFileImpl> imf, E57XmlWriter& cf, int indent, const char* forcedFieldName=NULL);
 
 #ifdef E57_DEBUG
     void                dump(int indent = 0, std::ostream& os = std::cout);
@@ -731,6 +804,13 @@ struct E57FileHeader {
 #endif
 };
 
+/// A path name that has been parsed and checked once, so it can be reused for many lookups.
+struct CompiledPathName {
+    ustring                 pathName;
+    bool                    isRelative;
+    std::vector<ustring>    fields;
+};
+
 class ImageFileImpl : public boost::enable_shared_from_this<ImageFileImpl> {
 public:
 					ImageFileImpl();
@@ -766,9 +846,13 @@ public:
     void            pathNameCheckWellFormed(const ustring& pathName);
     void            pathNameParse(const ustring& pathName, bool& isRelative, std::vector<ustring>& fields);
     ustring         pathNameUnparse(bool isRelative, const std::vector<ustring>& fields);
+    boost::shared_ptr<const CompiledPathName> pathNameCompile(const ustring& pathName);
+    boost::shared_ptr<StructureNodeImpl> parseXmlSubtree(uint64_t xmlOffset, uint64_t xmlLength);
 
     unsigned        bitsNeeded(int64_t minimum, int64_t maximum); //??? E57Utility?
     static void     readFileHeader(CheckedFile* file, E57FileHeader& header);
+    static void     checkIntegrity(const ustring& fileName, IntegrityReport& report, size_t maxErrorCount);
+    static void     copyRawXml(const ustring& fileName, std::ostream& os);
     void            incrWriterCount();
     void            decrWriterCount();
     void            incrReaderCount();
@@ -789,6 +873,11 @@ protected: //=================
     friend class CompressedVectorReaderImpl; //??? add file() instead of accessing file_, others friends too
 
     void checkImageFileOpen(const char* srcFileName, int srcLineNumber, const char* srcFunctionName);
+    void configure(const ustring& configuration);
+    void readXmlSection(std::vector<char>& xml);
+    void parseXmlSection(E57XmlParser& parser);
+    void parseXmlBuffer(char* xml, size_t length, E57XmlParser& parser);
+    void parseXmlLazy();
 
     struct NameSpace {
         ustring     prefix;
@@ -809,6 +898,12 @@ protected: //=================
     uint64_t        xmlLogicalOffset_;
     uint64_t        xmlLogicalLength_;
 
+    /// Options from configuration string
+    bool            lazyXml_;
+    bool            xmlValidation_;
+    bool            builtinXml_;
+    bool            recover_;
+
     /// Write file attributes
     uint64_t        unusedLogicalStart_;
 
@@ -817,17 +912,44 @@ protected: //=================
 
     /// Smart pointer to metadata tree
     boost::shared_ptr<StructureNodeImpl> root_;
+
+    /// Cache of recently parsed path names, see pathNameCompile()
+    static const size_t PATH_CACHE_MAX = 1024;
+    std::map<ustring, boost::shared_ptr<const CompiledPathName> > pathCache_;
 };
 
 //================================================================
 
 
+/// Where each bytestream's buffer in each data packet of a CompressedVector binary section starts, counted from the beginning of the bytestream.
+/// Built from the packet headers alone, so a reader can seek to the packet holding any byte of a bytestream without decoding the packets before it.
 class SeekIndex {
 public:
-    ///!!! implement seek
+                SeekIndex() : resyncPacket_(E57_UINT64_MAX) {};
+    void        build(CheckedFile* cf, uint64_t dataLogicalOffset, uint64_t sectionEndLogicalOffset);
+    void        buildTolerant(CheckedFile* cf, uint64_t dataLogicalOffset, uint64_t sectionEndLogicalOffset,
+                              unsigned bytestreamCount, const std::vector<uint64_t>& streamLength);
+    bool        isBuilt() {return(!packetLogicalOffset_.empty());};
+    void        find(unsigned bytestreamNumber, uint64_t streamByte,
+                     uint64_t& packetLogicalOffset, size_t& bufferIndex, size_t& bufferLength);
+
+    /// Packet queries for the recovery read mode, see buildTolerant()
+    size_t      packetCount() {return(packetLogicalOffset_.size());};
+    size_t      packetIndex(uint64_t packetLogicalOffset);
+    uint64_t    packetLogicalOffset(size_t packetIndex) {return(packetLogicalOffset_.at(packetIndex));};
+    uint64_t    packetAtOrAfter(uint64_t logicalOffset);
+    void        bufferRange(size_t packetIndex, unsigned bytestreamNumber, uint64_t& streamByteStart, uint64_t& streamByteEnd);
+    bool        isDamaged(size_t packetIndex) {return(damaged_.at(packetIndex));};
+    void        setDamaged(size_t packetIndex) {damaged_.at(packetIndex) = true;};
+    bool        isResyncGap(size_t packetIndex) {return(packetIndex == resyncPacket_);};
 #ifdef E57_DEBUG
-    void        dump(int /*indent*/ = 0, std::ostream& /*os*/ = std::cout) {/*???*/};
+    void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
+protected: //=================
+    std::vector<uint64_t>               packetLogicalOffset_;   /// logical offset of each data packet
+    std::vector<std::vector<uint64_t> > streamByteStart_;       /// per bytestream, start of its buffer in each data packet, then the bytestream length
+    std::vector<bool>                   damaged_;               /// per data packet, true if its pages or header can't be trusted
+    uint64_t                            resyncPacket_;          /// entry standing for the packets skipped while re-synchronizing, if any
 };
 
 //================================================================
@@ -949,6 +1071,7 @@ public:
     unsigned    read();
     unsigned    read(std::vector<SourceDestBuffer>& dbufs);
     void        seek(uint64_t recordNumber);
+    void        lostRecords(std::vector<int64_t>& startRecord, std::vector<int64_t>& recordCount);
     bool        isOpen();
     boost::shared_ptr<CompressedVectorNodeImpl> compressedVectorNode();
     void        close();
@@ -967,6 +1090,12 @@ protected: //=================
     uint64_t    earliestPacketNeededForInput();
     void        feedPacketToDecoders(uint64_t currentPacketLogicalOffset);
     uint64_t    findNextDataPacket(uint64_t nextPacketLogicalOffset);
+    void        seekChannel(DecodeChannel* chan, uint64_t recordNumber);
+
+    /// Recovery read mode ("recover" ImageFile option)
+    void        feedOrSkipPacket(uint64_t packetLogicalOffset);
+    void        skipDamagedPacket(size_t packetIndex);
+    void        skipLostRecords();
 
     //??? no default ctor, copy, assignment?
 
@@ -979,7 +1108,13 @@ protected: //=================
 
     uint64_t    recordCount_;                   /// number of records written so far
     uint64_t    maxRecordCount_;
+    uint64_t    dataLogicalOffset_;             /// first data packet
     uint64_t    sectionEndLogicalOffset_;
+
+    bool                            recover_;
+    boost::shared_ptr<SeekIndex>    recoveryIndex_;     /// packet map of this reader's bytestreams, built without trusting the checksums
+    std::map<uint64_t, uint64_t>    lostRecords_;       /// disjoint ranges of records skipped so far, start -> end
+    uint64_t                        readStartRecord_;   /// record number of the first record of the current read()
 };
 
 //================================================================
@@ -992,6 +1127,14 @@ public:
     void        write(std::vector<SourceDestBuffer>& sbufs, const size_t requestedRecordCount);
     bool        isOpen();
     boost::shared_ptr<CompressedVectorNodeImpl> compressedVectorNode();
+    bool        sourceRange(const ustring& pathName, double& minimum, double& maximum);
+    void        trackGroups(const ustring& idPathName, const std::vector<ustring>& rangePathNames);
+    bool        sourceGroups(std::vector<int64_t>& idValue, std::vector<int64_t>& startRecord, std::vector<int64_t>& recordCount,
+                             std::vector<double>& minimum, std::vector<double>& maximum);
+    void        trackChunks(int64_t chunkRecordCount, const std::vector<ustring>& rangePathNames);
+    bool        sourceChunks(std::vector<double>& minimum, std::vector<double>& maximum);
+    void        trackSamples(int64_t sampleInterval);
+    bool        sourceSamples(std::vector<SourceDestBuffer>& sbufs);
     void        close();
 
 #ifdef E57_DEBUG
@@ -1005,6 +1148,10 @@ protected: //=================
     void        checkImageFileOpen(const char* srcFileName, int srcLineNumber, const char* srcFunctionName);
     void        checkWriterOpen(const char* srcFileName, int srcLineNumber, const char* srcFunctionName);
     void        setBuffers(std::vector<SourceDestBuffer>& sbufs); //???needed?
+    unsigned    sourceIndex(const ustring& pathName);
+    void        accumulateGroups(size_t recordCount);
+    void        accumulateChunks(size_t recordCount);
+    void        accumulateSamples(size_t recordCount);
     size_t      totalOutputAvailable();
     size_t      currentPacketSize();
     uint64_t    packetWrite();
@@ -1028,6 +1175,29 @@ protected: //=================
     uint64_t                recordCount_;                   /// number of records written so far
     uint64_t                dataPacketsCount_;              /// number of data packets written so far
     uint64_t                indexPacketsCount_;             /// number of index packets written so far
+    std::vector<double>     sourceMinimum_;                 /// smallest value written from each of sbufs_
+    std::vector<double>     sourceMaximum_;                 /// largest value written from each of sbufs_
+
+    /// Runs of records with equal group identifier, see trackGroups()
+    int                     groupIdSource_;                 /// index in sbufs_ of the group identifier, -1 if not tracking
+    std::vector<unsigned>   groupRangeSources_;             /// indexes in sbufs_ of the buffers to keep a range of per group
+    std::vector<int64_t>    groupIdValue_;
+    std::vector<int64_t>    groupStartRecord_;
+    std::vector<int64_t>    groupRecordCount_;
+    std::vector<double>     groupMinimum_;                  /// groupRangeSources_.size() entries per group
+    std::vector<double>     groupMaximum_;
+
+    /// Ranges per chunk of chunkRecordCount_ records, see trackChunks()
+    uint64_t                chunkRecordCount_;              /// 0 if not tracking
+    std::vector<unsigned>   chunkRangeSources_;             /// indexes in sbufs_ of the buffers to keep a range of per chunk
+    std::vector<double>     chunkMinimum_;                  /// chunkRangeSources_.size() entries per chunk
+    std::vector<double>     chunkMaximum_;
+
+    /// Copy of every sampleInterval_-th record, see trackSamples()
+    uint64_t                sampleInterval_;                /// 0 if not tracking
+    size_t                  sampleCount_;                   /// number of records copied
+    std::vector<std::vector<char> >     sampleBytes_;       /// packed elements of each of sbufs_
+    std::vector<std::vector<ustring> >  sampleStrings_;     /// elements of each of sbufs_ holding strings
 };
 
 //================================================================
@@ -1209,6 +1379,9 @@ public:
     virtual uint64_t    totalRecordsCompleted() = 0;
     virtual size_t      inputProcess(const char* source, const size_t count) = 0;
     virtual void        stateReset() = 0;
+    virtual bool        seekRecord(uint64_t recordIndex, uint64_t& streamByte) = 0;
+    virtual bool        recordLayout(unsigned& bitsPerRecord, unsigned& bytesPerWord) = 0;  /// false if records vary in size
+    virtual void        setRecordLimit(uint64_t recordLimit) = 0;  /// stop output before this record, until the next call
     unsigned            bytestreamNumber() {return(bytestreamNumber_);};
 #ifdef E57_DEBUG
     virtual void        dump(int indent = 0, std::ostream& os = std::cout) = 0;
@@ -1235,6 +1408,9 @@ public:
     virtual size_t      inputProcessAligned(const char* inbuf, const size_t firstBit, const size_t endBit) = 0;
 
     virtual void        stateReset();
+    virtual bool        seekRecord(uint64_t recordIndex, uint64_t& streamByte);
+    virtual bool        recordLayout(unsigned& bitsPerRecord, unsigned& bytesPerWord);
+    virtual void        setRecordLimit(uint64_t recordLimit);
 
 #ifdef E57_DEBUG
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
@@ -1243,9 +1419,11 @@ protected: //================
                         BitpackDecoder(unsigned bytestreamNumber, SourceDestBuffer& dbuf, unsigned alignmentSize, uint64_t maxRecordCount);
 
     void                inBufferShiftDown();
+    virtual unsigned    recordBits() = 0;   /// bits used by every record in the bytestream, 0 if records vary in size
 
     uint64_t            currentRecordIndex_;
-    uint64_t            maxRecordCount_;
+    uint64_t            maxRecordCount_;    /// end of output, the record count unless limited by setRecordLimit()
+    uint64_t            recordCount_;
 
     boost::shared_ptr<SourceDestBufferImpl> destBuffer_;
 
@@ -1269,6 +1447,8 @@ public:
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
 protected: //================
+    virtual unsigned    recordBits() {return(bitsPerWord_);};
+
     FloatPrecision      precision_;
 };
 
@@ -1284,6 +1464,8 @@ public:
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
 protected: //================
+    virtual unsigned    recordBits() {return(0);};
+
     bool        readingPrefix_;
     int         prefixLength_;
     uint8_t     prefixBytes_[8];
@@ -1307,6 +1489,8 @@ public:
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
 protected: //================
+    virtual unsigned    recordBits() {return(bitsPerRecord_);};
+
     bool        isScaledInteger_;
     int64_t     minimum_;
     int64_t     maximum_;
@@ -1326,12 +1510,16 @@ public:
     virtual uint64_t    totalRecordsCompleted() {return(currentRecordIndex_);};
     virtual size_t      inputProcess(const char* source, const size_t byteCount);
     virtual void        stateReset();
+    virtual bool        seekRecord(uint64_t recordIndex, uint64_t& streamByte);
+    virtual bool        recordLayout(unsigned& bitsPerRecord, unsigned& bytesPerWord);
+    virtual void        setRecordLimit(uint64_t recordLimit);
 #ifdef E57_DEBUG
     virtual void        dump(int indent = 0, std::ostream& os = std::cout);
 #endif
 protected: //================
     uint64_t            currentRecordIndex_;
-    uint64_t            maxRecordCount_;
+    uint64_t            maxRecordCount_;    /// end of output, the record count unless limited by setRecordLimit()
+    uint64_t            recordCount_;
 
     boost::shared_ptr<SourceDestBufferImpl> destBuffer_;
 
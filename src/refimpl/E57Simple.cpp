@@ -799,6 +799,7 @@ DEALINGS IN THE SOFTWARE.
 #  define _LARGEFILE64_SOURCE
 #  define __LARGE64_FILES
 #  include <sys/types.h>
+#  include <sys/mman.h>
 #  include <unistd.h>
 #elif defined(__APPLE__)
 #  define _LARGEFILE64_SOURCE
@@ -811,6 +812,8 @@ DEALINGS IN THE SOFTWARE.
 #  error "no supported OS platform defined"
 #endif
 
+#include <cstdlib>
+#include <new>
 #include "E57Simple.h"
 #include "E57SimpleImpl.h"
 
@@ -970,6 +973,9 @@ void Data3D::Reset(void)
 	pointGroupingSchemes.groupingByLine.groupsSize = 0;
 	pointGroupingSchemes.groupingByLine.pointCountSize = 0;
 	pointGroupingSchemes.groupingByLine.idElementName = "";
+	pointGroupingSchemes.groupingByLine.generateGroups = false;
+	pointChunkSize = 0;
+	pointPreviewStride = 0;
 
 	pointFields.cartesianXField = false;
 	pointFields.cartesianYField = false;
@@ -1016,6 +1022,122 @@ void Data3D::Reset(void)
 };
 ////////////////////////////////////////////////////////////////////
 //
+//	e57::PointCloud
+//
+namespace {
+	/// Every buffer starts on a cache line, allocations of at least a huge page start on a huge page boundary
+	const size_t	POINT_BUFFER_ALIGNMENT	= 64;
+	const size_t	HUGE_PAGE_SIZE			= 2 * 1024 * 1024;
+
+	size_t	alignUp(size_t n, size_t alignment)
+	{
+		return (n + alignment - 1) & ~(alignment - 1);
+	}
+
+	/// Reserves count elements for buffer at offset, or leaves it NULL if not wanted.
+	/// With base == NULL only the offset is advanced, to size the allocation.
+	template <typename T>
+	void	placeBuffer(T* & buffer, bool wanted, int64_t count, char* base, size_t & offset)
+	{
+		if(!wanted)
+			return;
+		if(base != NULL)
+			buffer = reinterpret_cast<T*>(base + offset);
+		offset = alignUp(offset + (size_t) count * sizeof(T), POINT_BUFFER_ALIGNMENT);
+	}
+
+	void	placeBuffers(PointCloud & cloud, int64_t count, uint32_t mask, char* base, size_t & offset)
+	{
+		offset = 0;
+		placeBuffer(cloud.cartesianX,			(mask & E57_POINT_CARTESIAN) != 0,			count, base, offset);
+		placeBuffer(cloud.cartesianY,			(mask & E57_POINT_CARTESIAN) != 0,			count, base, offset);
+		placeBuffer(cloud.cartesianZ,			(mask & E57_POINT_CARTESIAN) != 0,			count, base, offset);
+		placeBuffer(cloud.cartesianInvalidState,(mask & E57_POINT_CARTESIAN_INVALID) != 0,	count, base, offset);
+		placeBuffer(cloud.sphericalRange,		(mask & E57_POINT_SPHERICAL) != 0,			count, base, offset);
+		placeBuffer(cloud.sphericalAzimuth,		(mask & E57_POINT_SPHERICAL) != 0,			count, base, offset);
+		placeBuffer(cloud.sphericalElevation,	(mask & E57_POINT_SPHERICAL) != 0,			count, base, offset);
+		placeBuffer(cloud.sphericalInvalidState,(mask & E57_POINT_SPHERICAL_INVALID) != 0,	count, base, offset);
+		placeBuffer(cloud.intensity,			(mask & E57_POINT_INTENSITY) != 0,			count, base, offset);
+		placeBuffer(cloud.isIntensityInvalid,	(mask & E57_POINT_INTENSITY_INVALID) != 0,	count, base, offset);
+		placeBuffer(cloud.colorRed,				(mask & E57_POINT_COLOR) != 0,				count, base, offset);
+		placeBuffer(cloud.colorGreen,			(mask & E57_POINT_COLOR) != 0,				count, base, offset);
+		placeBuffer(cloud.colorBlue,			(mask & E57_POINT_COLOR) != 0,				count, base, offset);
+		placeBuffer(cloud.isColorInvalid,		(mask & E57_POINT_COLOR_INVALID) != 0,		count, base, offset);
+		placeBuffer(cloud.rowIndex,				(mask & E57_POINT_ROW_COLUMN) != 0,			count, base, offset);
+		placeBuffer(cloud.columnIndex,			(mask & E57_POINT_ROW_COLUMN) != 0,			count, base, offset);
+		placeBuffer(cloud.returnIndex,			(mask & E57_POINT_RETURN) != 0,				count, base, offset);
+		placeBuffer(cloud.returnCount,			(mask & E57_POINT_RETURN) != 0,				count, base, offset);
+		placeBuffer(cloud.timeStamp,			(mask & E57_POINT_TIMESTAMP) != 0,			count, base, offset);
+		placeBuffer(cloud.isTimeStampInvalid,	(mask & E57_POINT_TIMESTAMP_INVALID) != 0,	count, base, offset);
+	}
+}
+
+	PointCloud::PointCloud(void)
+	: pointCount(0)
+	, fieldsMask(0)
+	, storage_(NULL)
+{
+};
+
+	PointCloud::~PointCloud(void)
+{
+	Reset();
+};
+
+void PointCloud::Reset(void)
+{
+	free(storage_);
+	storage_ = NULL;
+	static_cast<Data3DPointsData &>(*this) = Data3DPointsData();
+	pointCount = 0;
+	fieldsMask = 0;
+};
+
+size_t PointCloud::AllocationSize(
+	int64_t		count,
+	uint32_t	mask)
+{
+	if(count <= 0 || (mask & E57_POINT_ALL) == 0)
+		return 0;
+
+	PointCloud	sizing;
+	size_t		size = 0;
+	placeBuffers(sizing, count, mask, NULL, size);
+	return size + (size >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : POINT_BUFFER_ALIGNMENT);
+};
+
+void PointCloud::Allocate(
+	int64_t		count,
+	uint32_t	mask)
+{
+	Reset();
+	if(count <= 0 || (mask & E57_POINT_ALL) == 0)
+		return;
+
+	size_t	size = 0;
+	placeBuffers(*this, count, mask, NULL, size);
+
+	size_t	alignment = size >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : POINT_BUFFER_ALIGNMENT;
+	storage_ = malloc(size + alignment);
+	if(storage_ == NULL)
+		throw std::bad_alloc();
+
+	char*	base = reinterpret_cast<char*>(alignUp(reinterpret_cast<size_t>(storage_), alignment));
+#if defined(LINUX) && defined(MADV_HUGEPAGE)
+	if(alignment == HUGE_PAGE_SIZE)
+	{
+		/// Only the whole huge pages inside the block, the last one may end past it
+		size_t	usable = reinterpret_cast<char*>(storage_) + size + alignment - base;
+		madvise(base, usable - usable % HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+	}
+#endif
+	placeBuffers(*this, count, mask, base, size);
+
+	pointCount = count;
+	fieldsMask = mask & E57_POINT_ALL;
+};
+////////////////////////////////////////////////////////////////////
+//
 //	e57::Image2D
 //
 	Image2D::Image2D(void)
@@ -1079,8 +1201,8 @@ void Image2D::Reset(void)
 //
 //	e57::Reader
 //
-			Reader :: Reader(const ustring & filePath)
-: impl_(new ReaderImpl(filePath))
+			Reader :: Reader(const ustring & filePath, const ustring & configuration)
+: impl_(new ReaderImpl(filePath, configuration))
 {
 }
 
@@ -1241,6 +1363,170 @@ CompressedVectorReader	Reader :: SetUpData3DPointsData(
 		timeStamp, isTimeStampInvalid, pointDataExtension);
 }
 
+CompressedVectorReader	Reader :: SetUpData3DPointsData(
+	int32_t		dataIndex,			// data block index given by the NewData3D
+	int64_t		pointCount,			// size of each element buffer.
+	const Data3DPointsData_t<double> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
+	) const
+{
+	return impl_->SetUpData3DPointsData( dataIndex, pointCount, buffers, pointDataExtension);
+}
+
+CompressedVectorReader	Reader :: SetUpData3DPointsData(
+	int32_t		dataIndex,			// data block index given by the NewData3D
+	int64_t		pointCount,			// size of each element buffer.
+	const Data3DPointsData_t<float> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
+	) const
+{
+	return impl_->SetUpData3DPointsData( dataIndex, pointCount, buffers, pointDataExtension);
+}
+
+CompressedVectorReader	Reader :: SetUpData3DPointsData(
+	int32_t		dataIndex,			// data block index given by the NewData3D
+	int64_t		pointCount,			// size of each element buffer.
+	const Data3DPointsData_t<int32_t> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
+	) const
+{
+	return impl_->SetUpData3DPointsData( dataIndex, pointCount, buffers, pointDataExtension);
+}
+
+bool		Reader :: LoadData3D(
+	int32_t		dataIndex,		// This in the index into the images3D vector
+	uint32_t	fieldsMask,		// combination of e57::PointFieldsMask values
+	PointCloud &	pointCloud,	// receives the points
+	int			threadCount		// number of threads decoding the fields
+	) const
+{
+	return impl_->LoadData3D( dataIndex, fieldsMask, pointCloud, threadCount);
+}
+
+bool		Reader :: ReadData3DLines(
+	int32_t		dataIndex,		// This in the index into the images3D vector
+	int64_t		firstLine,		// idElementValue of the first line to read
+	int64_t		lineCount,		// number of lines to read
+	const Data3DPointsData & buffers,	// buffers to receive the points
+	int64_t		bufferSize,		// number of elements in each of the buffers
+	int64_t &	pointCount		// receives the number of points stored in the buffers
+	) const
+{
+	return impl_->ReadData3DLines( dataIndex, firstLine, lineCount, buffers, bufferSize, pointCount);
+}
+
+bool		Reader :: ReadData3DWindow(
+	int32_t		dataIndex,		// This in the index into the images3D vector
+	int64_t		firstRow,		// rowIndex of the first row of the window
+	int64_t		rowCount,		// number of rows in the window
+	int64_t		firstColumn,	// columnIndex of the first column of the window
+	int64_t		columnCount,	// number of columns in the window
+	const Data3DPointsData & buffers,	// buffers to receive the points
+	int64_t		bufferSize,		// number of elements in each of the buffers
+	int64_t &	pointCount		// receives the number of points stored in the buffers
+	) const
+{
+	return impl_->ReadData3DWindow( dataIndex, firstRow, rowCount, firstColumn, columnCount, buffers, bufferSize, pointCount);
+}
+
+bool		Reader :: SetPointTransform(
+	bool		applyPose,		// move the points by the pose of their Data3D
+	const RigidBodyTransform * transform	// applied after the pose, NULL for none
+	) const
+{
+	return impl_->SetPointTransform( applyPose, transform);
+}
+
+bool		Reader :: ForEachData3DParallel(
+	uint32_t	fieldsMask,		// combination of e57::PointFieldsMask values
+	const Data3DPointsFunction & function,	// called with the points of each Data3D
+	int			threadCount		// number of Data3D loaded at a time, 0 for the number of hardware threads
+	) const
+{
+	return impl_->ForEachData3DParallel( fieldsMask, function, threadCount);
+}
+
+bool		Reader :: ReadData3DPreview(
+	int32_t		dataIndex,		// This in the index into the images3D vector
+	const Data3DPointsData & buffers,	// buffers to receive the points
+	int64_t		bufferSize,		// number of elements in each of the buffers
+	int64_t &	pointCount		// receives the number of points stored in the buffers
+	) const
+{
+	return impl_->ReadData3DPreview( dataIndex, buffers, bufferSize, pointCount);
+}
+
+bool		Reader :: ReadPointsInBox(
+	int32_t		dataIndex,		// This in the index into the images3D vector
+	const CartesianBounds & box,	// bounds of the points to read, inclusive
+	const Data3DPointsData & buffers,	// buffers to receive the points
+	int64_t		bufferSize,		// number of elements in each of the buffers
+	int64_t &	pointCount		// receives the number of points stored in the buffers
+	) const
+{
+	return impl_->ReadPointsInBox( dataIndex, box, buffers, bufferSize, pointCount);
+}
+
+bool		Reader :: BuildPointChunkIndex(
+	int64_t		chunkSize		// number of points per chunk
+	) const
+{
+	return impl_->BuildPointChunkIndex( chunkSize);
+}
+
+////////////////////////////////////////////////////////////////////
+//
+//	e57::Data3DIterator
+//
+			Data3DIterator :: Data3DIterator(
+	const Reader &	reader,			// open reader, kept open while the iterator lives
+	int32_t		dataIndex,			// This in the index into the images3D vector
+	uint32_t	fieldsMask,			// combination of e57::PointFieldsMask values
+	int64_t		memoryBudget		// bytes the buffers and the decoders may use
+	)
+: impl_(new Data3DIteratorImpl(reader.impl_, dataIndex, fieldsMask, memoryBudget))
+{
+}
+
+			Data3DIterator :: ~Data3DIterator(void)
+{
+}
+
+bool		Data3DIterator :: Next(void)
+{
+	return impl_->Next();
+}
+
+const Data3DPointsData & Data3DIterator :: Points(void) const
+{
+	return impl_->Points();
+}
+
+int64_t		Data3DIterator :: PointCount(void) const
+{
+	return impl_->PointCount();
+}
+
+int64_t		Data3DIterator :: FirstPoint(void) const
+{
+	return impl_->FirstPoint();
+}
+
+int64_t		Data3DIterator :: BatchSize(void) const
+{
+	return impl_->BatchSize();
+}
+
+uint32_t	Data3DIterator :: FieldsMask(void) const
+{
+	return impl_->FieldsMask();
+}
+
+void		Data3DIterator :: Close(void)
+{
+	impl_->Close();
+}
+
 ////////////////////////////////////////////////////////////////////
 //
 //	e57::Writer
@@ -1355,6 +1641,36 @@ CompressedVectorWriter	Writer :: SetUpData3DPointsData(
 			timeStamp, isTimeStampInvalid, pointDataExtension);
 }
 
+CompressedVectorWriter	Writer :: SetUpData3DPointsData(
+	int32_t		dataIndex,			// data block index given by the NewData3D
+	int64_t		pointCount,			// size of each of the buffers given
+	const Data3DPointsData_t<double> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
+	) const
+{
+	return impl_->SetUpData3DPointsData( dataIndex, pointCount, buffers, pointDataExtension);
+}
+
+CompressedVectorWriter	Writer :: SetUpData3DPointsData(
+	int32_t		dataIndex,			// data block index given by the NewData3D
+	int64_t		pointCount,			// size of each of the buffers given
+	const Data3DPointsData_t<float> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
+	) const
+{
+	return impl_->SetUpData3DPointsData( dataIndex, pointCount, buffers, pointDataExtension);
+}
+
+CompressedVectorWriter	Writer :: SetUpData3DPointsData(
+	int32_t		dataIndex,			// data block index given by the NewData3D
+	int64_t		pointCount,			// size of each of the buffers given
+	const Data3DPointsData_t<int32_t> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
+	) const
+{
+	return impl_->SetUpData3DPointsData( dataIndex, pointCount, buffers, pointDataExtension);
+}
+
 bool		Writer :: WriteData3DGroupsData(
 	int32_t		dataIndex,			// data block index given by the NewData3D
 	int32_t		groupCount,			//!< size of each of the buffers given
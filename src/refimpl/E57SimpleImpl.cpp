@@ -91,6 +91,14 @@
 #endif
 
 #include <sstream>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include <cstring>
 #include "E57SimpleImpl.h"
 #include "time_conversion.h"
 
@@ -98,6 +106,734 @@ using namespace e57;
 using namespace std;
 //using namespace boost;
 
+namespace {
+/// Raw int32_t point buffers (Data3DPointsRawData) transfer ScaledInteger values without the scale and offset
+template <typename COORDTYPE> inline bool doScaling(const COORDTYPE*)	{return true;}
+template <> inline bool doScaling<int32_t>(const int32_t*)				{return false;}
+
+/// Appends the buffers of the non-NULL fields that are defined in the points prototype to destBuffers
+template <typename COORDTYPE>
+void	appendPointBuffers(
+	ImageFile	imf,
+	StructureNode	proto,
+	const Data3DPointsData_t<COORDTYPE> & buffers,
+	int64_t		count,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers),
+	vector<SourceDestBuffer> & destBuffers
+	)
+{
+	int64_t protoCount = proto.childCount();
+	int64_t protoIndex;
+
+	for( protoIndex = 0; protoIndex < protoCount; protoIndex++)
+	{
+		ustring		name = proto.get(protoIndex).elementName();
+		NodeType	type = proto.get(protoIndex).type();
+		bool		scaled = type == E57_SCALED_INTEGER ? true : false;
+		bool		coordScaled = scaled && doScaling(buffers.cartesianX);
+
+		if((name.compare("cartesianX") == 0) && proto.isDefined("cartesianX") && (buffers.cartesianX != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "cartesianX",
+				buffers.cartesianX,  (unsigned) count, true, coordScaled));
+		else if((name.compare("cartesianY") == 0) && proto.isDefined("cartesianY") && (buffers.cartesianY != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "cartesianY",
+				buffers.cartesianY,  (unsigned) count, true,coordScaled));
+		else if((name.compare("cartesianZ") == 0) && proto.isDefined("cartesianZ") && (buffers.cartesianZ != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "cartesianZ",
+				buffers.cartesianZ,  (unsigned) count, true, coordScaled));
+		else if((name.compare("cartesianInvalidState") == 0) && proto.isDefined("cartesianInvalidState") && (buffers.cartesianInvalidState != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "cartesianInvalidState",
+				buffers.cartesianInvalidState,       (unsigned) count, true));
+
+		else if((name.compare("sphericalRange") == 0) && proto.isDefined("sphericalRange") && (buffers.sphericalRange != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "sphericalRange",
+				buffers.sphericalRange,  (unsigned) count, true, coordScaled));
+		else if((name.compare("sphericalAzimuth") == 0) && proto.isDefined("sphericalAzimuth") && (buffers.sphericalAzimuth != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "sphericalAzimuth",
+				buffers.sphericalAzimuth,  (unsigned) count, true, coordScaled));
+		else if((name.compare("sphericalElevation") == 0) && proto.isDefined("sphericalElevation") && (buffers.sphericalElevation != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "sphericalElevation",
+				buffers.sphericalElevation,  (unsigned) count, true, coordScaled));
+		else if((name.compare("sphericalInvalidState") == 0) && proto.isDefined("sphericalInvalidState") && (buffers.sphericalInvalidState != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "sphericalInvalidState",
+				buffers.sphericalInvalidState,       (unsigned) count, true));
+
+		else if((name.compare("rowIndex") == 0) && proto.isDefined("rowIndex") && (buffers.rowIndex != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "rowIndex",
+				buffers.rowIndex,    (unsigned) count, true));
+		else if((name.compare("columnIndex") == 0) && proto.isDefined("columnIndex") && (buffers.columnIndex != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "columnIndex",
+				buffers.columnIndex, (unsigned) count, true));
+		else if((name.compare("returnIndex") == 0) && proto.isDefined("returnIndex") && (buffers.returnIndex != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "returnIndex",
+				buffers.returnIndex, (unsigned) count, true));
+		else if((name.compare("returnCount") == 0) && proto.isDefined("returnCount") && (buffers.returnCount != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "returnCount",
+				buffers.returnCount, (unsigned) count, true));
+
+		else if((name.compare("timeStamp") == 0) && proto.isDefined("timeStamp") && (buffers.timeStamp != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "timeStamp",
+				buffers.timeStamp,   (unsigned) count, true, coordScaled));
+		else if((name.compare("isTimeStampInvalid") == 0) && proto.isDefined("isTimeStampInvalid") && (buffers.isTimeStampInvalid != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "isTimeStampInvalid",
+				buffers.isTimeStampInvalid,(unsigned) count, true));
+
+		else if((name.compare("intensity") == 0) && proto.isDefined("intensity") && (buffers.intensity != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "intensity",   buffers.intensity,
+				(unsigned) count, true, coordScaled));
+		else if((name.compare("isIntensityInvalid") == 0) && proto.isDefined("isIntensityInvalid") && (buffers.isIntensityInvalid != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "isIntensityInvalid",
+				buffers.isIntensityInvalid,(unsigned) count, true));
+
+		else if((name.compare("colorRed") == 0) && proto.isDefined("colorRed") && (buffers.colorRed != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "colorRed",
+				buffers.colorRed,    (unsigned) count, true, scaled));
+		else if((name.compare("colorGreen") == 0) && proto.isDefined("colorGreen") && (buffers.colorGreen != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "colorGreen",
+				buffers.colorGreen,  (unsigned) count, true, scaled));
+		else if((name.compare("colorBlue") == 0) && proto.isDefined("colorBlue") && (buffers.colorBlue != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "colorBlue",
+				buffers.colorBlue,   (unsigned) count, true, scaled));
+		else if((name.compare("isColorInvalid") == 0) && proto.isDefined("isColorInvalid") && (buffers.isColorInvalid != NULL))
+			destBuffers.push_back(SourceDestBuffer(imf, "isColorInvalid",
+				buffers.isColorInvalid, (unsigned) count, true));
+		else if(pointDataExtension != NULL)
+			(*pointDataExtension)(imf,proto,(int) protoIndex,destBuffers);
+	}
+};
+
+/// The value a point field gives back when read, for a value written from a buffer:
+/// ScaledInteger values are rounded to the scale, single precision values to float
+double	storedValue(
+	Node		field,
+	bool		rawValues,		//!< the buffer held unscaled ScaledInteger values
+	double		value
+	)
+{
+	if(field.type() == E57_SCALED_INTEGER)
+	{
+		ScaledIntegerNode	scaled(field);
+		double	rawValue = rawValues ? value : floor((value - scaled.offset())/scaled.scale() + 0.5);
+		return rawValue * scaled.scale() + scaled.offset();
+	}
+	if((field.type() == E57_FLOAT) && (FloatNode(field).precision() == E57_SINGLE))
+		return (float) value;
+	return value;
+}
+
+/// Gets the range of the values written to a point field, in the units of the field
+bool	writtenRange(
+	CompressedVectorWriter	writer,
+	StructureNode			proto,
+	const char*				name,
+	bool					rawValues,		//!< the buffer held unscaled ScaledInteger values
+	double &				minimum,
+	double &				maximum
+	)
+{
+	if(!proto.isDefined(name) || !writer.sourceRange(name, minimum, maximum))
+		return false;
+
+	minimum = storedValue(proto.get(name), rawValues, minimum);
+	maximum = storedValue(proto.get(name), rawValues, maximum);
+	return true;
+}
+
+/// Records per CompressedVectorReader::read() when loading a whole Data3D
+const int64_t	LOAD_BLOCK_POINTS = 1024*1024;
+
+/// Calls visit(member, elementName, fieldsMask group) for every buffer of a Data3DPointsData,
+/// the most expensive fields to decode first
+template <typename VISITOR>
+void	visitPointBuffers(VISITOR & visit)
+{
+	visit(&Data3DPointsData::cartesianX,			"cartesianX",				E57_POINT_CARTESIAN);
+	visit(&Data3DPointsData::cartesianY,			"cartesianY",				E57_POINT_CARTESIAN);
+	visit(&Data3DPointsData::cartesianZ,			"cartesianZ",				E57_POINT_CARTESIAN);
+	visit(&Data3DPointsData::sphericalRange,		"sphericalRange",			E57_POINT_SPHERICAL);
+	visit(&Data3DPointsData::sphericalAzimuth,		"sphericalAzimuth",			E57_POINT_SPHERICAL);
+	visit(&Data3DPointsData::sphericalElevation,	"sphericalElevation",		E57_POINT_SPHERICAL);
+	visit(&Data3DPointsData::timeStamp,				"timeStamp",				E57_POINT_TIMESTAMP);
+	visit(&Data3DPointsData::intensity,				"intensity",				E57_POINT_INTENSITY);
+	visit(&Data3DPointsData::colorRed,				"colorRed",					E57_POINT_COLOR);
+	visit(&Data3DPointsData::colorGreen,			"colorGreen",				E57_POINT_COLOR);
+	visit(&Data3DPointsData::colorBlue,				"colorBlue",				E57_POINT_COLOR);
+	visit(&Data3DPointsData::rowIndex,				"rowIndex",					E57_POINT_ROW_COLUMN);
+	visit(&Data3DPointsData::columnIndex,			"columnIndex",				E57_POINT_ROW_COLUMN);
+	visit(&Data3DPointsData::returnIndex,			"returnIndex",				E57_POINT_RETURN);
+	visit(&Data3DPointsData::returnCount,			"returnCount",				E57_POINT_RETURN);
+	visit(&Data3DPointsData::cartesianInvalidState,	"cartesianInvalidState",	E57_POINT_CARTESIAN_INVALID);
+	visit(&Data3DPointsData::sphericalInvalidState,	"sphericalInvalidState",	E57_POINT_SPHERICAL_INVALID);
+	visit(&Data3DPointsData::isIntensityInvalid,	"isIntensityInvalid",		E57_POINT_INTENSITY_INVALID);
+	visit(&Data3DPointsData::isColorInvalid,		"isColorInvalid",			E57_POINT_COLOR_INVALID);
+	visit(&Data3DPointsData::isTimeStampInvalid,	"isTimeStampInvalid",		E57_POINT_TIMESTAMP_INVALID);
+}
+
+/// Collects the fieldsMask groups that have at least one field in the prototype
+struct DefinedPointFields {
+	StructureNode	proto;
+	uint32_t		mask;
+
+	DefinedPointFields(StructureNode p) : proto(p), mask(0) {}
+	template <typename T>
+	void operator()(T* Data3DPointsData::*, const char* name, uint32_t group)
+	{
+		if(proto.isDefined(name))
+			mask |= group;
+	}
+};
+
+/// Counts the fields of the fieldsMask groups that are in the prototype, and the bytes a point of them takes
+struct PointFieldBytes {
+	StructureNode	proto;
+	uint32_t		mask;
+	int64_t			fields;
+	int64_t			bytes;
+
+	PointFieldBytes(StructureNode p, uint32_t m) : proto(p), mask(m), fields(0), bytes(0) {}
+	template <typename T>
+	void operator()(T* Data3DPointsData::*, const char* name, uint32_t group)
+	{
+		if((mask & group) && proto.isDefined(name))
+		{
+			fields++;
+			bytes += sizeof(T);
+		}
+	}
+};
+
+/// Memory a CompressedVectorReader uses besides the caller's buffers:
+/// a cache of four data packets of up to 64 KiB, and an input buffer per field
+const int64_t	READER_PACKET_CACHE_BYTES	= 4 * 64 * 1024;
+const int64_t	READER_CHANNEL_BYTES		= 1024;
+
+/// Drops the buffers of fields that are not in the prototype
+struct ClearUndefinedPointFields {
+	StructureNode		proto;
+	Data3DPointsData &	buffers;
+
+	ClearUndefinedPointFields(StructureNode p, Data3DPointsData & b) : proto(p), buffers(b) {}
+	template <typename T>
+	void operator()(T* Data3DPointsData::* field, const char* name, uint32_t)
+	{
+		if(!proto.isDefined(name))
+			buffers.*field = NULL;
+	}
+};
+
+/// Advances every buffer by offset elements
+struct OffsetPointBuffers {
+	Data3DPointsData &	buffers;
+	int64_t				offset;
+
+	OffsetPointBuffers(Data3DPointsData & b, int64_t o) : buffers(b), offset(o) {}
+	template <typename T>
+	void operator()(T* Data3DPointsData::* field, const char*, uint32_t)
+	{
+		if(buffers.*field != NULL)
+			buffers.*field += offset;
+	}
+};
+
+/// Deals the buffers out round robin to the parts, one part per decoding thread
+struct SplitPointBuffers {
+	const Data3DPointsData &	all;
+	vector<Data3DPointsData> &	parts;
+	size_t						used;
+	uint32_t					together;		/// groups whose fields all go to the same part
+	size_t						togetherPart;
+
+	SplitPointBuffers(const Data3DPointsData & a, vector<Data3DPointsData> & p, uint32_t t = 0)
+		: all(a), parts(p), used(0), together(t), togetherPart(p.size()) {}
+	template <typename T>
+	void operator()(T* Data3DPointsData::* field, const char*, uint32_t group)
+	{
+		if(all.*field == NULL)
+			return;
+		if(!(group & together))
+			parts[used++ % parts.size()].*field = all.*field;
+		else
+		{
+			if(togetherPart == parts.size())
+				togetherPart = used++ % parts.size();
+			parts[togetherPart].*field = all.*field;
+		}
+	}
+};
+
+/// Collects the fieldsMask groups that have at least one non-NULL buffer
+struct PresentPointFields {
+	const Data3DPointsData &	buffers;
+	uint32_t					mask;
+
+	PresentPointFields(const Data3DPointsData & b) : buffers(b), mask(0) {}
+	template <typename T>
+	void operator()(T* Data3DPointsData::* field, const char*, uint32_t group)
+	{
+		if(buffers.*field != NULL)
+			mask |= group;
+	}
+};
+
+/// Drops the buffers of fields that have no buffer in the model
+struct MatchPointFields {
+	const Data3DPointsData &	model;
+	Data3DPointsData &			buffers;
+
+	MatchPointFields(const Data3DPointsData & m, Data3DPointsData & b) : model(m), buffers(b) {}
+	template <typename T>
+	void operator()(T* Data3DPointsData::* field, const char*, uint32_t)
+	{
+		if(model.*field == NULL)
+			buffers.*field = NULL;
+	}
+};
+
+/// Copies the elements keep[0], keep[1], ... of every source buffer to the front of the destination buffer
+struct CopyKeptPointBuffers {
+	const Data3DPointsData &	source;
+	const Data3DPointsData &	destination;
+	const vector<int64_t> &		keep;
+	size_t						count;		/// number of elements of keep to copy
+
+	CopyKeptPointBuffers(const Data3DPointsData & s, const Data3DPointsData & d, const vector<int64_t> & k, size_t c)
+	: source(s), destination(d), keep(k), count(c) {}
+	template <typename T>
+	void operator()(T* Data3DPointsData::* field, const char*, uint32_t)
+	{
+		const T*	from = source.*field;
+		T*			to = destination.*field;
+		if((from != NULL) && (to != NULL))
+			for(size_t i = 0; i < count; i++)
+				to[i] = from[keep[i]];
+	}
+};
+
+/// Records per CompressedVectorReader::read() when filtering records
+const int64_t	FILTER_BLOCK_POINTS = 64*1024;
+
+/// Reads ranges of records one after the other into buffers of bufferSize elements, seeking to each range.
+/// The records of a range can be filtered: they are read in blocks into a scratch PointCloud,
+/// and only the ones kept are copied to the buffers.
+class RecordRangeReader {
+public:
+	/// Tells whether to keep record i of the block of records just read
+	typedef std::function<bool(const Data3DPointsData & block, unsigned i)>	Filter;
+
+	int64_t		written;		/// number of records stored in the buffers
+
+	RecordRangeReader(ImageFile imf, CompressedVectorNode points, const Data3DPointsData & buffers, int64_t bufferSize)
+	: written(0), imf_(imf), proto_(points.prototype()), buffers_(buffers), bufferSize_(bufferSize)
+	{
+		appendPointBuffers(imf_, proto_, buffers_, bufferSize_, NULL, destBuffers_);
+		if(!destBuffers_.empty() && (bufferSize_ > 0))
+			reader_.reset(new CompressedVectorReader(points.reader(destBuffers_)));
+	}
+
+	bool	isOpen() const
+	{
+		return reader_ && reader_->isOpen();
+	}
+
+	/// Reads count records from first after the records already stored, false if the buffers run out of room
+	bool	read(int64_t first, int64_t count, const Filter & keep)
+	{
+		reader_->seek(first);
+		while(count > 0)
+		{
+			int64_t	room = bufferSize_ - written;
+			if(room <= 0)
+				return false;
+
+			Data3DPointsData	tail = buffers_;
+			OffsetPointBuffers	offset(tail, written);
+			visitPointBuffers(offset);
+
+			destBuffers_.clear();
+			if(!keep)
+			{
+				appendPointBuffers(imf_, proto_, tail, std::min(count, room), NULL, destBuffers_);
+				unsigned got = reader_->read(destBuffers_);
+				if(got == 0)
+					return false;
+				count -= got;
+				written += got;
+				continue;
+			}
+
+			if(scratch_.pointCount == 0)
+			{
+				PresentPointFields	present(buffers_);
+				visitPointBuffers(present);
+				scratch_.Allocate(FILTER_BLOCK_POINTS, present.mask);
+				MatchPointFields	match(buffers_, scratch_);
+				visitPointBuffers(match);
+			}
+			appendPointBuffers(imf_, proto_, scratch_, std::min(count, scratch_.pointCount), NULL, destBuffers_);
+			unsigned got = reader_->read(destBuffers_);
+			if(got == 0)
+				return false;
+			count -= got;
+
+			kept_.clear();
+			for(unsigned i = 0; i < got; i++)
+				if(keep(scratch_, i))
+					kept_.push_back(i);
+
+			size_t					copied = (size_t) std::min((int64_t) kept_.size(), room);
+			CopyKeptPointBuffers	copy(scratch_, tail, kept_, copied);
+			visitPointBuffers(copy);
+			written += copied;
+			if(copied < kept_.size())
+				return false;
+		}
+		return true;
+	}
+
+	void	close()
+	{
+		if(isOpen())
+			reader_->close();
+	}
+
+private:
+	ImageFile					imf_;
+	StructureNode				proto_;
+	Data3DPointsData			buffers_;
+	int64_t						bufferSize_;
+	PointCloud					scratch_;		/// filtered records are read here first
+	vector<SourceDestBuffer>	destBuffers_;
+	vector<int64_t>				kept_;
+	boost::shared_ptr<CompressedVectorReader>	reader_;
+};
+
+/// The libe57 extension element under /data3D/N with the cartesianBounds of every chunk of points
+const char*	POINT_CHUNKS_ELEMENT = E57_LIBE57_PREFIX ":pointChunks";
+
+/// Added to the file path to get the default path of a point chunk index file
+const char*	POINT_CHUNKS_FILE_SUFFIX = ".chunks";
+
+/// The libe57 extension element under /data3D/N with every pointStride-th point, in a "points" CompressedVector
+const char*	POINT_PREVIEW_ELEMENT = E57_LIBE57_PREFIX ":preview";
+
+/// Names of the cartesianBounds fields of a chunk or line group record, in the order of the bounds vectors
+const char*	CARTESIAN_BOUNDS_NAMES[6] = {"cartesianBounds/xMinimum", "cartesianBounds/xMaximum",
+										"cartesianBounds/yMinimum", "cartesianBounds/yMaximum",
+										"cartesianBounds/zMinimum", "cartesianBounds/zMaximum"};
+
+/// Registers the libe57 extension namespace of a file being written, once
+void	addLibe57Extension(ImageFile imf)
+{
+	ustring	uri;
+	if(!imf.extensionsLookupPrefix(E57_LIBE57_PREFIX, uri))
+		imf.extensionsAdd(E57_LIBE57_PREFIX, E57_LIBE57_URI);
+}
+
+/// Makes a copy of a prototype, for another CompressedVector of the same records
+Node	copyPrototype(
+	ImageFile	imf,
+	Node		node
+	)
+{
+	switch(node.type())
+	{
+	case E57_STRUCTURE:
+		{
+			StructureNode	from(node), to(imf);
+			for(int64_t i = 0; i < from.childCount(); i++)
+				to.set(from.get(i).elementName(), copyPrototype(imf, from.get(i)));
+			return to;
+		}
+	case E57_VECTOR:
+		{
+			VectorNode		from(node), to(imf, from.allowHeteroChildren());
+			for(int64_t i = 0; i < from.childCount(); i++)
+				to.append(copyPrototype(imf, from.get(i)));
+			return to;
+		}
+	case E57_INTEGER:
+		{
+			IntegerNode		from(node);
+			return IntegerNode(imf, from.value(), from.minimum(), from.maximum());
+		}
+	case E57_SCALED_INTEGER:
+		{
+			ScaledIntegerNode	from(node);
+			return ScaledIntegerNode(imf, from.rawValue(), from.minimum(), from.maximum(), from.scale(), from.offset());
+		}
+	case E57_FLOAT:
+		{
+			FloatNode		from(node);
+			return FloatNode(imf, from.value(), from.precision(), from.minimum(), from.maximum());
+		}
+	case E57_STRING:
+		return StringNode(imf, StringNode(node).value());
+	default:
+		return node;	// not allowed in a prototype, rejected by the CompressedVectorNode
+	}
+}
+
+/// Makes an empty CompressedVector of point chunk records, laid out like a LineGroupRecord without the idElementValue
+CompressedVectorNode	newPointChunks(
+	ImageFile	imf,
+	int64_t		pointsSize,
+	int64_t		chunkSize
+	)
+{
+	StructureNode	proto(imf);
+	proto.set("startPointIndex",	IntegerNode(imf, 0, 0, std::max(pointsSize - 1, (int64_t) 0)));
+	proto.set("pointCount",			IntegerNode(imf, 0, 0, chunkSize));
+
+	StructureNode	bbox(imf);
+	bbox.set("xMinimum", FloatNode(imf, 0., E57_DOUBLE));
+	bbox.set("xMaximum", FloatNode(imf, 0., E57_DOUBLE));
+	bbox.set("yMinimum", FloatNode(imf, 0., E57_DOUBLE));
+	bbox.set("yMaximum", FloatNode(imf, 0., E57_DOUBLE));
+	bbox.set("zMinimum", FloatNode(imf, 0., E57_DOUBLE));
+	bbox.set("zMaximum", FloatNode(imf, 0., E57_DOUBLE));
+	proto.set("cartesianBounds", bbox);
+
+	return CompressedVectorNode(imf, proto, VectorNode(imf, true));
+}
+
+/// Writes the point chunk records, chunk k starts at point k*chunkSize.
+/// bounds holds the six bounds of every chunk, one vector after the other.
+void	writePointChunks(
+	ImageFile	imf,
+	CompressedVectorNode	chunks,
+	int64_t		pointCount,
+	int64_t		chunkSize,
+	vector<double> & bounds
+	)
+{
+	size_t	chunkCount = bounds.size() / 6;
+	if(chunkCount == 0)
+		return;
+
+	vector<int64_t>	startPointIndex(chunkCount);
+	vector<int64_t>	chunkPointCount(chunkCount);
+	for(size_t k = 0; k < chunkCount; k++)
+	{
+		startPointIndex[k] = (int64_t) k * chunkSize;
+		chunkPointCount[k] = std::min(chunkSize, pointCount - startPointIndex[k]);
+	}
+
+	vector<SourceDestBuffer> sourceBuffers;
+	sourceBuffers.push_back(SourceDestBuffer(imf, "startPointIndex", &startPointIndex[0], chunkCount, true));
+	sourceBuffers.push_back(SourceDestBuffer(imf, "pointCount",      &chunkPointCount[0], chunkCount, true));
+	for(int bound = 0; bound < 6; bound++)
+		sourceBuffers.push_back(SourceDestBuffer(imf, CARTESIAN_BOUNDS_NAMES[bound], &bounds[bound*chunkCount], chunkCount, true));
+
+	CompressedVectorWriter writer = chunks.writer(sourceBuffers);
+	writer.write(chunkCount);
+	writer.close();
+}
+
+/// Reads records with a startPointIndex, pointCount and cartesianBounds: point chunks or line groups.
+/// Returns false if the records don't have these fields.
+bool	readPointChunks(
+	ImageFile	imf,
+	CompressedVectorNode	chunks,
+	vector<int64_t> & startPointIndex,
+	vector<int64_t> & pointCount,
+	vector<double> & bounds
+	)
+{
+	StructureNode	proto(chunks.prototype());
+	if(!proto.isDefined("startPointIndex") || !proto.isDefined("pointCount"))
+		return false;
+	for(int bound = 0; bound < 6; bound++)
+		if(!proto.isDefined(CARTESIAN_BOUNDS_NAMES[bound]))
+			return false;
+
+	size_t	chunkCount = (size_t) chunks.childCount();
+	startPointIndex.resize(chunkCount);
+	pointCount.resize(chunkCount);
+	bounds.resize(6*chunkCount);
+	if(chunkCount == 0)
+		return true;
+
+	vector<SourceDestBuffer> destBuffers;
+	destBuffers.push_back(SourceDestBuffer(imf, "startPointIndex", &startPointIndex[0], chunkCount, true));
+	destBuffers.push_back(SourceDestBuffer(imf, "pointCount",      &pointCount[0],      chunkCount, true));
+	for(int bound = 0; bound < 6; bound++)
+		destBuffers.push_back(SourceDestBuffer(imf, CARTESIAN_BOUNDS_NAMES[bound], &bounds[bound*chunkCount], chunkCount, true));
+
+	CompressedVectorReader reader = chunks.reader(destBuffers);
+	reader.read();
+	reader.close();
+	return true;
+}
+
+/// True if the chunk records follow each other from the first point and cover exactly total points
+bool	chunksCoverPoints(
+	const vector<int64_t> & startPointIndex,
+	const vector<int64_t> & pointCount,
+	int64_t		total
+	)
+{
+	int64_t	next = 0;
+	for(size_t k = 0; k < startPointIndex.size(); k++)
+	{
+		if((startPointIndex[k] != next) || (pointCount[k] < 0) || (pointCount[k] > total - next))
+			return false;
+		next += pointCount[k];
+	}
+	return next == total;
+}
+
+/// Turns per record range x, y, z ranges, as kept by the CompressedVectorWriter in the units of the buffers
+/// written, into the six bounds vectors of the records, in the values read back
+void	splitBounds(
+	StructureNode	proto,			//!< points prototype
+	bool			rawValues,		//!< the buffers held unscaled ScaledInteger values
+	const vector<double> & minimum,
+	const vector<double> & maximum,
+	vector<double> & bounds
+	)
+{
+	const char*	axisNames[3] = {"cartesianX", "cartesianY", "cartesianZ"};
+	size_t		count = minimum.size() / 3;
+
+	bounds.resize(6*count);
+	for(int axis = 0; axis < 3; axis++)
+	{
+		Node	field(proto.get(axisNames[axis]));
+		for(size_t i = 0; i < count; i++)
+		{
+			bounds[(2*axis)*count + i] = storedValue(field, rawValues, minimum[3*i + axis]);
+			bounds[(2*axis + 1)*count + i] = storedValue(field, rawValues, maximum[3*i + axis]);
+		}
+	}
+}
+
+/// Sets matrix to the 3x4 matrix of a rigid body transform, rotation in the first three columns, translation in the last
+void	rigidBodyMatrix(
+	const RigidBodyTransform & transform,
+	double		matrix[3][4]
+	)
+{
+	/// The quaternion is meant to be a unit quaternion, dividing by its norm keeps rounding out of the rotation
+	const Quaternion & q = transform.rotation;
+	double	norm = q.w*q.w + q.x*q.x + q.y*q.y + q.z*q.z;
+	double	s = (norm > 0.) ? 2. / norm : 0.;
+
+	matrix[0][0] = 1. - s*(q.y*q.y + q.z*q.z);
+	matrix[0][1] = s*(q.x*q.y - q.w*q.z);
+	matrix[0][2] = s*(q.x*q.z + q.w*q.y);
+	matrix[1][0] = s*(q.x*q.y + q.w*q.z);
+	matrix[1][1] = 1. - s*(q.x*q.x + q.z*q.z);
+	matrix[1][2] = s*(q.y*q.z - q.w*q.x);
+	matrix[2][0] = s*(q.x*q.z - q.w*q.y);
+	matrix[2][1] = s*(q.y*q.z + q.w*q.x);
+	matrix[2][2] = 1. - s*(q.x*q.x + q.y*q.y);
+
+	matrix[0][3] = transform.translation.x;
+	matrix[1][3] = transform.translation.y;
+	matrix[2][3] = transform.translation.z;
+}
+
+/// Allocates the buffers of the fieldsMask groups that the Data3D points have, for all its records.
+/// Returns the number of records.
+/// The cartesian buffers are kept when the transform computes them from the spherical coordinates.
+int64_t	allocatePointCloud(
+	ImageFile	imf,
+	int32_t		dataIndex,
+	uint32_t	fieldsMask,
+	const PointTransform & transform,
+	PointCloud & pointCloud
+	)
+{
+	VectorNode				data3D(imf.root().get("/data3D"));
+	StructureNode			scan(data3D.get(dataIndex));
+	CompressedVectorNode	points(scan.get("points"));
+	StructureNode			proto(points.prototype());
+	int64_t					pointCount = points.childCount();
+
+	DefinedPointFields		defined(proto);
+	visitPointBuffers(defined);
+	if(transform.FromSpherical())
+		defined.mask |= E57_POINT_CARTESIAN;
+	pointCloud.Allocate(pointCount, fieldsMask & defined.mask);
+
+	Data3DPointsData			cartesian = pointCloud;
+	ClearUndefinedPointFields	clear(proto, pointCloud);
+	visitPointBuffers(clear);
+	if(transform.FromSpherical())
+	{
+		pointCloud.cartesianX = cartesian.cartesianX;
+		pointCloud.cartesianY = cartesian.cartesianY;
+		pointCloud.cartesianZ = cartesian.cartesianZ;
+	}
+	return pointCount;
+}
+
+/// Reads all the records of the Data3D points into buffers, in blocks of LOAD_BLOCK_POINTS records,
+/// transforming each block while it is still in cache.
+/// Returns the number of records read.
+int64_t	readPointsInBlocks(
+	ImageFile	imf,
+	int32_t		dataIndex,
+	const Data3DPointsData & buffers,
+	int64_t		pointCount,
+	const PointTransform & transform = PointTransform()
+	)
+{
+	VectorNode				data3D(imf.root().get("/data3D"));
+	StructureNode			scan(data3D.get(dataIndex));
+	CompressedVectorNode	points(scan.get("points"));
+	StructureNode			proto(points.prototype());
+
+	/// Spherical coordinates that were not asked for are decoded to a buffer of one block, to compute the cartesian ones
+	int64_t		blockSize = std::min(pointCount, LOAD_BLOCK_POINTS);
+	PointCloud	spherical;
+	if(transform.FromSpherical() && (buffers.cartesianX != NULL) && (buffers.sphericalRange == NULL))
+		spherical.Allocate(blockSize, E57_POINT_SPHERICAL);
+
+	Data3DPointsData	block = buffers;
+	if(spherical.pointCount > 0)
+	{
+		block.sphericalRange = spherical.sphericalRange;
+		block.sphericalAzimuth = spherical.sphericalAzimuth;
+		block.sphericalElevation = spherical.sphericalElevation;
+	}
+
+	vector<SourceDestBuffer> destBuffers;
+	appendPointBuffers(imf, proto, block, blockSize, NULL, destBuffers);
+	if(destBuffers.empty())
+		return pointCount;
+
+	CompressedVectorReader reader = points.reader(destBuffers);
+	int64_t		readCount = 0;
+	unsigned	got = reader.read();
+	while(got > 0)
+	{
+		transform.Apply(block, got);
+		readCount += got;
+		if(readCount >= pointCount)
+			break;
+
+		/// Rebind to the next block of the same capacity, the last block is only partly filled
+		Data3DPointsData	next = buffers;
+		OffsetPointBuffers	offset(next, readCount);
+		visitPointBuffers(offset);
+		if(spherical.pointCount > 0)
+		{
+			next.sphericalRange = spherical.sphericalRange;
+			next.sphericalAzimuth = spherical.sphericalAzimuth;
+			next.sphericalElevation = spherical.sphericalElevation;
+		}
+		block = next;
+
+		destBuffers.clear();
+		appendPointBuffers(imf, proto, block, blockSize, NULL, destBuffers);
+		got = reader.read(destBuffers);
+	}
+	reader.close();
+	return readCount;
+}
+}
+
 namespace e57 {
 char *	GetNewGuid(void);
 double	GetGPSTime(void);
@@ -408,11 +1144,15 @@ char * e57::GetNewGuid(void)
 //	e57::ReaderImpl
 //
 	ReaderImpl::ReaderImpl(
-		const ustring & filePath)
-	: imf_(filePath,"r")
+		const ustring & filePath,
+		const ustring & configuration)
+	: imf_(filePath,"r",configuration)
+	, configuration_(configuration)
 	, root_(imf_.root())
 	, data3D_(root_.get("/data3D"))
 	, images2D_(root_.get("/images2D"))
+	, applyPose_(false)
+	, hasTransform_(false)
 {
 };
 
@@ -905,6 +1645,10 @@ bool	ReaderImpl :: ReadData3D(
 		data3DHeader.pointsSize = points.childCount();
 		StructureNode proto(points.prototype());
 
+		ustring uri;
+		if(imf_.extensionsLookupPrefix(E57_LIBE57_PREFIX, uri) && scan.isDefined(ustring(POINT_PREVIEW_ELEMENT) + "/pointStride"))
+			data3DHeader.pointPreviewStride = IntegerNode(scan.get(ustring(POINT_PREVIEW_ELEMENT) + "/pointStride")).value();
+
 		data3DHeader.guid = StringNode(scan.get("guid")).value();
 
 		if(scan.isDefined("name"))
@@ -1584,6 +2328,39 @@ CompressedVectorReader	ReaderImpl :: SetUpData3DPointsData(
 	int8_t*		isTimeStampInvalid,	//!< Value = 0 if the timeStamp is considered valid, 1 otherwise
 	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
 	)
+{
+	Data3DPointsData buffers;
+	buffers.cartesianX = cartesianX;
+	buffers.cartesianY = cartesianY;
+	buffers.cartesianZ = cartesianZ;
+	buffers.cartesianInvalidState = cartesianInvalidState;
+	buffers.intensity = intensity;
+	buffers.isIntensityInvalid = isIntensityInvalid;
+	buffers.colorRed = colorRed;
+	buffers.colorGreen = colorGreen;
+	buffers.colorBlue = colorBlue;
+	buffers.isColorInvalid = isColorInvalid;
+	buffers.sphericalRange = sphericalRange;
+	buffers.sphericalAzimuth = sphericalAzimuth;
+	buffers.sphericalElevation = sphericalElevation;
+	buffers.sphericalInvalidState = sphericalInvalidState;
+	buffers.rowIndex = rowIndex;
+	buffers.columnIndex = columnIndex;
+	buffers.returnIndex = returnIndex;
+	buffers.returnCount = returnCount;
+	buffers.timeStamp = timeStamp;
+	buffers.isTimeStampInvalid = isTimeStampInvalid;
+
+	return SetUpData3DPointsDataT(dataIndex, count, buffers, pointDataExtension);
+};
+
+template <typename COORDTYPE>
+CompressedVectorReader	ReaderImpl :: SetUpData3DPointsDataT(
+	int32_t		dataIndex,
+	int64_t		count,
+	const Data3DPointsData_t<COORDTYPE> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
+	)
 {
 	int64_t		readCount = 0;
 
@@ -1591,131 +2368,908 @@ CompressedVectorReader	ReaderImpl :: SetUpData3DPointsData(
 	CompressedVectorNode points(scan.get("points"));
 	StructureNode proto(points.prototype());
 
-	int64_t protoCount = proto.childCount();
-	int64_t protoIndex;
-
 	vector<SourceDestBuffer> destBuffers;
-
-	for( protoIndex = 0; protoIndex < protoCount; protoIndex++)
-	{
-		ustring		name = proto.get(protoIndex).elementName();
-		NodeType	type = proto.get(protoIndex).type();
-		bool		scaled = type == E57_SCALED_INTEGER ? true : false;
-
-		if((name.compare("cartesianX") == 0) && proto.isDefined("cartesianX") && (cartesianX != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "cartesianX",
-				cartesianX,  (unsigned) count, true, scaled));
-		else if((name.compare("cartesianY") == 0) && proto.isDefined("cartesianY") && (cartesianY != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "cartesianY",
-				cartesianY,  (unsigned) count, true,scaled));
-		else if((name.compare("cartesianZ") == 0) && proto.isDefined("cartesianZ") && (cartesianZ != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "cartesianZ",
-				cartesianZ,  (unsigned) count, true, scaled));
-		else if((name.compare("cartesianInvalidState") == 0) && proto.isDefined("cartesianInvalidState") && (cartesianInvalidState != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "cartesianInvalidState",
-				cartesianInvalidState,       (unsigned) count, true));
-
-		else if((name.compare("sphericalRange") == 0) && proto.isDefined("sphericalRange") && (sphericalRange != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "sphericalRange",
-				sphericalRange,  (unsigned) count, true, scaled));
-		else if((name.compare("sphericalAzimuth") == 0) && proto.isDefined("sphericalAzimuth") && (sphericalAzimuth != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "sphericalAzimuth",
-				sphericalAzimuth,  (unsigned) count, true, scaled));
-		else if((name.compare("sphericalElevation") == 0) && proto.isDefined("sphericalElevation") && (sphericalElevation != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "sphericalElevation",
-				sphericalElevation,  (unsigned) count, true, scaled));
-		else if((name.compare("sphericalInvalidState") == 0) && proto.isDefined("sphericalInvalidState") && (sphericalInvalidState != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "sphericalInvalidState",
-				sphericalInvalidState,       (unsigned) count, true));
-
-		else if((name.compare("rowIndex") == 0) && proto.isDefined("rowIndex") && (rowIndex != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "rowIndex",
-				rowIndex,    (unsigned) count, true));
-		else if((name.compare("columnIndex") == 0) && proto.isDefined("columnIndex") && (columnIndex != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "columnIndex",
-				columnIndex, (unsigned) count, true));
-		else if((name.compare("returnIndex") == 0) && proto.isDefined("returnIndex") && (returnIndex != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "returnIndex",
-				returnIndex, (unsigned) count, true));
-		else if((name.compare("returnCount") == 0) && proto.isDefined("returnCount") && (returnCount != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "returnCount",
-				returnCount, (unsigned) count, true));
-
-		else if((name.compare("timeStamp") == 0) && proto.isDefined("timeStamp") && (timeStamp != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "timeStamp",
-				timeStamp,   (unsigned) count, true, scaled));
-		else if((name.compare("isTimeStampInvalid") == 0) && proto.isDefined("isTimeStampInvalid") && (isTimeStampInvalid != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "isTimeStampInvalid",
-				isTimeStampInvalid,(unsigned) count, true));
-
-		else if((name.compare("intensity") == 0) && proto.isDefined("intensity") && (intensity != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "intensity",   intensity,
-				(unsigned) count, true, scaled));
-		else if((name.compare("isIntensityInvalid") == 0) && proto.isDefined("isIntensityInvalid") && (isIntensityInvalid != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "isIntensityInvalid",
-				isIntensityInvalid,(unsigned) count, true));
-
-		else if((name.compare("colorRed") == 0) && proto.isDefined("colorRed") && (colorRed != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "colorRed",
-				colorRed,    (unsigned) count, true, scaled));
-		else if((name.compare("colorGreen") == 0) && proto.isDefined("colorGreen") && (colorGreen != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "colorGreen",
-				colorGreen,  (unsigned) count, true, scaled));
-		else if((name.compare("colorBlue") == 0) && proto.isDefined("colorBlue") && (colorBlue != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "colorBlue",
-				colorBlue,   (unsigned) count, true, scaled));
-		else if((name.compare("isColorInvalid") == 0) && proto.isDefined("isColorInvalid") && (isColorInvalid != NULL))
-			destBuffers.push_back(SourceDestBuffer(imf_, "isColorInvalid",
-				isColorInvalid, (unsigned) count, true));
-		else if(pointDataExtension != NULL)
-			(*pointDataExtension)(imf_,proto,(int) protoIndex,destBuffers);
-	}
+	appendPointBuffers(imf_, proto, buffers, count, pointDataExtension, destBuffers);
 
 	CompressedVectorReader reader = points.reader(destBuffers);
 
 	return reader;
 };
 
-//#define TEST_EXTENSIONS
-////////////////////////////////////////////////////////////////////
-//
-//	e57::Writer
-//
-//! This function is the constructor for the writer class
-	WriterImpl::WriterImpl(
-		const ustring & filePath,
-		const ustring & coordinateMetadata)
-	: imf_(filePath,"w")
-	, root_(imf_.root())
-	, data3D_(imf_,true)
-	, images2D_(imf_,true)
+CompressedVectorReader	ReaderImpl :: SetUpData3DPointsData(
+	int32_t		dataIndex,
+	int64_t		count,
+	const Data3DPointsData_t<double> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
+	)
 {
-/// We are using the E57 v1.0 data format standard fieldnames.
-/// The standard fieldnames are used without an extension prefix (in the default namespace).
-/// We explicitly register it for completeness (the reference implementaion would do it for us, if we didn't).
-    imf_.extensionsAdd("", E57_V1_0_URI);
+	return SetUpData3DPointsDataT(dataIndex, count, buffers, pointDataExtension);
+};
 
-#ifdef TEST_EXTENSIONS
-	imf_.extensionsAdd("ext","http://www.libe57.org/extensions.html");
+CompressedVectorReader	ReaderImpl :: SetUpData3DPointsData(
+	int32_t		dataIndex,
+	int64_t		count,
+	const Data3DPointsData_t<float> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
+	)
+{
+	return SetUpData3DPointsDataT(dataIndex, count, buffers, pointDataExtension);
+};
 
-	root_.set("ext:extDesc", StringNode(imf_, "This is a test string"));
-#endif
-// Set per-file properties.
-/// Path names: "/formatName", "/majorVersion", "/minorVersion", "/coordinateMetadata"
-	root_.set("formatName", StringNode(imf_, "ASTM E57 3D Imaging Data File"));
-	root_.set("guid", StringNode(imf_, GetNewGuid()));
+CompressedVectorReader	ReaderImpl :: SetUpData3DPointsData(
+	int32_t		dataIndex,
+	int64_t		count,
+	const Data3DPointsData_t<int32_t> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
+	)
+{
+	return SetUpData3DPointsDataT(dataIndex, count, buffers, pointDataExtension);
+};
 
-// Get ASTM version number supported by library, so can write it into file
-	int astmMajor;
-	int astmMinor;
-	ustring libraryId;
-	E57Utilities().getVersions(astmMajor, astmMinor, libraryId);
+//! This function reads all the points of a Data3D into a PointCloud
+bool	ReaderImpl :: LoadData3D(
+	int32_t		dataIndex,		//!< This in the index into the images3D vector
+	uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values
+	PointCloud &	pointCloud,	//!< receives the points
+	int			threadCount		//!< number of threads decoding the fields
+	)
+{
+	pointCloud.Reset();
+	if(!IsOpen() || (dataIndex < 0) || (dataIndex >= data3D_.childCount()))
+		return false;
 
-	root_.set("versionMajor", IntegerNode(imf_, astmMajor));
-	root_.set("versionMinor", IntegerNode(imf_, astmMinor));
-	root_.set("e57LibraryVersion", StringNode(imf_,libraryId));
+	PointTransform			transform(GetPointTransform(StructureNode(data3D_.get(dataIndex)), fieldsMask));
+	int64_t					pointCount = allocatePointCloud(imf_, dataIndex, fieldsMask, transform, pointCloud);
+
+	/// The coordinates that are transformed together are decoded by the same thread
+	vector<Data3DPointsData>	parts(threadCount > 1 ? threadCount : 1);
+	SplitPointBuffers			split(pointCloud, parts, transform.Any() ? E57_POINT_CARTESIAN | E57_POINT_SPHERICAL : 0);
+	visitPointBuffers(split);
+	if(split.used < parts.size())
+		parts.resize(split.used > 0 ? split.used : 1);
+
+	/// Each extra thread reads through its own ImageFile, ImageFile is not thread safe
+	vector<int64_t>				readCounts(parts.size(), 0);
+	vector<std::exception_ptr>	errors(parts.size());
+	/// If a thread can't be started, the ones already running must be joined before their vectors go away
+	vector<std::thread>			threads;
+	threads.reserve(parts.size());
+	try {
+		for(size_t i = 1; i < parts.size(); i++)
+			threads.push_back(std::thread([&, i]()
+			{
+				try {
+					ImageFile imf(imf_.fileName(), "r", configuration_);
+					readCounts[i] = readPointsInBlocks(imf, dataIndex, parts[i], pointCount, transform);
+					imf.close();
+				} catch(...) {
+					errors[i] = std::current_exception();
+				}
+			}));
+	} catch(...) {
+		for(size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+		pointCloud.Reset();
+		throw;
+	}
+	try {
+		readCounts[0] = readPointsInBlocks(imf_, dataIndex, parts[0], pointCount, transform);
+	} catch(...) {
+		errors[0] = std::current_exception();
+	}
+	for(size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
 
-// Save a dummy string for coordinate system.
+	for(size_t i = 0; i < parts.size(); i++)
+	{
+		if(errors[i])
+		{
+			pointCloud.Reset();
+			std::rethrow_exception(errors[i]);
+		}
+		if(readCounts[i] != pointCount)
+			return false;
+	}
+	return true;
+};
+
+//! This function sets the transform of the points loaded
+bool	ReaderImpl :: SetPointTransform(
+	bool		applyPose,		//!< move the points by the pose of their Data3D
+	const RigidBodyTransform * transform	//!< applied after the pose, NULL for none
+	)
+{
+	if(!IsOpen())
+		return false;
+
+	applyPose_ = applyPose;
+	hasTransform_ = transform != NULL;
+	if(hasTransform_)
+		transform_ = *transform;
+	return true;
+};
+
+//! This function reads all the points of every Data3D of the file, several Data3D at a time
+bool	ReaderImpl :: ForEachData3DParallel(
+	uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values
+	const Data3DPointsFunction & function,	//!< called with the points of each Data3D
+	int			threadCount		//!< number of Data3D loaded at a time, 0 for the number of hardware threads
+	)
+{
+	if(!IsOpen() || !function)
+		return false;
+
+	/// Largest first, ties in file order
+	vector<pair<int64_t, int32_t> >	order;
+	for(int32_t i = 0; i < (int32_t) data3D_.childCount(); i++)
+	{
+		StructureNode	scan(data3D_.get(i));
+		order.push_back(make_pair(-CompressedVectorNode(scan.get("points")).childCount(), i));
+	}
+	std::sort(order.begin(), order.end());
+	if(order.empty())
+		return true;
+
+	if(threadCount <= 0)
+		threadCount = std::max((int) std::thread::hardware_concurrency(), 1);
+	size_t	workerCount = std::min((size_t) threadCount, order.size());
+
+	std::atomic<size_t>			next(0);
+	std::atomic<bool>			ok(true);
+	vector<std::exception_ptr>	errors(workerCount);
+
+	/// Each worker takes the next Data3D until there are none left, or one failed
+	auto worker = [&](ImageFile imf, size_t w)
+	{
+		try {
+			for(size_t k = next++; ok && (k < order.size()); k = next++)
+			{
+				int32_t			dataIndex = order[k].second;
+				VectorNode		data3D(imf.root().get("/data3D"));
+				PointTransform	transform(GetPointTransform(StructureNode(data3D.get(dataIndex)), fieldsMask));
+				PointCloud		pointCloud;
+				int64_t			pointCount = allocatePointCloud(imf, dataIndex, fieldsMask, transform, pointCloud);
+				if((readPointsInBlocks(imf, dataIndex, pointCloud, pointCount, transform) != pointCount) ||
+					!function(dataIndex, pointCloud))
+					ok = false;
+			}
+		} catch(...) {
+			errors[w] = std::current_exception();
+			ok = false;
+		}
+	};
+
+	/// Each extra thread reads through its own ImageFile, ImageFile is not thread safe
+	/// If a thread can't be started, the ones already running are stopped and joined
+	vector<std::thread>			threads;
+	threads.reserve(workerCount);
+	try {
+		for(size_t w = 1; w < workerCount; w++)
+			threads.push_back(std::thread([&, w]()
+			{
+				try {
+					ImageFile imf(imf_.fileName(), "r", configuration_);
+					worker(imf, w);
+					imf.close();
+				} catch(...) {
+					errors[w] = std::current_exception();
+					ok = false;
+				}
+			}));
+	} catch(...) {
+		ok = false;
+		for(size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+		throw;
+	}
+	worker(imf_, 0);
+	for(size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	for(size_t w = 0; w < workerCount; w++)
+		if(errors[w])
+			std::rethrow_exception(errors[w]);
+	return ok;
+};
+
+//! This function reads the lines of a gridded Data3D, keeping the points with a cross index in [firstCross, firstCross + crossCount)
+bool	ReaderImpl :: ReadGridLines(
+	int32_t		dataIndex,		//!< This in the index into the images3D vector
+	int64_t		firstLine,		//!< idElementValue of the first line to read
+	int64_t		lineCount,		//!< number of lines to read
+	int64_t		firstCross,		//!< first index across the lines to keep
+	int64_t		crossCount,		//!< number of indexes across the lines to keep, negative keeps whole lines
+	const Data3DPointsData & buffers,	//!< buffers to receive the points
+	int64_t		bufferSize,		//!< number of elements in each of the buffers
+	int64_t &	pointCount		//!< receives the number of points stored in the buffers
+	)
+{
+	pointCount = 0;
+	if(!IsOpen() || (dataIndex < 0) || (dataIndex >= data3D_.childCount()) || (bufferSize < 0))
+		return false;
+
+	StructureNode scan(data3D_.get(dataIndex));
+	if(!scan.isDefined("pointGroupingSchemes/groupingByLine"))
+		return false;
+
+	StructureNode			groupingByLine(scan.get("pointGroupingSchemes/groupingByLine"));
+	ustring					lineName = StringNode(groupingByLine.get("idElementName")).value();
+	CompressedVectorNode	groups(groupingByLine.get("groups"));
+	int64_t					groupCount = groups.childCount();
+
+	vector<int64_t>	idElementValue(groupCount > 0 ? groupCount : 1);
+	vector<int64_t>	startPointIndex(idElementValue.size());
+	vector<int64_t>	linePointCount(idElementValue.size());
+	if((groupCount > 0) && !ReadData3DGroupsData(dataIndex, (int32_t) groupCount,
+		&idElementValue[0], &startPointIndex[0], &linePointCount[0]))
+		return false;
+
+	/// (startPointIndex, pointCount) of the lines asked for, in file order
+	vector<pair<int64_t, int64_t> > lines;
+	for(int64_t i = 0; i < groupCount; i++)
+		if((idElementValue[i] >= firstLine) && (idElementValue[i] - firstLine < lineCount) && (linePointCount[i] > 0))
+			lines.push_back(make_pair(startPointIndex[i], linePointCount[i]));
+	std::sort(lines.begin(), lines.end());
+
+	CompressedVectorNode	points(scan.get("points"));
+	StructureNode			proto(points.prototype());
+	bool					filter = crossCount >= 0;
+	ustring					crossName = lineName.compare("rowIndex") == 0 ? "columnIndex" : "rowIndex";
+	int32_t* Data3DPointsData::* crossField = lineName.compare("rowIndex") == 0 ?
+		&Data3DPointsData::columnIndex : &Data3DPointsData::rowIndex;
+	if(filter && !proto.isDefined(crossName))
+		return false;
+
+	Data3DPointsData			target = buffers;
+	ClearUndefinedPointFields	clear(proto, target);
+	visitPointBuffers(clear);
+
+	/// The cross index is needed to filter the lines, even when the caller did not ask for it
+	vector<int32_t>	crossIndex;
+	if(filter && (target.*crossField == NULL))
+	{
+		crossIndex.resize(bufferSize > 0 ? bufferSize : 1);
+		target.*crossField = &crossIndex[0];
+	}
+
+	/// A line that holds every index of the indexBounds once is read only inside the window
+	int64_t	crossMinimum = 0;
+	int64_t	crossMaximum = -1;
+	if(filter && scan.isDefined("indexBounds"))
+	{
+		StructureNode	indexBounds(scan.get("indexBounds"));
+		ustring			prefix = crossName.compare("rowIndex") == 0 ? "row" : "column";
+		if(indexBounds.isDefined(prefix + "Minimum") && indexBounds.isDefined(prefix + "Maximum"))
+		{
+			crossMinimum = IntegerNode(indexBounds.get(prefix + "Minimum")).value();
+			crossMaximum = IntegerNode(indexBounds.get(prefix + "Maximum")).value();
+		}
+	}
+
+	if(lines.empty())
+		return true;
+
+	RecordRangeReader	reader(imf_, points, target, bufferSize);
+	if(!reader.isOpen())
+		return false;
+
+	RecordRangeReader::Filter	all;
+	RecordRangeReader::Filter	inWindow = [&](const Data3DPointsData & block, unsigned i) -> bool
+	{
+		int32_t	cross = (block.*crossField)[i];
+		return (cross >= firstCross) && (cross - firstCross < crossCount);
+	};
+
+	bool fit = true;
+	for(size_t i = 0; fit && (i < lines.size()); i++)
+	{
+		int64_t	start = lines[i].first;
+		int64_t	count = lines[i].second;
+
+		if(!filter)
+		{
+			fit = reader.read(start, count, all);
+			continue;
+		}
+		if(count == crossMaximum - crossMinimum + 1)
+		{
+			int64_t	low = std::max(firstCross, crossMinimum);
+			int64_t	high = std::min(firstCross + crossCount, crossMaximum + 1);
+			if(low >= high)
+				continue;
+
+			int64_t	lineWritten = reader.written;
+			bool	lineFit = reader.read(start + low - crossMinimum, high - low, all);
+
+			/// Check that the line really is in index order, else filter all of it
+			const int32_t* cross = target.*crossField + lineWritten;
+			bool	ordered = true;
+			for(int64_t k = 0; ordered && (k < reader.written - lineWritten); k++)
+				ordered = cross[k] == low + k;
+			if(ordered)
+			{
+				fit = lineFit;
+				continue;
+			}
+			reader.written = lineWritten;
+		}
+		fit = reader.read(start, count, inWindow);
+	}
+	reader.close();
+
+	pointCount = reader.written;
+	return fit;
+};
+
+//! This function reads whole lines of a gridded Data3D
+bool	ReaderImpl :: ReadData3DLines(
+	int32_t		dataIndex,		//!< This in the index into the images3D vector
+	int64_t		firstLine,		//!< idElementValue of the first line to read
+	int64_t		lineCount,		//!< number of lines to read
+	const Data3DPointsData & buffers,	//!< buffers to receive the points
+	int64_t		bufferSize,		//!< number of elements in each of the buffers
+	int64_t &	pointCount		//!< receives the number of points stored in the buffers
+	)
+{
+	return ReadGridLines(dataIndex, firstLine, lineCount, 0, -1, buffers, bufferSize, pointCount);
+};
+
+//! This function reads a rectangular window of the row/column grid of a gridded Data3D
+bool	ReaderImpl :: ReadData3DWindow(
+	int32_t		dataIndex,		//!< This in the index into the images3D vector
+	int64_t		firstRow,		//!< rowIndex of the first row of the window
+	int64_t		rowCount,		//!< number of rows in the window
+	int64_t		firstColumn,	//!< columnIndex of the first column of the window
+	int64_t		columnCount,	//!< number of columns in the window
+	const Data3DPointsData & buffers,	//!< buffers to receive the points
+	int64_t		bufferSize,		//!< number of elements in each of the buffers
+	int64_t &	pointCount		//!< receives the number of points stored in the buffers
+	)
+{
+	pointCount = 0;
+	if(!IsOpen() || (dataIndex < 0) || (dataIndex >= data3D_.childCount()) || (rowCount < 0) || (columnCount < 0))
+		return false;
+
+	StructureNode scan(data3D_.get(dataIndex));
+	if(!scan.isDefined("pointGroupingSchemes/groupingByLine/idElementName"))
+		return false;
+
+	ustring	lineName = StringNode(scan.get("pointGroupingSchemes/groupingByLine/idElementName")).value();
+	if(lineName.compare("rowIndex") == 0)
+		return ReadGridLines(dataIndex, firstRow, rowCount, firstColumn, columnCount, buffers, bufferSize, pointCount);
+	return ReadGridLines(dataIndex, firstColumn, columnCount, firstRow, rowCount, buffers, bufferSize, pointCount);
+};
+
+//! This function gets the point chunk records of a Data3D, from the file, a point chunk index file or the line groups
+bool	ReaderImpl :: ReadPointChunks(
+	int32_t		dataIndex,			//!< This in the index into the images3D vector
+	vector<int64_t> & startPointIndex,	//!< receives the first point of every chunk
+	vector<int64_t> & pointCount,		//!< receives the number of points of every chunk
+	vector<double> & bounds				//!< receives the six bounds of every chunk, one vector after the other
+	)
+{
+	StructureNode	scan(data3D_.get(dataIndex));
+	ustring			uri;
+	if(imf_.extensionsLookupPrefix(E57_LIBE57_PREFIX, uri) && scan.isDefined(POINT_CHUNKS_ELEMENT))
+		return readPointChunks(imf_, CompressedVectorNode(scan.get(POINT_CHUNKS_ELEMENT)), startPointIndex, pointCount, bounds);
+
+	/// An index file that is missing, unreadable or made for another file is ignored.
+	/// A file rewritten since the index was made has a new file guid, and its chunks must still cover all the points.
+	ustring	guid = StringNode(scan.get("guid")).value();
+	try {
+		ImageFile	index(imf_.fileName() + POINT_CHUNKS_FILE_SUFFIX, "r");
+		StructureNode	indexRoot(index.root());
+		bool		found = false;
+		if(root_.isDefined("guid") && indexRoot.isDefined("guid") &&
+			(StringNode(indexRoot.get("guid")).value().compare(StringNode(root_.get("guid")).value()) == 0))
+		{
+			VectorNode	data3D(indexRoot.get("data3D"));
+			for(int64_t i = 0; !found && (i < data3D.childCount()); i++)
+			{
+				StructureNode	entry(data3D.get(i));
+				if(StringNode(entry.get("guid")).value().compare(guid) == 0 && entry.isDefined(POINT_CHUNKS_ELEMENT))
+					found = readPointChunks(index, CompressedVectorNode(entry.get(POINT_CHUNKS_ELEMENT)), startPointIndex, pointCount, bounds) &&
+						chunksCoverPoints(startPointIndex, pointCount, CompressedVectorNode(scan.get("points")).childCount());
+			}
+		}
+		index.close();
+		if(found)
+			return true;
+	} catch(E57Exception &) {
+	}
+
+	if(scan.isDefined("pointGroupingSchemes/groupingByLine/groups"))
+		return readPointChunks(imf_, CompressedVectorNode(scan.get("pointGroupingSchemes/groupingByLine/groups")),
+			startPointIndex, pointCount, bounds);
+	return false;
+};
+
+//! This function reads a decimated preview of the points of a Data3D
+bool	ReaderImpl :: ReadData3DPreview(
+	int32_t		dataIndex,		//!< This in the index into the images3D vector
+	const Data3DPointsData & buffers,	//!< buffers to receive the points
+	int64_t		bufferSize,		//!< number of elements in each of the buffers
+	int64_t &	pointCount		//!< receives the number of points stored in the buffers
+	)
+{
+	pointCount = 0;
+	if(!IsOpen() || (dataIndex < 0) || (dataIndex >= data3D_.childCount()) || (bufferSize < 0))
+		return false;
+
+	StructureNode			scan(data3D_.get(dataIndex));
+	CompressedVectorNode	points(scan.get("points"));
+	ustring					uri;
+	if(imf_.extensionsLookupPrefix(E57_LIBE57_PREFIX, uri) && scan.isDefined(ustring(POINT_PREVIEW_ELEMENT) + "/points"))
+		points = CompressedVectorNode(scan.get(ustring(POINT_PREVIEW_ELEMENT) + "/points"));
+
+	int64_t	total = points.childCount();
+	if((total == 0) || (bufferSize == 0))
+		return true;
+
+	Data3DPointsData			target = buffers;
+	ClearUndefinedPointFields	clear(StructureNode(points.prototype()), target);
+	visitPointBuffers(clear);
+
+	RecordRangeReader	reader(imf_, points, target, bufferSize);
+	if(!reader.isOpen())
+		return false;
+
+	/// Points that don't all fit are decimated again, the records go through the filter in order
+	int64_t	step = (total + bufferSize - 1) / bufferSize;
+	int64_t	record = 0;
+	RecordRangeReader::Filter	everyStep;
+	if(step > 1)
+		everyStep = [&](const Data3DPointsData &, unsigned) -> bool
+		{
+			return (record++ % step) == 0;
+		};
+
+	bool ok = reader.read(0, total, everyStep);
+	reader.close();
+
+	pointCount = reader.written;
+	return ok;
+};
+
+//! This function reads the points of a Data3D that are inside a box
+bool	ReaderImpl :: ReadPointsInBox(
+	int32_t		dataIndex,		//!< This in the index into the images3D vector
+	const CartesianBounds & box,	//!< bounds of the points to read, inclusive
+	const Data3DPointsData & buffers,	//!< buffers to receive the points
+	int64_t		bufferSize,		//!< number of elements in each of the buffers
+	int64_t &	pointCount		//!< receives the number of points stored in the buffers
+	)
+{
+	pointCount = 0;
+	if(!IsOpen() || (dataIndex < 0) || (dataIndex >= data3D_.childCount()) || (bufferSize < 0))
+		return false;
+
+	StructureNode			scan(data3D_.get(dataIndex));
+	CompressedVectorNode	points(scan.get("points"));
+	StructureNode			proto(points.prototype());
+	if(!proto.isDefined("cartesianX") || !proto.isDefined("cartesianY") || !proto.isDefined("cartesianZ"))
+		return false;
+
+	/// (startPointIndex, pointCount) of the chunks that overlap the box, in file order
+	vector<pair<int64_t, int64_t> > ranges;
+	vector<int64_t>	chunkStart, chunkCount;
+	vector<double>	bounds;
+	if(ReadPointChunks(dataIndex, chunkStart, chunkCount, bounds))
+	{
+		size_t	n = chunkStart.size();
+		for(size_t k = 0; k < n; k++)
+			if((chunkCount[k] > 0) &&
+				(bounds[0*n + k] <= box.xMaximum) && (bounds[1*n + k] >= box.xMinimum) &&
+				(bounds[2*n + k] <= box.yMaximum) && (bounds[3*n + k] >= box.yMinimum) &&
+				(bounds[4*n + k] <= box.zMaximum) && (bounds[5*n + k] >= box.zMinimum))
+				ranges.push_back(make_pair(chunkStart[k], chunkCount[k]));
+		std::sort(ranges.begin(), ranges.end());
+	}
+	else if(points.childCount() > 0)
+		ranges.push_back(make_pair((int64_t) 0, points.childCount()));
+	if(ranges.empty())
+		return true;
+
+	Data3DPointsData			target = buffers;
+	ClearUndefinedPointFields	clear(proto, target);
+	visitPointBuffers(clear);
+
+	/// The coordinates are needed to test the points, even when the caller did not ask for them
+	vector<double>	x, y, z;
+	if(target.cartesianX == NULL)
+	{
+		x.resize(bufferSize > 0 ? bufferSize : 1);
+		target.cartesianX = &x[0];
+	}
+	if(target.cartesianY == NULL)
+	{
+		y.resize(bufferSize > 0 ? bufferSize : 1);
+		target.cartesianY = &y[0];
+	}
+	if(target.cartesianZ == NULL)
+	{
+		z.resize(bufferSize > 0 ? bufferSize : 1);
+		target.cartesianZ = &z[0];
+	}
+
+	RecordRangeReader	reader(imf_, points, target, bufferSize);
+	if(!reader.isOpen())
+		return false;
+
+	RecordRangeReader::Filter	inBox = [&](const Data3DPointsData & block, unsigned i) -> bool
+	{
+		return (block.cartesianX[i] >= box.xMinimum) && (block.cartesianX[i] <= box.xMaximum) &&
+			(block.cartesianY[i] >= box.yMinimum) && (block.cartesianY[i] <= box.yMaximum) &&
+			(block.cartesianZ[i] >= box.zMinimum) && (block.cartesianZ[i] <= box.zMaximum);
+	};
+
+	/// Chunks that follow each other are read without seeking in between
+	bool fit = true;
+	for(size_t i = 0; fit && (i < ranges.size()); i++)
+	{
+		int64_t	start = ranges[i].first;
+		int64_t	count = ranges[i].second;
+		while((i + 1 < ranges.size()) && (ranges[i + 1].first == start + count))
+			count += ranges[++i].second;
+		fit = reader.read(start, count, inBox);
+	}
+	reader.close();
+
+	pointCount = reader.written;
+	return fit;
+};
+
+//! This function makes a point chunk index file for all the Data3D of the file
+bool	ReaderImpl :: BuildPointChunkIndex(
+	int64_t		chunkSize		//!< number of points per chunk
+	)
+{
+	if(!IsOpen() || (chunkSize <= 0) || (chunkSize > std::numeric_limits<int32_t>::max()))
+		return false;
+
+	ImageFile	index(imf_.fileName() + POINT_CHUNKS_FILE_SUFFIX, "w");
+	index.extensionsAdd("", E57_V1_0_URI);
+	addLibe57Extension(index);
+
+	StructureNode	root(index.root());
+	root.set("formatName", StringNode(index, "libe57 point chunk index"));
+	if(root_.isDefined("guid"))
+		root.set("guid", StringNode(index, StringNode(root_.get("guid")).value()));
+	VectorNode	indexData3D(index, true);
+	root.set("data3D", indexData3D);
+
+	vector<double>	x(chunkSize), y(chunkSize), z(chunkSize);
+	Data3DPointsData	buffers;
+	buffers.cartesianX = &x[0];
+	buffers.cartesianY = &y[0];
+	buffers.cartesianZ = &z[0];
+
+	for(int64_t dataIndex = 0; dataIndex < data3D_.childCount(); dataIndex++)
+	{
+		StructureNode	scan(data3D_.get(dataIndex));
+		StructureNode	entry(index);
+		indexData3D.append(entry);
+		entry.set("guid", StringNode(index, StringNode(scan.get("guid")).value()));
+
+		CompressedVectorNode	points(scan.get("points"));
+		StructureNode			proto(points.prototype());
+		int64_t					total = points.childCount();
+		if(!proto.isDefined("cartesianX") || !proto.isDefined("cartesianY") || !proto.isDefined("cartesianZ") || (total == 0))
+			continue;
+
+	/// One pass over the coordinates, a chunk at a time
+		size_t			chunkCount = (size_t) ((total + chunkSize - 1) / chunkSize);
+		vector<double>	bounds(6*chunkCount);
+		for(int axis = 0; axis < 3; axis++)
+		{
+			std::fill(bounds.begin() + (2*axis)*chunkCount, bounds.begin() + (2*axis + 1)*chunkCount, std::numeric_limits<double>::max());
+			std::fill(bounds.begin() + (2*axis + 1)*chunkCount, bounds.begin() + (2*axis + 2)*chunkCount, -std::numeric_limits<double>::max());
+		}
+		vector<SourceDestBuffer> destBuffers;
+		appendPointBuffers(imf_, proto, buffers, chunkSize, NULL, destBuffers);
+		CompressedVectorReader	reader = points.reader(destBuffers);
+
+		int64_t		record = 0;
+		unsigned	got;
+		while((got = reader.read()) > 0)
+		{
+			for(unsigned i = 0; i < got; i++, record++)
+			{
+				size_t	k = (size_t) (record / chunkSize);
+				double	value[3] = {x[i], y[i], z[i]};
+				for(int axis = 0; axis < 3; axis++)
+				{
+					double & minimum = bounds[(2*axis)*chunkCount + k];
+					double & maximum = bounds[(2*axis + 1)*chunkCount + k];
+					if(value[axis] < minimum)
+						minimum = value[axis];
+					if(value[axis] > maximum)
+						maximum = value[axis];
+				}
+			}
+		}
+		reader.close();
+
+		CompressedVectorNode	chunks(newPointChunks(index, total, chunkSize));
+		entry.set(POINT_CHUNKS_ELEMENT, chunks);
+		writePointChunks(index, chunks, total, chunkSize, bounds);
+	}
+	index.close();
+	return true;
+};
+
+////////////////////////////////////////////////////////////////////
+//
+//	e57::PointTransform
+//
+//! This function is the constructor for a transform that does nothing
+	PointTransform::PointTransform(void)
+: move_(false)
+, fromSpherical_(false)
+{
+	for(int row = 0; row < 3; row++)
+		for(int column = 0; column < 4; column++)
+			matrix_[row][column] = (row == column) ? 1. : 0.;
+};
+
+//! This function is the constructor for the transform of the points of a Data3D
+	PointTransform::PointTransform(
+	StructureNode	scan,		//!< the Data3D
+	uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values read
+	bool		applyPose,		//!< move the points by the pose of the Data3D
+	const RigidBodyTransform * transform	//!< applied after the pose, NULL for none
+	)
+: move_(false)
+, fromSpherical_(false)
+{
+	for(int row = 0; row < 3; row++)
+		for(int column = 0; column < 4; column++)
+			matrix_[row][column] = (row == column) ? 1. : 0.;
+	if(!applyPose && (transform == NULL))
+		return;
+
+	StructureNode	proto(CompressedVectorNode(scan.get("points")).prototype());
+	fromSpherical_ = ((fieldsMask & E57_POINT_CARTESIAN) != 0) && !proto.isDefined("cartesianX") &&
+		proto.isDefined("sphericalRange") && proto.isDefined("sphericalAzimuth") && proto.isDefined("sphericalElevation");
+
+	if(applyPose && scan.isDefined("pose"))
+	{
+		RigidBodyTransform	pose = {{1., 0., 0., 0.}, {0., 0., 0.}};
+		StructureNode		poseNode(scan.get("pose"));
+		if(poseNode.isDefined("rotation"))
+		{
+			StructureNode rotation(poseNode.get("rotation"));
+			pose.rotation.w = FloatNode(rotation.get("w")).value();
+			pose.rotation.x = FloatNode(rotation.get("x")).value();
+			pose.rotation.y = FloatNode(rotation.get("y")).value();
+			pose.rotation.z = FloatNode(rotation.get("z")).value();
+		}
+		if(poseNode.isDefined("translation"))
+		{
+			StructureNode translation(poseNode.get("translation"));
+			pose.translation.x = FloatNode(translation.get("x")).value();
+			pose.translation.y = FloatNode(translation.get("y")).value();
+			pose.translation.z = FloatNode(translation.get("z")).value();
+		}
+		rigidBodyMatrix(pose, matrix_);
+	}
+
+	/// The transform is applied after the pose: matrix_ = transform * pose
+	if(transform != NULL)
+	{
+		double	global[3][4], product[3][4];
+		rigidBodyMatrix(*transform, global);
+		for(int row = 0; row < 3; row++)
+			for(int column = 0; column < 4; column++)
+				product[row][column] = global[row][0]*matrix_[0][column] + global[row][1]*matrix_[1][column] +
+					global[row][2]*matrix_[2][column] + ((column == 3) ? global[row][3] : 0.);
+		memcpy(matrix_, product, sizeof(matrix_));
+	}
+
+	for(int row = 0; row < 3; row++)
+		for(int column = 0; column < 4; column++)
+			if(matrix_[row][column] != ((row == column) ? 1. : 0.))
+				move_ = true;
+};
+
+//! This function transforms the first count points of the buffers
+void	PointTransform::Apply(
+	const Data3DPointsData & block,	//!< buffers of the points decoded
+	int64_t		count			//!< number of points decoded
+	) const
+{
+	double *	x = block.cartesianX;
+	double *	y = block.cartesianY;
+	double *	z = block.cartesianZ;
+	if(!Any() || (x == NULL) || (y == NULL) || (z == NULL))
+		return;
+
+	/// Plain loops over the separate x, y and z arrays, so that the compiler can vectorize them
+	const double	(*m)[4] = matrix_;
+	if(fromSpherical_)
+	{
+		const double *	range = block.sphericalRange;
+		const double *	azimuth = block.sphericalAzimuth;
+		const double *	elevation = block.sphericalElevation;
+		if((range == NULL) || (azimuth == NULL) || (elevation == NULL))
+			return;
+		if((block.cartesianInvalidState != NULL) && (block.sphericalInvalidState != NULL))
+			memcpy(block.cartesianInvalidState, block.sphericalInvalidState, (size_t) count * sizeof(int8_t));
+		for(int64_t i = 0; i < count; i++)
+		{
+			double	r = range[i] * cos(elevation[i]);
+			double	px = r * cos(azimuth[i]);
+			double	py = r * sin(azimuth[i]);
+			double	pz = range[i] * sin(elevation[i]);
+			x[i] = m[0][0]*px + m[0][1]*py + m[0][2]*pz + m[0][3];
+			y[i] = m[1][0]*px + m[1][1]*py + m[1][2]*pz + m[1][3];
+			z[i] = m[2][0]*px + m[2][1]*py + m[2][2]*pz + m[2][3];
+		}
+		return;
+	}
+	for(int64_t i = 0; i < count; i++)
+	{
+		double	px = x[i], py = y[i], pz = z[i];
+		x[i] = m[0][0]*px + m[0][1]*py + m[0][2]*pz + m[0][3];
+		y[i] = m[1][0]*px + m[1][1]*py + m[1][2]*pz + m[1][3];
+		z[i] = m[2][0]*px + m[2][1]*py + m[2][2]*pz + m[2][3];
+	}
+};
+
+////////////////////////////////////////////////////////////////////
+//
+//	e57::Data3DIterator
+//
+//! This function is the constructor for the iterator, it sizes and allocates the batch buffers
+	Data3DIteratorImpl::Data3DIteratorImpl(
+	boost::shared_ptr<ReaderImpl> reader,	//!< open reader
+	int32_t		dataIndex,		//!< This in the index into the images3D vector
+	uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values
+	int64_t		memoryBudget	//!< bytes the buffers and the decoders may use
+	)
+: reader_(reader)
+, totalCount_(0)
+, firstPoint_(0)
+, pointCount_(0)
+{
+	VectorNode	data3D(reader_->GetRawData3D());
+	if(!reader_->IsOpen() || (dataIndex < 0) || (dataIndex >= data3D.childCount()))
+		return;
+
+	ImageFile				imf(reader_->GetRawIMF());
+	StructureNode			scan(data3D.get(dataIndex));
+	CompressedVectorNode	points(scan.get("points"));
+	StructureNode			proto(points.prototype());
+
+	/// Computing the cartesian coordinates takes the spherical ones, decoded into the batch,
+	/// and their invalid state gives the cartesian one
+	transform_ = reader_->GetPointTransform(scan, fieldsMask);
+	DefinedPointFields		defined(proto);
+	visitPointBuffers(defined);
+	if(transform_.FromSpherical())
+	{
+		if(fieldsMask & E57_POINT_CARTESIAN_INVALID)
+			fieldsMask |= E57_POINT_SPHERICAL_INVALID;
+		fieldsMask |= E57_POINT_SPHERICAL;
+	}
+	fieldsMask &= defined.mask;
+
+	/// The computed cartesian fields are allocated with the decoded ones, but have no decoder
+	PointFieldBytes			width(proto, fieldsMask);
+	visitPointBuffers(width);
+	uint32_t	allocationMask = fieldsMask;
+	if(transform_.FromSpherical())
+	{
+		allocationMask |= E57_POINT_CARTESIAN;
+		width.bytes += 3 * sizeof(double);
+		if(fieldsMask & E57_POINT_SPHERICAL_INVALID)
+		{
+			allocationMask |= E57_POINT_CARTESIAN_INVALID;
+			width.bytes += sizeof(int8_t);
+		}
+	}
+	totalCount_ = points.childCount();
+	if((width.bytes == 0) || (totalCount_ == 0))
+		return;
+
+	/// Take the reader's own memory off the budget, then fit the allocation of the buffers in the rest
+	int64_t	bufferBudget = memoryBudget - READER_PACKET_CACHE_BYTES - width.fields * READER_CHANNEL_BYTES;
+	int64_t	batchSize = std::min(bufferBudget / width.bytes, totalCount_);
+	batchSize = std::min(batchSize, (int64_t) std::numeric_limits<int32_t>::max());
+	while(batchSize > 1)
+	{
+		int64_t	excess = (int64_t) PointCloud::AllocationSize(batchSize, allocationMask) - bufferBudget;
+		if(excess <= 0)
+			break;
+		batchSize -= std::max(excess / width.bytes, (int64_t) 1);
+	}
+	batchSize = std::max(batchSize, (int64_t) 1);
+
+	batch_.Allocate(batchSize, allocationMask);
+	Data3DPointsData			cartesian = batch_;
+	ClearUndefinedPointFields	clear(proto, batch_);
+	visitPointBuffers(clear);
+	if(transform_.FromSpherical())
+	{
+		batch_.cartesianX = cartesian.cartesianX;
+		batch_.cartesianY = cartesian.cartesianY;
+		batch_.cartesianZ = cartesian.cartesianZ;
+		batch_.cartesianInvalidState = cartesian.cartesianInvalidState;
+	}
+
+	vector<SourceDestBuffer>	destBuffers;
+	appendPointBuffers(imf, proto, batch_, batchSize, NULL, destBuffers);
+	points_.reset(new CompressedVectorReader(points.reader(destBuffers)));
+};
+
+	Data3DIteratorImpl::~Data3DIteratorImpl(void)
+{
+	Close();
+};
+
+//! This function reads the next batch of points into the buffers
+bool	Data3DIteratorImpl::Next(void)
+{
+	firstPoint_ += pointCount_;
+	pointCount_ = 0;
+	if(!points_ || (firstPoint_ >= totalCount_))
+		return false;
+
+	pointCount_ = points_->read();
+	transform_.Apply(batch_, pointCount_);
+	return pointCount_ > 0;
+};
+
+//! This function releases the buffers and the file reader
+void	Data3DIteratorImpl::Close(void)
+{
+	if(points_ && points_->isOpen() && reader_->IsOpen())
+		points_->close();
+	points_.reset();
+	batch_.Reset();
+	pointCount_ = 0;
+};
+
+//#define TEST_EXTENSIONS
+////////////////////////////////////////////////////////////////////
+//
+//	e57::Writer
+//
+//! This function is the constructor for the writer class
+	WriterImpl::WriterImpl(
+		const ustring & filePath,
+		const ustring & coordinateMetadata)
+	: imf_(filePath,"w")
+	, root_(imf_.root())
+	, data3D_(imf_,true)
+	, images2D_(imf_,true)
+{
+/// We are using the E57 v1.0 data format standard fieldnames.
+/// The standard fieldnames are used without an extension prefix (in the default namespace).
+/// We explicitly register it for completeness (the reference implementaion would do it for us, if we didn't).
+    imf_.extensionsAdd("", E57_V1_0_URI);
+
+#ifdef TEST_EXTENSIONS
+	imf_.extensionsAdd("ext","http://www.libe57.org/extensions.html");
+
+	root_.set("ext:extDesc", StringNode(imf_, "This is a test string"));
+#endif
+// Set per-file properties.
+/// Path names: "/formatName", "/majorVersion", "/minorVersion", "/coordinateMetadata"
+	root_.set("formatName", StringNode(imf_, "ASTM E57 3D Imaging Data File"));
+	root_.set("guid", StringNode(imf_, GetNewGuid()));
+
+// Get ASTM version number supported by library, so can write it into file
+	int astmMajor;
+	int astmMinor;
+	ustring libraryId;
+	E57Utilities().getVersions(astmMajor, astmMinor, libraryId);
+
+	root_.set("versionMajor", IntegerNode(imf_, astmMajor));
+	root_.set("versionMinor", IntegerNode(imf_, astmMinor));
+	root_.set("e57LibraryVersion", StringNode(imf_,libraryId));
+
+// Save a dummy string for coordinate system.
 /// Really should be a valid WKT string identifying the coordinate reference system (CRS).
     root_.set("coordinateMetadata", StringNode(imf_, coordinateMetadata));
 
@@ -1748,11 +3302,166 @@ bool	WriterImpl :: Close(void)
 {
 	if(IsOpen())
 	{
+		for(size_t i = 0; i < pointsWriters_.size(); i++)
+		{
+			AddWrittenBounds(pointsWriters_[i]);
+			if(generatedGroups_.count(pointsWriters_[i].dataIndex) > 0)
+				AddWrittenGroups(pointsWriters_[i]);
+			if(pointChunkSizes_.count(pointsWriters_[i].dataIndex) > 0)
+				AddWrittenChunks(pointsWriters_[i]);
+			if(pointPreviewStrides_.count(pointsWriters_[i].dataIndex) > 0)
+				AddWrittenPreview(pointsWriters_[i]);
+		}
+		pointsWriters_.clear();
+		generatedGroups_.clear();
+		pointChunkSizes_.clear();
+		pointPreviewStrides_.clear();
+
 		imf_.close();
 		return true;
 	}
 	return false;
 };
+
+//! This function adds the bounds that the Data3D header left out, from the range of the values written
+void	WriterImpl :: AddWrittenBounds(
+	const PointsWriter & pointsWriter)
+{
+	StructureNode			scan(data3D_.get(pointsWriter.dataIndex));
+	CompressedVectorNode	points(scan.get("points"));
+	StructureNode			proto(points.prototype());
+	CompressedVectorWriter	writer = pointsWriter.writer;
+	bool					raw = pointsWriter.rawValues;
+
+	double	xMinimum, xMaximum, yMinimum, yMaximum, zMinimum, zMaximum;
+	if(!scan.isDefined("cartesianBounds") &&
+		writtenRange(writer, proto, "cartesianX", raw, xMinimum, xMaximum) &&
+		writtenRange(writer, proto, "cartesianY", raw, yMinimum, yMaximum) &&
+		writtenRange(writer, proto, "cartesianZ", raw, zMinimum, zMaximum))
+	{
+		StructureNode bbox = StructureNode(imf_);
+		bbox.set("xMinimum", FloatNode(imf_, xMinimum));
+		bbox.set("xMaximum", FloatNode(imf_, xMaximum));
+		bbox.set("yMinimum", FloatNode(imf_, yMinimum));
+		bbox.set("yMaximum", FloatNode(imf_, yMaximum));
+		bbox.set("zMinimum", FloatNode(imf_, zMinimum));
+		bbox.set("zMaximum", FloatNode(imf_, zMaximum));
+		scan.set("cartesianBounds", bbox);
+	}
+
+	double	rangeMinimum, rangeMaximum, azimuthStart, azimuthEnd, elevationMinimum, elevationMaximum;
+	if(!scan.isDefined("sphericalBounds") &&
+		writtenRange(writer, proto, "sphericalRange", raw, rangeMinimum, rangeMaximum) &&
+		writtenRange(writer, proto, "sphericalAzimuth", raw, azimuthStart, azimuthEnd) &&
+		writtenRange(writer, proto, "sphericalElevation", raw, elevationMinimum, elevationMaximum))
+	{
+		StructureNode sbox = StructureNode(imf_);
+		sbox.set("rangeMinimum", FloatNode(imf_, rangeMinimum));
+		sbox.set("rangeMaximum", FloatNode(imf_, rangeMaximum));
+		sbox.set("elevationMinimum", FloatNode(imf_, elevationMinimum));
+		sbox.set("elevationMaximum", FloatNode(imf_, elevationMaximum));
+		sbox.set("azimuthStart", FloatNode(imf_, azimuthStart));
+		sbox.set("azimuthEnd", FloatNode(imf_, azimuthEnd));
+		scan.set("sphericalBounds", sbox);
+	}
+
+/// Like NewData3D, all three pairs are written, fields that are not in the points get 0
+	double	rowMinimum = 0., rowMaximum = 0., columnMinimum = 0., columnMaximum = 0., returnMinimum = 0., returnMaximum = 0.;
+	bool	hasRow = writtenRange(writer, proto, "rowIndex", false, rowMinimum, rowMaximum);
+	bool	hasColumn = writtenRange(writer, proto, "columnIndex", false, columnMinimum, columnMaximum);
+	bool	hasReturn = writtenRange(writer, proto, "returnIndex", false, returnMinimum, returnMaximum);
+	if(!scan.isDefined("indexBounds") && (hasRow || hasColumn || hasReturn))
+	{
+		StructureNode ibox = StructureNode(imf_);
+		ibox.set("rowMinimum", IntegerNode(imf_, (int64_t) rowMinimum));
+		ibox.set("rowMaximum", IntegerNode(imf_, (int64_t) rowMaximum));
+		ibox.set("columnMinimum", IntegerNode(imf_, (int64_t) columnMinimum));
+		ibox.set("columnMaximum", IntegerNode(imf_, (int64_t) columnMaximum));
+		ibox.set("returnMinimum", IntegerNode(imf_, (int64_t) returnMinimum));
+		ibox.set("returnMaximum", IntegerNode(imf_, (int64_t) returnMaximum));
+		scan.set("indexBounds", ibox);
+	}
+};
+
+//! This function writes the line groups collected while the points were written
+void	WriterImpl :: AddWrittenGroups(
+	PointsWriter & pointsWriter)
+{
+	StructureNode			scan(data3D_.get(pointsWriter.dataIndex));
+	CompressedVectorNode	groups(scan.get("pointGroupingSchemes/groupingByLine/groups"));
+	if(groups.childCount() > 0)		//already written by WriteData3DGroupsData()
+		return;
+
+	vector<int64_t>	idElementValue, startPointIndex, pointCount;
+	vector<double>	minimum, maximum;
+	if(!pointsWriter.writer.sourceGroups(idElementValue, startPointIndex, pointCount, minimum, maximum) ||
+		idElementValue.empty())
+		return;		//the lines weren't written one after the other, so there is no grouping by line
+
+// only one CompressedVector can be written at a time
+	if(pointsWriter.writer.isOpen())
+		pointsWriter.writer.close();
+
+	size_t	groupCount = idElementValue.size();
+	vector<SourceDestBuffer> groupSDBuffers;
+	groupSDBuffers.push_back(SourceDestBuffer(imf_, "idElementValue",  &idElementValue[0],  groupCount, true));
+	groupSDBuffers.push_back(SourceDestBuffer(imf_, "startPointIndex", &startPointIndex[0], groupCount, true));
+	groupSDBuffers.push_back(SourceDestBuffer(imf_, "pointCount",      &pointCount[0],      groupCount, true));
+
+// split the per group ranges of x, y and z into the six bounds
+	vector<double>	bounds;
+	if(StructureNode(groups.prototype()).isDefined("cartesianBounds"))
+	{
+		splitBounds(StructureNode(CompressedVectorNode(scan.get("points")).prototype()), pointsWriter.rawValues, minimum, maximum, bounds);
+		for(int bound = 0; bound < 6; bound++)
+			groupSDBuffers.push_back(SourceDestBuffer(imf_, CARTESIAN_BOUNDS_NAMES[bound], &bounds[bound*groupCount], groupCount, true));
+	}
+
+	CompressedVectorWriter writer = groups.writer(groupSDBuffers);
+	writer.write(groupCount);
+	writer.close();
+};
+
+//! This function writes the point chunk bounds collected while the points were written
+void	WriterImpl :: AddWrittenChunks(
+	PointsWriter & pointsWriter)
+{
+	vector<double>	minimum, maximum;
+	if(!pointsWriter.writer.sourceChunks(minimum, maximum) || minimum.empty())
+		return;
+
+// only one CompressedVector can be written at a time
+	if(pointsWriter.writer.isOpen())
+		pointsWriter.writer.close();
+
+	StructureNode			scan(data3D_.get(pointsWriter.dataIndex));
+	CompressedVectorNode	points(scan.get("points"));
+
+	vector<double>	bounds;
+	splitBounds(StructureNode(points.prototype()), pointsWriter.rawValues, minimum, maximum, bounds);
+	writePointChunks(imf_, CompressedVectorNode(scan.get(POINT_CHUNKS_ELEMENT)), points.childCount(),
+		pointChunkSizes_[pointsWriter.dataIndex], bounds);
+};
+
+//! This function writes the preview points kept while the points were written
+void	WriterImpl :: AddWrittenPreview(
+	PointsWriter & pointsWriter)
+{
+// only one CompressedVector can be written at a time
+	if(pointsWriter.writer.isOpen())
+		pointsWriter.writer.close();
+
+	vector<SourceDestBuffer>	sourceBuffers;
+	if(!pointsWriter.writer.sourceSamples(sourceBuffers))
+		return;
+
+	StructureNode			scan(data3D_.get(pointsWriter.dataIndex));
+	CompressedVectorNode	preview(scan.get(ustring(POINT_PREVIEW_ELEMENT) + "/points"));
+
+	CompressedVectorWriter writer = preview.writer(sourceBuffers);
+	writer.write(sourceBuffers[0].capacity());
+	writer.close();
+};
 //! This function returns the file raw E57Root Structure Node
 StructureNode	WriterImpl :: GetRawE57Root(void)
 {
@@ -2357,12 +4066,39 @@ int32_t	WriterImpl :: NewData3D(
 		int64_t groupsSize = data3DHeader.pointGroupingSchemes.groupingByLine.groupsSize;
 		int64_t countSize = data3DHeader.pointGroupingSchemes.groupingByLine.pointCountSize;
 		int64_t pointsSize = data3DHeader.pointsSize;
+		bool	generateGroups = data3DHeader.pointGroupingSchemes.groupingByLine.generateGroups;
+
+	/// Generated groups take their sizes from the index fields if they weren't given
+		if(generateGroups)
+		{
+			if(groupsSize <= 0)
+				groupsSize = (int64_t) (byColumn ? data3DHeader.pointFields.columnIndexMaximum :
+					data3DHeader.pointFields.rowIndexMaximum) + 1;
+			if(countSize <= 0)
+				countSize = pointsSize;
+		}
 
 		StructureNode lineGroupProto = StructureNode(imf_);
 		lineGroupProto.set("startPointIndex",   IntegerNode(imf_, 0, 0, pointsSize - 1));
 		lineGroupProto.set("idElementValue",    IntegerNode(imf_, 0, 0, groupsSize - 1));
 		lineGroupProto.set("pointCount",        IntegerNode(imf_, 0, 0, countSize));
 
+	/// Generated groups also get the bounding box of their points, for culling whole lines when reading
+		if(generateGroups && data3DHeader.pointFields.cartesianXField &&
+			data3DHeader.pointFields.cartesianYField && data3DHeader.pointFields.cartesianZField)
+		{
+			StructureNode bbox = StructureNode(imf_);
+			bbox.set("xMinimum", FloatNode(imf_, 0., E57_DOUBLE));
+			bbox.set("xMaximum", FloatNode(imf_, 0., E57_DOUBLE));
+			bbox.set("yMinimum", FloatNode(imf_, 0., E57_DOUBLE));
+			bbox.set("yMaximum", FloatNode(imf_, 0., E57_DOUBLE));
+			bbox.set("zMinimum", FloatNode(imf_, 0., E57_DOUBLE));
+			bbox.set("zMaximum", FloatNode(imf_, 0., E57_DOUBLE));
+			lineGroupProto.set("cartesianBounds", bbox);
+		}
+		if(generateGroups)
+			generatedGroups_.insert(pos);
+
 		//Not supported in this Simple API for now
 /*
 		StructureNode bbox = StructureNode(imf_);
@@ -2593,6 +4329,26 @@ int32_t	WriterImpl :: NewData3D(
     /// The CompressedVector will be filled by code below.
     CompressedVectorNode points = CompressedVectorNode(imf_, proto, codecs);
     scan.set("points", points);
+
+// the bounds of every pointChunkSize points are collected as the points are written, they are written by Close()
+	if((data3DHeader.pointChunkSize > 0) && data3DHeader.pointFields.cartesianXField &&
+		data3DHeader.pointFields.cartesianYField && data3DHeader.pointFields.cartesianZField)
+	{
+		addLibe57Extension(imf_);
+		scan.set(POINT_CHUNKS_ELEMENT, newPointChunks(imf_, data3DHeader.pointsSize, data3DHeader.pointChunkSize));
+		pointChunkSizes_[pos] = data3DHeader.pointChunkSize;
+	}
+
+// every pointPreviewStride-th point is kept as the points are written, the copies are written by Close()
+	if(data3DHeader.pointPreviewStride > 0)
+	{
+		addLibe57Extension(imf_);
+		StructureNode preview(imf_);
+		preview.set("pointStride", IntegerNode(imf_, data3DHeader.pointPreviewStride, 1, data3DHeader.pointPreviewStride));
+		preview.set("points", CompressedVectorNode(imf_, copyPrototype(imf_, proto), VectorNode(imf_, true)));
+		scan.set(POINT_PREVIEW_ELEMENT, preview);
+		pointPreviewStrides_[pos] = data3DHeader.pointPreviewStride;
+	}
 	return pos;
 };
 
@@ -2626,6 +4382,39 @@ CompressedVectorWriter	WriterImpl :: SetUpData3DPointsData(
 	int8_t*		isTimeStampInvalid,	//!< Value = 0 if the timeStamp is considered valid, 1 otherwise
 	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
 	)
+{
+	Data3DPointsData buffers;
+	buffers.cartesianX = cartesianX;
+	buffers.cartesianY = cartesianY;
+	buffers.cartesianZ = cartesianZ;
+	buffers.cartesianInvalidState = cartesianInvalidState;
+	buffers.intensity = intensity;
+	buffers.isIntensityInvalid = isIntensityInvalid;
+	buffers.colorRed = colorRed;
+	buffers.colorGreen = colorGreen;
+	buffers.colorBlue = colorBlue;
+	buffers.isColorInvalid = isColorInvalid;
+	buffers.sphericalRange = sphericalRange;
+	buffers.sphericalAzimuth = sphericalAzimuth;
+	buffers.sphericalElevation = sphericalElevation;
+	buffers.sphericalInvalidState = sphericalInvalidState;
+	buffers.rowIndex = rowIndex;
+	buffers.columnIndex = columnIndex;
+	buffers.returnIndex = returnIndex;
+	buffers.returnCount = returnCount;
+	buffers.timeStamp = timeStamp;
+	buffers.isTimeStampInvalid = isTimeStampInvalid;
+
+	return SetUpData3DPointsDataT(dataIndex, count, buffers, pointDataExtension);
+};
+
+template <typename COORDTYPE>
+CompressedVectorWriter	WriterImpl :: SetUpData3DPointsDataT(
+	int32_t		dataIndex,
+	int64_t		count,
+	const Data3DPointsData_t<COORDTYPE> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
+	)
 {
 #ifdef TEST_EXTENSIONS
 	uint8_t*		extraField1 = new uint8_t[(unsigned) count];
@@ -2643,66 +4432,66 @@ CompressedVectorWriter	WriterImpl :: SetUpData3DPointsData(
 	StructureNode proto(points.prototype());
 
 	vector<SourceDestBuffer> sourceBuffers;
-	if(proto.isDefined("cartesianX") && (cartesianX != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "cartesianX",  cartesianX,  (unsigned) count, true, true));
-	if(proto.isDefined("cartesianY") && (cartesianY != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "cartesianY",  cartesianY,  (unsigned) count, true, true));
+	if(proto.isDefined("cartesianX") && (buffers.cartesianX != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "cartesianX",  buffers.cartesianX,  (unsigned) count, true, doScaling(buffers.cartesianX)));
+	if(proto.isDefined("cartesianY") && (buffers.cartesianY != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "cartesianY",  buffers.cartesianY,  (unsigned) count, true, doScaling(buffers.cartesianY)));
 #ifdef TEST_EXTENSIONS
 	if(proto.isDefined("ext:extraField1"))
 		sourceBuffers.push_back(SourceDestBuffer(imf_,"ext:extraField1", extraField1, (unsigned) count, true));
 #endif
-	if(proto.isDefined("cartesianZ") && (cartesianZ != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "cartesianZ",  cartesianZ,  (unsigned) count, true, true));
+	if(proto.isDefined("cartesianZ") && (buffers.cartesianZ != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "cartesianZ",  buffers.cartesianZ,  (unsigned) count, true, doScaling(buffers.cartesianZ)));
 
-	if(proto.isDefined("sphericalRange") && (sphericalRange != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "sphericalRange",  sphericalRange,  (unsigned) count, true, true));
-	if(proto.isDefined("sphericalAzimuth") && (sphericalAzimuth != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "sphericalAzimuth",  sphericalAzimuth,  (unsigned) count, true, true));
-	if(proto.isDefined("sphericalElevation") && (sphericalElevation != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "sphericalElevation",  sphericalElevation,  (unsigned) count, true, true));
+	if(proto.isDefined("sphericalRange") && (buffers.sphericalRange != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "sphericalRange",  buffers.sphericalRange,  (unsigned) count, true, doScaling(buffers.sphericalRange)));
+	if(proto.isDefined("sphericalAzimuth") && (buffers.sphericalAzimuth != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "sphericalAzimuth",  buffers.sphericalAzimuth,  (unsigned) count, true, doScaling(buffers.sphericalAzimuth)));
+	if(proto.isDefined("sphericalElevation") && (buffers.sphericalElevation != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "sphericalElevation",  buffers.sphericalElevation,  (unsigned) count, true, doScaling(buffers.sphericalElevation)));
 
 #ifdef TEST_EXTENSIONS
 	if(proto.isDefined("ext:extraField2"))
 		sourceBuffers.push_back(SourceDestBuffer(imf_,"ext:extraField2", extraField2, (unsigned) count, true));
 #endif
 
-	if(proto.isDefined("intensity") && (intensity != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "intensity",   intensity,   (unsigned) count, true, true));
+	if(proto.isDefined("intensity") && (buffers.intensity != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "intensity",   buffers.intensity,   (unsigned) count, true, doScaling(buffers.intensity)));
 
-	if(proto.isDefined("colorRed") && (colorRed != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "colorRed",    colorRed,    (unsigned) count, true));
-	if(proto.isDefined("colorGreen") && (colorGreen != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "colorGreen",  colorGreen,  (unsigned) count, true));
-	if(proto.isDefined("colorBlue") && (colorBlue != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "colorBlue",   colorBlue,   (unsigned) count, true));
+	if(proto.isDefined("colorRed") && (buffers.colorRed != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "colorRed",    buffers.colorRed,    (unsigned) count, true));
+	if(proto.isDefined("colorGreen") && (buffers.colorGreen != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "colorGreen",  buffers.colorGreen,  (unsigned) count, true));
+	if(proto.isDefined("colorBlue") && (buffers.colorBlue != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "colorBlue",   buffers.colorBlue,   (unsigned) count, true));
 
-	if(proto.isDefined("returnIndex") && (returnIndex != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "returnIndex", returnIndex, (unsigned) count, true));
-	if(proto.isDefined("returnCount") && (returnCount != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "returnCount", returnCount, (unsigned) count, true));
+	if(proto.isDefined("returnIndex") && (buffers.returnIndex != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "returnIndex", buffers.returnIndex, (unsigned) count, true));
+	if(proto.isDefined("returnCount") && (buffers.returnCount != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "returnCount", buffers.returnCount, (unsigned) count, true));
 
-	if(proto.isDefined("rowIndex") && (rowIndex != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "rowIndex",    rowIndex,    (unsigned) count, true));
-	if(proto.isDefined("columnIndex") && (columnIndex != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "columnIndex", columnIndex, (unsigned) count, true));
+	if(proto.isDefined("rowIndex") && (buffers.rowIndex != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "rowIndex",    buffers.rowIndex,    (unsigned) count, true));
+	if(proto.isDefined("columnIndex") && (buffers.columnIndex != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "columnIndex", buffers.columnIndex, (unsigned) count, true));
 
-	if(proto.isDefined("timeStamp") && (timeStamp != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "timeStamp",   timeStamp,   (unsigned) count, true, true));
+	if(proto.isDefined("timeStamp") && (buffers.timeStamp != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "timeStamp",   buffers.timeStamp,   (unsigned) count, true, doScaling(buffers.timeStamp)));
 
 #ifdef TEST_EXTENSIONS
 	if(proto.isDefined("ext:extraField3"))
 		sourceBuffers.push_back(SourceDestBuffer(imf_,"ext:extraField3", extraField3, (unsigned) count, true));
 #endif
-	if(proto.isDefined("cartesianInvalidState") && (cartesianInvalidState != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "cartesianInvalidState",       cartesianInvalidState,       (unsigned) count, true));
-	if(proto.isDefined("sphericalInvalidState") && (sphericalInvalidState != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "sphericalInvalidState",       sphericalInvalidState,       (unsigned) count, true));
-	if(proto.isDefined("isIntensityInvalid") && (isIntensityInvalid != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "isIntensityInvalid",       isIntensityInvalid,       (unsigned) count, true));
-	if(proto.isDefined("isColorInvalid") && (isColorInvalid != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "isColorInvalid",       isColorInvalid,       (unsigned) count, true));
-	if(proto.isDefined("isTimeStampInvalid") && (isTimeStampInvalid != NULL))
-		sourceBuffers.push_back(SourceDestBuffer(imf_, "isTimeStampInvalid",       isTimeStampInvalid,       (unsigned) count, true));
+	if(proto.isDefined("cartesianInvalidState") && (buffers.cartesianInvalidState != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "cartesianInvalidState",       buffers.cartesianInvalidState,       (unsigned) count, true));
+	if(proto.isDefined("sphericalInvalidState") && (buffers.sphericalInvalidState != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "sphericalInvalidState",       buffers.sphericalInvalidState,       (unsigned) count, true));
+	if(proto.isDefined("isIntensityInvalid") && (buffers.isIntensityInvalid != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "isIntensityInvalid",       buffers.isIntensityInvalid,       (unsigned) count, true));
+	if(proto.isDefined("isColorInvalid") && (buffers.isColorInvalid != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "isColorInvalid",       buffers.isColorInvalid,       (unsigned) count, true));
+	if(proto.isDefined("isTimeStampInvalid") && (buffers.isTimeStampInvalid != NULL))
+		sourceBuffers.push_back(SourceDestBuffer(imf_, "isTimeStampInvalid",       buffers.isTimeStampInvalid,       (unsigned) count, true));
 
 	if(pointDataExtension != NULL)
 		(*pointDataExtension)(imf_,proto, sourceBuffers);
@@ -2710,8 +4499,66 @@ CompressedVectorWriter	WriterImpl :: SetUpData3DPointsData(
 // create the writer, all buffers must be setup before this call
 	CompressedVectorWriter writer = points.writer(sourceBuffers);
 
+// collect the line groups as the points go by, they are written by Close()
+	if(generatedGroups_.count(dataIndex) > 0)
+	{
+		StructureNode groupingByLine(scan.get("pointGroupingSchemes/groupingByLine"));
+		CompressedVectorNode groups(groupingByLine.get("groups"));
+		vector<ustring> rangeNames;
+		if(StructureNode(groups.prototype()).isDefined("cartesianBounds"))
+		{
+			rangeNames.push_back("cartesianX");
+			rangeNames.push_back("cartesianY");
+			rangeNames.push_back("cartesianZ");
+		}
+		writer.trackGroups(StringNode(groupingByLine.get("idElementName")).value(), rangeNames);
+	}
+	if((pointChunkSizes_.count(dataIndex) > 0) &&
+		(buffers.cartesianX != NULL) && (buffers.cartesianY != NULL) && (buffers.cartesianZ != NULL))
+	{
+		vector<ustring> rangeNames;
+		rangeNames.push_back("cartesianX");
+		rangeNames.push_back("cartesianY");
+		rangeNames.push_back("cartesianZ");
+		writer.trackChunks(pointChunkSizes_[dataIndex], rangeNames);
+	}
+	if(pointPreviewStrides_.count(dataIndex) > 0)
+		writer.trackSamples(pointPreviewStrides_[dataIndex]);
+
+	PointsWriter pointsWriter = {dataIndex, writer, !doScaling(buffers.cartesianX)};
+	pointsWriters_.push_back(pointsWriter);
 	return writer;
 };
+
+CompressedVectorWriter	WriterImpl :: SetUpData3DPointsData(
+	int32_t		dataIndex,
+	int64_t		count,
+	const Data3DPointsData_t<double> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
+	)
+{
+	return SetUpData3DPointsDataT(dataIndex, count, buffers, pointDataExtension);
+};
+
+CompressedVectorWriter	WriterImpl :: SetUpData3DPointsData(
+	int32_t		dataIndex,
+	int64_t		count,
+	const Data3DPointsData_t<float> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
+	)
+{
+	return SetUpData3DPointsDataT(dataIndex, count, buffers, pointDataExtension);
+};
+
+CompressedVectorWriter	WriterImpl :: SetUpData3DPointsData(
+	int32_t		dataIndex,
+	int64_t		count,
+	const Data3DPointsData_t<int32_t> & buffers,
+	bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
+	)
+{
+	return SetUpData3DPointsDataT(dataIndex, count, buffers, pointDataExtension);
+};
 //! This funtion writes out the group data
 bool	WriterImpl :: WriteData3DGroupsData(
 						int32_t		dataIndex,			//!< data block index given by the NewData3D
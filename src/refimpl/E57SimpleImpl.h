@@ -49,6 +49,7 @@
 
 #include <vector>
 #include <set>
+#include <map>
 #include <string>
 #include <iostream>
 #include <iomanip>
@@ -97,6 +98,45 @@ void	GetSystemTimeFromGPSDateTime(
 	);
 #endif
 
+////////////////////////////////////////////////////////////////////
+//
+//	e57::PointTransform
+//
+
+//! This is what is done to the cartesian coordinates of each block of points as it is decoded, see Reader::SetPointTransform
+
+class	PointTransform {
+
+private:
+	bool			move_;			//!< the matrix is not the identity
+	bool			fromSpherical_;	//!< the cartesian coordinates are computed from the spherical ones
+	double			matrix_[3][4];	//!< rotation in the first three columns, translation in the last
+
+public:
+//! This function is the constructor for a transform that does nothing
+					PointTransform(void);
+
+//! This function is the constructor for the transform of the points of a Data3D
+					PointTransform(
+						StructureNode	scan,		//!< the Data3D
+						uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values read
+						bool		applyPose,		//!< move the points by the pose of the Data3D
+						const RigidBodyTransform * transform	//!< applied after the pose, NULL for none
+						);
+
+//! This function returns true if the transform changes the points
+	bool			Any(void) const {return move_ || fromSpherical_;};
+
+//! This function returns true if the cartesian coordinates are computed from the spherical ones
+	bool			FromSpherical(void) const {return fromSpherical_;};
+
+//! This function transforms the first count points of the buffers, nothing is done without cartesian buffers
+	void			Apply(
+						const Data3DPointsData & block,	//!< buffers of the points decoded
+						int64_t		count			//!< number of points decoded
+						) const;
+}; //end PointTransform class
+
 ////////////////////////////////////////////////////////////////////
 //
 //	e57::ReaderImpl
@@ -109,17 +149,52 @@ class	ReaderImpl : public boost::enable_shared_from_this<ReaderImpl> {
 private:
 
 	ImageFile		imf_;
+	ustring			configuration_;
 	StructureNode	root_;
 
 	VectorNode		data3D_;
 
 	VectorNode		images2D_;
 
+	bool				applyPose_;		//!< see SetPointTransform()
+	bool				hasTransform_;
+	RigidBodyTransform	transform_;
+
+//! Shared implementation of the SetUpData3DPointsData() functions
+template <typename COORDTYPE>
+	CompressedVectorReader	SetUpData3DPointsDataT(
+						int32_t		dataIndex,
+						int64_t		pointCount,
+						const Data3DPointsData_t<COORDTYPE> & buffers,
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers)
+						);
+
+//! Shared implementation of ReadData3DLines() and ReadData3DWindow(), crossCount < 0 reads whole lines
+	bool			ReadGridLines(
+						int32_t		dataIndex,
+						int64_t		firstLine,
+						int64_t		lineCount,
+						int64_t		firstCross,
+						int64_t		crossCount,
+						const Data3DPointsData & buffers,
+						int64_t		bufferSize,
+						int64_t &	pointCount
+						);
+
+//! This function gets the records of a Data3D that tell the cartesianBounds of chunks of its points
+	bool			ReadPointChunks(
+						int32_t		dataIndex,
+						vector<int64_t> & startPointIndex,
+						vector<int64_t> & pointCount,
+						vector<double> & bounds		//!< the six bounds of every chunk, one vector after the other
+						);
+
 public:
 
 //! This function is the constructor for the reader class
 					ReaderImpl(
-						const ustring & filePath		//!< file path string
+						const ustring & filePath,		//!< file path string
+						const ustring & configuration = ""	//!< options passed to ImageFile
 						);
 
 //! This function is the destructor for the reader class
@@ -263,6 +338,97 @@ virtual CompressedVectorReader	SetUpData3DPointsData(
 
 						);
 
+//! These functions set up the point data fields to be read straight into buffers of the given type, see Data3DPointsData_t
+virtual CompressedVectorReader	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each element buffer.
+						const Data3DPointsData_t<double> & buffers,	//!< buffers to receive the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers) = NULL
+						);
+virtual CompressedVectorReader	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each element buffer.
+						const Data3DPointsData_t<float> & buffers,	//!< buffers to receive the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers) = NULL
+						);
+virtual CompressedVectorReader	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each element buffer.
+						const Data3DPointsData_t<int32_t> & buffers,	//!< buffers to receive the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, int protoIndex, vector<SourceDestBuffer> & destBuffers) = NULL
+						);
+
+//! This function reads all the points of a Data3D into a PointCloud
+virtual	bool		LoadData3D(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values
+						PointCloud &	pointCloud,	//!< receives the points
+						int			threadCount		//!< number of threads decoding the fields
+						);
+
+//! This function sets the transform of the points loaded
+virtual	bool		SetPointTransform(
+						bool		applyPose,		//!< move the points by the pose of their Data3D
+						const RigidBodyTransform * transform	//!< applied after the pose, NULL for none
+						);
+
+//! This function returns the transform of the points of a Data3D loaded for fieldsMask
+	PointTransform	GetPointTransform(
+						StructureNode	scan,		//!< the Data3D, possibly from another ImageFile of the file
+						uint32_t	fieldsMask		//!< combination of e57::PointFieldsMask values read
+						) const {return PointTransform(scan, fieldsMask, applyPose_, hasTransform_ ? &transform_ : NULL);};
+
+//! This function reads all the points of every Data3D of the file, several Data3D at a time
+virtual	bool		ForEachData3DParallel(
+						uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values
+						const Data3DPointsFunction & function,	//!< called with the points of each Data3D
+						int			threadCount		//!< number of Data3D loaded at a time, 0 for the number of hardware threads
+						);
+
+//! This function reads whole lines of a gridded Data3D
+virtual	bool		ReadData3DLines(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						int64_t		firstLine,		//!< idElementValue of the first line to read
+						int64_t		lineCount,		//!< number of lines to read
+						const Data3DPointsData & buffers,	//!< buffers to receive the points
+						int64_t		bufferSize,		//!< number of elements in each of the buffers
+						int64_t &	pointCount		//!< receives the number of points stored in the buffers
+						);
+
+//! This function reads a rectangular window of the row/column grid of a gridded Data3D
+virtual	bool		ReadData3DWindow(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						int64_t		firstRow,		//!< rowIndex of the first row of the window
+						int64_t		rowCount,		//!< number of rows in the window
+						int64_t		firstColumn,	//!< columnIndex of the first column of the window
+						int64_t		columnCount,	//!< number of columns in the window
+						const Data3DPointsData & buffers,	//!< buffers to receive the points
+						int64_t		bufferSize,		//!< number of elements in each of the buffers
+						int64_t &	pointCount		//!< receives the number of points stored in the buffers
+						);
+
+//! This function reads a decimated preview of the points of a Data3D
+virtual	bool		ReadData3DPreview(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						const Data3DPointsData & buffers,	//!< buffers to receive the points
+						int64_t		bufferSize,		//!< number of elements in each of the buffers
+						int64_t &	pointCount		//!< receives the number of points stored in the buffers
+						);
+
+//! This function reads the points of a Data3D that are inside a box
+virtual	bool		ReadPointsInBox(
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						const CartesianBounds & box,	//!< bounds of the points to read, inclusive
+						const Data3DPointsData & buffers,	//!< buffers to receive the points
+						int64_t		bufferSize,		//!< number of elements in each of the buffers
+						int64_t &	pointCount		//!< receives the number of points stored in the buffers
+						);
+
+//! This function makes a point chunk index file for all the Data3D of the file
+virtual	bool		BuildPointChunkIndex(
+						int64_t		chunkSize		//!< number of points per chunk
+						);
+
 //! This function returns the file raw E57Root Structure Node
 virtual	StructureNode		GetRawE57Root(void);	//!< /return Returns the E57Root StructureNode
 //! This function returns the raw Data3D Vector Node
@@ -273,6 +439,58 @@ virtual VectorNode			GetRawImages2D(void);	//!< /return Returns the raw Image2D
 virtual ImageFile			GetRawIMF(void);  //!< /return Returns the raw ImageFile
 }; //end Reader class
 
+////////////////////////////////////////////////////////////////////
+//
+//	e57::Data3DIterator
+//
+
+//! This is the implementation of the e57::Data3DIterator, it reads the points into a PointCloud of BatchSize() points
+
+class	Data3DIteratorImpl {
+
+private:
+	boost::shared_ptr<ReaderImpl>	reader_;		//!< keeps the ImageFile open
+	PointCloud						batch_;			//!< buffers reused for every batch
+	boost::shared_ptr<CompressedVectorReader>	points_;	//!< NULL when there is no field to read
+	int64_t							totalCount_;	//!< number of records in the "points" CompressedVector
+	int64_t							firstPoint_;
+	int64_t							pointCount_;
+	PointTransform					transform_;		//!< applied to each batch
+
+public:
+//! This function is the constructor for the iterator
+					Data3DIteratorImpl(
+						boost::shared_ptr<ReaderImpl> reader,	//!< open reader
+						int32_t		dataIndex,		//!< This in the index into the images3D vector
+						uint32_t	fieldsMask,		//!< combination of e57::PointFieldsMask values
+						int64_t		memoryBudget	//!< bytes the buffers and the decoders may use
+						);
+
+//! This function is the destructor for the iterator
+					~Data3DIteratorImpl(void);
+
+//! This function reads the next batch of points into the buffers
+	bool			Next(void);
+
+//! This function returns the buffers holding the current batch
+	const Data3DPointsData & Points(void) const {return batch_;};
+
+//! This function returns the number of points in the current batch
+	int64_t			PointCount(void) const {return pointCount_;};
+
+//! This function returns the index of the first point of the current batch
+	int64_t			FirstPoint(void) const {return firstPoint_;};
+
+//! This function returns the number of elements in each of the buffers
+	int64_t			BatchSize(void) const {return batch_.pointCount;};
+
+//! This function returns the field groups that have buffers
+	uint32_t		FieldsMask(void) const {return batch_.fieldsMask;};
+
+//! This function releases the buffers and the file reader
+	void			Close(void);
+}; //end Data3DIteratorImpl class
+
 
 ////////////////////////////////////////////////////////////////////
 //
@@ -291,6 +509,52 @@ private:
 
 	VectorNode				images2D_;
 
+//! A points writer handed out by SetUpData3DPointsData(), it tracks the range of the values written
+	struct PointsWriter {
+		int32_t					dataIndex;
+		CompressedVectorWriter	writer;
+		bool					rawValues;	//!< ScaledInteger coordinates were written unscaled
+	};
+	std::vector<PointsWriter>	pointsWriters_;
+
+//! This function adds the bounds that the Data3D header left out, from the range of the values written
+	void			AddWrittenBounds(
+						const PointsWriter & pointsWriter
+						);
+
+//! The Data3D indexes whose line groups are generated from the points written
+	std::set<int32_t>			generatedGroups_;
+
+//! This function writes the line groups collected while the points were written
+	void			AddWrittenGroups(
+						PointsWriter & pointsWriter
+						);
+
+//! The pointChunkSize of the Data3D indexes whose point chunk bounds are collected from the points written
+	std::map<int32_t, int64_t>	pointChunkSizes_;
+
+//! This function writes the point chunk bounds collected while the points were written
+	void			AddWrittenChunks(
+						PointsWriter & pointsWriter
+						);
+
+//! The pointPreviewStride of the Data3D indexes whose preview points are kept from the points written
+	std::map<int32_t, int64_t>	pointPreviewStrides_;
+
+//! This function writes the preview points kept while the points were written
+	void			AddWrittenPreview(
+						PointsWriter & pointsWriter
+						);
+
+//! Shared implementation of the SetUpData3DPointsData() functions
+template <typename COORDTYPE>
+	CompressedVectorWriter	SetUpData3DPointsDataT(
+						int32_t		dataIndex,
+						int64_t		pointCount,
+						const Data3DPointsData_t<COORDTYPE> & buffers,
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers)
+						);
+
 public:
 
 //! This function is the constructor for the writer class
@@ -378,6 +642,26 @@ virtual CompressedVectorWriter	SetUpData3DPointsData(
 						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers) = NULL
 						);
 
+//! These functions set up the point data fields to be written straight from buffers of the given type, see Data3DPointsData_t
+virtual CompressedVectorWriter	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each of the buffers given
+						const Data3DPointsData_t<double> & buffers,	//!< buffers with the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers) = NULL
+						);
+virtual CompressedVectorWriter	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each of the buffers given
+						const Data3DPointsData_t<float> & buffers,	//!< buffers with the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers) = NULL
+						);
+virtual CompressedVectorWriter	SetUpData3DPointsData(
+						int32_t		dataIndex,			//!< data block index given by the NewData3D
+						int64_t		pointCount,			//!< size of each of the buffers given
+						const Data3DPointsData_t<int32_t> & buffers,	//!< buffers with the point fields
+						bool		(*pointDataExtension)(ImageFile	imf, StructureNode proto, vector<SourceDestBuffer> & sourceBuffers) = NULL
+						);
+
 
 //! This funtion writes out the group data
 virtual bool		WriteData3DGroupsData(
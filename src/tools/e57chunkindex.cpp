@@ -0,0 +1,105 @@
+/*
+ * e57chunkindex.cpp - make a point chunk index file for the Data3D of an E57 file.
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "E57Simple.h"
+
+using namespace e57;
+using namespace std;
+
+struct CommandLineOptions {
+    int64_t chunkSize;
+    ustring inputFileName;
+
+            CommandLineOptions():chunkSize(65536){};
+    void    parse(int argc, char** argv);
+};
+
+//================================================================
+
+void usage(ustring msg)
+{
+    cerr << "ERROR: " << msg << endl;
+    cerr << "Usage:" << endl;
+    cerr << "    e57chunkindex [-chunk <points>] <e57_file>" << endl;
+    cerr << "    The index is written to <e57_file>.chunks, where Reader::ReadPointsInBox looks for it." << endl;
+    cerr << "    For example:" << endl;
+    cerr << "        e57chunkindex scan0001.e57" << endl;
+    cerr << "        e57chunkindex -chunk 16384 scan0001.e57" << endl;
+    cerr << endl;
+    exit(-1);
+}
+
+
+void CommandLineOptions::parse(int argc, char** argv)
+{
+    /// Skip program name
+    argc--; argv++;
+
+    for (; argc > 0 && *argv[0] == '-'; argc--,argv++) {
+        if (strcmp(argv[0], "-chunk") == 0 && argc > 1) {
+            argc--; argv++;
+            chunkSize = atoll(argv[0]);
+            if (chunkSize <= 0)
+                usage(ustring("bad chunk size: ") + argv[0]);
+        } else
+            usage(ustring("unknown option: ") + argv[0]);
+    }
+
+    if (argc != 1)
+        usage("wrong number of command line arguments");
+
+    inputFileName = argv[0];
+}
+
+//================================================================
+
+int main(int argc, char** argv)
+{
+    /// Catch any exceptions thrown.
+    try {
+        CommandLineOptions options;
+        options.parse(argc, argv);
+
+        Reader reader(options.inputFileName);
+        if (!reader.BuildPointChunkIndex(options.chunkSize)) {
+            cerr << "Error: could not make the point chunk index of " << options.inputFileName << endl;
+            return -1;
+        }
+        reader.Close();
+    } catch(E57Exception& ex) {
+        ex.report(__FILE__, __LINE__, __FUNCTION__);
+        return -1;
+    } catch (std::exception& ex) {
+        cerr << "Got an std::exception, what=" << ex.what() << endl;
+        return -1;
+    } catch (...) {
+        cerr << "Got an unknown exception" << endl;
+        return -1;
+    }
+    return 0;
+}
@@ -31,6 +31,12 @@
 #include <float.h>
 #include <map>
 #include <memory>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+#include <exception>
 #include "E57Foundation.h"
 #include "E57FoundationImpl.h" //??? for exceptions, should be in separate file
 
@@ -52,8 +58,9 @@ ustring decimalString(uint64_t x) {std::ostringstream ss; ss << x; return(ss.str
 struct CommandLineOptions {
     ustring startPath;
     ustring inputFileName;
+    unsigned threads;
 
-            CommandLineOptions(){};
+            CommandLineOptions():threads(0){};
     void    parse(int argc, char** argv);
 };
 
@@ -99,7 +106,7 @@ struct Statistics {
 };
 
 /// Forward declarations for local functions
-void gatherStats(Node n, Statistics& stats, ImageFile imf);
+void gatherStats(CommandLineOptions& options, Node n, Statistics& stats, ImageFile imf);
 void printStats(CommandLineOptions& options, Statistics& stats, ImageFile imf);
 
 int main(int argc, char** argv)
@@ -115,14 +122,14 @@ int main(int argc, char** argv)
 
         Statistics stats;
         if (options.startPath == "")
-            gatherStats(root, stats, imf);
+            gatherStats(options, root, stats, imf);
         else {
             ///??? handle case where startPath is a compressed node (inside a CompressedVector).
             if (!root.isDefined(options.startPath)) {
                 cerr << "Error: E57 path " << options.startPath << " not defined." << endl;
                 return 0;
             }
-            gatherStats(root.get(options.startPath), stats, imf);
+            gatherStats(options, root.get(options.startPath), stats, imf);
         }
 
         printStats(options, stats, imf);
@@ -145,10 +152,13 @@ void usage(ustring msg)
 {
     cerr << "ERROR: " << msg << endl;
     cerr << "Usage:" << endl;
-    cerr << "    e57fields <e57_file> [start_path]" << endl;
+    cerr << "    e57fields [options] <e57_file> [start_path]" << endl;
+    cerr << "    where options are:" << endl;
+    cerr << "        -threads <n>   read large CompressedVectors with n threads (default: number of cores)" << endl;
     cerr << "    For example:" << endl;
     cerr << "        e57fields scan0001.e57" << endl;
     cerr << "        e57fields scan0001.e57 /data3D/0/points" << endl;
+    cerr << "        e57fields -threads 4 scan0001.e57" << endl;
     cerr << endl;
     exit(-1); //??? consistent with other utilities?
 }
@@ -159,15 +169,25 @@ void CommandLineOptions::parse(int argc, char** argv)
     /// Skip program name
     argc--; argv++;
 
-//??? no options yet
-//    for (; argc > 0 && *argv[0] == '-'; argc--,argv++) {
-//        if (strcmp(argv[0], "-unusedNotOptional") == 0)
-//            unusedNotOptional = true;
-//        else {
-//            usage(ustring("unknown option: ") + argv[0]);
-//            throw EXCEPTION("unknown option"); //??? UsageException
-//        }
-//    }
+    for (; argc > 0 && *argv[0] == '-'; argc--,argv++) {
+        if (strcmp(argv[0], "-threads") == 0) {
+            if (argc < 2)
+                usage("missing value of -threads option");
+            argc--; argv++;
+            int n = atoi(argv[0]);
+            if (n < 1)
+                usage(ustring("bad value of -threads option: ") + argv[0]);
+            threads = static_cast<unsigned>(n);
+        } else
+            usage(ustring("unknown option: ") + argv[0]);
+    }
+
+    /// Default to one thread per core
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+    }
 
 	if (argc != 1 && argc != 2)
         usage("wrong number of command line arguments");
@@ -369,21 +389,24 @@ void calcDoubleStats(OccurrenceStats* occur, const char* measure, double value,
 
     occur->sum += value;
 
-    /// Compute minimum value
-    if (occur->minimum.count == 0 || value < occur->minimum.dvalue) {
-        occur->minimum.dvalue = value;
-        occur->minimum.count = 1;
-        occur->minimum.firstPath = getPathFunctor.getPath();
-    } else if (value == occur->minimum.dvalue)
-        occur->minimum.count++;
-
-    /// Compute maximum value
-    if (occur->maximum.count == 0 || value > occur->maximum.dvalue) {
-        occur->maximum.dvalue = value;
-        occur->maximum.count = 1;
-        occur->maximum.firstPath = getPathFunctor.getPath();
-    } else if (value == occur->maximum.dvalue)
-        occur->maximum.count++;
+    /// NaNs are counted below, but don't take part in the extrema (otherwise a leading NaN would stick as min and max).
+    if (value == value) {
+        /// Compute minimum value
+        if (occur->minimum.count == 0 || value < occur->minimum.dvalue) {
+            occur->minimum.dvalue = value;
+            occur->minimum.count = 1;
+            occur->minimum.firstPath = getPathFunctor.getPath();
+        } else if (value == occur->minimum.dvalue)
+            occur->minimum.count++;
+
+        /// Compute maximum value
+        if (occur->maximum.count == 0 || value > occur->maximum.dvalue) {
+            occur->maximum.dvalue = value;
+            occur->maximum.count = 1;
+            occur->maximum.firstPath = getPathFunctor.getPath();
+        } else if (value == occur->maximum.dvalue)
+            occur->maximum.count++;
+    }
 
     /// Record occurrences of zeros
     if (value == 0) {
@@ -416,12 +439,14 @@ void calcDoubleStats(OccurrenceStats* occur, const char* measure, double value,
             }
             occur->denormalized.count++;
             break;
-        case FP_ZERO:   // Negative zero (-0)
-            if (value < 0.0 && occur->negativeZero.count == 0) {
-                occur->negativeZero.dvalue = value;
-                occur->negativeZero.firstPath = getPathFunctor.getPath();
+        case FP_ZERO:   // Negative zero (-0), which compares equal to 0, so test the sign bit
+            if (std::signbit(value)) {
+                if (occur->negativeZero.count == 0) {
+                    occur->negativeZero.dvalue = value;
+                    occur->negativeZero.firstPath = getPathFunctor.getPath();
+                }
+                occur->negativeZero.count++;
             }
-            occur->negativeZero.count++;
             break;
         default:
             break;
@@ -430,6 +455,273 @@ void calcDoubleStats(OccurrenceStats* occur, const char* measure, double value,
 
 //================================================================
 
+/// Statistics of one block of values of a CompressedVector element (one transfer buffer full).
+/// They are computed with a few branch-free loops over the buffer, which the compiler can vectorize,
+/// then merged into the OccurrenceStats by mergeBlockStats() with the same result as calling
+/// calcInt64Stats() or calcDoubleStats() on each value in turn.
+/// The first occurrences of interesting values are only searched for when they are really needed.
+template <class T>
+struct BlockStats {
+    const T*    values;             // NULL if every value in the block is the same (e.g. childCount of a prototype branch)
+    T           constant;           // the value when values==NULL
+    unsigned    count;
+    double      sum;
+    unsigned    valueCount;         // number of values that aren't NaN, only these take part in the extrema
+    T           minimum;
+    T           maximum;
+    unsigned    minimumCount;
+    unsigned    maximumCount;
+    unsigned    zeroCount;
+    unsigned    nanCount;
+    unsigned    infinityCount;
+    unsigned    denormalizedCount;
+    unsigned    negativeZeroCount;
+
+    BlockStats():values(NULL),constant(0),count(0),sum(0.0),valueCount(0),minimum(0),maximum(0),minimumCount(0),
+                 maximumCount(0),zeroCount(0),nanCount(0),infinityCount(0),denormalizedCount(0),negativeZeroCount(0){};
+
+    T           value(unsigned i) const {return(values ? values[i] : constant);};
+};
+
+void calcBlockStats(const int64_t* values, unsigned count, BlockStats<int64_t>& b)
+{
+    b = BlockStats<int64_t>();
+    b.values = values;
+    b.count = count;
+    b.valueCount = count;
+    if (count == 0)
+        return;
+
+    int64_t minimum = values[0];
+    int64_t maximum = values[0];
+    unsigned zeroCount = 0;
+    double sums[4] = {0.0, 0.0, 0.0, 0.0};  // independent partial sums, so the additions don't wait on each other
+    for (unsigned i = 0; i < count; i++) {
+        int64_t value = values[i];
+        minimum = (value < minimum) ? value : minimum;
+        maximum = (value > maximum) ? value : maximum;
+        zeroCount += (value == 0);
+        sums[i & 3] += static_cast<double>(value);
+    }
+
+    unsigned minimumCount = 0;
+    unsigned maximumCount = 0;
+    for (unsigned i = 0; i < count; i++) {
+        minimumCount += (values[i] == minimum);
+        maximumCount += (values[i] == maximum);
+    }
+
+    b.sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    b.minimum = minimum;
+    b.maximum = maximum;
+    b.minimumCount = minimumCount;
+    b.maximumCount = maximumCount;
+    b.zeroCount = zeroCount;
+}
+
+void calcBlockStats(const double* values, unsigned count, BlockStats<double>& b)
+{
+    b = BlockStats<double>();
+    b.values = values;
+    b.count = count;
+
+    const double infinity = numeric_limits<double>::infinity();
+    double minimum = infinity;
+    double maximum = -infinity;
+    unsigned nanCount = 0;
+    unsigned zeroCount = 0;
+    unsigned infinityCount = 0;
+    unsigned denormalizedCount = 0;
+    unsigned negativeZeroCount = 0;
+    double sums[4] = {0.0, 0.0, 0.0, 0.0};
+    for (unsigned i = 0; i < count; i++) {
+        double value = values[i];
+        double magnitude = fabs(value);
+
+        /// Comparisons with NaN are false, so NaNs never become an extremum
+        minimum = (value < minimum) ? value : minimum;
+        maximum = (value > maximum) ? value : maximum;
+        nanCount          += (value != value);
+        zeroCount         += (value == 0.0);
+        infinityCount     += (magnitude == infinity);
+        denormalizedCount += (magnitude < DBL_MIN && value != 0.0);
+        negativeZeroCount += (value == 0.0 && std::signbit(value));
+        sums[i & 3] += value;
+    }
+
+    unsigned minimumCount = 0;
+    unsigned maximumCount = 0;
+    for (unsigned i = 0; i < count; i++) {
+        minimumCount += (values[i] == minimum);
+        maximumCount += (values[i] == maximum);
+    }
+
+    b.sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    b.valueCount = count - nanCount;
+    b.minimum = minimum;
+    b.maximum = maximum;
+    b.minimumCount = minimumCount;
+    b.maximumCount = maximumCount;
+    b.zeroCount = zeroCount;
+    b.nanCount = nanCount;
+    b.infinityCount = infinityCount;
+    b.denormalizedCount = denormalizedCount;
+    b.negativeZeroCount = negativeZeroCount;
+}
+
+void calcConstantBlockStats(int64_t value, unsigned count, BlockStats<int64_t>& b)
+{
+    b = BlockStats<int64_t>();
+    b.constant = value;
+    b.count = count;
+    b.valueCount = count;
+    b.sum = static_cast<double>(value) * count;
+    b.minimum = b.maximum = value;
+    b.minimumCount = b.maximumCount = count;
+    b.zeroCount = (value == 0) ? count : 0;
+}
+
+/// Access the field of a StatEntry that holds values of type T
+inline int64_t& entryValue(StatEntry& entry, int64_t) {return(entry.ivalue);}
+inline double&  entryValue(StatEntry& entry, double)  {return(entry.dvalue);}
+
+/// Index of first value in block that matches, only called when the block has at least one.
+template <class T, class Predicate>
+unsigned firstIndex(const BlockStats<T>& b, Predicate matches)
+{
+    unsigned i = 0;
+    while (i < b.count - 1 && !matches(b.value(i)))
+        i++;
+    return(i);
+}
+
+/// Add count occurrences of a special value from block, remembering the first one if it is the first seen.
+template <class T, class Predicate>
+void mergeSpecialValue(StatEntry& entry, unsigned count, const BlockStats<T>& b, uint64_t firstRecord,
+                       GetPathFunctor& getPathFunctor, Predicate matches)
+{
+    if (count == 0)
+        return;
+    if (entry.count == 0) {
+        unsigned i = firstIndex(b, matches);
+        entryValue(entry, T()) = b.value(i);
+        getPathFunctor.setRecordNumber(firstRecord + i);
+        entry.firstPath = getPathFunctor.getPath();
+    }
+    entry.count += count;
+}
+
+template <class T>
+void mergeBlockStats(OccurrenceStats* occur, const char* measure, const BlockStats<T>& b, uint64_t firstRecord,
+                     GetPathFunctor& getPathFunctor)
+{
+    if (b.count == 0)
+        return;
+
+    if (occur->count == 0) {
+        occur->measure = measure;
+        getPathFunctor.setRecordNumber(firstRecord);
+        occur->firstPath = getPathFunctor.getPath();
+    }
+    occur->count += b.count;
+    occur->sum += b.sum;
+
+    if (b.valueCount > 0) {
+        /// Compute minimum value, the value and path stored are those of the first equal value (e.g. 0 or -0)
+        T& minimum = entryValue(occur->minimum, T());
+        if (occur->minimum.count == 0 || b.minimum < minimum) {
+            unsigned i = firstIndex(b, [&b](T value){return(value == b.minimum);});
+            minimum = b.value(i);
+            occur->minimum.count = b.minimumCount;
+            getPathFunctor.setRecordNumber(firstRecord + i);
+            occur->minimum.firstPath = getPathFunctor.getPath();
+        } else if (b.minimum == minimum)
+            occur->minimum.count += b.minimumCount;
+
+        /// Compute maximum value
+        T& maximum = entryValue(occur->maximum, T());
+        if (occur->maximum.count == 0 || b.maximum > maximum) {
+            unsigned i = firstIndex(b, [&b](T value){return(value == b.maximum);});
+            maximum = b.value(i);
+            occur->maximum.count = b.maximumCount;
+            getPathFunctor.setRecordNumber(firstRecord + i);
+            occur->maximum.firstPath = getPathFunctor.getPath();
+        } else if (b.maximum == maximum)
+            occur->maximum.count += b.maximumCount;
+    }
+
+    /// Record occurrences of zeros and special floating point values (the counts are zero for integers)
+    mergeSpecialValue(occur->zero, b.zeroCount, b, firstRecord, getPathFunctor,
+                      [](T value){return(value == 0);});
+    mergeSpecialValue(occur->quietNan, b.nanCount, b, firstRecord, getPathFunctor,
+                      [](T value){return(value != value);});
+    mergeSpecialValue(occur->infinity, b.infinityCount, b, firstRecord, getPathFunctor,
+                      [](T value){return(std::isinf(static_cast<double>(value)));});
+    mergeSpecialValue(occur->denormalized, b.denormalizedCount, b, firstRecord, getPathFunctor,
+                      [](T value){return(value != 0 && fabs(static_cast<double>(value)) < DBL_MIN);});
+    mergeSpecialValue(occur->negativeZero, b.negativeZeroCount, b, firstRecord, getPathFunctor,
+                      [](T value){return(value == 0 && std::signbit(static_cast<double>(value)));});
+}
+
+//================================================================
+
+/// Add the statistics gathered on a later part of the file (e.g. by another thread) to stats.
+void mergeStatEntry(StatEntry& to, const StatEntry& from)
+{
+    if (from.count == 0)
+        return;
+    if (to.count == 0) {
+        to = from;
+        return;
+    }
+    to.count += from.count;
+}
+
+void mergeOccurrenceStats(OccurrenceStats& to, const OccurrenceStats& from)
+{
+    if (from.count == 0)
+        return;
+    if (to.count == 0) {
+        to = from;
+        return;
+    }
+    to.count += from.count;
+    to.sum += from.sum;
+
+    /// Only one of ivalue and dvalue is used in an OccurrenceStats, the other stays zero, so comparing both works for either type.
+    if (from.minimum.count > 0) {
+        if (to.minimum.count == 0 || from.minimum.ivalue < to.minimum.ivalue || from.minimum.dvalue < to.minimum.dvalue)
+            to.minimum = from.minimum;
+        else if (from.minimum.ivalue == to.minimum.ivalue && from.minimum.dvalue == to.minimum.dvalue)
+            to.minimum.count += from.minimum.count;
+    }
+    if (from.maximum.count > 0) {
+        if (to.maximum.count == 0 || from.maximum.ivalue > to.maximum.ivalue || from.maximum.dvalue > to.maximum.dvalue)
+            to.maximum = from.maximum;
+        else if (from.maximum.ivalue == to.maximum.ivalue && from.maximum.dvalue == to.maximum.dvalue)
+            to.maximum.count += from.maximum.count;
+    }
+
+    mergeStatEntry(to.zero,         from.zero);
+    mergeStatEntry(to.quietNan,     from.quietNan);
+    mergeStatEntry(to.signalingNan, from.signalingNan);
+    mergeStatEntry(to.infinity,     from.infinity);
+    mergeStatEntry(to.denormalized, from.denormalized);
+    mergeStatEntry(to.negativeZero, from.negativeZero);
+}
+
+void mergeStatistics(Statistics& to, const Statistics& from)
+{
+    for (map<ustring, OccurrenceStats>::const_iterator iter = from.typeStats.begin(); iter != from.typeStats.end(); ++iter)
+        mergeOccurrenceStats(to.typeStats[iter->first], iter->second);
+    for (map<pair<ustring,ustring>, OccurrenceStats>::const_iterator iter = from.fieldTypeStats.begin(); iter != from.fieldTypeStats.end(); ++iter)
+        mergeOccurrenceStats(to.fieldTypeStats[iter->first], iter->second);
+    for (map<pair<ustring,ustring>, OccurrenceStats>::const_iterator iter = from.fieldDistinctTypeStats.begin(); iter != from.fieldDistinctTypeStats.end(); ++iter)
+        mergeOccurrenceStats(to.fieldDistinctTypeStats[iter->first], iter->second);
+}
+
+//================================================================
+
 struct CVElementInfo {
     static const int BUFFER_ELEMENT_COUNT = 10*1024;
 
@@ -546,8 +838,9 @@ void makeCVInfo(CompressedVectorNode cv, vector<CVElementInfo>& cvElements,
                 destBuffers.push_back(SourceDestBuffer(imf, protoPathName, &(*(einfo.dBuffer))[0], einfo.dBuffer->size(), true, true));
                 break;
             case E57_STRING:
-                /// Resize string buffer and add it to destBuffers
+                /// Resize string buffer and add it to destBuffers, the lengths of the strings are put in the int64_t buffer
                 einfo.sBuffer->resize(CVElementInfo::BUFFER_ELEMENT_COUNT);
+                einfo.iBuffer->resize(CVElementInfo::BUFFER_ELEMENT_COUNT);
                 destBuffers.push_back(SourceDestBuffer(imf, protoPathName, &(*einfo.sBuffer))); //!!! change to buffer ref
                 break;
             case E57_COMPRESSED_VECTOR:
@@ -561,103 +854,162 @@ void makeCVInfo(CompressedVectorNode cv, vector<CVElementInfo>& cvElements,
     }
 }
 
-void gatherCompressedVectorStats(CompressedVectorNode cv, Statistics& stats, ImageFile imf)
+bool hasStringField(CompressedVectorNode cv)
 {
-#ifdef VERBOSE
-    cout << "gathering stats on CompressedVector: " << cv.pathName() << endl;
-#endif
+    vector<Node> allNodes;
+    findAllNodes(cv.prototype(), allNodes);
+    for (unsigned i = 0; i < allNodes.size(); i++) {
+        if (allNodes[i].type() == E57_STRING)
+            return(true);
+    }
+    return(false);
+}
 
+void gatherCompressedVectorRange(CompressedVectorNode cv, Statistics& stats, ImageFile imf, uint64_t firstRecord, uint64_t endRecord)
+{
     /// Make a list of all elements in prototype and allocate appropriate transfer buffers
     vector<CVElementInfo> cvElements;
     vector<SourceDestBuffer> destBuffers;
     makeCVInfo(cv, cvElements, imf, stats, destBuffers);
 
     CompressedVectorReader reader = cv.reader(destBuffers);
+    if (firstRecord > 0)
+        reader.seek(firstRecord);
 
-    unsigned gotCount = 0;
-    uint64_t recordNumber = 0;
-    do {
+    BlockStats<int64_t> iStats;
+    BlockStats<double>  dStats;
+    uint64_t recordNumber = firstRecord;
+    while (recordNumber < endRecord) {
         /// Read a block of data into the buffers stored in each CVElementInfo
-        gotCount = reader.read();
+        unsigned gotCount = reader.read();
+        if (gotCount == 0)
+            break;
+
+        /// The last block of a range may run into the next one, which is another thread's work
+        if (gotCount > endRecord - recordNumber)
+            gotCount = static_cast<unsigned>(endRecord - recordNumber);
 
         for (unsigned elem = 0; elem < cvElements.size(); elem++) {
             CVElementInfo* cvElement = &cvElements.at(elem);
             Node protoNode = cvElement->protoNode;
 
-            /// Update the getPathFunctor with the current recordNumber
-            /// If the pathName of a CV element is needed (e.g. when new minimum found) this recordNumber will be used.
-//???
+            /// Reduce the block to a BlockStats, then merge it into the three OccurrenceStats of the element.
+            /// If the pathName of a CV element is needed (e.g. when new minimum found) it is made from the recordNumber then.
+            const char* measure = "value";
+            bool isDouble = false;
             switch (protoNode.type()) {
-                case E57_STRUCTURE: {
-                    StructureNode s(protoNode);
-                    int64_t value = s.childCount();  /// value is same for each record in CompressedVector
-                    for (unsigned i = 0; i < gotCount; i++) {
-                        cvElement->getPathFunctor.setRecordNumber(recordNumber+i);
-                        calcInt64Stats(cvElement->typeOccur,              "childCount", value, cvElement->getPathFunctor);
-                        calcInt64Stats(cvElement->fieldTypeOccur,         "childCount", value, cvElement->getPathFunctor);
-                        calcInt64Stats(cvElement->fieldDistinctTypeOccur, "childCount", value, cvElement->getPathFunctor);
-                    }
-                }
+                case E57_STRUCTURE:
+                    /// value is same for each record in CompressedVector
+                    calcConstantBlockStats(StructureNode(protoNode).childCount(), gotCount, iStats);
+                    measure = "childCount";
                 break;
-                case E57_VECTOR: {
-                    VectorNode v(protoNode);
-                    int64_t value = v.childCount();  /// value is same for each record in CompressedVector
-                    for (unsigned i = 0; i < gotCount; i++) {
-                        cvElement->getPathFunctor.setRecordNumber(recordNumber+i);
-                        calcInt64Stats(cvElement->typeOccur,              "childCount", value, cvElement->getPathFunctor);
-                        calcInt64Stats(cvElement->fieldTypeOccur,         "childCount", value, cvElement->getPathFunctor);
-                        calcInt64Stats(cvElement->fieldDistinctTypeOccur, "childCount", value, cvElement->getPathFunctor);
-                    }
-                }
+                case E57_VECTOR:
+                    /// value is same for each record in CompressedVector
+                    calcConstantBlockStats(VectorNode(protoNode).childCount(), gotCount, iStats);
+                    measure = "childCount";
                 break;
-                case E57_INTEGER: {
-                    int64_t* p = &cvElement->iBuffer->at(0);
-                    for (unsigned i = 0; i < gotCount; i++,p++) {
-                        int64_t value = *p;
-                        cvElement->getPathFunctor.setRecordNumber(recordNumber+i);
-                        calcInt64Stats(cvElement->typeOccur,              "value", value, cvElement->getPathFunctor);
-                        calcInt64Stats(cvElement->fieldTypeOccur,         "value", value, cvElement->getPathFunctor);
-                        calcInt64Stats(cvElement->fieldDistinctTypeOccur, "value", value, cvElement->getPathFunctor);
-                    }
-                }
+                case E57_INTEGER:
+                    calcBlockStats(&cvElement->iBuffer->at(0), gotCount, iStats);
                 break;
                 case E57_SCALED_INTEGER:
-                case E57_FLOAT: {
-                    double* p = &cvElement->dBuffer->at(0);
-                    for (unsigned i = 0; i < gotCount; i++,p++) {
-                        double value = *p;
-                        cvElement->getPathFunctor.setRecordNumber(recordNumber+i);
-                        calcDoubleStats(cvElement->typeOccur,              "value", value, cvElement->getPathFunctor);
-                        calcDoubleStats(cvElement->fieldTypeOccur,         "value", value, cvElement->getPathFunctor);
-                        calcDoubleStats(cvElement->fieldDistinctTypeOccur, "value", value, cvElement->getPathFunctor);
-                    }
-                }
+                case E57_FLOAT:
+                    calcBlockStats(&cvElement->dBuffer->at(0), gotCount, dStats);
+                    isDouble = true;
                 break;
                 case E57_STRING: {
-                    for (unsigned i = 0; i < gotCount; i++) {
-                        int64_t value = cvElement->sBuffer->at(i).length();  // Get length of next string in transfer buffer
-                        cvElement->getPathFunctor.setRecordNumber(recordNumber+i);
-                        calcInt64Stats(cvElement->typeOccur,              "length", value, cvElement->getPathFunctor);
-                        calcInt64Stats(cvElement->fieldTypeOccur,         "length", value, cvElement->getPathFunctor);
-                        calcInt64Stats(cvElement->fieldDistinctTypeOccur, "length", value, cvElement->getPathFunctor);
-                    }
+                    vector<int64_t>& lengths = *cvElement->iBuffer;
+                    for (unsigned i = 0; i < gotCount; i++)
+                        lengths[i] = cvElement->sBuffer->at(i).length();  // Get length of next string in transfer buffer
+                    calcBlockStats(&lengths[0], gotCount, iStats);
+                    measure = "length";
                 }
                 break;
                 case E57_BLOB:
                 case E57_COMPRESSED_VECTOR:
                     /// These shouldn't happen in a CompressedVector
-                    break;
+                    continue;
+            }
+
+            if (isDouble) {
+                mergeBlockStats(cvElement->typeOccur,              measure, dStats, recordNumber, cvElement->getPathFunctor);
+                mergeBlockStats(cvElement->fieldTypeOccur,         measure, dStats, recordNumber, cvElement->getPathFunctor);
+                mergeBlockStats(cvElement->fieldDistinctTypeOccur, measure, dStats, recordNumber, cvElement->getPathFunctor);
+            } else {
+                mergeBlockStats(cvElement->typeOccur,              measure, iStats, recordNumber, cvElement->getPathFunctor);
+                mergeBlockStats(cvElement->fieldTypeOccur,         measure, iStats, recordNumber, cvElement->getPathFunctor);
+                mergeBlockStats(cvElement->fieldDistinctTypeOccur, measure, iStats, recordNumber, cvElement->getPathFunctor);
             }
         }
         recordNumber += gotCount;
-    } while (gotCount > 0);
+    }
     reader.close();
 }
 
+/// CompressedVectors with fewer records than this per thread are read by a single thread
+const uint64_t MIN_SHARD_RECORD_COUNT = 1024*1024;
+
+void gatherCompressedVectorStats(CommandLineOptions& options, CompressedVectorNode cv, Statistics& stats, ImageFile imf)
+{
+#ifdef VERBOSE
+    cout << "gathering stats on CompressedVector: " << cv.pathName() << endl;
+#endif
+
+    /// Split the records into contiguous ranges, one per thread.
+    /// Ranges other than the first are found with CompressedVectorReader::seek, which can't skip strings.
+    uint64_t recordCount = cv.childCount();
+    uint64_t shardCount = recordCount / MIN_SHARD_RECORD_COUNT;
+    if (shardCount > options.threads)
+        shardCount = options.threads;
+    if (shardCount <= 1 || hasStringField(cv)) {
+        gatherCompressedVectorRange(cv, stats, imf, 0, recordCount);
+        return;
+    }
+
+    /// An ImageFile can only be used by one thread at a time, so each extra thread opens the file again.
+    /// Each thread gathers into its own Statistics, which are merged in record order afterwards,
+    /// so the first occurrences come out the same as reading the records in turn.
+    ustring fileName = imf.fileName();
+    ustring cvPath = cv.pathName();
+    vector<Statistics> shardStats(static_cast<size_t>(shardCount));
+    vector<exception_ptr> shardErrors(static_cast<size_t>(shardCount));
+    vector<std::thread> threads;
+    for (unsigned shard = 1; shard < shardCount; shard++) {
+        uint64_t firstRecord = recordCount * shard / shardCount;
+        uint64_t endRecord   = recordCount * (shard + 1) / shardCount;
+        threads.push_back(std::thread([&, shard, firstRecord, endRecord]() {
+            try {
+                ImageFile shardImf(fileName, "r", "lazyXml");
+                CompressedVectorNode shardCv(shardImf.root().get(cvPath));
+                gatherCompressedVectorRange(shardCv, shardStats[shard], shardImf, firstRecord, endRecord);
+                shardImf.close();
+            } catch (...) {
+                shardErrors[shard] = current_exception();
+            }
+        }));
+    }
+
+    /// The first range goes straight into stats, on this thread
+    try {
+        gatherCompressedVectorRange(cv, stats, imf, 0, recordCount / shardCount);
+    } catch (...) {
+        shardErrors[0] = current_exception();
+    }
+
+    for (unsigned i = 0; i < threads.size(); i++)
+        threads[i].join();
+    for (unsigned shard = 0; shard < shardCount; shard++) {
+        if (shardErrors[shard])
+            rethrow_exception(shardErrors[shard]);
+    }
+
+    for (unsigned shard = 1; shard < shardCount; shard++)
+        mergeStatistics(stats, shardStats[shard]);
+}
+
 
 //================================================================
 
-void gatherStats(Node n, Statistics& stats, ImageFile imf)
+void gatherStats(CommandLineOptions& options, Node n, Statistics& stats, ImageFile imf)
 {
 #ifdef VERBOSE
     cout << "gathering stats on node " << n.pathName() << endl;
@@ -701,7 +1053,7 @@ void gatherStats(Node n, Statistics& stats, ImageFile imf)
             /// Gather stats on all of children
             uint64_t childCount = s.childCount();
             for (uint64_t i = 0; i < childCount; i++)
-                gatherStats(s.get(i), stats, imf);
+                gatherStats(options, s.get(i), stats, imf);
         }
         break;
         case E57_VECTOR: {
@@ -713,7 +1065,7 @@ void gatherStats(Node n, Statistics& stats, ImageFile imf)
             /// Gather stats on all of children
             uint64_t childCount = v.childCount();
             for (uint64_t i = 0; i < childCount; i++)
-                gatherStats(v.get(i), stats, imf);
+                gatherStats(options, v.get(i), stats, imf);
         }
         break;
         case E57_COMPRESSED_VECTOR: {
@@ -722,7 +1074,7 @@ void gatherStats(Node n, Statistics& stats, ImageFile imf)
             calcInt64Stats(fieldTypeOccur, "childCount", cv.childCount(), getPathFunctor);
             calcInt64Stats(fieldDistinctTypeOccur, "childCount", cv.childCount(), getPathFunctor);
 
-            gatherCompressedVectorStats(cv, stats, imf);
+            gatherCompressedVectorStats(options, cv, stats, imf);
         }
         break;
         case E57_INTEGER: {
@@ -0,0 +1,157 @@
+/*
+ * e57integrity.cpp - check the page checksums and packet chains of E57 files.
+ *
+ * Permission is hereby granted, free of charge, to any person or organization
+ * obtaining a copy of the software and accompanying documentation covered by
+ * this license (the "Software") to use, reproduce, display, distribute,
+ * execute, and transmit the Software, and to prepare derivative works of the
+ * Software, and to permit third-parties to whom the Software is furnished to
+ * do so, all subject to the following:
+ *
+ * The copyright notices in the Software and this entire statement, including
+ * the above license grant, this restriction and the following disclaimer,
+ * must be included in all copies of the Software, in whole or in part, and
+ * all derivative works of the Software, unless such copies or derivative
+ * works are solely in the form of machine-executable object code generated by
+ * a source language processor.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "E57Foundation.h"
+
+using namespace e57;
+using namespace std;
+
+struct CommandLineOptions {
+    bool    quiet;
+    size_t  maxErrorCount;
+    vector<ustring> fileNames;
+
+            CommandLineOptions():quiet(false),maxErrorCount(100){};
+    void    parse(int argc, char** argv);
+};
+
+//================================================================
+
+void usage(ustring msg)
+{
+    cerr << "ERROR: " << msg << endl;
+    cerr << "Usage:" << endl;
+    cerr << "    e57integrity [-q] [-maxerrors <count>] <e57_file> [<e57_file> ...]" << endl;
+    cerr << "    Verifies the checksum of every page and walks the packets of every CompressedVector," << endl;
+    cerr << "    without decoding any values. Use e57validate to check the contents follow the standard." << endl;
+    cerr << "    -q                   only print files that have problems" << endl;
+    cerr << "    -maxerrors <count>   number of problems listed for each file (default 100)" << endl;
+    cerr << "    The exit status is 0 if all files are intact, 1 otherwise." << endl;
+    cerr << "    For example:" << endl;
+    cerr << "        e57integrity scan0001.e57" << endl;
+    cerr << "        e57integrity -q *.e57" << endl;
+    cerr << endl;
+    exit(-1);
+}
+
+
+void CommandLineOptions::parse(int argc, char** argv)
+{
+    /// Skip program name
+    argc--; argv++;
+
+    for (; argc > 0 && *argv[0] == '-'; argc--,argv++) {
+        if (strcmp(argv[0], "-q") == 0)
+            quiet = true;
+        else if (strcmp(argv[0], "-maxerrors") == 0 && argc > 1) {
+            argc--; argv++;
+            char* end;
+            long long n = strtoll(argv[0], &end, 10);
+            if (*end != '\0' || n < 0)
+                usage(ustring("bad error count: ") + argv[0]);
+            maxErrorCount = static_cast<size_t>(n);
+        } else
+            usage(ustring("unknown option: ") + argv[0]);
+    }
+
+    if (argc < 1)
+        usage("no input files given");
+
+    for (; argc > 0; argc--,argv++)
+        fileNames.push_back(argv[0]);
+}
+
+//================================================================
+
+/// Check one file and print the result, returns true if it is intact
+bool checkFile(const CommandLineOptions& options, const ustring& fileName)
+{
+    E57Utilities utilities;
+    IntegrityReport report;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool intact = utilities.checkIntegrity(fileName, report, options.maxErrorCount);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (intact && options.quiet)
+        return(true);
+
+    cout << fileName << ": ";
+    if (intact)
+        cout << "OK" << endl;
+    else
+        cout << report.errorCount << " problems" << endl;
+    cout << "    " << report.pageCount << " pages";
+    if (report.badPageCount > 0)
+        cout << " (" << report.badPageCount << " bad)";
+    cout << ", " << report.sectionCount << " CompressedVector sections, " << report.packetCount << " good packets";
+    if (seconds > 0)
+        cout << ", " << static_cast<int64_t>(report.fileLength / seconds / 1e6) << " MB/s";
+    cout << endl;
+
+    for (size_t i = 0; i < report.errors.size(); i++) {
+        const IntegrityError& error = report.errors[i];
+        cout << "    offset " << error.physicalOffset << ": " << utilities.errorCodeToString(error.errorCode);
+        if (!error.context.empty())
+            cout << ", " << error.context;
+        cout << endl;
+    }
+    if (report.errorCount > report.errors.size())
+        cout << "    " << report.errorCount - report.errors.size() << " more problems not listed" << endl;
+
+    return(intact);
+}
+
+//================================================================
+
+int main(int argc, char** argv)
+{
+    CommandLineOptions options;
+    options.parse(argc, argv);
+
+    bool allIntact = true;
+    for (size_t i = 0; i < options.fileNames.size(); i++) {
+        /// Catch any exceptions thrown, and go on with the next file.
+        try {
+            if (!checkFile(options, options.fileNames[i]))
+                allIntact = false;
+        } catch(E57Exception& ex) {
+            cout << options.fileNames[i] << ": could not be checked" << endl;
+            ex.report(__FILE__, __LINE__, __FUNCTION__);
+            allIntact = false;
+        } catch (std::exception& ex) {
+            cout << options.fileNames[i] << ": could not be checked, got an std::exception, what=" << ex.what() << endl;
+            allIntact = false;
+        } catch (...) {
+            cout << options.fileNames[i] << ": could not be checked, got an unknown exception" << endl;
+            allIntact = false;
+        }
+    }
+    return(allIntact ? 0 : 1);
+}
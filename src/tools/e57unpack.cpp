@@ -54,9 +54,41 @@ using std::string;
 #include <vector>
 using std::vector;
 
+#include <map>
+using std::map;
+
 #include <limits>
 using std::numeric_limits;
 
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sstream>
+using std::ostringstream;
+
+#include <fstream>
+using std::ifstream;
+
+#include <algorithm>
+using std::sort;
+
+#include <thread>
+using std::thread;
+
+#include <mutex>
+using std::mutex;
+using std::unique_lock;
+using std::lock_guard;
+
+#include <condition_variable>
+using std::condition_variable;
+
+#include <chrono>
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
 #include <boost/config.hpp>
 
 #include <boost/program_options.hpp>
@@ -71,6 +103,10 @@ using boost::program_options::value;
 using boost::filesystem::path;
 using boost::filesystem::create_directories;
 using boost::filesystem::portable_directory_name;
+using boost::filesystem::is_directory;
+using boost::filesystem::is_regular_file;
+using boost::filesystem::directory_iterator;
+using boost::filesystem::file_size;
 
 #include <boost/filesystem/fstream.hpp>
 using boost::filesystem::ofstream;
@@ -117,8 +153,12 @@ print_help(
     cout
     << "Usage:\n"
     << PROGRAM_NAME" [options] e57-file [unpack-directory]\n"
+    << PROGRAM_NAME" [options] --batch list-file-or-directory unpack-directory\n"
     << "  The purpose of this program is to break the e57 file into\n"
     << "  parts.\n"
+    << "  With --batch, every .e57 file of a directory, or every file\n"
+    << "  named in a list file (one per line), is unpacked into its\n"
+    << "  own subdirectory of the unpack directory.\n"
     << endl
     << options
     ;
@@ -138,6 +178,1019 @@ public:
 
 };
 
+// fast csv text: numbers are formatted straight into a block of text,
+// with the fewest digits that read back as the same value, and many
+// records are written at a time
+
+enum csv_kind { csv_double, csv_float, csv_integer, csv_string };
+
+// records formatted at a time, by one thread
+const size_t csv_block_size = 16*1024;
+
+struct csv_block
+{
+    vector<variant<vector<double>, vector<int64_t>, vector<ustring> > > buf;
+    vector<SourceDestBuffer>    sdb;
+    unsigned                    count;
+    string                      text;
+};
+
+unsigned
+csv_threads(
+) {
+    if (opt.count("threads"))
+        return std::max(opt["threads"].as<unsigned>(), 1u);
+    // with --batch, the files are already unpacked in parallel
+    if (opt.count("batch"))
+        return 1;
+    return std::max(thread::hardware_concurrency(), 1u);
+}
+
+void
+bind_csv_block(
+    ImageFile imf
+    , StructureNode prototype
+    , size_t buf_size
+    , csv_block& block
+) {
+    for (int64_t i=0; i<prototype.childCount(); ++i) {
+        Node n(prototype.get(i));
+        switch(n.type()) {
+            case e57::E57_FLOAT:
+            case e57::E57_SCALED_INTEGER:
+                block.buf.push_back(vector<double>(buf_size));
+                block.sdb.push_back(
+                    SourceDestBuffer(
+                        imf
+                        , n.elementName()
+                        , &get<vector<double> >(block.buf.back())[0]
+                        , buf_size
+                        , true
+                        , true
+                    )
+                );
+                break;
+            case e57::E57_INTEGER:
+                block.buf.push_back(vector<int64_t>(buf_size));
+                block.sdb.push_back(
+                    SourceDestBuffer(
+                        imf
+                        , n.elementName()
+                        , &get<vector<int64_t> >(block.buf.back())[0]
+                        , buf_size
+                        , true
+                        , true
+                    )
+                );
+                break;
+            case e57::E57_STRING:
+                block.buf.push_back(vector<ustring>(buf_size));
+                block.sdb.push_back(
+                    SourceDestBuffer(
+                        imf
+                        , n.elementName()
+                        , &get<vector<ustring> >(block.buf.back())
+                    )
+                );
+                break;
+            default:
+                throw(runtime_error(
+                    "prototype contains illegal type")
+            );
+        }
+    }
+    block.count = 0;
+}
+
+// writes the digits of v at out, returns their number
+size_t
+format_integer(
+    int64_t v
+    , char* out
+) {
+    char digits[20];
+    size_t n(0);
+    uint64_t u = (v < 0) ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+    do {
+        digits[n++] = static_cast<char>('0' + u%10);
+        u /= 10;
+    } while (u);
+    size_t len(0);
+    if (v < 0)
+        out[len++] = '-';
+    while (n)
+        out[len++] = digits[--n];
+    return len;
+}
+
+// writes the shortest text that reads back as v, returns its length.
+// most values are scaled integers, with a few decimals: if v*10^k is
+// a whole number m below 2^53, then m/10^k is exact in both the text
+// and the division, so "m with k decimals" reads back as v exactly when
+// m/10^k == v.  the smallest such k gives the fewest digits.  other
+// values take the %g form with 15 to 17 significant digits, whichever
+// is the first to read back as v.
+size_t
+format_double(
+    double v
+    , char* out
+) {
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    if (v == 0) {
+        // keep the sign of -0
+        size_t len(0);
+        if (std::signbit(v))
+            out[len++] = '-';
+        out[len++] = '0';
+        return len;
+    }
+    if (std::fabs(v) < 1e15) {
+        for (int k=0; k<10; ++k) {
+            double scaled = v*pow10[k];
+            if (std::fabs(scaled) >= 9007199254740992.0)
+                break;
+            double m = std::floor(scaled + 0.5);
+            if (m/pow10[k] != v)
+                continue;
+
+            char digits[20];
+            size_t n = format_integer(static_cast<int64_t>(std::fabs(m)), digits);
+            size_t len(0);
+            if (v < 0)
+                out[len++] = '-';
+            if (n <= static_cast<size_t>(k)) {
+                out[len++] = '0';
+                out[len++] = '.';
+                for (size_t z=n; z<static_cast<size_t>(k); ++z)
+                    out[len++] = '0';
+                memcpy(out+len, digits, n);
+                len += n;
+            }
+            else {
+                memcpy(out+len, digits, n-k);
+                len += n-k;
+                if (k) {
+                    out[len++] = '.';
+                    memcpy(out+len, digits+n-k, k);
+                    len += k;
+                }
+            }
+            return len;
+        }
+    }
+    int n(0);
+    for (int digits=15; digits<=17; ++digits) {
+        n = snprintf(out, 32, "%.*g", digits, v);
+        if (strtod(out, 0) == v || v != v)
+            break;
+    }
+    return n;
+}
+
+// like format_double, for values of single precision fields, which
+// need at most 9 significant digits
+size_t
+format_float(
+    double v
+    , char* out
+) {
+    float f = static_cast<float>(v);
+    int n(0);
+    for (int digits=6; digits<=9; ++digits) {
+        n = snprintf(out, 32, "%.*g", digits, static_cast<double>(f));
+        if (strtof(out, 0) == f || f != f)
+            break;
+    }
+    return n;
+}
+
+// strings with separators, quotes or line ends are quoted
+void
+append_csv_string(
+    string& text
+    , const ustring& s
+) {
+    if (s.find_first_of(",\"\r\n") == string::npos) {
+        text += s;
+        return;
+    }
+    text += '"';
+    for (size_t i=0; i<s.size(); ++i) {
+        if (s[i] == '"')
+            text += '"';
+        text += s[i];
+    }
+    text += '"';
+}
+
+void
+format_csv_block(
+    csv_block& block
+    , const vector<csv_kind>& kinds
+) {
+    size_t fields = kinds.size();
+    vector<const double*> reals(fields);
+    vector<const int64_t*> integers(fields);
+    vector<const vector<ustring>*> strings(fields);
+    for (size_t j=0; j<fields; ++j) {
+        if (kinds[j] == csv_integer)
+            integers[j] = &get<vector<int64_t> >(block.buf[j])[0];
+        else if (kinds[j] == csv_string)
+            strings[j] = &get<vector<ustring> >(block.buf[j]);
+        else
+            reals[j] = &get<vector<double> >(block.buf[j])[0];
+    }
+
+    string& text(block.text);
+    text.clear();
+    char number[32];
+    for (unsigned i=0; i<block.count; ++i) {
+        for (size_t j=0; j<fields; ++j) {
+            if (j)
+                text += ',';
+            switch(kinds[j]) {
+                case csv_double:
+                    text.append(number, format_double(reals[j][i], number));
+                    break;
+                case csv_float:
+                    text.append(number, format_float(reals[j][i], number));
+                    break;
+                case csv_integer:
+                    text.append(number, format_integer(integers[j][i], number));
+                    break;
+                case csv_string:
+                    append_csv_string(text, (*strings[j])[i]);
+                    break;
+            }
+        }
+        text += '\n';
+    }
+}
+
+// reads the records into the blocks in turn, formats the blocks on
+// up to threads threads, and writes their text in order
+uint64_t
+write_csv(
+    CompressedVectorReader& rd
+    , vector<csv_block>& blocks
+    , const vector<csv_kind>& kinds
+    , unsigned threads
+    , ostream& out
+) {
+    uint64_t total_count(0);
+    bool more(true);
+    while (more) {
+        size_t n(0);
+        while (n < blocks.size()) {
+            blocks[n].count = rd.read(blocks[n].sdb);
+            if (!blocks[n].count) {
+                more = false;
+                break;
+            }
+            ++n;
+        }
+
+        if (threads > 1 && n > 1) {
+            vector<thread> workers;
+            for (size_t t=0; t<threads && t<n; ++t)
+                workers.push_back(thread([&blocks, &kinds, n, t, threads]() {
+                    for (size_t b=t; b<n; b+=threads)
+                        format_csv_block(blocks[b], kinds);
+                }));
+            for (size_t t=0; t<workers.size(); ++t)
+                workers[t].join();
+        }
+        else {
+            for (size_t b=0; b<n; ++b)
+                format_csv_block(blocks[b], kinds);
+        }
+
+        for (size_t b=0; b<n; ++b) {
+            out.write(blocks[b].text.data(), blocks[b].text.size());
+            total_count += blocks[b].count;
+        }
+    }
+    return total_count;
+}
+
+// the narrowest binary type that holds every value of a field,
+// empty if the field can't be written as binary
+string
+binary_type(
+    const Node& n
+    , size_t& size
+) {
+    switch(n.type()) {
+        case e57::E57_FLOAT:
+            if (FloatNode(n).precision() == e57::E57_SINGLE) {
+                size = 4;
+                return "f32";
+            }
+            size = 8;
+            return "f64";
+        case e57::E57_SCALED_INTEGER:
+            size = 8;
+            return "f64";
+        case e57::E57_INTEGER: {
+            IntegerNode i(n);
+            int64_t lo = i.minimum();
+            int64_t hi = i.maximum();
+            if (lo >= 0) {
+                if (hi <= numeric_limits<uint8_t>::max()) { size = 1; return "u8"; }
+                if (hi <= numeric_limits<uint16_t>::max()) { size = 2; return "u16"; }
+                if (hi <= numeric_limits<uint32_t>::max()) { size = 4; return "u32"; }
+            }
+            else {
+                if (lo >= numeric_limits<int8_t>::min() && hi <= numeric_limits<int8_t>::max()) { size = 1; return "i8"; }
+                if (lo >= numeric_limits<int16_t>::min() && hi <= numeric_limits<int16_t>::max()) { size = 2; return "i16"; }
+                if (lo >= numeric_limits<int32_t>::min() && hi <= numeric_limits<int32_t>::max()) { size = 4; return "i32"; }
+            }
+            size = 8;
+            return "i64";
+        }
+        default:
+            size = 0;
+            return "";
+    }
+}
+
+// a buffer the decoder fills with values of the given binary type,
+// stride bytes apart
+SourceDestBuffer
+binary_buffer(
+    ImageFile imf
+    , const string& name
+    , const string& type
+    , char* base
+    , size_t capacity
+    , size_t stride
+) {
+    if (type == "f64") return SourceDestBuffer(imf, name, reinterpret_cast<double*>(base), capacity, true, true, stride);
+    if (type == "f32") return SourceDestBuffer(imf, name, reinterpret_cast<float*>(base), capacity, true, true, stride);
+    if (type == "u8") return SourceDestBuffer(imf, name, reinterpret_cast<uint8_t*>(base), capacity, true, false, stride);
+    if (type == "i8") return SourceDestBuffer(imf, name, reinterpret_cast<int8_t*>(base), capacity, true, false, stride);
+    if (type == "u16") return SourceDestBuffer(imf, name, reinterpret_cast<uint16_t*>(base), capacity, true, false, stride);
+    if (type == "i16") return SourceDestBuffer(imf, name, reinterpret_cast<int16_t*>(base), capacity, true, false, stride);
+    if (type == "u32") return SourceDestBuffer(imf, name, reinterpret_cast<uint32_t*>(base), capacity, true, false, stride);
+    if (type == "i32") return SourceDestBuffer(imf, name, reinterpret_cast<int32_t*>(base), capacity, true, false, stride);
+    return SourceDestBuffer(imf, name, reinterpret_cast<int64_t*>(base), capacity, true, false, stride);
+}
+
+// the exported files are little endian, whatever the host
+void
+to_little_endian(
+    char* base
+    , size_t size
+    , size_t count
+    , size_t stride
+) {
+#ifdef E57_BIGENDIAN
+    for (size_t i=0; i<count; ++i)
+        std::reverse(base + i*stride, base + i*stride + size);
+#else
+    (void)base; (void)size; (void)count; (void)stride;
+#endif
+}
+
+// field names like "las:classification" become part of file names
+string
+file_name_part(
+    string name
+) {
+    for (size_t i=0; i<name.size(); ++i)
+        if (!isalnum(static_cast<unsigned char>(name[i])) && name[i] != '_' && name[i] != '-')
+            name[i] = '_';
+    return name;
+}
+
+// write the points of a scan as raw binary, decoded straight into the
+// buffers that are written out: either one file per field ("columns"),
+// or one file of records, each field at a fixed offset ("records").
+// the records are laid out like a C struct of the fields, each field
+// aligned to its size and the record size padded to the largest one,
+// so they can be read through a struct pointer.
+// the layout goes to the .inf file of the scan, e.g. for numpy:
+//   numpy.fromfile("image3d-0.cartesianX.f64", "<f8")
+//   numpy.fromfile("image3d-0.bin", numpy.dtype({"names": [...], "formats": ["<f8", ...], "offsets": [...], "itemsize": ...}))
+uint64_t
+unpack_binary(
+    ImageFile imf
+    , CompressedVectorNode points
+    , const path& dst
+    , const string& stem
+    , ostream& inf
+    , ostream& log
+) {
+    bool records = (opt["binary"].as<string>() == "records");
+    StructureNode prototype(points.prototype());
+
+    struct column {
+        string  name;
+        string  type;
+        size_t  size;
+        size_t  offset;
+    };
+    vector<column> columns;
+    size_t record_size(0);
+    size_t record_alignment(1);
+    for (int64_t i=0; i<prototype.childCount(); ++i) {
+        Node n(prototype.get(i));
+        column c;
+        c.name = n.elementName();
+        c.type = binary_type(n, c.size);
+        if (c.type.empty()) {
+            inf << "binary.skipped = " << c.name << endl;
+            continue;
+        }
+        record_size = (record_size + c.size - 1) / c.size * c.size;
+        record_alignment = std::max(record_alignment, c.size);
+        c.offset = records ? record_size : 0;
+        record_size += c.size;
+        columns.push_back(c);
+    }
+    record_size = (record_size + record_alignment - 1) / record_alignment * record_alignment;
+
+    inf << "binary = " << (records ? "records" : "columns") << endl;
+    inf << "binary.count = " << points.childCount() << endl;
+    if (records) {
+        inf << "binary.file = " << stem << ".bin" << endl;
+        inf << "binary.recordSize = " << record_size << endl;
+    }
+    for (size_t i=0; i<columns.size(); ++i) {
+        inf << "binary.field." << i << " = " << columns[i].name << endl;
+        inf << "binary.field." << i << ".type = " << columns[i].type << endl;
+        if (records)
+            inf << "binary.field." << i << ".offset = " << columns[i].offset << endl;
+        else
+            inf << "binary.field." << i << ".file = "
+                << stem << "." << file_name_part(columns[i].name) << "." << columns[i].type << endl;
+    }
+    if (columns.empty())
+        return 0;
+
+    // storage is in uint64_t, so every value is aligned in the columns
+    const size_t buf_size = 64*1024;
+    vector<vector<uint64_t> > storage;
+    vector<shared_ptr<ofstream> > files;
+    vector<SourceDestBuffer> sdb;
+    if (records) {
+        storage.push_back(vector<uint64_t>((buf_size*record_size + 7)/8));
+        files.push_back(shared_ptr<ofstream>(new ofstream(dst/(stem+".bin"), ios_base::out|ios_base::binary)));
+        char* base = reinterpret_cast<char*>(&storage[0][0]);
+        for (size_t i=0; i<columns.size(); ++i)
+            sdb.push_back(binary_buffer(imf, columns[i].name, columns[i].type, base + columns[i].offset, buf_size, record_size));
+        log << "unpacking: " << dst/(stem+".bin") << " ... ";
+    }
+    else {
+        for (size_t i=0; i<columns.size(); ++i) {
+            storage.push_back(vector<uint64_t>((buf_size*columns[i].size + 7)/8));
+            path name(stem + "." + file_name_part(columns[i].name) + "." + columns[i].type);
+            files.push_back(shared_ptr<ofstream>(new ofstream(dst/name, ios_base::out|ios_base::binary)));
+            char* base = reinterpret_cast<char*>(&storage[i][0]);
+            sdb.push_back(binary_buffer(imf, columns[i].name, columns[i].type, base, buf_size, columns[i].size));
+        }
+        log << "unpacking: " << dst/(stem+".*") << " ... ";
+    }
+
+    CompressedVectorReader rd(points.reader(sdb));
+    unsigned count;
+    uint64_t total_count(0);
+    while((count = rd.read())) {
+        total_count += count;
+        if (records) {
+            char* base = reinterpret_cast<char*>(&storage[0][0]);
+            for (size_t i=0; i<columns.size(); ++i)
+                to_little_endian(base + columns[i].offset, columns[i].size, count, record_size);
+            files[0]->write(base, count*record_size);
+        }
+        else {
+            for (size_t i=0; i<columns.size(); ++i) {
+                char* base = reinterpret_cast<char*>(&storage[i][0]);
+                to_little_endian(base, columns[i].size, count, columns[i].size);
+                files[i]->write(base, count*columns[i].size);
+            }
+        }
+    }
+    rd.close();
+    for (size_t i=0; i<files.size(); ++i) {
+        files[i]->close();
+        if (!*files[i])
+            throw(runtime_error("writing binary point data failed"));
+    }
+    log << " total points: " << total_count << endl;
+
+    return total_count;
+}
+
+uint64_t
+unpack(
+    const path& src
+    , const path& dst
+    , ostream& log
+) {
+    string fmt;
+    if (opt.count("format"))
+        fmt = opt["format"].as<string>();
+
+    ImageFile imf(src.string(), "r");
+    StructureNode root = imf.root();
+    uint64_t point_count(0);
+
+    create_directories(dst);
+
+    ofstream root_inf(dst/"root.inf");
+    root_inf << "formatName = " << StringNode(root.get("formatName")).value() << endl;
+    root_inf << "guid = " << StringNode(root.get("guid")).value() << endl;
+    root_inf << "versionMajor = " << IntegerNode(root.get("versionMajor")).value() << endl;
+    root_inf << "versionMinor = " << IntegerNode(root.get("versionMinor")).value() << endl;
+    if (root.isDefined("e57LibraryVersion")) {
+        root_inf << "e57LibraryVersion = " << StringNode(root.get("e57LibraryVersion")).value() << endl;
+    }
+    if (root.isDefined("coordinateMetadata")) {
+        root_inf << "coordinateMetadata = " << StringNode(root.get("coordinateMetadata")).value() << endl;
+    }
+    if (root.isDefined("creationDateTime")) {
+        StructureNode t(root.get("creationDateTime"));
+        root_inf << format("creationDateTime.dateTimeValue = %.15g\n") % FloatNode(t.get("dateTimeValue")).value();
+        if (t.isDefined("isAtomicClockReferenced")) {
+            root_inf << "creationDateTime.isAtomicClockReferenced = " << IntegerNode(t.get("isAtomicClockReferenced")).value() << endl;
+        }
+    }
+    root_inf.close();
+
+    if (root.isDefined("data3D") && !opt.count("no-points")) {
+        VectorNode data3D(root.get("data3D"));
+        for (int64_t child=0; child<data3D.childCount(); ++child) {
+            StructureNode            scan(data3D.get(child));
+            CompressedVectorNode     points(scan.get("points"));
+            StructureNode            prototype(points.prototype());
+            vector<csv_kind>         kinds;
+            string pointrecord;
+
+            string comma;
+            for (int64_t i=0; i<prototype.childCount(); ++i) {
+                Node n(prototype.get(i));
+                pointrecord += comma + n.elementName();
+                switch(n.type()) {
+                    case e57::E57_FLOAT:
+                    case e57::E57_SCALED_INTEGER:
+                        if (n.type() == e57::E57_FLOAT && FloatNode(n).precision() == e57::E57_SINGLE)
+                            kinds.push_back(csv_float);
+                        else
+                            kinds.push_back(csv_double);
+                        break;
+                    case e57::E57_INTEGER:
+                        kinds.push_back(csv_integer);
+                        break;
+                    case e57::E57_STRING:
+                        kinds.push_back(csv_string);
+                        break;
+                    default:
+                        throw(runtime_error(
+                            "prototype contains illegal type")
+                    );
+                }
+                if (comma.empty()) comma = ",";
+            }
+
+            ofstream inf(
+                dst/path(string("image3d-")+lexical_cast<string>(child)+".inf")
+            );
+            inf << "pointrecord = " << pointrecord << endl; // can be used as a header line for the csv file
+            // the default csv has no format string, every number is written
+            // with the fewest digits that read back as the same value
+            if (opt.count("format") && !opt.count("binary"))
+                inf << "pointrecord.format = " << fmt << endl;
+            if (scan.isDefined("name")) {
+                inf << "name = " << StringNode(scan.get("name")).value() << endl;
+            }
+            inf << "guid = " << StringNode(scan.get("guid")).value() << endl;
+            if (scan.isDefined("description")) {
+                inf << "description = " << StringNode(scan.get("description")).value() << endl;
+            }
+            if (scan.isDefined("pose")) {
+                StructureNode pose(scan.get("pose"));
+                StructureNode translation(pose.get("translation"));
+                StructureNode rotation(pose.get("rotation"));
+                inf << "pose.translation.x = " << FloatNode(translation.get("x")).value() << endl;
+                inf << "pose.translation.y = " << FloatNode(translation.get("y")).value() << endl;
+                inf << "pose.translation.z = " << FloatNode(translation.get("z")).value() << endl;
+                inf << "pose.rotation.w = " << FloatNode(rotation.get("w")).value() << endl;
+                inf << "pose.rotation.x = " << FloatNode(rotation.get("x")).value() << endl;
+                inf << "pose.rotation.y = " << FloatNode(rotation.get("y")).value() << endl;
+                inf << "pose.rotation.z = " << FloatNode(rotation.get("z")).value() << endl;
+            }
+            if (scan.isDefined("acquisitionStart")) {
+                StructureNode t(scan.get("acquisitionStart"));
+                inf << format("acquisitionStart.dateTimeValue = %.15g\n") % FloatNode(t.get("dateTimeValue")).value();
+                if (t.isDefined("isAtomicClockReferenced")) {
+                    inf << "acquisitionStart.isAtomicClockReferenced = " << IntegerNode(t.get("isAtomicClockReferenced")).value() << endl;
+                }
+            }
+            if (scan.isDefined("acquisitionEnd")) {
+                StructureNode t(scan.get("acquisitionEnd"));
+                inf << format("acquisitionEnd.dateTimeValue = %.15g\n") % FloatNode(t.get("dateTimeValue")).value();
+                if (t.isDefined("isAtomicClockReferenced")) {
+                    inf << "acquisitionEnd.isAtomicClockReferenced = " << IntegerNode(t.get("isAtomicClockReferenced")).value() << endl;
+                }
+            }
+            if (scan.isDefined("sensorVendor")) {
+                inf << "sensorVendor = " << StringNode(scan.get("sensorVendor")).value() << endl;
+            }
+            if (scan.isDefined("sensorModel")) {
+                inf << "sensorModel = " << StringNode(scan.get("sensorModel")).value() << endl;
+            }
+            if (scan.isDefined("sensorSerialNumber")) {
+                inf << "sensorSerialNumber = " << StringNode(scan.get("sensorSerialNumber")).value() << endl;
+            }
+            if (scan.isDefined("HardwareVersion")) {
+                inf << "HardwareVersion = " << StringNode(scan.get("HardwareVersion")).value() << endl;
+            }
+            if (scan.isDefined("SoftwareVersion")) {
+                inf << "SoftwareVersion = " << StringNode(scan.get("SoftwareVersion")).value() << endl;
+            }
+            if (scan.isDefined("FirmwareVersion")) {
+                inf << "FirmwareVersion = " << StringNode(scan.get("FirmwareVersion")).value() << endl;
+            }
+            if (scan.isDefined("temperature")) {
+                inf << "temperature = " << FloatNode(scan.get("temperature")).value() << endl;
+            }
+            if (scan.isDefined("relativeHumidity")) {
+                inf << "relativeHumidity = " << FloatNode(scan.get("relativeHumidity")).value() << endl;
+            }
+            if (scan.isDefined("atmosphericPressure")) {
+                inf << "atmosphericPressure = " << FloatNode(scan.get("atmosphericPressure")).value() << endl;
+            }
+            if (opt.count("binary")) {
+                point_count += unpack_binary(
+                    imf
+                    , points
+                    , dst
+                    , string("image3d-")+lexical_cast<string>(child)
+                    , inf
+                    , log
+                );
+                inf.close();
+                continue;
+            }
+            inf.close();
+
+            // with a format string of the user, boost::format formats the
+            // records; otherwise blocks of records are formatted in parallel
+            // (see write_csv), so each worker needs blocks of its own
+            unsigned threads = opt.count("format") ? 1 : csv_threads();
+            vector<csv_block> blocks(opt.count("format") ? 1 : 2*threads);
+            for (size_t b=0; b<blocks.size(); ++b)
+                bind_csv_block(
+                    imf
+                    , prototype
+                    , opt.count("format") ? 1024 : csv_block_size
+                    , blocks[b]
+                );
+
+            CompressedVectorReader rd(points.reader(blocks[0].sdb));
+            path csvname(string("image3d-")+lexical_cast<string>(child)+".csv");
+            ofstream ocsv(dst/csvname);
+            ostream& out(ocsv); // needed to fix ambiguity for << operator on msvc
+            log << "unpacking: " << dst/csvname << " ... ";
+            uint64_t total_count(0);
+
+            out << pointrecord << '\n'; // put the header line into csv
+            if (opt.count("format")) {
+                vector<variant<vector<double>, vector<int64_t>, vector<ustring> > >& buf(blocks[0].buf);
+                format tfmt(fmt);
+                tfmt.exceptions( all_error_bits ^ too_many_args_bit );
+                unsigned count;
+                while((count = rd.read())) {
+                    total_count += count;
+                    for (size_t i=0; i<count; ++i) {
+                        for (size_t j=0; j<buf.size(); ++j)
+                            tfmt = tfmt % apply_visitor(get_at(i),buf.at(j));
+                        out << tfmt << '\n';
+                    }
+                }
+            }
+            else
+                total_count = write_csv(rd, blocks, kinds, threads, out);
+            rd.close();
+            log << " total points: " << total_count << endl;
+            point_count += total_count;
+
+            ocsv.close();
+        }
+    }
+
+    if (root.isDefined("images2D") && !opt.count("no-images")) {
+        VectorNode images2D(root.get("images2D"));
+        for (int64_t child=0; child<images2D.childCount(); ++child) {
+            StructureNode  image(images2D.get(child));
+            path inf_path = dst/path(string("image2d-")+lexical_cast<string>(child)+".inf");
+            ofstream inf(inf_path);
+            string reptype;
+            if (image.isDefined("visualReferenceRepresentation"))
+                reptype = "visualReferenceRepresentation";
+            else if (image.isDefined("pinholeRepresentation"))
+                reptype = "pinholeRepresentation";
+            else if (image.isDefined("sphericalRepresentation"))
+                reptype = "sphericalRepresentation";
+            else if (image.isDefined("cylindricalRepresentation"))
+                reptype = "cylindricalRepresentation";
+            StructureNode rep(image.get(reptype));
+            string imgtype;
+            path img_path(dst/path(string("image2d-")+lexical_cast<string>(child)+".img"));
+            if (rep.isDefined("jpegImage")) {
+                img_path.replace_extension(".jpg");
+                imgtype = "jpegImage";
+            }
+            else if (rep.isDefined("pngImage")) {
+                img_path.replace_extension(".png");
+                imgtype = "pngImage";
+            }
+            // extract image blob
+            BlobNode blob(rep.get(imgtype));
+            ofstream img(img_path, ios_base::out|ios_base::binary);
+            const streamsize buffer_size = 1024*1024;
+            vector<uint8_t> buffer(buffer_size);
+            int64_t offset = 0;
+            int64_t remaining = blob.byteCount();
+            size_t get;
+            log << "unpacking: " << img_path << " ... ";
+            while(img && remaining > 0) {
+                get = (remaining > buffer_size)?buffer_size:remaining;
+                blob.read(&buffer[0], offset, get);
+                img.write(reinterpret_cast<char*>(&buffer[0]), get);
+                offset += get;
+                remaining -= get;
+            }
+            img.close();
+            // extract meta data
+            inf << "guid = " << StringNode(image.get("guid")).value() << endl;
+            if (image.isDefined("name")) {
+                inf << "name = " << StringNode(image.get("name")).value() << endl;
+            }
+            if (image.isDefined("description")) {
+                inf << "description = " << StringNode(image.get("description")).value() << endl;
+            }
+            if (image.isDefined("sensorVendor")) {
+                inf << "sensorVendor = " << StringNode(image.get("sensorVendor")).value() << endl;
+            }
+            if (image.isDefined("sensorModel")) {
+                inf << "sensorModel = " << StringNode(image.get("sensorModel")).value() << endl;
+            }
+            if (image.isDefined("sensorSerialNumber")) {
+                inf << "sensorSerialNumber = " << StringNode(image.get("sensorSerialNumber")).value() << endl;
+            }
+            if (image.isDefined("pose")) {
+                StructureNode pose(image.get("pose"));
+                StructureNode translation(pose.get("translation"));
+                StructureNode rotation(pose.get("rotation"));
+                inf << "pose.translation.x = " << FloatNode(translation.get("x")).value() << endl;
+                inf << "pose.translation.y = " << FloatNode(translation.get("y")).value() << endl;
+                inf << "pose.translation.z = " << FloatNode(translation.get("z")).value() << endl;
+                inf << "pose.rotation.w = " << FloatNode(rotation.get("w")).value() << endl;
+                inf << "pose.rotation.x = " << FloatNode(rotation.get("x")).value() << endl;
+                inf << "pose.rotation.y = " << FloatNode(rotation.get("y")).value() << endl;
+                inf << "pose.rotation.z = " << FloatNode(rotation.get("z")).value() << endl;
+            }
+            if (rep.isDefined("imageHeight")) {
+                inf << reptype+".imageHeight = " << IntegerNode(rep.get("imageHeight")).value() << endl;
+                log << IntegerNode(rep.get("imageHeight")).value() << " x ";
+            }
+            if (rep.isDefined("imageWidth")) {
+                inf << reptype+".imageWidth = " << IntegerNode(rep.get("imageWidth")).value() << endl;
+                log << IntegerNode(rep.get("imageWidth")).value() << " pixels" << endl;
+            }
+            if (rep.isDefined("focalLength")) {
+                inf << reptype+".focalLength = " << FloatNode(rep.get("focalLength")).value() << endl;
+            }
+            if (rep.isDefined("pixelWidth")) {
+                inf << reptype+".pixelWidth = " << FloatNode(rep.get("pixelWidth")).value() << endl;
+            }
+            if (rep.isDefined("pixelHeight")) {
+                inf << reptype+".pixelHeight = " << FloatNode(rep.get("pixelHeight")).value() << endl;
+            }
+            if (rep.isDefined("principalPointX")) {
+                inf << reptype+".principalPointX = " << FloatNode(rep.get("principalPointX")).value() << endl;
+            }
+            if (rep.isDefined("principalPointY")) {
+                inf << reptype+".principalPointY = " << FloatNode(rep.get("principalPointY")).value() << endl;
+            }
+            if (rep.isDefined("radius")) {
+                inf << reptype+".radius = " << FloatNode(rep.get("radius")).value() << endl;
+            }
+
+            inf.close();
+        }
+    }
+
+    return point_count;
+}
+
+// rough memory use of unpacking one file: the parsed xml tree dominates,
+// so go by the length of the xml section given in the file header
+// (fileSignature[8], majorVersion, minorVersion, filePhysicalLength,
+// xmlPhysicalOffset, xmlLogicalLength, pageSize; little endian)
+uint64_t
+unpack_memory_estimate(
+    const path& src
+) {
+    const uint64_t base = 4*1024*1024; // image and point buffers
+    unsigned char header[48];
+    ifstream in(src.string().c_str(), ios_base::in|ios_base::binary);
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)))
+        return base; // unpacking will fail too, and report why
+    uint64_t xml_length(0);
+    for (int i=7; i>=0; --i)
+        xml_length = (xml_length << 8) | header[32+i];
+    return base + 8*xml_length;
+}
+
+// hands the files of a batch to the worker threads, in order.
+// a file is only handed out when its memory estimate fits beside
+// those of the files being unpacked; if nothing else is running it is
+// handed out anyway, so a file larger than the limit is unpacked alone.
+class batch_scheduler
+{
+    mutex                       m;
+    condition_variable          changed;
+    const vector<uint64_t>&     estimate;
+    size_t                      next_file;
+    uint64_t                    limit; // zero if no limit
+    uint64_t                    in_use;
+    unsigned                    running;
+public:
+    batch_scheduler(const vector<uint64_t>& estimate_, uint64_t limit_)
+        : estimate(estimate_), next_file(0), limit(limit_), in_use(0), running(0) {}
+
+    bool next(size_t& file) {
+        unique_lock<mutex> lock(m);
+        while (next_file < estimate.size() && running > 0 && limit > 0
+               && in_use + estimate[next_file] > limit)
+            changed.wait(lock);
+        if (next_file >= estimate.size())
+            return false;
+        file = next_file++;
+        in_use += estimate[file];
+        ++running;
+        return true;
+    }
+
+    void finished(size_t file) {
+        lock_guard<mutex> lock(m);
+        in_use -= estimate[file];
+        --running;
+        changed.notify_all();
+    }
+};
+
+struct batch_report
+{
+    mutex       m;
+    unsigned    unpacked;
+    unsigned    failed;
+    uint64_t    points;
+    uint64_t    bytes;
+    batch_report() : unpacked(0), failed(0), points(0), bytes(0) {}
+};
+
+void
+batch_worker(
+    const vector<path>& src
+    , const vector<path>& dst
+    , batch_scheduler& scheduler
+    , batch_report& report
+) {
+    size_t file;
+    while (scheduler.next(file)) {
+        // a file that fails is reported, and doesn't stop the batch;
+        // the output of each file is kept together
+        ostringstream log;
+        steady_clock::time_point start = steady_clock::now();
+        uint64_t points(0);
+        string error;
+        try {
+            points = unpack(src[file], dst[file], log);
+        } catch(E57Exception& e) {
+            error = E57Utilities().errorCodeToString(e.errorCode()) + " " + e.context();
+        } catch(exception& e) {
+            error = e.what();
+        } catch(...) {
+            error = "unknown exception";
+        }
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        scheduler.finished(file);
+
+        boost::system::error_code ec;
+        uint64_t bytes = file_size(src[file], ec);
+        if (ec)
+            bytes = 0;
+
+        if (error.empty()) {
+            log << src[file].string() << ": " << points << " points in "
+                << format("%.2f s") % seconds;
+            if (seconds > 0)
+                log << format(" (%.0f points/s, %.1f MB/s)")
+                    % (points/seconds) % (bytes/seconds/(1024*1024));
+            log << endl;
+        }
+        else
+            log << src[file].string() << ": FAILED, " << error << endl;
+
+        lock_guard<mutex> lock(report.m);
+        if (error.empty()) {
+            ++report.unpacked;
+            report.points += points;
+            report.bytes += bytes;
+        }
+        else
+            ++report.failed;
+        cout << log.str();
+    }
+}
+
+int
+unpack_batch(
+    const path& src
+    , const path& dst
+) {
+    // the files are either the .e57 files of a directory, or listed
+    // one per line in a file
+    vector<path> files;
+    if (is_directory(src)) {
+        for (directory_iterator it(src), end; it != end; ++it) {
+            string ext = it->path().extension().string();
+            for (size_t i=0; i<ext.size(); ++i)
+                ext[i] = tolower(ext[i]);
+            if (is_regular_file(it->status()) && ext == ".e57")
+                files.push_back(it->path());
+        }
+        sort(files.begin(), files.end());
+    }
+    else {
+        ifstream list(src.string().c_str());
+        if (!list)
+            throw(runtime_error("can't open list file " + src.string()));
+        string line;
+        while (getline(list, line)) {
+            while (!line.empty() && isspace(static_cast<unsigned char>(line[line.size()-1])))
+                line.erase(line.size()-1);
+            if (!line.empty())
+                files.push_back(path(line));
+        }
+    }
+
+    uint64_t limit(0);
+    if (opt.count("memory-limit"))
+        limit = static_cast<uint64_t>(opt["memory-limit"].as<double>()*1024*1024);
+
+    // files of the same name, e.g. from different directories of a list
+    // file, would be unpacked over each other, so refuse the whole batch.
+    // names are compared ignoring case, for case insensitive file systems
+    vector<path> dsts;
+    vector<uint64_t> estimate;
+    map<string, size_t> names;
+    for (size_t i=0; i<files.size(); ++i) {
+        dsts.push_back(dst/files[i].stem());
+        string name = dsts[i].string();
+        for (size_t j=0; j<name.size(); ++j)
+            name[j] = tolower(name[j]);
+        if (!names.insert(make_pair(name, i)).second)
+            throw(runtime_error("both " + files[names[name]].string() + " and "
+                + files[i].string() + " would be unpacked to " + dsts[i].string()));
+        estimate.push_back(limit ? unpack_memory_estimate(files[i]) : 0);
+    }
+
+    unsigned jobs = thread::hardware_concurrency();
+    if (opt.count("jobs"))
+        jobs = opt["jobs"].as<unsigned>();
+    if (jobs > files.size())
+        jobs = static_cast<unsigned>(files.size());
+    if (jobs == 0)
+        jobs = 1;
+
+    // all workers share this process, so the xml parser setup of the
+    // e57 library is done only once for the whole batch
+    steady_clock::time_point start = steady_clock::now();
+    batch_scheduler scheduler(estimate, limit);
+    batch_report report;
+    vector<thread> workers;
+    for (unsigned i=0; i<jobs; ++i)
+        workers.push_back(thread(batch_worker, std::cref(files), std::cref(dsts), std::ref(scheduler), std::ref(report)));
+    for (size_t i=0; i<workers.size(); ++i)
+        workers[i].join();
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    cout << "unpacked " << report.unpacked << " of " << files.size()
+         << " files with " << jobs << " jobs: " << report.points << " points in "
+         << format("%.2f s") % seconds;
+    if (seconds > 0)
+        cout << format(" (%.0f points/s, %.1f MB/s)")
+            % (report.points/seconds) % (report.bytes/seconds/(1024*1024));
+    cout << endl;
+
+    return report.failed ? -1 : 0;
+}
+
 int
 main(
     int argc
@@ -180,6 +1233,42 @@ main(
                 "no-points"
                 , "supress pointcloud output"
             )
+            (
+                "binary,b"
+                , value<string>()
+                , "write the points as raw little endian\n"
+                  "binary instead of csv: \"columns\" (one\n"
+                  "file per field) or \"records\" (one file\n"
+                  "of records with naturally aligned fields);\n"
+                  "the layout is described in the .inf file\n"
+            )
+            (
+                "threads,t"
+                , value<unsigned>()
+                , "number of threads formatting csv\n"
+                  "text (default: number of processor\n"
+                  "cores, 1 with --batch)"
+            )
+            (
+                "batch"
+                , "unpack a list of files, several at\n"
+                  "a time in this process"
+            )
+            (
+                "jobs,j"
+                , value<unsigned>()
+                , "number of files unpacked at the same\n"
+                  "time with --batch (default: number of\n"
+                  "processor cores)"
+            )
+            (
+                "memory-limit"
+                , value<double>()
+                , "megabytes; with --batch, don't start\n"
+                  "another file while the estimated memory\n"
+                  "use of the files being unpacked would\n"
+                  "exceed this"
+            )
             ;
 
         positional_options_description  positional;
@@ -204,14 +1293,25 @@ main(
             return 0;
         }
 
-        if (opt.count("src")) {
-            string fmt;
-            if (opt.count("format"))
-                fmt = opt["format"].as<string>();
+        if (opt.count("binary")
+            && opt["binary"].as<string>() != "columns"
+            && opt["binary"].as<string>() != "records") {
+            print_help(options);
+            return -1;
+        }
 
-            ImageFile imf(opt["src"].as<string>(), "r");
-            StructureNode root = imf.root();
+        if (opt.count("batch")) {
+            if (!opt.count("src") || !opt.count("dst")) {
+                print_help(options);
+                return -1;
+            }
+            return unpack_batch(
+                path(opt["src"].as<string>())
+                , path(opt["dst"].as<string>())
+            );
+        }
 
+        if (opt.count("src")) {
             path dst;
             if (opt.count("dst"))
                 dst = path(opt["dst"].as<string>());
@@ -220,305 +1320,7 @@ main(
                 dst.replace_extension();
             }
 
-            create_directories(dst);
-
-            ofstream root_inf(dst/"root.inf");
-            root_inf << "formatName = " << StringNode(root.get("formatName")).value() << endl;
-            root_inf << "guid = " << StringNode(root.get("guid")).value() << endl;
-            root_inf << "versionMajor = " << IntegerNode(root.get("versionMajor")).value() << endl;
-            root_inf << "versionMinor = " << IntegerNode(root.get("versionMinor")).value() << endl;
-            if (root.isDefined("e57LibraryVersion")) {
-                root_inf << "e57LibraryVersion = " << StringNode(root.get("e57LibraryVersion")).value() << endl;
-            }
-            if (root.isDefined("coordinateMetadata")) {
-                root_inf << "coordinateMetadata = " << StringNode(root.get("coordinateMetadata")).value() << endl;
-            }
-            if (root.isDefined("creationDateTime")) {
-                StructureNode t(root.get("creationDateTime"));
-                root_inf << format("creationDateTime.dateTimeValue = %.15g\n") % FloatNode(t.get("dateTimeValue")).value();
-                if (t.isDefined("isAtomicClockReferenced")) {
-                    root_inf << "creationDateTime.isAtomicClockReferenced = " << IntegerNode(t.get("isAtomicClockReferenced")).value() << endl;
-                }
-            }
-            root_inf.close();
-
-            if (root.isDefined("data3D") && !opt.count("no-points")) {
-                VectorNode data3D(root.get("data3D"));
-                for (int64_t child=0; child<data3D.childCount(); ++child) {
-                    StructureNode            scan(data3D.get(child));
-                    CompressedVectorNode     points(scan.get("points"));
-                    StructureNode            prototype(points.prototype());
-                    vector<SourceDestBuffer> sdb;
-                    const size_t buf_size = 1024;
-                    vector<variant<vector<double>, vector<int64_t>, vector<ustring> > > buf;
-                    string pointrecord;
-
-                    string comma;
-                    if (!opt.count("format")) {
-                        fmt.clear();
-                        for (int64_t i=0; i<prototype.childCount(); ++i) {
-                            switch(prototype.get(i).type()) {
-                                case e57::E57_FLOAT:
-                                case e57::E57_SCALED_INTEGER:
-                                    buf.push_back(vector<double>(buf_size));
-                                    if (!opt.count("format"))
-                                        fmt += comma +"%."+lexical_cast<string>(numeric_limits<double>::digits10)+"g";
-                                    break;
-                                case e57::E57_INTEGER:
-                                    buf.push_back(vector<int64_t>(buf_size));
-                                    if (!opt.count("format"))
-                                        fmt += comma +"%d";
-                                    break;
-                                case e57::E57_STRING:
-                                    buf.push_back(vector<ustring>(buf_size));
-                                    if (!opt.count("format"))
-                                        fmt += comma + "%s";
-                            }
-                            if (comma.empty()) comma = ",";
-                        }
-                    }
-                    comma.clear();
-                    for (int i=0; i<prototype.childCount(); ++i) {
-                        Node n(prototype.get(i));
-                        pointrecord += comma + n.elementName();
-                        if (comma.empty()) comma = ",";
-                        switch(n.type()) {
-                            case e57::E57_FLOAT:
-                            case e57::E57_SCALED_INTEGER:
-                                sdb.push_back(
-                                    SourceDestBuffer(
-                                        imf
-                                        , n.elementName()
-                                        , &get<vector<double> >(buf[i])[0]
-                                        , buf_size
-                                        , true
-                                        , true
-                                    )
-                                );
-                                break;
-                            case e57::E57_INTEGER:
-                                sdb.push_back(
-                                    SourceDestBuffer(
-                                        imf
-                                        , n.elementName()
-                                        , &get<vector<int64_t> >(buf[i])[0]
-                                        , buf_size
-                                        , true
-                                        , true
-                                    )
-                                );
-                            break;
-                            case e57::E57_STRING:
-                                sdb.push_back(
-                                    SourceDestBuffer(
-                                        imf
-                                        , n.elementName()
-                                        , &get<vector<ustring> >(buf[i])
-                                    )
-                                );
-                            break;
-                            default:
-                                throw(runtime_error(
-                                    "prototype contains illegal type")
-                            );
-                        }
-                    }
-
-                    ofstream inf(
-                        dst/path(string("image3d-")+lexical_cast<string>(child)+".inf")
-                    );
-                    inf << "pointrecord = " << pointrecord << endl; // can be used as a header line for the csv file
-                    inf << "pointrecord.format = " << fmt << endl;
-                    if (scan.isDefined("name")) {
-                        inf << "name = " << StringNode(scan.get("name")).value() << endl;
-                    }
-                    inf << "guid = " << StringNode(scan.get("guid")).value() << endl;
-                    if (scan.isDefined("description")) {
-                        inf << "description = " << StringNode(scan.get("description")).value() << endl;
-                    }
-                    if (scan.isDefined("pose")) {
-                        StructureNode pose(scan.get("pose"));
-                        StructureNode translation(pose.get("translation"));
-                        StructureNode rotation(pose.get("rotation"));
-                        inf << "pose.translation.x = " << FloatNode(translation.get("x")).value() << endl;
-                        inf << "pose.translation.y = " << FloatNode(translation.get("y")).value() << endl;
-                        inf << "pose.translation.z = " << FloatNode(translation.get("z")).value() << endl;
-                        inf << "pose.rotation.w = " << FloatNode(rotation.get("w")).value() << endl;
-                        inf << "pose.rotation.x = " << FloatNode(rotation.get("x")).value() << endl;
-                        inf << "pose.rotation.y = " << FloatNode(rotation.get("y")).value() << endl;
-                        inf << "pose.rotation.z = " << FloatNode(rotation.get("z")).value() << endl;
-                    }
-                    if (scan.isDefined("acquisitionStart")) {
-                        StructureNode t(scan.get("acquisitionStart"));
-                        inf << format("acquisitionStart.dateTimeValue = %.15g\n") % FloatNode(t.get("dateTimeValue")).value();
-                        if (t.isDefined("isAtomicClockReferenced")) {
-                            inf << "acquisitionStart.isAtomicClockReferenced = " << IntegerNode(t.get("isAtomicClockReferenced")).value() << endl;
-                        }
-                    }
-                    if (scan.isDefined("acquisitionEnd")) {
-                        StructureNode t(scan.get("acquisitionEnd"));
-                        inf << format("acquisitionEnd.dateTimeValue = %.15g\n") % FloatNode(t.get("dateTimeValue")).value();
-                        if (t.isDefined("isAtomicClockReferenced")) {
-                            inf << "acquisitionEnd.isAtomicClockReferenced = " << IntegerNode(t.get("isAtomicClockReferenced")).value() << endl;
-                        }
-                    }
-                    if (scan.isDefined("sensorVendor")) {
-                        inf << "sensorVendor = " << StringNode(scan.get("sensorVendor")).value() << endl;
-                    }
-                    if (scan.isDefined("sensorModel")) {
-                        inf << "sensorModel = " << StringNode(scan.get("sensorModel")).value() << endl;
-                    }
-                    if (scan.isDefined("sensorSerialNumber")) {
-                        inf << "sensorSerialNumber = " << StringNode(scan.get("sensorSerialNumber")).value() << endl;
-                    }
-                    if (scan.isDefined("HardwareVersion")) {
-                        inf << "HardwareVersion = " << StringNode(scan.get("HardwareVersion")).value() << endl;
-                    }
-                    if (scan.isDefined("SoftwareVersion")) {
-                        inf << "SoftwareVersion = " << StringNode(scan.get("SoftwareVersion")).value() << endl;
-                    }
-                    if (scan.isDefined("FirmwareVersion")) {
-                        inf << "FirmwareVersion = " << StringNode(scan.get("FirmwareVersion")).value() << endl;
-                    }
-                    if (scan.isDefined("temperature")) {
-                        inf << "temperature = " << FloatNode(scan.get("temperature")).value() << endl;
-                    }
-                    if (scan.isDefined("relativeHumidity")) {
-                        inf << "relativeHumidity = " << FloatNode(scan.get("relativeHumidity")).value() << endl;
-                    }
-                    if (scan.isDefined("atmosphericPressure")) {
-                        inf << "atmosphericPressure = " << FloatNode(scan.get("atmosphericPressure")).value() << endl;
-                    }
-                    inf.close();
-
-                    CompressedVectorReader rd(points.reader(sdb));
-                    path csvname(string("image3d-")+lexical_cast<string>(child)+".csv");
-                    ofstream ocsv(dst/csvname);
-                    ostream& out(ocsv); // needed to fix ambiguity for << operator on msvc
-                    cout << "unpacking: " << dst/csvname << " ... ";
-                    unsigned count;
-                    uint64_t total_count(0);
-
-                    format tfmt(fmt);
-                    tfmt.exceptions( all_error_bits ^ too_many_args_bit );
-                    out << pointrecord << endl; // put the header line into csv
-                    while((count = rd.read())) {
-                        total_count += count;
-                        for (size_t i=0; i<count; ++i) {
-                            for (size_t j=0; j<buf.size(); ++j)
-                                tfmt = tfmt % apply_visitor(get_at(i),buf.at(j));
-                            out << tfmt << endl;
-                        }
-                    }
-                    cout << " total points: " << total_count << endl;
-
-                    ocsv.close();
-                }
-            }
-
-            if (root.isDefined("images2D") && !opt.count("no-images")) {
-                VectorNode images2D(root.get("images2D"));
-                for (int64_t child=0; child<images2D.childCount(); ++child) {
-                    StructureNode  image(images2D.get(child));
-                    path inf_path = dst/path(string("image2d-")+lexical_cast<string>(child)+".inf");
-                    ofstream inf(inf_path);
-                    string reptype;
-                    if (image.isDefined("visualReferenceRepresentation"))
-                        reptype = "visualReferenceRepresentation";
-                    else if (image.isDefined("pinholeRepresentation"))
-                        reptype = "pinholeRepresentation";
-                    else if (image.isDefined("sphericalRepresentation"))
-                        reptype = "sphericalRepresentation";
-                    else if (image.isDefined("cylindricalRepresentation"))
-                        reptype = "cylindricalRepresentation";
-                    StructureNode rep(image.get(reptype));
-                    string imgtype;
-                    path img_path(dst/path(string("image2d-")+lexical_cast<string>(child)+".img"));
-                    if (rep.isDefined("jpegImage")) {
-                        img_path.replace_extension(".jpg");
-                        imgtype = "jpegImage";
-                    }
-                    else if (rep.isDefined("pngImage")) {
-                        img_path.replace_extension(".png");
-                        imgtype = "pngImage";
-                    }
-                    // extract image blob
-                    BlobNode blob(rep.get(imgtype));
-                    ofstream img(img_path, ios_base::out|ios_base::binary);
-                    const streamsize buffer_size = 1024*1024;
-                    vector<uint8_t> buffer(buffer_size);
-                    int64_t offset = 0;
-                    int64_t remaining = blob.byteCount();
-                    size_t get;
-                    cout << "unpacking: " << img_path << " ... ";
-                    while(img && remaining > 0) {
-                        get = (remaining > buffer_size)?buffer_size:remaining;
-                        blob.read(&buffer[0], offset, get);
-                        img.write(reinterpret_cast<char*>(&buffer[0]), get);
-                        offset += get;
-                        remaining -= get;
-                    }
-                    img.close();
-                    // extract meta data
-                    inf << "guid = " << StringNode(image.get("guid")).value() << endl;
-                    if (image.isDefined("name")) {
-                        inf << "name = " << StringNode(image.get("name")).value() << endl;
-                    }
-                    if (image.isDefined("description")) {
-                        inf << "description = " << StringNode(image.get("description")).value() << endl;
-                    }
-                    if (image.isDefined("sensorVendor")) {
-                        inf << "sensorVendor = " << StringNode(image.get("sensorVendor")).value() << endl;
-                    }
-                    if (image.isDefined("sensorModel")) {
-                        inf << "sensorModel = " << StringNode(image.get("sensorModel")).value() << endl;
-                    }
-                    if (image.isDefined("sensorSerialNumber")) {
-                        inf << "sensorSerialNumber = " << StringNode(image.get("sensorSerialNumber")).value() << endl;
-                    }
-                    if (image.isDefined("pose")) {
-                        StructureNode pose(image.get("pose"));
-                        StructureNode translation(pose.get("translation"));
-                        StructureNode rotation(pose.get("rotation"));
-                        inf << "pose.translation.x = " << FloatNode(translation.get("x")).value() << endl;
-                        inf << "pose.translation.y = " << FloatNode(translation.get("y")).value() << endl;
-                        inf << "pose.translation.z = " << FloatNode(translation.get("z")).value() << endl;
-                        inf << "pose.rotation.w = " << FloatNode(rotation.get("w")).value() << endl;
-                        inf << "pose.rotation.x = " << FloatNode(rotation.get("x")).value() << endl;
-                        inf << "pose.rotation.y = " << FloatNode(rotation.get("y")).value() << endl;
-                        inf << "pose.rotation.z = " << FloatNode(rotation.get("z")).value() << endl;
-                    }
-                    if (rep.isDefined("imageHeight")) {
-                        inf << reptype+".imageHeight = " << IntegerNode(rep.get("imageHeight")).value() << endl;
-                        cout << IntegerNode(rep.get("imageHeight")).value() << " x ";
-                    }
-                    if (rep.isDefined("imageWidth")) {
-                        inf << reptype+".imageWidth = " << IntegerNode(rep.get("imageWidth")).value() << endl;
-                        cout << IntegerNode(rep.get("imageWidth")).value() << " pixels" << endl;
-                    }
-                    if (rep.isDefined("focalLength")) {
-                        inf << reptype+".focalLength = " << FloatNode(rep.get("focalLength")).value() << endl;
-                    }
-                    if (rep.isDefined("pixelWidth")) {
-                        inf << reptype+".pixelWidth = " << FloatNode(rep.get("pixelWidth")).value() << endl;
-                    }
-                    if (rep.isDefined("pixelHeight")) {
-                        inf << reptype+".pixelHeight = " << FloatNode(rep.get("pixelHeight")).value() << endl;
-                    }
-                    if (rep.isDefined("principalPointX")) {
-                        inf << reptype+".principalPointX = " << FloatNode(rep.get("principalPointX")).value() << endl;
-                    }
-                    if (rep.isDefined("principalPointY")) {
-                        inf << reptype+".principalPointY = " << FloatNode(rep.get("principalPointY")).value() << endl;
-                    }
-                    if (rep.isDefined("radius")) {
-                        inf << reptype+".radius = " << FloatNode(rep.get("radius")).value() << endl;
-                    }
-
-                    inf.close();
-                }
-            }
-
+            unpack(path(opt["src"].as<string>()), dst, cout);
             return 0;
         }
         else {
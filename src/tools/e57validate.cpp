@@ -71,6 +71,13 @@
 using std::strlen;
 #include <cmath>
 using std::fabs;
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <chrono>
 
 #include "E57Foundation.h"
 using namespace e57;
@@ -104,12 +111,13 @@ inline std::string toString(bool x)     {std::ostringstream ss; ss << x; return(
 
 /// Don't do any work if past specified maximumum message count (including expanding arguments).
 /// Note: the do{}while(0) loop eats the trailing semicolon after macro expansion of "PRINT_MESSAGE(...);"
-/// printMessage is called when messageCount is < 2 beyond allowed to allow suppression message to be printed.
+/// printMessage is called when messageCount is < 2 beyond allowed to allow suppression message to be printed (see countMessage).
+/// checkErrorLimit stops the validation when the error limit is reached.
 #define PRINT_MESSAGE(messageNumber, n, msg, cvp, index) do {                                   \
     if ((messageNumber) >= 0 && (messageNumber) < E57ValidatorOptions::MessageNumberCount) {    \
-        messageCount_[(messageNumber)]++;                                                       \
-        if (messageCount_[(messageNumber)] < options_.messagesAllowed[(messageNumber)]+2)       \
+        if (countMessage(messageNumber))                                                        \
             printMessage((messageNumber), (n), (msg), (cvp), (index));                          \
+        checkErrorLimit(messageNumber);                                                         \
     }                                                                                           \
 } while (0)
 
@@ -119,10 +127,16 @@ struct E57ValidatorOptions {
     static const int MessageNumberCount = 5000;
 
     uint64_t    messagesAllowed[MessageNumberCount];
+    uint64_t    maxErrorCount;  /// stop validating after this many errors, 0 for no limit
+    unsigned    threadCount;    /// number of threads that check the records of a large points CompressedVector
 
     E57ValidatorOptions() {
         for (int i = 0; i < MessageNumberCount; i++)
             messagesAllowed[i] = 100;
+        maxErrorCount = 0;
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0)
+            threadCount = 1;
     };
 };
 
@@ -135,6 +149,7 @@ struct CommandLineOptions {
             CommandLineOptions(){};
     void    parse(int argc, char** argv);
     void    usage(ustring msg);
+    uint64_t parseValue(const char* flag);
 };
 
 void CommandLineOptions::usage(ustring msg)
@@ -153,16 +168,31 @@ void CommandLineOptions::usage(ustring msg)
     cerr << "        -i=<N> print a maximum of N messages for each informational message code." << endl;
     cerr << "        -m<DDDD> suppress printing of specific 4 digit message code DDDD." << endl;
     cerr << "        -m<DDDD>=<N> print a maximum of N messages for specific 4 digit message code DDDD." << endl;
+    cerr << "        -x=<N> stop validating after the first N errors." << endl;
+    cerr << "        -t=<N> check the points of large scans with N threads (default: number of cores)." << endl;
     cerr << "    For example:" << endl;
     cerr << "        e57validate scan0001.e57               // validate a file with default options" << endl;
     cerr << "        e57validate -i scan0001.e57            // suppress all informational messages" << endl;
     cerr << "        e57validate -w=10 scan0001.e57         // print up to 10 lines of each type of warning message" << endl;
     cerr << "        e57validate -m4003 scan0001.e57        // suppress message number 4003" << endl;
     cerr << "        e57validate -m4003=10 scan0001.e57     // print up to 10 lines of message number 4003" << endl;
+    cerr << "        e57validate -x=1 scan0001.e57          // stop at the first error" << endl;
     cerr << endl;
     exit(-1);
 }
 
+uint64_t CommandLineOptions::parseValue(const char* flag)
+{
+    /// Get N from a flag of the form "-c=<N>"
+    if (flag[2] != '=' || flag[3] == '\0')
+        usage(ustring("bad option format in flag ") + flag);
+    for (size_t j = 3; j < strlen(flag); j++) {
+        if (flag[j] < '0' || '9' < flag[j])
+            usage(ustring("bad decimal number in flag") + flag);
+    }
+    return(strtoull(&flag[3], NULL, 10));
+}
+
 void CommandLineOptions::parse(int argc, char** argv)
 {
     /// Skip program name
@@ -267,6 +297,15 @@ void CommandLineOptions::parse(int argc, char** argv)
                     options.messagesAllowed[i] = allowed;
             }
             options.messagesAllowed[messageNumber] = allowed;
+        } else if (argv[0][1] == 'x') {
+            options.maxErrorCount = parseValue(argv[0]);
+            if (options.maxErrorCount == 0)
+                usage(ustring("error limit must be at least one in flag ") + argv[0]);
+        } else if (argv[0][1] == 't') {
+            uint64_t threadCount = parseValue(argv[0]);
+            if (threadCount == 0 || threadCount > 1024)
+                usage(ustring("bad thread count in flag ") + argv[0]);
+            options.threadCount = static_cast<unsigned>(threadCount);
         } else
             usage(ustring("unknown option: ") + argv[0]);
     }
@@ -449,6 +488,30 @@ struct PointBuffers {
         return(dbufs);
     };
 
+    /// Allocate the same buffers as other, so that another reader gets the same fields
+    void allocateLike(const PointBuffers& other) {
+        if (other.cartesianX)            cartesianX = new double[elementCount];
+        if (other.cartesianY)            cartesianY = new double[elementCount];
+        if (other.cartesianZ)            cartesianZ = new double[elementCount];
+        if (other.sphericalRange)        sphericalRange = new double[elementCount];
+        if (other.sphericalAzimuth)      sphericalAzimuth = new double[elementCount];
+        if (other.sphericalElevation)    sphericalElevation = new double[elementCount];
+        if (other.rowIndex)              rowIndex = new int64_t[elementCount];
+        if (other.columnIndex)           columnIndex = new int64_t[elementCount];
+        if (other.returnCount)           returnCount = new int64_t[elementCount];
+        if (other.returnIndex)           returnIndex = new int64_t[elementCount];
+        if (other.timeStamp)             timeStamp = new double[elementCount];
+        if (other.intensity)             intensity = new double[elementCount];
+        if (other.colorRed)              colorRed = new double[elementCount];
+        if (other.colorGreen)            colorGreen = new double[elementCount];
+        if (other.colorBlue)             colorBlue = new double[elementCount];
+        if (other.cartesianInvalidState) cartesianInvalidState = new int8_t[elementCount];
+        if (other.sphericalInvalidState) sphericalInvalidState = new int8_t[elementCount];
+        if (other.isTimeStampInvalid)    isTimeStampInvalid = new int8_t[elementCount];
+        if (other.isIntensityInvalid)    isIntensityInvalid = new int8_t[elementCount];
+        if (other.isColorInvalid)        isColorInvalid = new int8_t[elementCount];
+    };
+
     ~PointBuffers() {
         if (cartesianX)            delete [] cartesianX;
         if (cartesianY)            delete [] cartesianY;
@@ -485,6 +548,7 @@ struct BoundingBox {
             BoundingBox(StructureNode bounds, ustring boundsName);
     void    addPoint(double x0, double x1, double x2);
     void    addPoint(double coords[3]);
+    void    merge(const BoundingBox& other);
     bool    contains(double x0, double x1, double x2);
     bool    contains(double coords[3]);
     void    dump(int indent = 0, std::ostream& os = std::cout);
@@ -577,6 +641,20 @@ void BoundingBox::addPoint(double coords[3])
     }
 }
 
+void BoundingBox::merge(const BoundingBox& other)
+{
+    /// Grow to hold other, which was accumulated from other points
+    if (other.notEmpty) {
+        double coords[3];
+        for (unsigned i = 0; i < 3; i++)
+            coords[i] = other.minimum[i];
+        addPoint(coords);
+        for (unsigned i = 0; i < 3; i++)
+            coords[i] = other.maximum[i];
+        addPoint(coords);
+    }
+}
+
 bool BoundingBox::contains(double x0, double x1, double x2)
 {
     double coords[3];
@@ -685,6 +763,7 @@ public:
     bool        isDefined() {return(isDefined_);};
     bool        isByRow() {return(isByRow_);};
     LineGroup*  findLineGroup(int64_t lineIndex);
+    void        mergeActual(const LineGrouping& other);
 
     void        dump(int indent = 0, std::ostream& os = std::cout);
 //================
@@ -851,6 +930,19 @@ LineGroup* LineGrouping::findLineGroup(int64_t lineIndex)
     return(iter != groups_.end() ? &iter->second : NULL);
 }
 
+void LineGrouping::mergeActual(const LineGrouping& other)
+{
+    /// Add the actual bounding boxes of a copy of this grouping, that other points were added to
+    GroupsMap::const_iterator iter;
+    for (iter = other.groups_.begin(); iter != other.groups_.end(); iter++) {
+        LineGroup* lineGroup = findLineGroup(iter->first);
+        if (lineGroup) {
+            lineGroup->actualCartesianBounds.merge(iter->second.actualCartesianBounds);
+            lineGroup->actualSphericalBounds.merge(iter->second.actualSphericalBounds);
+        }
+    }
+}
+
 void LineGrouping::dump(int indent, std::ostream& os)
 {
     os << space(indent) << "isDefined:     " << isDefined_ << endl;
@@ -867,6 +959,120 @@ void LineGrouping::dump(int indent, std::ostream& os)
 
 //================================================================
 
+/// The declared bounds and line grouping of a Data3D that its point records are checked against.
+/// Read once, then shared (read only) by all the ranges of records that are checked.
+struct PointRecordContext {
+    LineGrouping lineGrouping;
+    bool        cartesianBoundsDefined;
+    BoundingBox cartesianBounds;
+    bool        sphericalBoundsDefined;
+    BoundingBox sphericalBounds;
+    bool        indexBoundsDefined;
+    BoundingBox indexBounds;
+
+    PointRecordContext(CompressedVectorNode cv);
+};
+
+PointRecordContext::PointRecordContext(CompressedVectorNode cv)
+: lineGrouping(cv.parent()),    /// Read defined line grouping into memory (if any)
+  cartesianBoundsDefined(false),
+  sphericalBoundsDefined(false),
+  indexBoundsDefined(false)
+{
+    StructureNode data3D = StructureNode(cv.parent());
+
+    /// Get cartesianBounds, if any
+    if (data3D.isDefined("cartesianBounds")) {
+        cartesianBoundsDefined = true;
+        cartesianBounds = BoundingBox(StructureNode(data3D.get("cartesianBounds")), "cartesianBounds");
+    }
+
+    /// Get sphericalBounds, if any
+    if (data3D.isDefined("sphericalBounds")) {
+        sphericalBoundsDefined = true;
+        sphericalBounds = BoundingBox(StructureNode(data3D.get("sphericalBounds")), "sphericalBounds");
+    }
+
+    /// Get indexBounds, if any
+    if (data3D.isDefined("indexBounds")) {
+        indexBoundsDefined = true;
+        indexBounds = BoundingBox(StructureNode(data3D.get("indexBounds")), "indexBounds");
+    }
+}
+
+//================================================================
+
+/// A message of a validator that checks part of the file on another thread, kept to be printed later in file order.
+struct LoggedMessage {
+    int         messageNumber;
+    bool        countOnly;      /// message was past its print limit, it is only kept to count errors in order
+    ustring     location;
+    ustring     msg;
+
+    LoggedMessage(int messageNumber0, ustring location0 = "", ustring msg0 = "", bool countOnly0 = false)
+        : messageNumber(messageNumber0), countOnly(countOnly0), location(location0), msg(msg0) {};
+};
+
+/// Thrown to stop validating when the error limit (E57ValidatorOptions::maxErrorCount) is reached
+struct StopValidation {};
+
+/// Records [firstRecord, endRecord) of a points CompressedVector, and what was found checking them
+struct PointRecordRange {
+    uint64_t    firstRecord;
+    uint64_t    endRecord;
+    uint64_t    recordCount;            /// number of records checked so far
+
+    /// Bounding boxes of the actual points, in a copy of the line grouping for the line groups
+    LineGrouping lineGrouping;
+    BoundingBox scanCartesianBoundsActual;
+    BoundingBox scanSphericalBoundsActual;
+    int64_t     rowIndexActualMinimum;
+    int64_t     rowIndexActualMaximum;
+    int64_t     columnIndexActualMinimum;
+    int64_t     columnIndexActualMaximum;
+    int64_t     returnIndexActualMinimum;
+    int64_t     returnIndexActualMaximum;
+
+    /// When checked on another thread: the messages to print, the message counts, and the error count so far
+    vector<LoggedMessage>   log;
+    vector<uint64_t>        messageCount;
+    std::atomic<uint64_t>   errorCount;
+    std::exception_ptr      error;
+
+    PointRecordRange(const PointRecordContext& context, uint64_t firstRecord0, uint64_t endRecord0);
+    void merge(const PointRecordRange& later);
+};
+
+PointRecordRange::PointRecordRange(const PointRecordContext& context, uint64_t firstRecord0, uint64_t endRecord0)
+: firstRecord(firstRecord0),
+  endRecord(endRecord0),
+  recordCount(0),
+  lineGrouping(context.lineGrouping),
+  rowIndexActualMinimum(E57_INT64_MAX),
+  rowIndexActualMaximum(E57_INT64_MIN),
+  columnIndexActualMinimum(E57_INT64_MAX),
+  columnIndexActualMaximum(E57_INT64_MIN),
+  returnIndexActualMinimum(E57_INT64_MAX),
+  returnIndexActualMaximum(E57_INT64_MIN),
+  errorCount(0)
+{}
+
+void PointRecordRange::merge(const PointRecordRange& later)
+{
+    recordCount += later.recordCount;
+    lineGrouping.mergeActual(later.lineGrouping);
+    scanCartesianBoundsActual.merge(later.scanCartesianBoundsActual);
+    scanSphericalBoundsActual.merge(later.scanSphericalBoundsActual);
+    rowIndexActualMinimum    = std::min(rowIndexActualMinimum, later.rowIndexActualMinimum);
+    rowIndexActualMaximum    = std::max(rowIndexActualMaximum, later.rowIndexActualMaximum);
+    columnIndexActualMinimum = std::min(columnIndexActualMinimum, later.columnIndexActualMinimum);
+    columnIndexActualMaximum = std::max(columnIndexActualMaximum, later.columnIndexActualMaximum);
+    returnIndexActualMinimum = std::min(returnIndexActualMinimum, later.returnIndexActualMinimum);
+    returnIndexActualMaximum = std::max(returnIndexActualMaximum, later.returnIndexActualMaximum);
+}
+
+//================================================================
+
 class E57Validator {
 public:
     E57Validator(E57ValidatorOptions opts, std::ostream& os = std::cout);
@@ -878,6 +1084,7 @@ public:
     uint64_t suspiciousCount() const;
     uint64_t informationalCount() const;
     uint64_t messageCount(int messageNumber) const;
+    uint64_t pointRecordCount() const {return(pointRecordCount_);};
 
     void dump(int indent = 0, std::ostream& os = std::cout) const;
 
@@ -886,6 +1093,16 @@ protected:
     std::ostream&       os_;
     E57ValidatorOptions options_;
     uint64_t            messageCount_[E57ValidatorOptions::MessageNumberCount];
+    uint64_t            errorTotal_;        /// errors counted towards options_.maxErrorCount
+    uint64_t            pointRecordCount_;  /// number of point records checked
+
+    /// Set in a validator that checks a range of point records on another thread:
+    /// its messages are kept here instead of printed, and it stops when stopRequested_ returns true.
+    vector<LoggedMessage>*  log_;
+    std::function<bool()>   stopRequested_;
+
+    /// Records of a points CompressedVector checked by each thread, smaller ones are checked by a single thread
+    static const uint64_t MIN_RANGE_RECORD_COUNT = 256*1024;
 
     bool validateInteger(Node n, CompressedVectorNode* cvp = NULL, uint64_t index = 0);
     bool validateScaledInteger(Node n, CompressedVectorNode* cvp = NULL, uint64_t index = 0);
@@ -907,6 +1124,11 @@ protected:
     void validateOriginalGuids(Node n);
     void validatePoints(Node n);
     void validatePointRecordContents(CompressedVectorNode cv, StructureNode proto, PointBuffers& pbufs);
+    void checkPointRecords(CompressedVectorNode cv, StructureNode proto, PointBuffers& pbufs,
+                           const PointRecordContext& context, PointRecordRange& range);
+    static void checkPointRecordRange(const E57ValidatorOptions& options, CompressedVectorNode cv, PointBuffers& pbufs,
+                                      const PointRecordContext& context, vector<std::unique_ptr<PointRecordRange> >& ranges, size_t r);
+    void replayMessages(const PointRecordRange& range);
     void validatePointGroupingSchemes(Node n);
     void validateGroupingByLine(Node n);
     void validateLineGroupRecords(Node n);
@@ -927,13 +1149,19 @@ protected:
     void validateGuid(Node n, CompressedVectorNode* cvp = NULL, uint64_t index = 0);
     void validateCoordinateMetadata(Node n);
     void validateExtensionElement(Node n, CompressedVectorNode* cvp = NULL, uint64_t index = 0);
+    bool countMessage(int messageNumber);
+    void checkErrorLimit(int messageNumber);
     void printMessage(int messageNumber, Node n, ustring msg, CompressedVectorNode* cvp = NULL, uint64_t index = 0);
+    void emitMessage(int messageNumber, const ustring& location, const ustring& msg);
     void checkRequired(StructureNode sn, ustring name, CompressedVectorNode* cvp = NULL, uint64_t index = 0);
 };
 
 E57Validator::E57Validator(E57ValidatorOptions opts, std::ostream& os)
-: options_(opts),
-  os_(os)
+: os_(os),
+  options_(opts),
+  errorTotal_(0),
+  pointRecordCount_(0),
+  log_(NULL)
 {
     for (int i = 0; i < E57ValidatorOptions::MessageNumberCount; i++)
         messageCount_[i] = 0;
@@ -975,7 +1203,11 @@ uint64_t E57Validator::messageCount(int messageNumber) const {
 }
 
 void E57Validator::validate(ImageFile imf) {
-    validateE57Root(imf.root());
+    try {
+        validateE57Root(imf.root());
+    } catch (StopValidation&) {
+        os_ << "Stopped validating after " << toString(errorTotal_) << " errors." << endl;
+    }
 }
 
 //================================================================
@@ -1520,53 +1752,189 @@ void E57Validator::validatePoints(Node n) {
 }
 
 void E57Validator::validatePointRecordContents(CompressedVectorNode cv, StructureNode proto, PointBuffers& pbufs) {
-    StructureNode data3D = StructureNode(cv.parent());
-
-    /// Read defined line grouping into memory (if any)
-    LineGrouping lineGrouping(cv.parent());
+    /// Read the declared bounds and line grouping once, all ranges of records are checked against them
+    PointRecordContext context(cv);
 //cout << "lineGrouping:" << endl; //???
-//lineGrouping.dump(4); //???
+//context.lineGrouping.dump(4); //???
+
+    /// Split large CompressedVectors into ranges of records, each checked on its own thread
+    uint64_t recordCount = cv.childCount();
+    uint64_t rangeCount = recordCount / MIN_RANGE_RECORD_COUNT;
+    if (rangeCount > options_.threadCount)
+        rangeCount = options_.threadCount;
+
+    if (rangeCount <= 1) {
+        PointRecordRange range(context, 0, recordCount);
+        try {
+            checkPointRecords(cv, proto, pbufs, context, range);
+        } catch (StopValidation&) {
+            pointRecordCount_ += range.recordCount;
+            throw;
+        }
+        pointRecordCount_ += range.recordCount;
+        return;
+    }
 
-    /// Get cartesianBounds, if any
-    bool cartesianBoundsDefined = false;
-    BoundingBox cartesianBounds;
-    if (data3D.isDefined("cartesianBounds")) {
-        cartesianBoundsDefined = true;
-        cartesianBounds = BoundingBox(StructureNode(data3D.get("cartesianBounds")), "cartesianBounds");
-//cout << "cartesianBounds:" << endl; //???
-//cartesianBounds.dump(4); //???
+    vector<std::unique_ptr<PointRecordRange> > ranges;
+    for (uint64_t r = 0; r < rangeCount; r++)
+        ranges.push_back(std::unique_ptr<PointRecordRange>(new PointRecordRange(context, recordCount*r/rangeCount, recordCount*(r+1)/rangeCount)));
+
+    /// The errors already found count towards the error limit of the ranges
+    E57ValidatorOptions rangeOptions = options_;
+    if (options_.maxErrorCount > 0)
+        rangeOptions.maxErrorCount = options_.maxErrorCount - errorTotal_;
+
+    /// An ImageFile can only be used by one thread at a time, so each extra thread opens the file again
+    ustring fileName = cv.destImageFile().fileName();
+    ustring cvPath = cv.pathName();
+    vector<std::thread> threads;
+    for (size_t r = 1; r < ranges.size(); r++) {
+        threads.push_back(std::thread([&, r]() {
+            try {
+                ImageFile imf(fileName, "r", "lazyXml");
+                PointBuffers rangeBufs = PointBuffers();
+                rangeBufs.allocateLike(pbufs);
+                checkPointRecordRange(rangeOptions, CompressedVectorNode(imf.root().get(cvPath)), rangeBufs, context, ranges, r);
+                imf.close();
+            } catch (...) {
+                ranges[r]->error = std::current_exception();
+            }
+        }));
     }
 
-    /// Get sphericalBounds, if any
-    bool sphericalBoundsDefined = false;
-    BoundingBox sphericalBounds;
-    if (data3D.isDefined("sphericalBounds")) {
-        sphericalBoundsDefined = true;
-        sphericalBounds = BoundingBox(StructureNode(data3D.get("sphericalBounds")), "sphericalBounds");
-//cout << "sphericalBounds:" << endl; //???
-//sphericalBounds.dump(4); //???
+    /// The first range is checked on this thread
+    try {
+        checkPointRecordRange(rangeOptions, cv, pbufs, context, ranges, 0);
+    } catch (...) {
+        ranges[0]->error = std::current_exception();
     }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
 
-    /// Get indexBounds, if any
-    bool indexBoundsDefined = false;
-    BoundingBox indexBounds;
-    if (data3D.isDefined("indexBounds")) {
-        indexBoundsDefined = true;
-        indexBounds = BoundingBox(StructureNode(data3D.get("indexBounds")), "indexBounds");
-//cout << "indexBounds:" << endl; //???
-//indexBounds.dump(4); //???
+    /// Print the messages of the ranges in file order, with the same counting and suppression as checking the records in turn
+    for (size_t r = 0; r < ranges.size(); r++) {
+        PointRecordRange& range = *ranges[r];
+        pointRecordCount_ += range.recordCount;
+        replayMessages(range);
+        if (range.error)
+            std::rethrow_exception(range.error);
+        if (r > 0)
+            ranges[0]->merge(range);
     }
 
-    /// Declare bounding boxes for actual points
-    BoundingBox scanCartesianBoundsActual;
-    BoundingBox scanSphericalBoundsActual;
+    /// Check scan bboxes tight (ranges[0] now holds the actual bounds of all the points)
+//???
+
+    //??? check each lineGroup: (actual vs. declared) start, count, bboxes tight
+}
+
+void E57Validator::checkPointRecordRange(const E57ValidatorOptions& options, CompressedVectorNode cv, PointBuffers& pbufs,
+                                         const PointRecordContext& context, vector<std::unique_ptr<PointRecordRange> >& ranges, size_t r) {
+    PointRecordRange& range = *ranges[r];
+
+    /// Check with a validator of our own, that counts from zero and keeps its messages in the range's log
+    E57Validator validator(options);
+    validator.log_ = &range.log;
+
+    /// Stop when the ranges before this one have used up the error limit (this range's own errors are counted by checkErrorLimit)
+    if (options.maxErrorCount > 0) {
+        validator.stopRequested_ = [&ranges, r, &options]() {
+            uint64_t earlierErrors = 0;
+            for (size_t i = 0; i < r; i++)
+                earlierErrors += ranges[i]->errorCount;
+            return(earlierErrors >= options.maxErrorCount);
+        };
+    }
+
+    try {
+        validator.checkPointRecords(cv, StructureNode(cv.prototype()), pbufs, context, range);
+    } catch (StopValidation&) {
+        /// The messages so far are in the log, the ones after the limit aren't needed
+    }
+    range.errorCount = validator.errorTotal_;
+    range.messageCount.assign(validator.messageCount_, validator.messageCount_ + E57ValidatorOptions::MessageNumberCount);
+}
+
+void E57Validator::replayMessages(const PointRecordRange& range) {
+    /// Count and print the logged messages in order, as PRINT_MESSAGE would have
+    vector<uint64_t> loggedCount(E57ValidatorOptions::MessageNumberCount, 0);
+    for (size_t i = 0; i < range.log.size(); i++) {
+        const LoggedMessage& m = range.log[i];
+        loggedCount[m.messageNumber]++;
+        if (countMessage(m.messageNumber) && !m.countOnly)
+            emitMessage(m.messageNumber, m.location, m.msg);
+        checkErrorLimit(m.messageNumber);
+    }
+
+    /// Add the messages that were past their print limit, and weren't kept
+    if (!range.messageCount.empty()) {
+        for (int i = 0; i < E57ValidatorOptions::MessageNumberCount; i++)
+            messageCount_[i] += range.messageCount[i] - loggedCount[i];
+    }
+}
+
+/// Bits set in the flags of each record of a block, by the checks of whole blocks in checkPointRecords
+enum {
+    CARTESIAN_X_OUT_OF_BOUNDS           = 0x001,
+    CARTESIAN_Y_OUT_OF_BOUNDS           = 0x002,
+    CARTESIAN_Z_OUT_OF_BOUNDS           = 0x004,
+    SPHERICAL_RANGE_OUT_OF_BOUNDS       = 0x008,
+    SPHERICAL_AZIMUTH_OUT_OF_BOUNDS     = 0x010,
+    SPHERICAL_ELEVATION_OUT_OF_BOUNDS   = 0x020,
+    ROW_INDEX_OUT_OF_BOUNDS             = 0x040,
+    COLUMN_INDEX_OUT_OF_BOUNDS          = 0x080,
+    RETURN_INDEX_OUT_OF_BOUNDS          = 0x100
+};
 
-    int64_t rowIndexActualMinimum    = E57_INT64_MAX;
-    int64_t rowIndexActualMaximum    = E57_INT64_MIN;
-    int64_t columnIndexActualMinimum = E57_INT64_MAX;
-    int64_t columnIndexActualMaximum = E57_INT64_MIN;
-    int64_t returnIndexActualMinimum = E57_INT64_MAX;
-    int64_t returnIndexActualMaximum = E57_INT64_MIN;
+/// Set flag for each value in [begin,end) outside of [minimum,maximum].
+/// There are no branches in the loop, so the compiler can vectorize it.
+template <class T>
+void flagOutOfBounds(const T* values, size_t begin, size_t end, double minimum, double maximum, uint16_t flag, uint16_t* flags)
+{
+    for (size_t i = begin; i < end; i++) {
+        double value = static_cast<double>(values[i]);
+        flags[i] |= static_cast<uint16_t>(((value < minimum) | (maximum < value)) * flag);
+    }
+}
+
+/// Convert coordinates using formulas from 5.5 of ASTM E57 standard
+inline void cartesianToSpherical(double x, double y, double z, double& range, double& azimuth, double& elevation)
+{
+    range = sqrt(x*x + y*y + z*z);
+    azimuth = 0.0;
+    if (x != 0 || y != 0)
+        azimuth = atan2(y, x);
+    elevation = 0.0;
+    if (range != 0)
+        elevation = asin(z / range);
+}
+
+inline void sphericalToCartesian(double range, double azimuth, double elevation, double& x, double& y, double& z)
+{
+    x = range * cos(elevation) * cos(azimuth);
+    y = range * cos(elevation) * sin(azimuth);
+    z = range * sin(elevation);
+}
+
+void E57Validator::checkPointRecords(CompressedVectorNode cv, StructureNode proto, PointBuffers& pbufs,
+                                     const PointRecordContext& context, PointRecordRange& records) {
+    const BoundingBox& cartesianBounds = context.cartesianBounds;
+    const BoundingBox& sphericalBounds = context.sphericalBounds;
+    const BoundingBox& indexBounds = context.indexBounds;
+    LineGrouping& lineGrouping = records.lineGrouping;
+
+    /// Converted coordinates are only needed where there are declared bounds to check them against
+    bool checkCartesianBounds = context.cartesianBoundsDefined && cartesianBounds.notEmpty;
+    bool checkSphericalBounds = context.sphericalBoundsDefined && sphericalBounds.notEmpty;
+
+    /// Kept in local variables in the loop, and stored in records after each block.
+    /// The record count is kept in records, so it is right when the error limit stops the checking part way through a block.
+    int64_t rowIndexActualMinimum    = records.rowIndexActualMinimum;
+    int64_t rowIndexActualMaximum    = records.rowIndexActualMaximum;
+    int64_t columnIndexActualMinimum = records.columnIndexActualMinimum;
+    int64_t columnIndexActualMaximum = records.columnIndexActualMaximum;
+    int64_t returnIndexActualMinimum = records.returnIndexActualMinimum;
+    int64_t returnIndexActualMaximum = records.returnIndexActualMaximum;
 
     int64_t prevReturnIndex = 0;
     int64_t prevReturnCount = 0;
@@ -1574,41 +1942,83 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
     /// Get iterator that reads CompressedVector contents in blocks
     CompressedVectorReader reader = cv.reader(pbufs.allBuffers(cv.destImageFile()));
 
-    size_t gotCount = 0;
+    /// A range after the first starts one record early, for the state of the multiple return sequence
     uint64_t blockStart = 0;
+    if (records.firstRecord > 0) {
+        blockStart = records.firstRecord - 1;
+        reader.seek(blockStart);
+    }
+
+    vector<uint16_t> flags(PointBuffers::elementCount);
+    size_t gotCount = 0;
     do {
+        if (stopRequested_ && stopRequested_())
+            throw StopValidation();
+
         /// Read a block of data into the buffers in pbufs
         gotCount = reader.read();
 //printf("points read, gotCount=%d\n", gotCount); //???
 
+        /// Only check the records of the range in this block
+        size_t begin = 0;
+        if (blockStart < records.firstRecord)
+            begin = static_cast<size_t>(std::min<uint64_t>(records.firstRecord - blockStart, gotCount));
+        size_t end = gotCount;
+        if (blockStart + end > records.endRecord)
+            end = static_cast<size_t>(records.endRecord - blockStart);
+        if (begin > 0 && pbufs.returnIndex && pbufs.returnCount) {
+            prevReturnIndex = pbufs.returnIndex[begin-1];
+            prevReturnCount = pbufs.returnCount[begin-1];
+        }
+
+        /// Check the bounds of the whole block first, the loop over the records below only looks at the flags
+        std::fill(flags.begin(), flags.end(), 0);
+        if (checkCartesianBounds && pbufs.cartesianX && pbufs.cartesianY && pbufs.cartesianZ) {
+            flagOutOfBounds(pbufs.cartesianX, begin, end, cartesianBounds.minimum[0], cartesianBounds.maximum[0], CARTESIAN_X_OUT_OF_BOUNDS, &flags[0]);
+            flagOutOfBounds(pbufs.cartesianY, begin, end, cartesianBounds.minimum[1], cartesianBounds.maximum[1], CARTESIAN_Y_OUT_OF_BOUNDS, &flags[0]);
+            flagOutOfBounds(pbufs.cartesianZ, begin, end, cartesianBounds.minimum[2], cartesianBounds.maximum[2], CARTESIAN_Z_OUT_OF_BOUNDS, &flags[0]);
+        }
+        if (checkSphericalBounds && pbufs.sphericalRange && pbufs.sphericalAzimuth && pbufs.sphericalElevation) {
+            flagOutOfBounds(pbufs.sphericalRange, begin, end, sphericalBounds.minimum[0], sphericalBounds.maximum[0], SPHERICAL_RANGE_OUT_OF_BOUNDS, &flags[0]);
+            flagOutOfBounds(pbufs.sphericalAzimuth, begin, end, sphericalBounds.minimum[1], sphericalBounds.maximum[1], SPHERICAL_AZIMUTH_OUT_OF_BOUNDS, &flags[0]);
+            flagOutOfBounds(pbufs.sphericalElevation, begin, end, sphericalBounds.minimum[2], sphericalBounds.maximum[2], SPHERICAL_ELEVATION_OUT_OF_BOUNDS, &flags[0]);
+        }
+        if (pbufs.rowIndex)
+            flagOutOfBounds(pbufs.rowIndex, begin, end, indexBounds.minimum[0], indexBounds.maximum[0], ROW_INDEX_OUT_OF_BOUNDS, &flags[0]);
+        if (pbufs.columnIndex)
+            flagOutOfBounds(pbufs.columnIndex, begin, end, indexBounds.minimum[1], indexBounds.maximum[1], COLUMN_INDEX_OUT_OF_BOUNDS, &flags[0]);
+        if (pbufs.returnIndex && pbufs.returnCount)
+            flagOutOfBounds(pbufs.returnIndex, begin, end, indexBounds.minimum[2], indexBounds.maximum[2], RETURN_INDEX_OUT_OF_BOUNDS, &flags[0]);
+
         /// Process block one record at a time
-        for (size_t i = 0; i < gotCount; i++) {
+        for (size_t i = begin; i < end; i++) {
+            records.recordCount++;
+
             //================================================================
             if (pbufs.cartesianX && pbufs.cartesianY && pbufs.cartesianZ) {
                 if (!pbufs.cartesianInvalidState || pbufs.cartesianInvalidState[i] == 0) {  /// This point coordinate is valid
-                    /// Calc spherical coords from cartesian using formulas from 5.5 of ASTM E57 standard
-                    double range = sqrt(pbufs.cartesianX[i]*pbufs.cartesianX[i]
-                                        + pbufs.cartesianY[i]*pbufs.cartesianY[i]
-                                        + pbufs.cartesianZ[i]*pbufs.cartesianZ[i]);
+                    double x = pbufs.cartesianX[i];
+                    double y = pbufs.cartesianY[i];
+                    double z = pbufs.cartesianZ[i];
+
+                    /// Calc spherical coords from cartesian, when there are spherical bounds to check
+                    double range = 0.0;
                     double azimuth = 0.0;
-                    if (pbufs.cartesianX[i] != 0 || pbufs.cartesianY[i] != 0)
-                        azimuth = atan2(pbufs.cartesianY[i], pbufs.cartesianX[i]);
                     double elevation = 0.0;
-                    if (range != 0)
-                        elevation = asin(pbufs.cartesianZ[i] / range);
+                    bool converted = false;
 
                     /// Check each coordinate in Cartesian bounds
-                    if (cartesianBoundsDefined && cartesianBounds.notEmpty) {
-                        if ((pbufs.cartesianX[i] < cartesianBounds.minimum[0]) || (cartesianBounds.maximum[0] < pbufs.cartesianX[i]))
-                            PRINT_MESSAGE(1000/*???*/, proto.get("cartesianX"), "value " + toString(pbufs.cartesianX[i]) + " is out of Cartesian bounds", &cv, blockStart+i);
-                        if ((pbufs.cartesianY[i] < cartesianBounds.minimum[1]) || (cartesianBounds.maximum[1] < pbufs.cartesianY[i]))
-                            PRINT_MESSAGE(1000/*???*/, proto.get("cartesianY"), "value " + toString(pbufs.cartesianY[i]) + " is out of Cartesian bounds", &cv, blockStart+i);
-                        if ((pbufs.cartesianZ[i] < cartesianBounds.minimum[2]) || (cartesianBounds.maximum[2] < pbufs.cartesianZ[i]))
-                            PRINT_MESSAGE(1000/*???*/, proto.get("cartesianZ"), "value " + toString(pbufs.cartesianZ[i]) + " is out of Cartesian bounds", &cv, blockStart+i);
-                    }
+                    if (flags[i] & CARTESIAN_X_OUT_OF_BOUNDS)
+                        PRINT_MESSAGE(1000/*???*/, proto.get("cartesianX"), "value " + toString(x) + " is out of Cartesian bounds", &cv, blockStart+i);
+                    if (flags[i] & CARTESIAN_Y_OUT_OF_BOUNDS)
+                        PRINT_MESSAGE(1000/*???*/, proto.get("cartesianY"), "value " + toString(y) + " is out of Cartesian bounds", &cv, blockStart+i);
+                    if (flags[i] & CARTESIAN_Z_OUT_OF_BOUNDS)
+                        PRINT_MESSAGE(1000/*???*/, proto.get("cartesianZ"), "value " + toString(z) + " is out of Cartesian bounds", &cv, blockStart+i);
 
                     /// Check each coordinate in Spherical bounds
-                    if (sphericalBoundsDefined && sphericalBounds.notEmpty) {
+                    if (checkSphericalBounds) {
+                        cartesianToSpherical(x, y, z, range, azimuth, elevation);
+                        converted = true;
                         if ((range < sphericalBounds.minimum[0]) || (sphericalBounds.maximum[0] < range))
                             PRINT_MESSAGE(1000/*???*/, proto.get("cartesianX"), "converted range " + toString(range) + " is out of spherical bounds", &cv, blockStart+i);
                         if ((azimuth < sphericalBounds.minimum[1]) || (sphericalBounds.maximum[1] < azimuth))
@@ -1641,24 +2051,24 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
                             /// Check is inside cartesian bounding box of the lineGroup
                             if (lineGroup->declaredCartesianBoundsDefined) {
 //lineGroup->declaredCartesianBounds.dump(4); //???
-                                if (pbufs.cartesianX[i] < lineGroup->declaredCartesianBounds.minimum[0]
-                                    || lineGroup->declaredCartesianBounds.maximum[0] < pbufs.cartesianX[i]) {
+                                if (x < lineGroup->declaredCartesianBounds.minimum[0]
+                                    || lineGroup->declaredCartesianBounds.maximum[0] < x) {
                                     PRINT_MESSAGE(1000/*???*/, proto.get("cartesianX"),
-                                               "value " + toString(pbufs.cartesianX[i]) + " is out of Cartesian bounds of line group "
+                                               "value " + toString(x) + " is out of Cartesian bounds of line group "
                                                + toString(lineIndex),
                                                &cv, blockStart+i);
                                 }
-                                if (pbufs.cartesianY[i] < lineGroup->declaredCartesianBounds.minimum[1]
-                                    || lineGroup->declaredCartesianBounds.maximum[1] < pbufs.cartesianY[i]) {
+                                if (y < lineGroup->declaredCartesianBounds.minimum[1]
+                                    || lineGroup->declaredCartesianBounds.maximum[1] < y) {
                                     PRINT_MESSAGE(1000/*???*/, proto.get("cartesianY"),
-                                               "value " + toString(pbufs.cartesianY[i]) + " is out of Cartesian bounds of line group "
+                                               "value " + toString(y) + " is out of Cartesian bounds of line group "
                                                + toString(lineIndex),
                                                &cv, blockStart+i);
                                 }
-                                if (pbufs.cartesianZ[i] < lineGroup->declaredCartesianBounds.minimum[2]
-                                    || lineGroup->declaredCartesianBounds.maximum[2] < pbufs.cartesianZ[i]) {
+                                if (z < lineGroup->declaredCartesianBounds.minimum[2]
+                                    || lineGroup->declaredCartesianBounds.maximum[2] < z) {
                                     PRINT_MESSAGE(1000/*???*/, proto.get("cartesianZ"),
-                                               "value " + toString(pbufs.cartesianZ[i]) + " is out of Cartesian bounds of line group "
+                                               "value " + toString(z) + " is out of Cartesian bounds of line group "
                                                + toString(lineIndex),
                                                &cv, blockStart+i);
                                 }
@@ -1666,6 +2076,10 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
 
                             /// Check is inside spherical bounding box of the lineGroup
                             if (lineGroup->declaredSphericalBoundsDefined) {
+                                if (!converted) {
+                                    cartesianToSpherical(x, y, z, range, azimuth, elevation);
+                                    converted = true;
+                                }
                                 if (range < lineGroup->declaredSphericalBounds.minimum[0]
                                     || lineGroup->declaredSphericalBounds.maximum[0] < range) {
                                     PRINT_MESSAGE(1000/*???*/, proto.get("cartesianX"),
@@ -1687,11 +2101,13 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
                                                + toString(lineIndex),
                                                &cv, blockStart+i);
                                 }
+
+                                /// Add point to lineGroup actual spherical bounding box, only kept where one is declared
+                                lineGroup->actualSphericalBounds.addPoint(range, azimuth, elevation);
                             }
 
-                            /// Add point to lineGroup actual bounding boxes
-                            lineGroup->actualCartesianBounds.addPoint(pbufs.cartesianX[i], pbufs.cartesianY[i], pbufs.cartesianZ[i]);
-                            lineGroup->actualSphericalBounds.addPoint(range, azimuth, elevation);
+                            /// Add point to lineGroup actual bounding box
+                            lineGroup->actualCartesianBounds.addPoint(x, y, z);
                         } else {
                             if (lineGrouping.isByRow())
                                 PRINT_MESSAGE(1000/*???*/, proto.get("rowIndex"), "no line group for row number " + toString(lineIndex), &cv, blockStart+i);
@@ -1701,8 +2117,9 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
                     }
 
                     /// Add point to scan bounding box
-                    scanCartesianBoundsActual.addPoint(pbufs.cartesianX[i], pbufs.cartesianY[i], pbufs.cartesianZ[i]);
-                    scanSphericalBoundsActual.addPoint(range, azimuth, elevation);
+                    records.scanCartesianBoundsActual.addPoint(x, y, z);
+                    if (converted)
+                        records.scanSphericalBoundsActual.addPoint(range, azimuth, elevation);
 //??? update actual count, actual start
 
                 } else if (pbufs.cartesianInvalidState[i] == 1) {
@@ -1723,23 +2140,28 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
             //================================================================
             if (pbufs.sphericalRange && pbufs.sphericalAzimuth && pbufs.sphericalElevation) {
                 if (!pbufs.sphericalInvalidState || pbufs.sphericalInvalidState[i] == 0) {  /// This point coordinate is valid
-                    /// Calc cartesian coords from spherical using formulas from 5.5 of ASTM E57 standard
-                    double x = pbufs.sphericalRange[i] * cos(pbufs.sphericalElevation[i]) * cos(pbufs.sphericalAzimuth[i]);
-                    double y = pbufs.sphericalRange[i] * cos(pbufs.sphericalElevation[i]) * sin(pbufs.sphericalAzimuth[i]);
-                    double z = pbufs.sphericalRange[i] * sin(pbufs.sphericalElevation[i]);
+                    double range = pbufs.sphericalRange[i];
+                    double azimuth = pbufs.sphericalAzimuth[i];
+                    double elevation = pbufs.sphericalElevation[i];
+
+                    /// Calc cartesian coords from spherical, when there are Cartesian bounds to check
+                    double x = 0.0;
+                    double y = 0.0;
+                    double z = 0.0;
+                    bool converted = false;
 
                     /// Check each coordinate in Spherical bounds
-                    if (sphericalBoundsDefined && sphericalBounds.notEmpty) {
-                        if (pbufs.sphericalRange[i] < sphericalBounds.minimum[0] || sphericalBounds.maximum[0] < pbufs.sphericalRange[i])
-                            PRINT_MESSAGE(1000/*???*/, proto.get("sphericalRange"), "value " + toString(pbufs.sphericalRange[i]) + " is out of spherical bounds", &cv, blockStart+i);
-                        if (pbufs.sphericalAzimuth[i] < sphericalBounds.minimum[1] || sphericalBounds.maximum[1] < pbufs.sphericalAzimuth[i])
-                            PRINT_MESSAGE(1000/*???*/, proto.get("sphericalAzimuth"), "value " + toString(pbufs.sphericalAzimuth[i]) + " is out of spherical bounds", &cv, blockStart+i);
-                        if (pbufs.sphericalElevation[i] < sphericalBounds.minimum[2] || sphericalBounds.maximum[2] < pbufs.sphericalElevation[i])
-                            PRINT_MESSAGE(1000/*???*/, proto.get("sphericalElevation"), "value " + toString(pbufs.sphericalElevation[i]) + " is out of spherical bounds", &cv, blockStart+i);
-                    }
+                    if (flags[i] & SPHERICAL_RANGE_OUT_OF_BOUNDS)
+                        PRINT_MESSAGE(1000/*???*/, proto.get("sphericalRange"), "value " + toString(range) + " is out of spherical bounds", &cv, blockStart+i);
+                    if (flags[i] & SPHERICAL_AZIMUTH_OUT_OF_BOUNDS)
+                        PRINT_MESSAGE(1000/*???*/, proto.get("sphericalAzimuth"), "value " + toString(azimuth) + " is out of spherical bounds", &cv, blockStart+i);
+                    if (flags[i] & SPHERICAL_ELEVATION_OUT_OF_BOUNDS)
+                        PRINT_MESSAGE(1000/*???*/, proto.get("sphericalElevation"), "value " + toString(elevation) + " is out of spherical bounds", &cv, blockStart+i);
 
                     /// Check each coordinate in Cartesian bounds
-                    if (cartesianBoundsDefined && cartesianBounds.notEmpty) {
+                    if (checkCartesianBounds) {
+                        sphericalToCartesian(range, azimuth, elevation, x, y, z);
+                        converted = true;
                         if (x < cartesianBounds.minimum[0] || cartesianBounds.maximum[0] < x)
                             PRINT_MESSAGE(1000/*???*/, proto.get("sphericalRange"), "converted x " + toString(x) + " is out of Cartesian bounds", &cv, blockStart+i);
                         if (y < cartesianBounds.minimum[1] || cartesianBounds.maximum[1] < y)
@@ -1771,24 +2193,24 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
                         if (lineGroup) {
                             /// Check is inside spherical bounding box of the lineGroup
                             if (lineGroup->declaredSphericalBoundsDefined) {
-                                if (pbufs.sphericalRange[i] < lineGroup->declaredSphericalBounds.minimum[0]
-                                    || lineGroup->declaredSphericalBounds.maximum[0] < pbufs.sphericalRange[i]) {
+                                if (range < lineGroup->declaredSphericalBounds.minimum[0]
+                                    || lineGroup->declaredSphericalBounds.maximum[0] < range) {
                                     PRINT_MESSAGE(1000/*???*/, proto.get("sphericalRange"),
-                                               "value " + toString(pbufs.sphericalRange[i]) + " is out of Spherical bounds of line group "
+                                               "value " + toString(range) + " is out of Spherical bounds of line group "
                                                + toString(lineIndex),
                                                &cv, blockStart+i);
                                 }
-                                if (pbufs.sphericalAzimuth[i] < lineGroup->declaredSphericalBounds.minimum[1]
-                                    || lineGroup->declaredSphericalBounds.maximum[1] < pbufs.sphericalAzimuth[i]) {
+                                if (azimuth < lineGroup->declaredSphericalBounds.minimum[1]
+                                    || lineGroup->declaredSphericalBounds.maximum[1] < azimuth) {
                                     PRINT_MESSAGE(1000/*???*/, proto.get("sphericalAzimuth"),
-                                               "value " + toString(pbufs.sphericalAzimuth[i]) + " is out of Spherical bounds of line group "
+                                               "value " + toString(azimuth) + " is out of Spherical bounds of line group "
                                                + toString(lineIndex),
                                                &cv, blockStart+i);
                                 }
-                                if (pbufs.sphericalElevation[i] < lineGroup->declaredSphericalBounds.minimum[2]
-                                    || lineGroup->declaredSphericalBounds.maximum[2] < pbufs.sphericalElevation[i]) {
+                                if (elevation < lineGroup->declaredSphericalBounds.minimum[2]
+                                    || lineGroup->declaredSphericalBounds.maximum[2] < elevation) {
                                     PRINT_MESSAGE(1000/*???*/, proto.get("sphericalElevation"),
-                                               "value " + toString(pbufs.sphericalElevation[i]) + " is out of Spherical bounds of line group "
+                                               "value " + toString(elevation) + " is out of Spherical bounds of line group "
                                                + toString(lineIndex),
                                                &cv, blockStart+i);
                                 }
@@ -1796,6 +2218,10 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
 
                             /// Check is inside Cartesian bounding box of the lineGroup
                             if (lineGroup->declaredCartesianBoundsDefined) {
+                                if (!converted) {
+                                    sphericalToCartesian(range, azimuth, elevation, x, y, z);
+                                    converted = true;
+                                }
                                 if (x < lineGroup->declaredCartesianBounds.minimum[0]
                                     || lineGroup->declaredCartesianBounds.maximum[0] < x) {
                                     PRINT_MESSAGE(1000/*???*/, proto.get("sphericalRange"),
@@ -1817,11 +2243,13 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
                                                + toString(lineIndex),
                                                &cv, blockStart+i);
                                 }
+
+                                /// Add point to lineGroup actual Cartesian bounding box, only kept where one is declared
+                                lineGroup->actualCartesianBounds.addPoint(x, y, z);
                             }
 
-                            /// Add point to lineGroup actual bounding boxes
-                            lineGroup->actualSphericalBounds.addPoint(pbufs.sphericalRange[i], pbufs.sphericalAzimuth[i], pbufs.sphericalElevation[i]);
-                            lineGroup->actualCartesianBounds.addPoint(x, y, z);
+                            /// Add point to lineGroup actual bounding box
+                            lineGroup->actualSphericalBounds.addPoint(range, azimuth, elevation);
 
 //??? increment actual count
 
@@ -1834,8 +2262,9 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
                     }
 
                     /// Add point to scan bounding box
-                    scanSphericalBoundsActual.addPoint(pbufs.sphericalRange[i], pbufs.sphericalAzimuth[i], pbufs.sphericalElevation[i]);
-                    scanCartesianBoundsActual.addPoint(x, y, z);
+                    records.scanSphericalBoundsActual.addPoint(range, azimuth, elevation);
+                    if (converted)
+                        records.scanCartesianBoundsActual.addPoint(x, y, z);
                 } else if (pbufs.sphericalInvalidState[i] == 1) {
                     /// Range coordinate has no meaningful value
                     /// Nothing to check
@@ -1849,7 +2278,7 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
             //================================================================
             if (pbufs.rowIndex) {
                 /// Check within declared scanIndexBounds
-                if (pbufs.rowIndex[i] < indexBounds.minimum[0] || indexBounds.maximum[0] < pbufs.rowIndex[i]) {
+                if (flags[i] & ROW_INDEX_OUT_OF_BOUNDS) {
                     PRINT_MESSAGE(1000/*???*/, proto.get("rowIndex"),
                                "value " + toString(pbufs.rowIndex[i]) + " is out of indexBounds ["
                                + toString(indexBounds.minimum[0]) + "," + toString(indexBounds.maximum[0]) + "]",
@@ -1868,7 +2297,7 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
             //================================================================
             if (pbufs.columnIndex) {
                 /// Check within declared scanIndexBounds
-                if (pbufs.columnIndex[i] < indexBounds.minimum[1] || indexBounds.maximum[1] < pbufs.columnIndex[i]) {
+                if (flags[i] & COLUMN_INDEX_OUT_OF_BOUNDS) {
                     PRINT_MESSAGE(1000/*???*/, proto.get("columnIndex"),
                                "value " + toString(pbufs.columnIndex[i]) + " is out of indexBounds ["
                                + toString(indexBounds.minimum[1]) + "," + toString(indexBounds.maximum[1]) + "]",
@@ -1905,13 +2334,12 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
                 }
 
                 /// Check within declared indexBounds
-                if (pbufs.returnIndex[i] < indexBounds.minimum[2] || indexBounds.maximum[2] < pbufs.returnIndex[i]) {
+                if (flags[i] & RETURN_INDEX_OUT_OF_BOUNDS) {
                     PRINT_MESSAGE(1000/*???*/, proto.get("returnIndex"),
                                "value " + toString(pbufs.returnIndex[i]) + " is out of indexBounds ["
                                + toString(indexBounds.minimum[2]) + "," + toString(indexBounds.maximum[2]) + "]",
                                &cv, blockStart+i);
                 }
-
                 /// First point in multiple return sequence must have returnIndex==0
                 if (blockStart+i == 0 || prevReturnIndex == prevReturnCount-1) {
                     if (pbufs.returnIndex[i] != 0) {
@@ -1978,18 +2406,19 @@ void E57Validator::validatePointRecordContents(CompressedVectorNode cv, Structur
             }
         } // for i
 
+        records.rowIndexActualMinimum    = rowIndexActualMinimum;
+        records.rowIndexActualMaximum    = rowIndexActualMaximum;
+        records.columnIndexActualMinimum = columnIndexActualMinimum;
+        records.columnIndexActualMaximum = columnIndexActualMaximum;
+        records.returnIndexActualMinimum = returnIndexActualMinimum;
+        records.returnIndexActualMaximum = returnIndexActualMaximum;
+        records.errorCount = errorTotal_;
         blockStart += gotCount;
-    } while (gotCount > 0);
+    } while (gotCount > 0 && blockStart < records.endRecord);
     reader.close();
-
-    /// Check scan bboxes tight
-//???
-
-
-
-    //??? check each lineGroup: (actual vs. declared) start, count, bboxes tight
 }
 
+
 //================================================================
 
 void E57Validator::validatePointGroupingSchemes(Node n) {
@@ -2726,19 +3155,54 @@ void E57Validator::validateExtensionElement(Node n, CompressedVectorNode* cvp, u
 
 //================================================================
 
+bool E57Validator::countMessage(int messageNumber) {
+    /// Count message, and return true if it should be passed to printMessage.
+    /// It is printed when messageCount is < 2 beyond allowed to allow suppression message to be printed.
+    messageCount_[messageNumber]++;
+    if (messageCount_[messageNumber] < options_.messagesAllowed[messageNumber]+2)
+        return(true);
+
+    /// A range checked on another thread keeps the errors past the limit too (without the text),
+    /// so that replaying its log stops at the same error as checking the records in turn.
+    if (log_ && options_.maxErrorCount > 0 && messageNumber < 2000)
+        log_->push_back(LoggedMessage(messageNumber, "", "", true));
+    return(false);
+}
+
+void E57Validator::checkErrorLimit(int messageNumber) {
+    if (messageNumber < 2000 && options_.maxErrorCount > 0 && ++errorTotal_ >= options_.maxErrorCount)
+        throw StopValidation();
+}
+
 void E57Validator::printMessage(int messageNumber, Node n, ustring msg, CompressedVectorNode* cvp, uint64_t index) {
     if (messageNumber < 1000 || messageNumber > 4999) {
         os_ << "InternalError: message number " << messageNumber << " is out of bounds [1000,4999]" << endl;
         return;
     }
 
+    /// Messages of a range checked on another thread are printed later, unless they won't be printed at all
+    if (options_.messagesAllowed[messageNumber] == 0 && !log_)
+        return;
+
+    if (cvp == NULL)
+        emitMessage(messageNumber, n.pathName(), msg);
+    else
+        emitMessage(messageNumber, cvp->pathName() + "/" + toString(index) + n.pathName(), msg);
+}
+
+void E57Validator::emitMessage(int messageNumber, const ustring& location, const ustring& msg) {
+    if (log_) {
+        log_->push_back(LoggedMessage(messageNumber, location, msg));
+        return;
+    }
+
 //cout << "options_.messagesAllowed[messageNumber]=" << toString(options_.messagesAllowed[messageNumber]) << endl; //???
 //cout << "messageCount_[messageNumber]=" << toString(messageCount_[messageNumber]) << endl; //???
 
     if (options_.messagesAllowed[messageNumber] == 0)
         return;
 
-    /// messageCount has already been incremented in the PRINT_MESSAGE macro
+    /// messageCount has already been incremented by countMessage
     if (messageCount_[messageNumber] == options_.messagesAllowed[messageNumber]+1) {
         os_ << "More than " << toString(options_.messagesAllowed[messageNumber]);
         os_ << " messages for message number " << toString(messageNumber) << ".  Suppressing the rest." << endl;
@@ -2757,12 +3221,7 @@ void E57Validator::printMessage(int messageNumber, Node n, ustring msg, Compress
         os_ << "Suspicious";
     else
         os_ << "Informational";
-    os_ << " " << toString(messageNumber) << " in ";
-    if (cvp == NULL)
-        os_ << n.pathName();
-    else
-        os_ << cvp->pathName() << "/" << index << n.pathName();
-    os_ << ": " << msg << endl;
+    os_ << " " << toString(messageNumber) << " in " << location << ": " << msg << endl;
 }
 
 void E57Validator::checkRequired(StructureNode sn, ustring name, CompressedVectorNode* cvp, uint64_t index) {
@@ -2780,12 +3239,18 @@ bool validateFile(E57ValidatorOptions options, ustring fname)
         ImageFile imf(fname, "r");
 
         E57Validator validator = E57Validator(options);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
         validator.validate(imf);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
         cout << "Error count:           " << toString(validator.errorCount()) << endl;
         cout << "Warning count:         " << toString(validator.warningCount()) << endl;
         cout << "Suspicious count:      " << toString(validator.suspiciousCount()) << endl;
         cout << "Informational count:   " << toString(validator.informationalCount()) << endl;
+        cout << "Points validated:      " << toString(validator.pointRecordCount());
+        if (seconds > 0)
+            cout << " (" << toString(static_cast<uint64_t>(validator.pointRecordCount() / seconds)) << " per second)";
+        cout << endl;
 
         /// Total up all errors and unsuppressed warnings and suspicious messages
         uint64_t messageCount = validator.errorCount();
@@ -49,27 +49,9 @@ int main(int argc, char** argv)
         CommandLineOptions options;
         options.parse(argc, argv);
 
-        const int N = 1024;
-        static uint8_t buf[N];
-
-        uint64_t length = E57Utilities().rawXmlLength(options.inputFileName);
-
-        uint64_t start = 0;
-        while (start < length) {
-            size_t count;
-            if (length-start > N)
-                count = N;
-            else
-                count = static_cast<size_t>(length-start);
-
-            /// Read a block of xml text
-            E57Utilities().rawXmlRead(options.inputFileName, buf, start, count);
-
-            /// Send block to cout
-            cout.write(reinterpret_cast<char*>(buf), count);
-
-            start += count;
-        }
+        /// Stream the XML section straight to cout, without parsing it
+        E57Utilities().rawXmlCopy(options.inputFileName, cout);
+        cout.flush();
     } catch(E57Exception& ex) {
         ex.report(__FILE__, __LINE__, __FUNCTION__);
         return -1;
@@ -35,6 +35,14 @@
 #include <iomanip>
 #include <map>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <chrono>
+#include <algorithm>
 
 #if 0
 #ifdef WIN32
@@ -48,6 +56,7 @@
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <boost/filesystem.hpp>
 
 using namespace std;
 using namespace e57;
@@ -66,13 +75,25 @@ void usage(ustring msg)
 {
     cerr << "Usage: " << msg << endl;
     cerr << "    las2e57 [options] <las_file> <e57_file>" << endl;
+    cerr << "    las2e57 [options] -batch <list_file_or_directory> <output_directory>" << endl;
     cerr << "    options:" << endl;
-    cerr << "        -unusedNotOptional         completely zero fields are forced to be included in output file even though they could be discarded" <<endl;
+    cerr << "                                   by default the points are read once, every field of the LAS point format is written" << endl;
+    cerr << "                                   (even if all zero), and the coordinate ranges come from the extents in the LAS header;" << endl;
+    cerr << "                                   if points lie outside those extents, the file is converted again as with -twoPass" << endl;
+    cerr << "        -twoPass                   read the points once to find the fields used and their ranges before converting," << endl;
+    cerr << "                                   gives smaller files (all zero fields are left out) but reads the LAS file twice" << endl;
+    cerr << "        -unusedNotOptional         with -twoPass, completely zero fields are forced to be included in output file even though they could be discarded" <<endl;
 //??? uncomment following line when waveform support is implemented
 //???    cerr << "        -stripWaveforms            don't include waveforms in output file (included by default)." << endl;
+    cerr << "        -batch                     convert every .las file in a directory, or every file named in a list file (one per line)," << endl;
+    cerr << "                                   into <output_directory>/<name>.e57, several files at a time in one process" << endl;
+    cerr << "        -jobs <n>                  with -batch, number of files converted at the same time (default: number of processor cores)" << endl;
+    cerr << "        -memoryLimit <megabytes>   with -batch, don't start another file while the estimated memory use of the" << endl;
+    cerr << "                                   conversions running would exceed this (default: no limit)" << endl;
     cerr << endl;
     cerr << "    For example:" << endl;
     cerr << "        las2e57 scan0001.las scan0001.e57" << endl;
+    cerr << "        las2e57 -batch -jobs 8 scans/ converted/" << endl;
     cerr << endl;
 }
 
@@ -81,10 +102,14 @@ void usage(ustring msg)
 struct CommandLineOptions {
     ustring inputFileName;
     ustring outputFileName;
+    bool    twoPass;
     bool    unusedNotOptional;
     bool    stripWaveforms;
+    bool    batch;
+    unsigned jobs;
+    uint64_t memoryLimit;
 
-            CommandLineOptions():unusedNotOptional(false),stripWaveforms(false){};
+            CommandLineOptions():twoPass(false),unusedNotOptional(false),stripWaveforms(false),batch(false),jobs(0),memoryLimit(0){};
     void    parse(int argc, char** argv);
 };
 
@@ -95,11 +120,29 @@ void CommandLineOptions::parse(int argc, char** argv)
     argc--; argv++;
 
     for (; argc > 0 && *argv[0] == '-'; argc--,argv++) {
-        if (strcmp(argv[0], "-unusedNotOptional") == 0)
+        if (strcmp(argv[0], "-twoPass") == 0)
+            twoPass = true;
+        else if (strcmp(argv[0], "-unusedNotOptional") == 0)
             unusedNotOptional = true;
         else if (strcmp(argv[0], "-stripWaveforms") == 0)
             stripWaveforms = true;
-        else {
+        else if (strcmp(argv[0], "-batch") == 0)
+            batch = true;
+        else if (strcmp(argv[0], "-jobs") == 0 && argc > 1) {
+            argc--; argv++;
+            jobs = static_cast<unsigned>(atoi(argv[0]));
+            if (jobs == 0) {
+                usage("-jobs needs a positive number");
+                throw EXCEPTION("bad -jobs value"); //??? UsageException
+            }
+        } else if (strcmp(argv[0], "-memoryLimit") == 0 && argc > 1) {
+            argc--; argv++;
+            memoryLimit = static_cast<uint64_t>(atof(argv[0]) * 1024 * 1024);
+            if (memoryLimit == 0) {
+                usage("-memoryLimit needs a positive number of megabytes");
+                throw EXCEPTION("bad -memoryLimit value"); //??? UsageException
+            }
+        } else {
             usage(ustring("unknown option: ") + argv[0]);
             throw EXCEPTION("unknown option"); //??? UsageException
         }
@@ -110,6 +153,7 @@ void CommandLineOptions::parse(int argc, char** argv)
         throw EXCEPTION("wrong number of command line arguments"); //??? UsageException
     }
 
+    /// With -batch, these name the list of files (or their directory) and the output directory
     inputFileName = argv[0];
     outputFileName = argv[1];
 }
@@ -215,8 +259,8 @@ struct UseInfo {
 
 
             UseInfo();
-    void    processPoint(LASPublicHeaderBlock& hdr, LASPointDataRecord& point, int64_t columnIndex);
-    void    processPoint(LASPublicHeaderBlock& hdr, LASPointDataRecord& point);
+    void    assumeFormat(LASPublicHeaderBlock& hdr, uint64_t pointCount);
+    void    processBlock(LASPointBlock& block, const vector<int64_t>& columnIndices);
     void    dump(int indent = 0, std::ostream& os = std::cout);
 };
 
@@ -265,90 +309,130 @@ UseInfo::UseInfo()
     maximumZ = E57_INT64_MIN;
 }
 
-void UseInfo::processPoint(LASPublicHeaderBlock& hdr, LASPointDataRecord& point, int64_t columnIndex)
+/// Raw integer range of one coordinate from the extents in the LAS header, with a unit of slack for rounding.
+/// If the header has no usable extents, the whole range of the 32 bit LAS coordinates is used.
+void headerRange(double minimum, double maximum, double scaleFactor, double offset, int64_t& rawMinimum, int64_t& rawMaximum)
+{
+    rawMinimum = E57_INT32_MIN;
+    rawMaximum = E57_INT32_MAX;
+    if (scaleFactor == 0.0 || !(minimum <= maximum) || (minimum == 0.0 && maximum == 0.0))
+        return;
+
+    double a = (minimum - offset) / scaleFactor;
+    double b = (maximum - offset) / scaleFactor;
+    double low  = floor((a < b) ? a : b) - 1;
+    double high = ceil((a < b) ? b : a) + 1;
+    if (E57_INT32_MIN < low && low < E57_INT32_MAX)
+        rawMinimum = static_cast<int64_t>(low);
+    if (E57_INT32_MIN < high && high < E57_INT32_MAX)
+        rawMaximum = static_cast<int64_t>(high);
+}
+
+void UseInfo::assumeFormat(LASPublicHeaderBlock& hdr, uint64_t pointCount)
+{
+    /// Every field of the point format is assumed used, with the range the LAS standard allows for it.
+    /// The coordinate ranges come from the extents in the header.
+    bool     version0 = (hdr.versionMajor == 1 && hdr.versionMinor == 0);
+    unsigned format   = hdr.pointDataFormatId;
+
+    gotPoint = (pointCount > 0);
+    intensityUsed = true;
+    returnNumberUsed = true;
+    numberOfReturnsUsed = true;
+    scanDirectionFlagUsed = true;
+    edgeOfFlightLineUsed = true;
+    classificationUsed = true;
+    syntheticUsed = !version0;
+    keyPointUsed = !version0;
+    withheldUsed = !version0;
+    scanAngleRankUsed = true;
+    fileMarkerUsed = version0;
+    userBitFieldUsed = version0;
+    userDataUsed = !version0;
+    pointSourceIdUsed = !version0;
+    gpsTimeUsed = (format == 1 || format == 3 || format == 4 || format == 5);
+    redUsed = greenUsed = blueUsed = (format == 2 || format == 3 || format == 5);
+    wavePacketDescriptorIndexUsed = byteOffsetToWaveformDataUsed = waveformPacketSizeInBytesUsed =
+        returnPointWaveformLocationUsed = xTUsed = yTUsed = zTUsed = (format == 4 || format == 5);
+
+    /// The number of columns isn't known until all points are read, but each has at least one point
+    maximumColumnIndex = (pointCount > 0) ? static_cast<int64_t>(pointCount - 1) : 0;
+    maximumReturnIndex = 7;
+    maximumReturnCount = 7;
+    minimumClassification = 0;
+    maximumClassification = version0 ? E57_UINT8_MAX : 31;
+    minimumScanAngleRank = E57_INT8_MIN;
+    maximumScanAngleRank = E57_INT8_MAX;
+    headerRange(hdr.minX, hdr.maxX, hdr.xScaleFactor, hdr.xOffset, minimumX, maximumX);
+    headerRange(hdr.minY, hdr.maxY, hdr.yScaleFactor, hdr.yOffset, minimumY, maximumY);
+    headerRange(hdr.minZ, hdr.maxZ, hdr.zScaleFactor, hdr.zOffset, minimumZ, maximumZ);
+}
+
+template <class T>
+bool anyNonZero(const vector<T>& values)
+{
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i] != 0)
+            return(true);
+    }
+    return(false);
+}
+
+template <class T, class R>
+void widenRange(const vector<T>& values, R& minimum, R& maximum)
 {
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i] < minimum)
+            minimum = values[i];
+        if (values[i] > maximum)
+            maximum = values[i];
+    }
+}
+
+void UseInfo::processBlock(LASPointBlock& block, const vector<int64_t>& columnIndices)
+{
+    /// Fields that aren't in the point format have empty arrays, and are never used.
+    if (block.count == 0)
+        return;
     gotPoint = true;
-    if (point.intensity != 0)
-        intensityUsed = true;
-    if (point.returnNumber != 0)
-        returnNumberUsed = true;
-    if (point.numberOfReturns != 0)
-        numberOfReturnsUsed = true;
-    if (point.scanDirectionFlag != 0)
-        scanDirectionFlagUsed = true;
-    if (point.edgeOfFlightLine != 0)
-        edgeOfFlightLineUsed = true;
-    if (point.classification != 0)
-        classificationUsed = true;
-    if (point.synthetic != 0)
-        syntheticUsed = true;
-    if (point.keyPoint != 0)
-        keyPointUsed = true;
-    if (point.withheld != 0)
-        withheldUsed = true;
-    if (point.scanAngleRank != 0)
-        scanAngleRankUsed = true;
-    if (point.fileMarker != 0)
-        fileMarkerUsed = true;
-    if (point.userBitField != 0)
-        userBitFieldUsed = true;
-    if (point.userData != 0)
-        userDataUsed = true;
-    if (point.pointSourceId != 0)
-        pointSourceIdUsed = true;
-    if (point.gpsTime != 0)
-        gpsTimeUsed = true;
-    if (point.red != 0)
-        redUsed = true;
-    if (point.green != 0)
-        greenUsed = true;
-    if (point.blue != 0)
-        blueUsed = true;
-    if (point.wavePacketDescriptorIndex != 0)
-        wavePacketDescriptorIndexUsed = true;
-    if (point.byteOffsetToWaveformData != 0)
-        byteOffsetToWaveformDataUsed = true;
-    if (point.waveformPacketSizeInBytes != 0)
-        waveformPacketSizeInBytesUsed = true;
-    if (point.returnPointWaveformLocation != 0)
-        returnPointWaveformLocationUsed = true;
-    if (point.xT != 0)
-        xTUsed = true;
-    if (point.yT != 0)
-        yTUsed = true;
-    if (point.zT != 0)
-        zTUsed = true;
-
-    if (columnIndex > maximumColumnIndex)
-        maximumColumnIndex = columnIndex;
-    if (point.returnNumber > maximumReturnIndex)
-        maximumReturnIndex = point.returnNumber;
-    if (point.numberOfReturns > maximumReturnCount)
-        maximumReturnCount = point.numberOfReturns;
-    if (point.classification < minimumClassification)
-        minimumClassification = point.classification;
-    if (point.classification > maximumClassification)
-        maximumClassification = point.classification;
-    if (point.scanAngleRank < minimumScanAngleRank)
-        minimumScanAngleRank = point.scanAngleRank;
-    if (point.scanAngleRank > maximumScanAngleRank)
-        maximumScanAngleRank = point.scanAngleRank;
-    if (point.gpsTime < minimumGpsTime)
-        minimumGpsTime = point.gpsTime;
-    if (point.gpsTime > maximumGpsTime)
-        maximumGpsTime = point.gpsTime;
-    if (point.x < minimumX)
-        minimumX = point.x;
-    if (point.x > maximumX)
-        maximumX = point.x;
-    if (point.y < minimumY)
-        minimumY = point.y;
-    if (point.y > maximumY)
-        maximumY = point.y;
-    if (point.z < minimumZ)
-        minimumZ = point.z;
-    if (point.z > maximumZ)
-        maximumZ = point.z;
+    intensityUsed = intensityUsed || anyNonZero(block.intensity);
+    returnNumberUsed = returnNumberUsed || anyNonZero(block.returnNumber);
+    numberOfReturnsUsed = numberOfReturnsUsed || anyNonZero(block.numberOfReturns);
+    scanDirectionFlagUsed = scanDirectionFlagUsed || anyNonZero(block.scanDirectionFlag);
+    edgeOfFlightLineUsed = edgeOfFlightLineUsed || anyNonZero(block.edgeOfFlightLine);
+    classificationUsed = classificationUsed || anyNonZero(block.classification);
+    syntheticUsed = syntheticUsed || anyNonZero(block.synthetic);
+    keyPointUsed = keyPointUsed || anyNonZero(block.keyPoint);
+    withheldUsed = withheldUsed || anyNonZero(block.withheld);
+    scanAngleRankUsed = scanAngleRankUsed || anyNonZero(block.scanAngleRank);
+    fileMarkerUsed = fileMarkerUsed || anyNonZero(block.fileMarker);
+    userBitFieldUsed = userBitFieldUsed || anyNonZero(block.userBitField);
+    userDataUsed = userDataUsed || anyNonZero(block.userData);
+    pointSourceIdUsed = pointSourceIdUsed || anyNonZero(block.pointSourceId);
+    gpsTimeUsed = gpsTimeUsed || anyNonZero(block.gpsTime);
+    redUsed = redUsed || anyNonZero(block.red);
+    greenUsed = greenUsed || anyNonZero(block.green);
+    blueUsed = blueUsed || anyNonZero(block.blue);
+    wavePacketDescriptorIndexUsed = wavePacketDescriptorIndexUsed || anyNonZero(block.wavePacketDescriptorIndex);
+    byteOffsetToWaveformDataUsed = byteOffsetToWaveformDataUsed || anyNonZero(block.byteOffsetToWaveformData);
+    waveformPacketSizeInBytesUsed = waveformPacketSizeInBytesUsed || anyNonZero(block.waveformPacketSizeInBytes);
+    returnPointWaveformLocationUsed = returnPointWaveformLocationUsed || anyNonZero(block.returnPointWaveformLocation);
+    xTUsed = xTUsed || anyNonZero(block.xT);
+    yTUsed = yTUsed || anyNonZero(block.yT);
+    zTUsed = zTUsed || anyNonZero(block.zT);
+
+    int64_t minimumColumnIndex = 0;
+    widenRange(columnIndices, minimumColumnIndex, maximumColumnIndex);
+    int64_t minimumReturnIndex = 0;
+    widenRange(block.returnNumber, minimumReturnIndex, maximumReturnIndex);
+    int64_t minimumReturnCount = 0;
+    widenRange(block.numberOfReturns, minimumReturnCount, maximumReturnCount);
+    widenRange(block.classification, minimumClassification, maximumClassification);
+    widenRange(block.scanAngleRank, minimumScanAngleRank, maximumScanAngleRank);
+    widenRange(block.gpsTime, minimumGpsTime, maximumGpsTime);
+    widenRange(block.x, minimumX, maximumX);
+    widenRange(block.y, minimumY, maximumY);
+    widenRange(block.z, minimumZ, maximumZ);
 }
 
 void UseInfo::dump(int indent, std::ostream& os)
@@ -490,45 +574,55 @@ void DenseGroupingScheme::write(ImageFile imf, StructureNode groupingSchemeNode,
     StructureNode proto = StructureNode(imf);
     vector<SourceDestBuffer> sourceBuffers;
 
+    /// Leave out the empty groups at either end of the id range (the range may have been taken from the LAS format rather than the points).
+    size_t first = 0;
+    size_t last = groups.size() - 1;
+    while (first < last && groups[first].count == 0)
+        first++;
+    while (last > first && groups[last].count == 0)
+        last--;
+    GroupRecord* written = &groups[first];
+    size_t writtenCount = last - first + 1;
+
     /// Add id value for this group, pathname: "/data3D/0/pointGroupingSchemes/<groupingSchemeName>/groups/0/idElementValue"
-    proto.set("idElementValue",  IntegerNode(imf, minimumId, minimumId, maximumId));
-    sourceBuffers.push_back(SourceDestBuffer(imf, "idElementValue", &(groups[0].id), groups.size(), false, false, sizeof(GroupRecord)));
+    proto.set("idElementValue",  IntegerNode(imf, written[0].id, written[0].id, written[writtenCount-1].id));
+    sourceBuffers.push_back(SourceDestBuffer(imf, "idElementValue", &(written[0].id), writtenCount, false, false, sizeof(GroupRecord)));
 
     /// Find the maximum point count and startPointIndex in all the groups (will save a few bytes in the file).
     int64_t pointCountMax = 0;
     int64_t startPointIndexMax = 0;
-    for (unsigned i = 0; i < groups.size(); i++) {
-        if (groups[i].count > pointCountMax)
-            pointCountMax = groups[i].count;
-        if (groups[i].startIndex > startPointIndexMax)
-            startPointIndexMax = groups[i].startIndex;
+    for (size_t i = 0; i < writtenCount; i++) {
+        if (written[i].count > pointCountMax)
+            pointCountMax = written[i].count;
+        if (written[i].startIndex > startPointIndexMax)
+            startPointIndexMax = written[i].startIndex;
     }
 
     /// Add pointCount, pathname: "/data3D/0/pointGroupingSchemes/<groupingSchemeName>/groups/0/pointCount"
     proto.set("pointCount",  IntegerNode(imf, 0, 0, pointCountMax));
-    sourceBuffers.push_back(SourceDestBuffer(imf, "pointCount", &(groups[0].count), groups.size(), false, false, sizeof(GroupRecord)));
+    sourceBuffers.push_back(SourceDestBuffer(imf, "pointCount", &(written[0].count), writtenCount, false, false, sizeof(GroupRecord)));
 
     /// If group members are contiguous, add startPointIndex, pathname: "/data3D/0/pointGroupingSchemes/<groupingSchemeName>/groups/0/startPointIndex"
     if (areMembersContiguous) {
         proto.set("startPointIndex",  IntegerNode(imf, 0, 0, startPointIndexMax));
-        sourceBuffers.push_back(SourceDestBuffer(imf, "startPointIndex", &(groups[0].startIndex), groups.size(), false, false, sizeof(GroupRecord)));
+        sourceBuffers.push_back(SourceDestBuffer(imf, "startPointIndex", &(written[0].startIndex), writtenCount, false, false, sizeof(GroupRecord)));
     }
 
     /// Add bounding box, pathname: "/data3D/0/pointGroupingSchemes/<groupingSchemeName>/groups/0/cartesianBounds/xMinimum" etc...
     StructureNode bbox = StructureNode(imf);
     proto.set("cartesianBounds", bbox);
     bbox.set("xMinimum", FloatNode(imf, 0.0, E57_DOUBLE));
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/xMinimum", &(groups[0].bbox.minimum[0]), groups.size(), false, false, sizeof(GroupRecord)));
+    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/xMinimum", &(written[0].bbox.minimum[0]), writtenCount, false, false, sizeof(GroupRecord)));
     bbox.set("xMaximum", FloatNode(imf, 0.0, E57_DOUBLE));
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/xMaximum", &(groups[0].bbox.maximum[0]), groups.size(), false, false, sizeof(GroupRecord)));
+    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/xMaximum", &(written[0].bbox.maximum[0]), writtenCount, false, false, sizeof(GroupRecord)));
     bbox.set("yMinimum", FloatNode(imf, 0.0, E57_DOUBLE));
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/yMinimum", &(groups[0].bbox.minimum[1]), groups.size(), false, false, sizeof(GroupRecord)));
+    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/yMinimum", &(written[0].bbox.minimum[1]), writtenCount, false, false, sizeof(GroupRecord)));
     bbox.set("yMaximum", FloatNode(imf, 0.0, E57_DOUBLE));
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/yMaximum", &(groups[0].bbox.maximum[1]), groups.size(), false, false, sizeof(GroupRecord)));
+    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/yMaximum", &(written[0].bbox.maximum[1]), writtenCount, false, false, sizeof(GroupRecord)));
     bbox.set("zMinimum", FloatNode(imf, 0.0, E57_DOUBLE));
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/zMinimum", &(groups[0].bbox.minimum[2]), groups.size(), false, false, sizeof(GroupRecord)));
+    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/zMinimum", &(written[0].bbox.minimum[2]), writtenCount, false, false, sizeof(GroupRecord)));
     bbox.set("zMaximum", FloatNode(imf, 0.0, E57_DOUBLE));
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/zMaximum", &(groups[0].bbox.maximum[2]), groups.size(), false, false, sizeof(GroupRecord)));
+    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianBounds/zMaximum", &(written[0].bbox.maximum[2]), writtenCount, false, false, sizeof(GroupRecord)));
 
     /// Make empty codecs vector for use in creating groups CompressedVector.
     /// If this vector is empty, it is assumed that all fields will use the BitPack codec.
@@ -542,7 +636,7 @@ void DenseGroupingScheme::write(ImageFile imf, StructureNode groupingSchemeNode,
     /// Write source buffers into CompressedVector
     {
         CompressedVectorWriter writer = groupsNode.writer(sourceBuffers);
-        writer.write(groups.size());
+        writer.write(writtenCount);
         writer.close();
     }
 }
@@ -676,8 +770,8 @@ void SparseGroupingScheme::dump(int indent, std::ostream& os)
 class GroupingSchemes {
 public:
             GroupingSchemes(UseInfo useInfo);
-    void    addMember(LASPublicHeaderBlock& hdr, LASPointDataRecord& point, int64_t recordIndex, int64_t columnIndex);
-    void    write(ImageFile imf);
+    void    addBlock(LASPublicHeaderBlock& hdr, LASPointBlock& block, int64_t startRecord, const vector<int64_t>& columnIndices);
+    void    write(ImageFile imf, UseInfo& used);
     void    dump(int indent = 0, std::ostream& os = std::cout);
 
 protected:
@@ -708,42 +802,48 @@ GroupingSchemes::GroupingSchemes(UseInfo useInfo)
   groupByPointSourceId_()
 {}
 
-void GroupingSchemes::addMember(LASPublicHeaderBlock& hdr, LASPointDataRecord& point, int64_t recordIndex,int64_t columnIndex)
+void GroupingSchemes::addBlock(LASPublicHeaderBlock& hdr, LASPointBlock& block, int64_t startRecord, const vector<int64_t>& columnIndices)
 {
-    double coords[3];
-    coords[0] = hdr.xScaleFactor * point.x + hdr.xOffset;
-    coords[1] = hdr.yScaleFactor * point.y + hdr.yOffset;
-    coords[2] = hdr.zScaleFactor * point.z + hdr.zOffset;
-
-    if (useInfo_.maximumColumnIndex > 0)
-        groupByLine_.addMember(columnIndex, coords, recordIndex);
-    if (useInfo_.returnNumberUsed)
-        groupByReturnIndex_.addMember(point.returnNumber, coords, recordIndex);
-    if (useInfo_.scanDirectionFlagUsed)
-        groupByScanDirectionFlag_.addMember(point.scanDirectionFlag, coords, recordIndex);
-    if (useInfo_.edgeOfFlightLineUsed)
-        groupByEdgeOfFlightLine_.addMember(point.edgeOfFlightLine, coords, recordIndex);
-    if (useInfo_.classificationUsed)
-        groupByClassification_.addMember(point.classification, coords, recordIndex);
-    if (useInfo_.syntheticUsed)
-        groupBySynthetic_.addMember(point.synthetic, coords, recordIndex);
-    if (useInfo_.keyPointUsed)
-        groupByKeyPoint_.addMember(point.keyPoint, coords, recordIndex);
-    if (useInfo_.withheldUsed)
-        groupByWithheld_.addMember(point.withheld, coords, recordIndex);
-    if (useInfo_.scanAngleRankUsed)
-        groupByScanAngleRank_.addMember(point.scanAngleRank, coords, recordIndex);
-    if (useInfo_.pointSourceIdUsed)
-        groupByPointSourceId_.addMember(point.pointSourceId, coords, recordIndex);
+    for (size_t i = 0; i < block.count; i++) {
+        double coords[3];
+        coords[0] = hdr.xScaleFactor * block.x[i] + hdr.xOffset;
+        coords[1] = hdr.yScaleFactor * block.y[i] + hdr.yOffset;
+        coords[2] = hdr.zScaleFactor * block.z[i] + hdr.zOffset;
+        int64_t recordIndex = startRecord + i;
+
+        if (useInfo_.maximumColumnIndex > 0)
+            groupByLine_.addMember(columnIndices[i], coords, recordIndex);
+        if (useInfo_.returnNumberUsed)
+            groupByReturnIndex_.addMember(block.returnNumber[i], coords, recordIndex);
+        if (useInfo_.scanDirectionFlagUsed)
+            groupByScanDirectionFlag_.addMember(block.scanDirectionFlag[i], coords, recordIndex);
+        if (useInfo_.edgeOfFlightLineUsed)
+            groupByEdgeOfFlightLine_.addMember(block.edgeOfFlightLine[i], coords, recordIndex);
+        if (useInfo_.classificationUsed)
+            groupByClassification_.addMember(block.classification[i], coords, recordIndex);
+        if (useInfo_.syntheticUsed)
+            groupBySynthetic_.addMember(block.synthetic[i], coords, recordIndex);
+        if (useInfo_.keyPointUsed)
+            groupByKeyPoint_.addMember(block.keyPoint[i], coords, recordIndex);
+        if (useInfo_.withheldUsed)
+            groupByWithheld_.addMember(block.withheld[i], coords, recordIndex);
+        if (useInfo_.scanAngleRankUsed)
+            groupByScanAngleRank_.addMember(block.scanAngleRank[i], coords, recordIndex);
+        if (useInfo_.pointSourceIdUsed)
+            groupByPointSourceId_.addMember(block.pointSourceId[i], coords, recordIndex);
+    }
 }
 
-void GroupingSchemes::write(ImageFile imf)
+void GroupingSchemes::write(ImageFile imf, UseInfo& used)
 {
     /// Add groupingSchemes structure in per-scan area, pathname: "/data3D/0/pointGroupingSchemes"
     StructureNode scan0 = StructureNode(imf.root().get("/data3D/0"));
     StructureNode groupingSchemesNode = StructureNode(imf);
     scan0.set("pointGroupingSchemes", groupingSchemesNode);
 
+    /// The line grouping is written whenever the points have a columnIndex field,
+    /// the other schemes for the fields that turned out to be used by the points.
+
     if (useInfo_.maximumColumnIndex > 0) {
         /// Add groupByLine scheme, pathname: "/data3D/0/pointGroupingSchemes/groupByLine"
         StructureNode groupingSchemeNode = StructureNode(imf);
@@ -751,63 +851,63 @@ void GroupingSchemes::write(ImageFile imf)
         groupByLine_.write(imf, groupingSchemeNode, "columnIndex",
                              "Points are grouped into scanlines or columns.  Columns are delimited by a change in scanDirection.");  //??? handle startIndex
     }
-    if (useInfo_.returnNumberUsed) {
+    if (used.returnNumberUsed) {
         /// Add groupByReturnIndex scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupByReturnIndex"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingByReturnIndex", groupingSchemeNode);
         groupByReturnIndex_.write(imf, groupingSchemeNode, "returnIndex",
                                   "Points are grouped into return pulse positions. returnIndex=0 is first return.");
     }
-    if (useInfo_.scanDirectionFlagUsed) {
+    if (used.scanDirectionFlagUsed) {
         /// Add groupByScanDirectionFlag scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupByScanDirectionFlag"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingByScanDirectionFlag", groupingSchemeNode);
         groupByScanDirectionFlag_.write(imf, groupingSchemeNode, "las:scanDirectionFlag",
                                         "Points are grouped into positive (dir=1) or negative (dir=0) scan direction.  Positive scan direction moves from left side of in-track direction to right side.");
     }
-    if (useInfo_.edgeOfFlightLineUsed) {
+    if (used.edgeOfFlightLineUsed) {
         /// Add groupByEdgeOfFlightLine scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupByEdgeOfFlightLine"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingByEdgeOfFlightLine", groupingSchemeNode);
         groupByEdgeOfFlightLine_.write(imf, groupingSchemeNode, "las:edgeOfFlightLine",
                                        "Points are grouped edge and non-edge points in the scan lines.");
     }
-    if (useInfo_.classificationUsed) {
+    if (used.classificationUsed) {
         /// Add groupByClassification scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupByClassification"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingByClassification", groupingSchemeNode);
         groupByClassification_.write(imf, groupingSchemeNode, "las:classification",
                                      "Points are grouped into classes of surface that the beam illuminated.  Point classes are standardized by ASPRS.");
     }
-    if (useInfo_.syntheticUsed) {
+    if (used.syntheticUsed) {
         /// Add groupBySynthetic scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupBySynthetic"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingBySynthetic", groupingSchemeNode);
         groupBySynthetic_.write(imf, groupingSchemeNode, "las:synthetic",
                                 "Points are grouped into synthetic and non-synthetic.  Synthetic points are created by a technique other than LIDAR collection.");
     }
-    if (useInfo_.keyPointUsed) {
+    if (used.keyPointUsed) {
         /// Add groupByKeyPoint scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupByKeyPoint"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingByKeyPoint", groupingSchemeNode);
         groupByKeyPoint_.write(imf, groupingSchemeNode, "las:keyPoint",
                                "Points are grouped into key and non-key points.  A key point should generally not be withheld in a thinning algorithm.");
     }
-    if (useInfo_.withheldUsed) {
+    if (used.withheldUsed) {
         /// Add groupByWithheld scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupByWithheld"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingByWithheld", groupingSchemeNode);
         groupByWithheld_.write(imf, groupingSchemeNode, "las:withheld",
                                "Points are grouped withheld and non-withheld.  Withheld points should not be included in processing (synonymous with Deleted)");
     }
-    if (useInfo_.scanAngleRankUsed) {
+    if (used.scanAngleRankUsed) {
         /// Add groupByScanAngleRank scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupByScanAngleRank"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingByScanAngleRank", groupingSchemeNode);
         groupByScanAngleRank_.write(imf, groupingSchemeNode, "las:scanAngleRank",
                                     "Points are grouped by scan angle rank, which is the angle in degrees from nadir of the beam.  Negative angles being to the left side of the aircraft.");
     }
-    if (useInfo_.pointSourceIdUsed) {
+    if (used.pointSourceIdUsed) {
         /// Add groupByPointSourceId scheme, pathname: "/data3D/0/pointGroupingSchemes/las:groupByPointSourceId"
         StructureNode groupingSchemeNode = StructureNode(imf);
         groupingSchemesNode.set("las:groupingByPointSourceId", groupingSchemeNode);
@@ -864,14 +964,159 @@ void GroupingSchemes::dump(int indent, std::ostream& os)
 
 //================================================================
 
+/// Numbers the scan lines (columns) of the points, a new column starts wherever the scan direction flag changes.
+struct ColumnCounter {
+    bool    started;
+    bool    lastScanDirectionFlag;
+    int64_t columnIndex;
+
+            ColumnCounter() : started(false), lastScanDirectionFlag(false), columnIndex(0) {};
+    void    assign(LASPointBlock& block, vector<int64_t>& columnIndices);
+};
+
+void ColumnCounter::assign(LASPointBlock& block, vector<int64_t>& columnIndices)
+{
+    columnIndices.resize(static_cast<size_t>(block.count));
+    for (size_t i = 0; i < columnIndices.size(); i++) {
+        /// Look for reverses in scan direction to delimit columns
+        bool scanDirectionFlag = (block.scanDirectionFlag[i] != 0);
+        if (started && lastScanDirectionFlag != scanDirectionFlag)
+            columnIndex++;
+        started = true;
+        lastScanDirectionFlag = scanDirectionFlag;
+
+        /// Save current column index in buffer for writing
+        columnIndices[i] = columnIndex;
+    }
+}
+
+//================================================================
+
+/// Number of LAS records read, converted and written at a time
+const uint64_t POINT_BLOCK_RECORDS = 64*1024;
+
+/// Number of blocks circulating through the stages of one conversion
+const size_t POINT_BLOCK_POOL = 4;
+
+/// A block of points on its way through the conversion
+struct PointBlock {
+    int64_t         startRecord;
+    LASPointBlock   las;
+    vector<int64_t> columnIndices;
+
+                    PointBlock() : startRecord(0) {};
+};
+
+/// Thrown when a point lies outside the extents in the LAS header, which gave the coordinate ranges of a single pass conversion
+struct PointsOutsideExtents : public std::runtime_error {
+            PointsOutsideExtents() : std::runtime_error("points lie outside of the extents in the LAS header") {};
+};
+
+/// Hands blocks from one stage of the conversion to the next, blocking while it is full or empty.
+/// close() marks the end of the input (pop() returns false once drained), abort() stops both sides at once.
+template <class T>
+class BoundedQueue {
+public:
+            BoundedQueue(size_t capacity) : capacity_(capacity), closed_(false), aborted_(false) {};
+    bool    push(T item);
+    bool    pop(T& item);
+    void    close();
+    void    abort();
+
+protected:
+    std::mutex              mutex_;
+    std::condition_variable changed_;
+    std::deque<T>           items_;
+    size_t                  capacity_;
+    bool                    closed_;
+    bool                    aborted_;
+};
+
+template <class T>
+bool BoundedQueue<T>::push(T item)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!closed_ && !aborted_ && items_.size() >= capacity_)
+        changed_.wait(lock);
+    if (closed_ || aborted_)
+        return(false);
+    items_.push_back(item);
+    changed_.notify_all();
+    return(true);
+}
+
+template <class T>
+bool BoundedQueue<T>::pop(T& item)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!closed_ && !aborted_ && items_.empty())
+        changed_.wait(lock);
+    if (aborted_ || items_.empty())
+        return(false);
+    item = items_.front();
+    items_.pop_front();
+    changed_.notify_all();
+    return(true);
+}
+
+template <class T>
+void BoundedQueue<T>::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    changed_.notify_all();
+}
+
+template <class T>
+void BoundedQueue<T>::abort()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    aborted_ = true;
+    changed_.notify_all();
+}
+
+/// Makes the buffer of one field of a point block, for the writer
+typedef std::function<SourceDestBuffer(PointBlock&)> BufferBinder;
+
+template <class T>
+SourceDestBuffer blockBuffer(ImageFile imf, const ustring& pathName, vector<T>& values)
+{
+    /// A buffer can't be empty, even if the block has no points
+    if (values.empty())
+        values.resize(1);
+    return(SourceDestBuffer(imf, pathName, &values[0], values.size(), true));
+}
+
+SourceDestBuffer blockBuffer(ImageFile imf, const ustring& pathName, vector<uint64_t>& values)
+{
+    /// E57 integers are signed, the offsets into the waveform data are far below 2^63
+    if (values.empty())
+        values.resize(1);
+    return(SourceDestBuffer(imf, pathName, reinterpret_cast<int64_t*>(&values[0]), values.size(), true));
+}
+
+vector<SourceDestBuffer> bindBuffers(vector<BufferBinder>& binders, PointBlock& block)
+{
+    vector<SourceDestBuffer> buffers;
+    for (size_t i = 0; i < binders.size(); i++)
+        buffers.push_back(binders[i](block));
+    return(buffers);
+}
+
+//================================================================
+
 /// Declare local functions:
 void findUnusedFields(CommandLineOptions& options, LASReader& lasf, ImageFile imf, UseInfo& useInfo);
+void assumeFormatFields(LASReader& lasf, UseInfo& useInfo);
 void copyPerScanData(CommandLineOptions& options, LASReader& lasf, ImageFile imf, UseInfo& useInfo);
 void copyVariableLengthRecords(CommandLineOptions& options, LASReader& lasf, ImageFile imf, WaveformDatabase& waveDb);
 void copyWaveformData(CommandLineOptions& options, LASReader& lasf, ImageFile imf, WaveformDatabase& waveDb);
-void copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile imf,
-                      UseInfo& useInfo, GroupingSchemes& groupings, WaveformDatabase& waveDb);
+uint64_t copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile imf, UseInfo& useInfo, UseInfo& pointInfo,
+                          GroupingSchemes& groupings, vector<PointBlock>& pool);
 void copyPerFileData(CommandLineOptions& options, LASReader& lasf, ImageFile imf, UseInfo& useInfo);
+uint64_t convertFile(CommandLineOptions& options, vector<PointBlock>& pool);
+uint64_t writeE57File(CommandLineOptions& options, LASReader& lasf, vector<PointBlock>& pool);
+int convertBatch(CommandLineOptions& options);
 ustring generateUuidString();
 
 int main(int argc, char** argv)
@@ -901,23 +1146,69 @@ int main(int argc, char** argv)
         CommandLineOptions options;
         options.parse(argc, argv);
 
-        /// Open existing LAS file for input
-        LASReader lasf(options.inputFileName);
-        LASPublicHeaderBlock hdr;
-        lasf.getHeader(hdr);
+        /// Convert a whole list of files, in this process
+        if (options.batch)
+            return(convertBatch(options));
+
+        vector<PointBlock> pool;
+        uint64_t totalPointCount = convertFile(options, pool);
+        cout << "converted " << totalPointCount << " points" << endl;
+    } catch(E57Exception& ex) {
+        ex.report(__FILE__, __LINE__, __FUNCTION__);
+        return -1;
+    } catch (std::exception& ex) {
+        cerr << "Got an std::exception, what=" << ex.what() << endl;
+        return -1;
+    } catch (...) {
+        cerr << "Got an unknown exception" << endl;
+        return -1;
+    }
+
+#ifdef E57_DEBUG_MEMORY
+    _ASSERTE(_CrtCheckMemory()); //??? check heap ok
+#endif
+    return 0;
+}
+
+//================================================================
+
+uint64_t convertFile(CommandLineOptions& options, vector<PointBlock>& pool)
+{
+    /// Open existing LAS file for input
+    LASReader lasf(options.inputFileName);
+    LASPublicHeaderBlock hdr;
+    lasf.getHeader(hdr);
 #ifdef E57_VERBOSE
-        hdr.dump(4);
+    hdr.dump(4);
 #endif
 
-        /// Check LAS file is version that this conversion utility supports
-        if (hdr.versionMajor != 1 || hdr.versionMinor > 2) {
-            cout << "ERROR: can't convert LAS version " << hdr.versionMajor << "." << hdr.versionMinor << " files, aborting." << endl;
-            return(-1);
-        }
+    /// Check LAS file is version that this conversion utility supports
+    if (hdr.versionMajor != 1 || hdr.versionMinor > 2) {
+        ostringstream ss;
+        ss << "can't convert LAS version " << (unsigned)hdr.versionMajor << "." << (unsigned)hdr.versionMinor << " files";
+        throw EXCEPTION(ss.str().c_str());
+    }
 
-		/// Create empty E57 file for output
-        ImageFile imf(options.outputFileName, "w");
+    uint64_t totalPointCount;
+    try {
+        totalPointCount = writeE57File(options, lasf, pool);
+    } catch (PointsOutsideExtents&) {
+        /// The prototype ranges were taken from a wrong LAS header, start again and take them from the points
+        CommandLineOptions twoPassOptions = options;
+        twoPassOptions.twoPass = true;
+        totalPointCount = writeE57File(twoPassOptions, lasf, pool);
+    }
+    lasf.close();
+    return(totalPointCount);
+}
+
+uint64_t writeE57File(CommandLineOptions& options, LASReader& lasf, vector<PointBlock>& pool)
+{
+    /// Create empty E57 file for output
+    ImageFile imf(options.outputFileName, "w");
 
+    /// If the conversion fails, don't leave a partial E57 file behind
+    try {
         /// We are using the E57 v1.0 data format standard fieldnames.
         /// The standard fieldnames are used without an extension prefix (in the default namespace).
         /// We explicitly register it for completeness (the reference implementaion would do it for us, if we didn't).
@@ -932,42 +1223,252 @@ int main(int argc, char** argv)
         WaveformDatabase waveDb;
         UseInfo useInfo;
 
-        /// Do a first pass through the LAS points to see what fields are actually used.
-        /// In practice, many "required" fields in an LAS file are filled with zeroes.
-        findUnusedFields(options, lasf, imf, useInfo);
+        if (options.twoPass) {
+            /// Do a first pass through the LAS points to see what fields are actually used.
+            /// In practice, many "required" fields in an LAS file are filled with zeroes.
+            findUnusedFields(options, lasf, imf, useInfo);
+        } else {
+            /// Read the points only once: the point format and header decide which fields are written, and their ranges.
+            assumeFormatFields(lasf, useInfo);
+        }
 #ifdef E57_VERBOSE
         useInfo.dump();
 #endif
 
-		copyPerScanData(options, lasf, imf, useInfo);
-		copyVariableLengthRecords(options, lasf, imf, waveDb);
+        copyPerScanData(options, lasf, imf, useInfo);
+        copyVariableLengthRecords(options, lasf, imf, waveDb);
         copyWaveformData(options, lasf, imf, waveDb);
         GroupingSchemes groupings(useInfo);
-		copyPerPointData(options, lasf, imf, useInfo, groupings, waveDb);
-		copyPerFileData(options, lasf, imf, useInfo);
-    	groupings.write(imf);
+        UseInfo pointInfo;
+        uint64_t totalPointCount = copyPerPointData(options, lasf, imf, useInfo, pointInfo, groupings, pool);
+        copyPerFileData(options, lasf, imf, useInfo);
+        groupings.write(imf, pointInfo);
 
 #ifdef E57_MAX_VERBOSE
         groupings.dump();
         imf.dump();
 #endif
-        lasf.close();
-		imf.close();
-    } catch(E57Exception& ex) {
-        ex.report(__FILE__, __LINE__, __FUNCTION__);
-        return -1;
-    } catch (std::exception& ex) {
-        cerr << "Got an std::exception, what=" << ex.what() << endl;
-        return -1;
+        imf.close();
+        return(totalPointCount);
     } catch (...) {
-        cerr << "Got an unknown exception" << endl;
-        return -1;
+        imf.cancel();
+        throw;
     }
+}
 
-#ifdef E57_DEBUG_MEMORY
-    _ASSERTE(_CrtCheckMemory()); //??? check heap ok
-#endif
-    return 0;
+//================================================================
+
+/// One file of a batch conversion
+struct BatchJob {
+    ustring     inputFileName;
+    ustring     outputFileName;
+    uint64_t    memoryEstimate;
+};
+
+/// Rough memory use of converting one LAS file.
+/// The pool of decoded point blocks dominates, and its size only depends on the record length:
+/// a decoded record takes at most about twice the bytes of the packed LAS record, plus its column index.
+uint64_t conversionMemoryEstimate(const ustring& lasFileName)
+{
+    uint64_t recordLength = 0;
+    try {
+        LASReader lasf(lasFileName);
+        LASPublicHeaderBlock hdr;
+        lasf.getHeader(hdr);
+        recordLength = hdr.pointDataRecordLength;
+    } catch (...) {
+        /// Converting the file will fail too, and report why
+    }
+    return(POINT_BLOCK_POOL * POINT_BLOCK_RECORDS * (2 * recordLength + sizeof(int64_t)));
+}
+
+/// Hands the files of a batch to the worker threads, in order.
+/// A file is only handed out when its memory estimate fits beside the estimates of the files being converted.
+/// If nothing else is running, the next file is handed out anyway, so a file larger than the limit is converted alone.
+class BatchScheduler {
+public:
+                BatchScheduler(vector<BatchJob>& jobs, uint64_t memoryLimit);
+    bool        next(size_t& jobIndex);
+    void        finished(size_t jobIndex);
+
+protected:
+    std::mutex              mutex_;
+    std::condition_variable changed_;
+    vector<BatchJob>&       jobs_;
+    size_t                  nextJob_;
+    uint64_t                memoryLimit_;   /// zero if no limit
+    uint64_t                memoryInUse_;
+    unsigned                runningCount_;
+};
+
+BatchScheduler::BatchScheduler(vector<BatchJob>& jobs, uint64_t memoryLimit)
+: jobs_(jobs),
+  nextJob_(0),
+  memoryLimit_(memoryLimit),
+  memoryInUse_(0),
+  runningCount_(0)
+{
+}
+
+bool BatchScheduler::next(size_t& jobIndex)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (nextJob_ < jobs_.size() && runningCount_ > 0 && memoryLimit_ > 0 &&
+           memoryInUse_ + jobs_[nextJob_].memoryEstimate > memoryLimit_)
+        changed_.wait(lock);
+    if (nextJob_ >= jobs_.size())
+        return(false);
+
+    jobIndex = nextJob_++;
+    memoryInUse_ += jobs_[jobIndex].memoryEstimate;
+    runningCount_++;
+    return(true);
+}
+
+void BatchScheduler::finished(size_t jobIndex)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    memoryInUse_ -= jobs_[jobIndex].memoryEstimate;
+    runningCount_--;
+    changed_.notify_all();
+}
+
+/// Totals of a batch conversion, updated by the worker threads as each file finishes
+struct BatchReport {
+    std::mutex  mutex;
+    unsigned    convertedCount;
+    unsigned    failedCount;
+    uint64_t    pointCount;
+    uint64_t    byteCount;
+
+                BatchReport() : convertedCount(0), failedCount(0), pointCount(0), byteCount(0) {};
+};
+
+void batchWorker(CommandLineOptions& options, vector<BatchJob>& jobs, BatchScheduler& scheduler, BatchReport& report)
+{
+    /// The blocks of points are reused for every file this worker converts
+    vector<PointBlock> pool;
+
+    size_t jobIndex;
+    while (scheduler.next(jobIndex)) {
+        BatchJob& job = jobs[jobIndex];
+        CommandLineOptions fileOptions = options;
+        fileOptions.inputFileName  = job.inputFileName;
+        fileOptions.outputFileName = job.outputFileName;
+
+        /// A file that fails is reported, and doesn't stop the rest of the batch
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint64_t pointCount = 0;
+        ustring  error;
+        try {
+            pointCount = convertFile(fileOptions, pool);
+        } catch (E57Exception& ex) {
+            error = E57Utilities().errorCodeToString(ex.errorCode()) + " " + ex.context();
+        } catch (std::exception& ex) {
+            error = ex.what();
+        } catch (...) {
+            error = "unknown exception";
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        scheduler.finished(jobIndex);
+
+        boost::system::error_code ec;
+        uint64_t byteCount = boost::filesystem::file_size(job.inputFileName, ec);
+        if (ec)
+            byteCount = 0;
+
+        ostringstream line;
+        line << job.inputFileName << " -> " << job.outputFileName << ": ";
+        if (error.empty()) {
+            line << pointCount << " points in " << fixed << setprecision(2) << seconds << " s";
+            if (seconds > 0)
+                line << " (" << setprecision(0) << pointCount / seconds << " points/s, "
+                     << setprecision(1) << byteCount / seconds / (1024 * 1024) << " MB/s)";
+        } else
+            line << "FAILED, " << error;
+
+        std::lock_guard<std::mutex> lock(report.mutex);
+        if (error.empty()) {
+            report.convertedCount++;
+            report.pointCount += pointCount;
+            report.byteCount  += byteCount;
+        } else
+            report.failedCount++;
+        cout << line.str() << endl;
+    }
+}
+
+int convertBatch(CommandLineOptions& options)
+{
+    /// The input is either a directory of LAS files, or a file listing them one per line
+    vector<ustring> inputFileNames;
+    boost::filesystem::path source(options.inputFileName);
+    if (boost::filesystem::is_directory(source)) {
+        for (boost::filesystem::directory_iterator it(source), end; it != end; ++it) {
+            ustring extension = it->path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (boost::filesystem::is_regular_file(it->status()) && extension == ".las")
+                inputFileNames.push_back(it->path().string());
+        }
+        std::sort(inputFileNames.begin(), inputFileNames.end());
+    } else {
+        ifstream list(options.inputFileName.c_str());
+        if (!list)
+            throw EXCEPTION(("can't open list file " + options.inputFileName).c_str());
+        ustring line;
+        while (getline(list, line)) {
+            /// Tolerate DOS line ends and blank lines
+            while (!line.empty() && isspace(static_cast<unsigned char>(line[line.size() - 1])))
+                line.erase(line.size() - 1);
+            if (!line.empty())
+                inputFileNames.push_back(line);
+        }
+    }
+
+    /// Each file is written to the output directory, under the name of the LAS file
+    boost::filesystem::path outputDirectory(options.outputFileName);
+    /// LAS files of the same name (e.g. from different directories of a list file) would overwrite each other's output,
+    /// so the whole batch is refused.  Names are compared ignoring case, for case insensitive file systems.
+    vector<BatchJob> jobs(inputFileNames.size());
+    map<ustring, size_t> outputNames;
+    for (size_t i = 0; i < inputFileNames.size(); i++) {
+        jobs[i].inputFileName  = inputFileNames[i];
+        jobs[i].outputFileName = (outputDirectory / (boost::filesystem::path(inputFileNames[i]).stem().string() + ".e57")).string();
+        ustring outputName = jobs[i].outputFileName;
+        std::transform(outputName.begin(), outputName.end(), outputName.begin(), ::tolower);
+        if (!outputNames.insert(make_pair(outputName, i)).second) {
+            throw EXCEPTION(("both " + inputFileNames[outputNames[outputName]] + " and " + inputFileNames[i]
+                             + " would be converted to " + jobs[i].outputFileName).c_str());
+        }
+        jobs[i].memoryEstimate = options.memoryLimit ? conversionMemoryEstimate(inputFileNames[i]) : 0;
+    }
+    boost::filesystem::create_directories(outputDirectory);
+
+    unsigned workerCount = options.jobs ? options.jobs : std::thread::hardware_concurrency();
+    if (workerCount > jobs.size())
+        workerCount = static_cast<unsigned>(jobs.size());
+    if (workerCount == 0)
+        workerCount = 1;
+
+    /// The workers share this process, so the XML parser setup of the E57 library is only done once
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BatchScheduler scheduler(jobs, options.memoryLimit);
+    BatchReport report;
+    vector<std::thread> workers;
+    for (unsigned i = 0; i < workerCount; i++)
+        workers.push_back(std::thread(batchWorker, std::ref(options), std::ref(jobs), std::ref(scheduler), std::ref(report)));
+    for (unsigned i = 0; i < workers.size(); i++)
+        workers[i].join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    ostringstream summary;
+    summary << "converted " << report.convertedCount << " of " << jobs.size() << " files with " << workerCount << " jobs: "
+            << report.pointCount << " points in " << fixed << setprecision(2) << seconds << " s";
+    if (seconds > 0)
+        summary << " (" << setprecision(0) << report.pointCount / seconds << " points/s, "
+                << setprecision(1) << report.byteCount / seconds / (1024 * 1024) << " MB/s)";
+    cout << summary.str() << endl;
+    return(report.failedCount > 0 ? -1 : 0);
 }
 
 //================================================================
@@ -977,32 +1478,22 @@ void findUnusedFields(CommandLineOptions& options, LASReader& lasf, ImageFile im
     LASPublicHeaderBlock hdr;
     lasf.getHeader(hdr);
 
-    const unsigned N = 10*1024;
-    vector<LASPointDataRecord> pointBuffer(N);
+    LASPointBlock   block;
+    vector<int64_t> columnIndices;
+    ColumnCounter   columns;
 
-    unsigned    totalPointCount = hdr.numberOfPointRecords;
-    unsigned    recordCount = 0;
-    bool        lastScanDirectionFlag = false;
-    int64_t     columnIndex = 0;
-    for (unsigned currentRecord = 0; currentRecord < totalPointCount; currentRecord += recordCount) {
-        recordCount = min(N, totalPointCount - currentRecord);
+    uint64_t totalPointCount = lasf.pointCount();
+    for (uint64_t currentRecord = 0; currentRecord < totalPointCount; currentRecord += block.count) {
 #ifdef E57_MAX_VERBOSE
-        cerr << "reading " << recordCount << endl;
+        cerr << "reading " << POINT_BLOCK_RECORDS << endl;
 #endif
-        lasf.readPoints(&pointBuffer[0], currentRecord, recordCount);
+        if (lasf.readPointBlock(block, currentRecord, POINT_BLOCK_RECORDS) == 0)
+            break;
 
         /// Process each point and note fields that are used (have non-zero values).
-        for (unsigned i = 0; i < recordCount; i++) {
-            /// Look for reverses in scan direction to delimit columns
-            if (currentRecord != 0 || i != 0) {
-                if (lastScanDirectionFlag != pointBuffer[i].scanDirectionFlag)
-                    columnIndex++;
-            }
-            lastScanDirectionFlag = pointBuffer[i].scanDirectionFlag;
-
-            useInfo.processPoint(hdr, pointBuffer[i], columnIndex);
-        }
-     }
+        columns.assign(block, columnIndices);
+        useInfo.processBlock(block, columnIndices);
+    }
 
 #ifdef E57_VERBOSE
     cout << "searched " << totalPointCount << " points" << endl;
@@ -1011,6 +1502,27 @@ void findUnusedFields(CommandLineOptions& options, LASReader& lasf, ImageFile im
 
 //================================================================
 
+void assumeFormatFields(LASReader& lasf, UseInfo& useInfo)
+{
+    LASPublicHeaderBlock hdr;
+    lasf.getHeader(hdr);
+
+    useInfo.assumeFormat(hdr, lasf.pointCount());
+
+    /// The acquisition start may come from the point times, take it from the first block of points.
+    /// Later points can be earlier, the E57 timeStamps relative to it are negative then.
+    LASPointBlock sample;
+    lasf.readPointBlock(sample, 0, POINT_BLOCK_RECORDS);
+    UseInfo sampleInfo;
+    sampleInfo.processBlock(sample, vector<int64_t>());
+    useInfo.minimumGpsTime = sampleInfo.minimumGpsTime;
+    useInfo.maximumGpsTime = sampleInfo.maximumGpsTime;
+    if (!sampleInfo.gpsTimeUsed)
+        useInfo.minimumGpsTime = 0.0;
+}
+
+//================================================================
+
 void copyPerScanData(CommandLineOptions& options, LASReader& lasf, ImageFile imf, UseInfo& useInfo)
 {
     LASPublicHeaderBlock hdr;
@@ -1101,7 +1613,8 @@ void copyPerScanData(CommandLineOptions& options, LASReader& lasf, ImageFile imf
                     }
 
                     if (options.unusedNotOptional || useInfo.gpsTimeUsed) {
-                        /// Use smallest absolute gps time from points as aquisition start.
+                        /// Use smallest absolute gps time from points as aquisition start, from all the points with two passes,
+                        /// else from the first block of points (see assumeFormatFields).
                         /// Add back in the offset that the LAS standard subtracts out.
                         /// We don't lose resolution in E57 file because timeStamps are always relative to acquisitionStart.
                         StructureNode dateTimeStruct = StructureNode(imf);
@@ -1121,16 +1634,7 @@ void copyPerScanData(CommandLineOptions& options, LASReader& lasf, ImageFile imf
     scan0.set("las:publicHeaderBlockData", rawHeaderBlob);
     rawHeaderBlob.write(&rawHeader[0], 0LL, static_cast<uint64_t>(rawHeader.size()));
 
-    /// Add bounding box, pathname: "/data3D/0/cartesianBounds/xMinimum" etc...
-    /// Don't use bounding box in LAS header, use the one computed by this program ("guaranteed" to be right).
-    StructureNode bbox = StructureNode(imf);
-    scan0.set("cartesianBounds", bbox);
-    bbox.set("xMinimum", FloatNode(imf, hdr.xScaleFactor * useInfo.minimumX + hdr.xOffset, E57_DOUBLE));
-    bbox.set("xMaximum", FloatNode(imf, hdr.xScaleFactor * useInfo.maximumX + hdr.xOffset, E57_DOUBLE));
-    bbox.set("yMinimum", FloatNode(imf, hdr.yScaleFactor * useInfo.minimumY + hdr.yOffset, E57_DOUBLE));
-    bbox.set("yMaximum", FloatNode(imf, hdr.yScaleFactor * useInfo.maximumY + hdr.yOffset, E57_DOUBLE));
-    bbox.set("zMinimum", FloatNode(imf, hdr.zScaleFactor * useInfo.minimumZ + hdr.zOffset, E57_DOUBLE));
-    bbox.set("zMaximum", FloatNode(imf, hdr.zScaleFactor * useInfo.maximumZ + hdr.zOffset, E57_DOUBLE));
+    /// The bounding box is added by copyPerPointData, from the coordinates written.
 }
 
 //================================================================
@@ -1223,8 +1727,8 @@ void copyWaveformData(CommandLineOptions& options, LASReader& lasf, ImageFile im
 
 //================================================================
 
-void copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile imf,
-                      UseInfo& useInfo, GroupingSchemes& groupings, WaveformDatabase& waveDb)
+uint64_t copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile imf, UseInfo& useInfo, UseInfo& pointInfo,
+                          GroupingSchemes& groupings, vector<PointBlock>& pool)
 {
     LASPublicHeaderBlock hdr;
     lasf.getHeader(hdr);
@@ -1251,105 +1755,103 @@ void copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile im
     /// This prototype will be used in creating the points CompressedVector.
     /// The prototype is a flat structure containing each field.
     /// Using this proto in a CompressedVector will form path names like: "/data3D/0/points/0/cartesianX".
+    /// The buffers of the fields are bound to the arrays of each block of points as it is written.
     StructureNode proto = StructureNode(imf);
-    const unsigned N = 10*1024;
-    vector<SourceDestBuffer> sourceBuffers;
+    vector<BufferBinder> binders;
 
-    vector<LASPointDataRecord> pointBuffer(N);
-    vector<int64_t> columnIndices(N);
     bool writingTimeStamp = false;
     double lasTimeOffset = 0.0;  // amount to add to gpsTime in LAS point record to get absolute GPS time.
     double e57TimeOffset = 0.0;  // amount to add to timeStamp in E57 point record to get absolute GPS time.
 
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianX", &pointBuffer[0].x, N, true, false, sizeof(LASPointDataRecord)));
+    binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "cartesianX", block.las.x));});
     proto.set("cartesianX",  ScaledIntegerNode(imf, useInfo.minimumX, useInfo.minimumX, useInfo.maximumX, hdr.xScaleFactor, hdr.xOffset));
 
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianY", &pointBuffer[0].y, N, true, false, sizeof(LASPointDataRecord)));
+    binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "cartesianY", block.las.y));});
     proto.set("cartesianY",  ScaledIntegerNode(imf, useInfo.minimumY, useInfo.minimumY, useInfo.maximumY, hdr.yScaleFactor, hdr.yOffset));
 
-    sourceBuffers.push_back(SourceDestBuffer(imf, "cartesianZ", &pointBuffer[0].z, N, true, false, sizeof(LASPointDataRecord)));
+    binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "cartesianZ", block.las.z));});
     proto.set("cartesianZ",  ScaledIntegerNode(imf, useInfo.minimumZ, useInfo.minimumZ, useInfo.maximumZ, hdr.zScaleFactor, hdr.zOffset));
 
     if (options.unusedNotOptional || useInfo.intensityUsed) {
-        sourceBuffers.push_back(SourceDestBuffer(imf, "intensity", &pointBuffer[0].intensity, N, true, false, sizeof(LASPointDataRecord)));
+        binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "intensity", block.las.intensity));});
         proto.set("intensity",  IntegerNode(imf, 0, E57_UINT16_MIN, E57_UINT16_MAX)); //!!! get rid of overloads!
     }
 
     if (useInfo.maximumColumnIndex > 0) {
-        sourceBuffers.push_back(SourceDestBuffer(imf, "columnIndex", &columnIndices[0], N, true, false));
+        binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "columnIndex", block.columnIndices));});
         proto.set("columnIndex",  IntegerNode(imf, 0, 0, useInfo.maximumColumnIndex));
     }
 
     if (options.unusedNotOptional || useInfo.returnNumberUsed) {
-        sourceBuffers.push_back(SourceDestBuffer(imf, "returnIndex", &pointBuffer[0].returnNumber, N, true, false, sizeof(LASPointDataRecord)));
+        binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "returnIndex", block.las.returnNumber));});
         proto.set("returnIndex",  IntegerNode(imf, 0, 0, useInfo.maximumReturnIndex));
     }
 
     if (options.unusedNotOptional || useInfo.numberOfReturnsUsed) {
-        sourceBuffers.push_back(SourceDestBuffer(imf, "returnCount", &pointBuffer[0].numberOfReturns, N, true, false, sizeof(LASPointDataRecord)));
+        binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "returnCount", block.las.numberOfReturns));});
         proto.set("returnCount",  IntegerNode(imf, 0, 0, max(useInfo.maximumReturnCount, useInfo.maximumReturnIndex)));
     }
     if (options.unusedNotOptional || useInfo.scanDirectionFlagUsed) {
-        sourceBuffers.push_back(SourceDestBuffer(imf, "las:scanDirectionFlag", &pointBuffer[0].scanDirectionFlag, N, true, false, sizeof(LASPointDataRecord)));
+        binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:scanDirectionFlag", block.las.scanDirectionFlag));});
         proto.set("las:scanDirectionFlag",  IntegerNode(imf, 0, 0, 1));
     }
 
     if (options.unusedNotOptional || useInfo.edgeOfFlightLineUsed) {
-        sourceBuffers.push_back(SourceDestBuffer(imf, "las:edgeOfFlightLine", &pointBuffer[0].edgeOfFlightLine, N, true, false, sizeof(LASPointDataRecord)));
+        binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:edgeOfFlightLine", block.las.edgeOfFlightLine));});
         proto.set("las:edgeOfFlightLine",  IntegerNode(imf, 0, 0, 1));
     }
 
     /// LAS v1.0 had 8 bit classification field, >v1.0 has 5 bit field.
     /// Specifying actual min and max used, so don't care about size in LAS file.
     if (options.unusedNotOptional || useInfo.classificationUsed) {
-        sourceBuffers.push_back(SourceDestBuffer(imf, "las:classification", &pointBuffer[0].classification, N, true, false, sizeof(LASPointDataRecord)));
+        binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:classification", block.las.classification));});
         proto.set("las:classification",  IntegerNode(imf, useInfo.minimumClassification, useInfo.minimumClassification, useInfo.maximumClassification));
     }
 
     if (hdr.versionMajor == 1 && hdr.versionMinor > 0) {
         if (options.unusedNotOptional || useInfo.syntheticUsed) {
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:synthetic", &pointBuffer[0].synthetic, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:synthetic", block.las.synthetic));});
             proto.set("las:synthetic",  IntegerNode(imf, 0, 0, 1));
         }
 
         if (options.unusedNotOptional || useInfo.keyPointUsed) {
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:keyPoint", &pointBuffer[0].keyPoint, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:keyPoint", block.las.keyPoint));});
             proto.set("las:keyPoint",  IntegerNode(imf, 0, 0, 1));
         }
 
         if (options.unusedNotOptional || useInfo.withheldUsed) {
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:withheld", &pointBuffer[0].withheld, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:withheld", block.las.withheld));});
             proto.set("las:withheld",  IntegerNode(imf, 0, 0, 1));
         }
     }
     if (options.unusedNotOptional || useInfo.scanAngleRankUsed) {
-        sourceBuffers.push_back(SourceDestBuffer(imf, "las:scanAngleRank", &pointBuffer[0].scanAngleRank, N, true, false, sizeof(LASPointDataRecord)));
+        binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:scanAngleRank", block.las.scanAngleRank));});
         proto.set("las:scanAngleRank",  IntegerNode(imf, useInfo.minimumScanAngleRank, useInfo.minimumScanAngleRank, useInfo.maximumScanAngleRank));
     }
 
     if (hdr.versionMajor == 1 && hdr.versionMinor == 0) {
         /// LAS v1.0 had file marker and user bit fields
         if (options.unusedNotOptional || useInfo.fileMarkerUsed) {
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:fileMarker", &pointBuffer[0].fileMarker, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:fileMarker", block.las.fileMarker));});
             proto.set("las:fileMarker",  IntegerNode(imf, 0, E57_UINT8_MIN, E57_UINT8_MAX));
         }
 
         if (options.unusedNotOptional || useInfo.userBitFieldUsed) {
             /// Reusing las:userData field name rather than create new name.  Means that may be either 16 bits or 8 bits.
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:userData", &pointBuffer[0].userBitField, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:userData", block.las.userBitField));});
             proto.set("las:userData",  IntegerNode(imf, 0, E57_UINT16_MIN, E57_UINT16_MAX));
         }
     } else {
         /// LAS v1.1+ has user data and point source id
         if (options.unusedNotOptional || useInfo.userDataUsed) {
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:userData", &pointBuffer[0].userData, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:userData", block.las.userData));});
             proto.set("las:userData",  IntegerNode(imf, 0, E57_UINT8_MIN, E57_UINT8_MAX));
         }
 
         /// Note a zero value of pointSourceId should be interpreted as the fileSourceId of this file.
         /// So if this field isn't defined (because all zero), this should be interpreted as all pointSourcIds set to fileSourceId.
         if (options.unusedNotOptional || useInfo.pointSourceIdUsed) {
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:pointSourceId", &pointBuffer[0].pointSourceId, N, true, false,sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:pointSourceId", block.las.pointSourceId));});
             proto.set("las:pointSourceId",  IntegerNode(imf, 0, E57_UINT16_MIN, E57_UINT16_MAX));
         }
     }
@@ -1361,7 +1863,7 @@ void copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile im
         case 5:
             if (options.unusedNotOptional || useInfo.gpsTimeUsed) {
                 writingTimeStamp = true;
-                sourceBuffers.push_back(SourceDestBuffer(imf, "timeStamp", &pointBuffer[0].gpsTime, N, true, false, sizeof(LASPointDataRecord)));
+                binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "timeStamp", block.las.gpsTime));});
                 proto.set("timeStamp", FloatNode(imf, 0.0, E57_DOUBLE));
 
                 /// Calc lasTimeOffset, the amount that is added to gpsTime in LAS point record to get absolute GPS time.
@@ -1403,13 +1905,13 @@ void copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile im
         case 3:
         case 5:
             if (options.unusedNotOptional || useInfo.redUsed || useInfo.blueUsed || useInfo.greenUsed) {
-                sourceBuffers.push_back(SourceDestBuffer(imf, "colorRed", &pointBuffer[0].red, N, true, false, sizeof(LASPointDataRecord)));
+                binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "colorRed", block.las.red));});
                 proto.set("colorRed", IntegerNode(imf, 0, E57_UINT16_MIN, E57_UINT16_MAX));
 
-                sourceBuffers.push_back(SourceDestBuffer(imf, "colorGreen", &pointBuffer[0].green, N, true, false, sizeof(LASPointDataRecord)));
+                binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "colorGreen", block.las.green));});
                 proto.set("colorGreen", IntegerNode(imf, 0, E57_UINT16_MIN, E57_UINT16_MAX));
 
-                sourceBuffers.push_back(SourceDestBuffer(imf, "colorBlue", &pointBuffer[0].blue, N, true, false, sizeof(LASPointDataRecord)));
+                binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "colorBlue", block.las.blue));});
                 proto.set("colorBlue", IntegerNode(imf, 0, E57_UINT16_MIN, E57_UINT16_MAX));
             }
             break;
@@ -1418,25 +1920,25 @@ void copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile im
     switch (hdr.pointDataFormatId) {
         case 4:
         case 5:
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:wavePacketDescriptorIndex", &pointBuffer[0].wavePacketDescriptorIndex, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:wavePacketDescriptorIndex", block.las.wavePacketDescriptorIndex));});
             proto.set("las:wavePacketDescriptorIndex",  IntegerNode(imf, 0, E57_UINT8_MIN, E57_UINT8_MAX));
 
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:byteOffsetToWaveformData", reinterpret_cast<int64_t*>(&pointBuffer[0].byteOffsetToWaveformData), N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:byteOffsetToWaveformData", block.las.byteOffsetToWaveformData));});
             proto.set("las:byteOffsetToWaveformData",  IntegerNode(imf, 0LL, 0LL, E57_INT64_MAX));
 
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:waveformPacketSizeInBytes", &pointBuffer[0].waveformPacketSizeInBytes, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:waveformPacketSizeInBytes", block.las.waveformPacketSizeInBytes));});
             proto.set("las:waveformPacketSizeInBytes",  IntegerNode(imf, 0LU, E57_UINT32_MIN, E57_UINT32_MAX));
 
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:returnPointWaveformLocation", &pointBuffer[0].returnPointWaveformLocation, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:returnPointWaveformLocation", block.las.returnPointWaveformLocation));});
             proto.set("las:returnPointWaveformLocation",  FloatNode(imf, 0.0, E57_SINGLE));
 
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:xT", &pointBuffer[0].xT, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:xT", block.las.xT));});
             proto.set("las:xT",  FloatNode(imf, 0.0, E57_SINGLE));
 
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:yT", &pointBuffer[0].yT, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:yT", block.las.yT));});
             proto.set("las:yT",  FloatNode(imf, 0.0, E57_SINGLE));
 
-            sourceBuffers.push_back(SourceDestBuffer(imf, "las:zT", &pointBuffer[0].zT, N, true, false, sizeof(LASPointDataRecord)));
+            binders.push_back([=](PointBlock& block) {return(blockBuffer(imf, "las:zT", block.las.zT));});
             proto.set("las:zT",  FloatNode(imf, 0.0, E57_SINGLE));
             break;
     }
@@ -1446,58 +1948,134 @@ void copyPerPointData(CommandLineOptions& options, LASReader& lasf, ImageFile im
     CompressedVectorNode points = CompressedVectorNode(imf, proto, codecs);
     scan0.set("points", points);
 
-    unsigned totalPointCount = hdr.numberOfPointRecords;
-    int64_t columnIndex = 0;
-    bool lastScanDirectionFlag = false;
-    {
-        CompressedVectorWriter writer = points.writer(sourceBuffers);
-
-        unsigned recordCount = 0;
-        for (unsigned currentRecord = 0; currentRecord < totalPointCount; currentRecord += recordCount) {
-            recordCount = min(N, totalPointCount - currentRecord);
-#ifdef E57_MAX_VERBOSE
-            cerr << "reading " << recordCount << endl;
-#endif
-            lasf.readPoints(&pointBuffer[0], currentRecord, recordCount);
-
-            /// If we can compute columnIndex, do so for each point we read
-            if (useInfo.maximumColumnIndex > 0) {
-                for (unsigned i = 0; i < recordCount; i++) {
-                    /// Look for reverses in scan direction to delimit columns
-                    if (currentRecord != 0 || i != 0) {
-                        if (lastScanDirectionFlag != (pointBuffer[i].scanDirectionFlag != 0))
-                            columnIndex++;
-                    }
-                    lastScanDirectionFlag = (pointBuffer[i].scanDirectionFlag != 0);
-
-                    /// Save current column index in buffer for writing
-                    columnIndices[i] = columnIndex;
-                }
+    /// Points go through three stages, connected by queues of blocks:
+    ///   the reader thread decodes blocks of LAS records,
+    ///   the converter thread numbers the columns, gathers statistics and groupings, and adjusts the time stamps,
+    ///   and this thread encodes the blocks into the E57 file.
+    /// A fixed pool of blocks circulates through the stages, so the stages overlap with bounded memory use.
+    /// The pool belongs to the caller, so a batch of conversions reuses the arrays of the blocks.
+    pool.resize(POINT_BLOCK_POOL);
+    BoundedQueue<PointBlock*> freeBlocks(POINT_BLOCK_POOL);
+    BoundedQueue<PointBlock*> readBlocks(POINT_BLOCK_POOL);
+    BoundedQueue<PointBlock*> convertedBlocks(POINT_BLOCK_POOL);
+    for (size_t i = 0; i < pool.size(); i++)
+        freeBlocks.push(&pool[i]);
+
+    /// The first failure stops every stage, and is rethrown once they have all finished
+    std::exception_ptr readerError, converterError, encoderError;
+    auto abortAll = [&]() {
+        freeBlocks.abort();
+        readBlocks.abort();
+        convertedBlocks.abort();
+    };
+
+    /// The writer starts out bound to an empty block, the arrays of the pool may still have the sizes of an earlier file
+    PointBlock emptyBlock;
+    vector<SourceDestBuffer> sourceBuffers = bindBuffers(binders, emptyBlock);
+    CompressedVectorWriter writer = points.writer(sourceBuffers);
+
+    uint64_t totalPointCount = lasf.pointCount();
+    std::thread reader([&]() {
+        try {
+            uint64_t recordCount = 0;
+            for (uint64_t currentRecord = 0; currentRecord < totalPointCount; currentRecord += recordCount) {
+                PointBlock* block;
+                if (!freeBlocks.pop(block))
+                    break;
+                block->startRecord = currentRecord;
+                recordCount = lasf.readPointBlock(block->las, currentRecord, POINT_BLOCK_RECORDS);
+                if (recordCount == 0 || !readBlocks.push(block))
+                    break;
             }
+            readBlocks.close();
+        } catch (...) {
+            readerError = std::current_exception();
+            abortAll();
+        }
+    });
+
+    std::thread converter([&]() {
+        try {
+            ColumnCounter columns;
+            PointBlock* block;
+            while (readBlocks.pop(block)) {
+                /// If we can compute columnIndex, do so for each point we read
+                if (useInfo.maximumColumnIndex > 0)
+                    columns.assign(block->las, block->columnIndices);
+
+                /// Statistics of the points actually converted, the prototype ranges have to hold them
+                pointInfo.processBlock(block->las, block->columnIndices);
+                if (pointInfo.minimumX < useInfo.minimumX || pointInfo.maximumX > useInfo.maximumX ||
+                    pointInfo.minimumY < useInfo.minimumY || pointInfo.maximumY > useInfo.maximumY ||
+                    pointInfo.minimumZ < useInfo.minimumZ || pointInfo.maximumZ > useInfo.maximumZ)
+                    throw PointsOutsideExtents();
+
+                /// Add each point into various grouping schemes
+                groupings.addBlock(hdr, block->las, block->startRecord, block->columnIndices);
+
+                /// Adjust time stamp for new offset
+                if (writingTimeStamp) {
+                    /// Want timeStamp+e57TimeOffset to be as close as possible to gpsTime+lasTimeOffset
+                    /// So timeStamp = gpsTime+lasTimeOffset - e57TimeOffset
+                    /// Be careful about order of addition/subtraction so as not to lose resolution.
+                    /// Subtract two larger numbers first.  It is OK to trash old value of gpsTime here.
+                    long double netOffset = lasTimeOffset - e57TimeOffset;
+                    vector<double>& gpsTime = block->las.gpsTime;
+                    for (size_t i = 0; i < gpsTime.size(); i++)
+                        gpsTime[i] += netOffset;
+                }
 
-            /// Adjust time stamp for new offset
-            if (writingTimeStamp) {
-                /// Want timeStamp+e57TimeOffset to be as close as possible to gpsTime+lasTimeOffset
-                /// So timeStamp = gpsTime+lasTimeOffset - e57TimeOffset
-                /// Be careful about order of addition/subtraction so as not to lose resolution.
-                /// Subtract two larger numbers first.  It is OK to trash old value of gpsTime here.
-                long double netOffset = lasTimeOffset - e57TimeOffset;
-                for (unsigned i = 0; i < recordCount; i++)
-                    pointBuffer[i].gpsTime += netOffset;
+                if (!convertedBlocks.push(block))
+                    break;
             }
-#ifdef E57_MAX_VERBOSE
-            cerr << "writing " << recordCount << endl;
-#endif
-            writer.write(recordCount);
+            convertedBlocks.close();
+        } catch (...) {
+            converterError = std::current_exception();
+            abortAll();
+        }
+    });
 
-            /// Add each point into various grouping schemes
-            for (unsigned i = 0; i < recordCount; i++)
-                groupings.addMember(hdr, pointBuffer[i], currentRecord+i, columnIndices[i]);
+    {
+        try {
+            PointBlock* block;
+            while (convertedBlocks.pop(block)) {
+                sourceBuffers = bindBuffers(binders, *block);
+                writer.write(sourceBuffers, static_cast<size_t>(block->las.count));
+                if (!freeBlocks.push(block))
+                    break;
+            }
+        } catch (...) {
+            encoderError = std::current_exception();
+            abortAll();
+        }
+        reader.join();
+        converter.join();
+        if (readerError)
+            std::rethrow_exception(readerError);
+        if (converterError)
+            std::rethrow_exception(converterError);
+        if (encoderError)
+            std::rethrow_exception(encoderError);
+
+        /// Add bounding box, pathname: "/data3D/0/cartesianBounds/xMinimum" etc...
+        /// Don't use bounding box in LAS header, use the range of the coordinates written ("guaranteed" to be right).
+        double minimum[3], maximum[3];
+        if (writer.sourceRange("cartesianX", minimum[0], maximum[0]) &&
+            writer.sourceRange("cartesianY", minimum[1], maximum[1]) &&
+            writer.sourceRange("cartesianZ", minimum[2], maximum[2])) {
+            StructureNode bbox = StructureNode(imf);
+            scan0.set("cartesianBounds", bbox);
+            bbox.set("xMinimum", FloatNode(imf, hdr.xScaleFactor * minimum[0] + hdr.xOffset, E57_DOUBLE));
+            bbox.set("xMaximum", FloatNode(imf, hdr.xScaleFactor * maximum[0] + hdr.xOffset, E57_DOUBLE));
+            bbox.set("yMinimum", FloatNode(imf, hdr.yScaleFactor * minimum[1] + hdr.yOffset, E57_DOUBLE));
+            bbox.set("yMaximum", FloatNode(imf, hdr.yScaleFactor * maximum[1] + hdr.yOffset, E57_DOUBLE));
+            bbox.set("zMinimum", FloatNode(imf, hdr.zScaleFactor * minimum[2] + hdr.zOffset, E57_DOUBLE));
+            bbox.set("zMaximum", FloatNode(imf, hdr.zScaleFactor * maximum[2] + hdr.zOffset, E57_DOUBLE));
         }
 
         writer.close();
     }
-    cout << "converted " << totalPointCount << " points" << endl;
+    return(totalPointCount);
 }
 
 //================================================================